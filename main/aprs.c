@@ -30,6 +30,7 @@
 #include <math.h>
 #include <errno.h>
 #include <unistd.h>
+#include <ctype.h>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -38,9 +39,11 @@
 
 #include <esp_log.h>
 #include <esp_rom_crc.h>
+#include <esp_random.h>
+#include <esp_system.h>
+#include <esp_timer.h>
 #include <esp_event.h>
 #include <nvs.h>
-#include <esp_spiffs.h>
 
 #ifndef __P
 #define __P(arg) arg
@@ -67,27 +70,87 @@
 #include "aprs_parsers.h"
 #include "aprs_encoder.h"
 #include "aprs_log.h"
+#include "aprs_lsdb.h"
+#include "aprs_journal.h"
+#include "aprs_msg.h"
+#include "aprs_objects.h"
+#include "aprs_telemetry.h"
+#include "aprs_query.h"
+#include "storage.h"
+#include "main.h"
 
 #define TAG	"APRS"
 
-#ifndef NSDEBUG
-#define APRS_TASK_STACK_SIZE	4096+1024
+// Query replies, message retries and beacons are encoded and sent from the task loop
+#ifndef NDEBUG
+#define APRS_TASK_STACK_SIZE	6144+1024
 #else
-#define APRS_TASK_STACK_SIZE	4096
+#define APRS_TASK_STACK_SIZE	6144
 #endif
 
 #define APRS_TASK_PRIORITY	3
 #define APRS_FRAME_POOL_SIZE 4
 #define APRS_EVENT_SEND_TIMEOUT 100
-#define APRS_STATIONS_DB_FILE	"/spiffs/stations.db"
+#define APRS_STATIONS_DB_FILE	STORAGE_PATH("stations.db")
+#define APRS_STATIONS_LOG_PATH	STORAGE_PATH("stations")	// Segments are stations.<number>
+#define APRS_STATIONS_LOG_PERCENT	50	// Max part of filesystem used by stations log
+#define APRS_STATIONS_JOURNAL	STORAGE_PATH("stations.jnl")	// Updates since last btree sync
+#define APRS_STATIONS_DB_NEW	STORAGE_PATH("stations.new")	// Btree rebuilt at boot
+#define APRS_STATIONS_RECOVERY	STORAGE_PATH("stations.rec")	// Present while btree is opened and recovered
+#define APRS_STATIONS_OPEN_TIMEOUT	600	// Seconds, far above a rebuild of APRS_STATIONS_CHECK_MAX entries
 #define APRS_QUEUE_SIZE	5
 
+#ifdef CONFIG_ESP32S3APRS_APRS_OBJECTS_MAX
+#define APRS_OBJECTS_MAX	CONFIG_ESP32S3APRS_APRS_OBJECTS_MAX
+#else
+#define APRS_OBJECTS_MAX	64
+#endif
+
+#ifdef CONFIG_ESP32S3APRS_APRS_TELEMETRY_STATIONS
+#define APRS_TELEMETRY_STATIONS	CONFIG_ESP32S3APRS_APRS_TELEMETRY_STATIONS
+#else
+#define APRS_TELEMETRY_STATIONS	8
+#endif
+
+#ifdef CONFIG_ESP32S3APRS_APRS_CACHE_SIZE
+#define APRS_CACHE_SIZE	CONFIG_ESP32S3APRS_APRS_CACHE_SIZE
+#define APRS_CACHE_DIRTY	CONFIG_ESP32S3APRS_APRS_CACHE_DIRTY
+#define APRS_CACHE_AGE	CONFIG_ESP32S3APRS_APRS_CACHE_AGE
+#define APRS_CACHE_LOW_BATTERY	CONFIG_ESP32S3APRS_APRS_CACHE_LOW_BATTERY
+#else
+#define APRS_CACHE_SIZE	32
+#define APRS_CACHE_DIRTY	16
+#define APRS_CACHE_AGE	60
+#define APRS_CACHE_LOW_BATTERY	3400
+#endif
+
+#ifdef CONFIG_ESP32S3APRS_APRS_MAX_STATIONS
+#define APRS_MAX_STATIONS	CONFIG_ESP32S3APRS_APRS_MAX_STATIONS
+#define APRS_MAX_AGE	CONFIG_ESP32S3APRS_APRS_MAX_AGE
+#define APRS_PINNED	CONFIG_ESP32S3APRS_APRS_PINNED
+#else
+#define APRS_MAX_STATIONS	2000
+#define APRS_MAX_AGE	168
+#define APRS_PINNED	""
+#endif
+
+#define APRS_MAX_PINNED	8
+// Entries visited by boot check and rebuild : station, time and geo entries plus retention slack
+#define APRS_STATIONS_CHECK_MAX	((APRS_MAX_STATIONS?APRS_MAX_STATIONS:100000)*4)
+#define APRS_RETENTION_PERIOD	600	// Seconds between retention passes
+#define APRS_RETENTION_BUDGET	32	// Index entries visited per task loop
+
+#define APRS_EARTH_RADIUS	3959.0	// miles
+#define APRS_PARSE_STATS_PERIOD	100	// Frames between parser stats log
+
 enum APRS_Event_E {
 	APRS_EVENT_FRAME_RECEIVED,	// Receive frame
 	APRS_EVENT_GPS,			// Receive GPS data
 	APRS_SEND_STATUS,		// Request to send status (text in aprs data)
 	APRS_SEND_POSITION,
 	APRS_RESET_DB,
+	APRS_SEND_MESSAGE,		// Queue message (addressee and text in message)
+	APRS_FLUSH_DB,			// Write cached stations to flash
 };
 
 typedef struct APRS_Event_S {
@@ -104,6 +167,10 @@ typedef struct APRS_Event_S {
 		};
 		AX25_Addr_t addr;
 		char text[64];
+		struct {
+			char addressee[10];
+			char text[68];
+		} message;
 	};
 } APRS_Event_t;
 
@@ -118,6 +185,9 @@ struct APRS_S {
 
 	nvs_handle_t nvs;
 
+	APRS_Msg_t * msg;	// messaging engine
+	APRS_Query_t * query;	// query responder
+
 	SB_t sb;	// smart beaconing state
 	bool first_beacon;
 	uint32_t frame_count;
@@ -126,10 +196,21 @@ struct APRS_S {
 	StaticSemaphore_t 	stations_sem_data;
 	int stations_fd;
 	DB * stations_db;	// station database
+	APRS_Log_Cache_t * stations_cache;	// write-back cache of stations_db
+	APRS_Log_Retention_t * stations_retention;	// aging and eviction of stations_db
+	AX25_Addr_t pinned[APRS_MAX_PINNED];	// never evicted
+	uint8_t n_pinned;
 
 	SemaphoreHandle_t 	local_sem;
 	StaticSemaphore_t 	local_sem_data;
 
+	SemaphoreHandle_t 	objects_sem;
+	StaticSemaphore_t 	objects_sem_data;
+	APRS_Objects_t * objects;	// Objects and items table
+	SemaphoreHandle_t 	telemetry_sem;
+	StaticSemaphore_t 	telemetry_sem_data;
+	APRS_Telemetries_t * telemetry;	// Telemetry definitions and history
+
 	AX25_Addr_t appid;
 	AX25_Addr_t digis[APRS_MAX_DIGI];
 	uint8_t n_digis;
@@ -154,13 +235,34 @@ static void APRS_Gps_Event_Handler(APRS_t * Aprs,esp_event_base_t event_base, in
 static void APRS_Task(APRS_t * Aprs);
 static int APRS_Prepare_Data(APRS_t * Aprs, APRS_Data_t * Data);
 static int APRS_Send_Data(APRS_t * Aprs, APRS_Data_t * Data);
+static int APRS_Msg_Send_Cb(APRS_t * Aprs, const struct APRS_Message * Message);
+static bool APRS_Is_Local(APRS_t * Aprs, const char * Addressee);
+static int APRS_Tx_Position(APRS_t * Aprs, const char * Text);
+static int APRS_Tx_Status(APRS_t * Aprs, const char * Text, time_t Timestamp);
+static int APRS_Query_Send_Cb(APRS_t * Aprs, enum APRS_Query_Reply_E Reply, const AX25_Addr_t * Requester, const char * Text);
+static int APRS_Handle_Query(APRS_t * Aprs, const APRS_Data_t * Data, const char * Query, bool Directed);
+static void APRS_Post_Event(int32_t Id, Frame_t * Frame, const APRS_Data_t * Data);
+static void APRS_Release_Event_Handler(APRS_t * Aprs, esp_event_base_t Base, int32_t Id, Frame_t ** Frame);
+static void APRS_Battery_Event_Handler(APRS_t * Aprs, esp_event_base_t event_base, int32_t event_id, int * Voltage);
+static void APRS_Shutdown_Handler(void);
+static bool APRS_Retention_Pinned(const AX25_Addr_t * Callid, APRS_t * Aprs);
+
+static APRS_t * APRS_Instance;	// for shutdown handler
 
 extern Kiss_t * Kiss;
 
+// Station records first (callid order), then secondary index entries
 static int APRS_Db_Station_Compare(const DBT * Key1, const DBT * Key2) {
 	if (Key1->size == sizeof(AX25_Addr_t) && Key2->size == sizeof(AX25_Addr_t)) {
 		return  AX25_Addr_Cmp(Key1->data, Key2->data);
 	}
+	if (Key1->size == sizeof(APRS_Log_Index_t) && Key2->size == sizeof(APRS_Log_Index_t)) {
+		return memcmp(Key1->data, Key2->data, sizeof(APRS_Log_Index_t));
+	}
+	if ((Key1->size == sizeof(AX25_Addr_t) || Key1->size == sizeof(APRS_Log_Index_t))
+			&& (Key2->size == sizeof(AX25_Addr_t) || Key2->size == sizeof(APRS_Log_Index_t))) {
+		return (Key1->size == sizeof(AX25_Addr_t))?-1:1;
+	}
 	ESP_LOGE(TAG,"Wrong key size in APRS_Db_Compare");
 	return -1;
 }
@@ -186,10 +288,48 @@ APRS_t * APRS_Init(AX25_Lm_t * Ax25_Lm) {
 	ESP_LOGD(TAG,"Init out buffer %p",aprs->out_framebuff);
 
 	aprs->stations_sem = xSemaphoreCreateMutexStatic(&aprs->stations_sem_data);
+
+	if (!(aprs->stations_cache = APRS_Log_Cache_Init(NULL, NULL, APRS_CACHE_SIZE, APRS_CACHE_DIRTY, APRS_CACHE_AGE)))
+		ESP_LOGE(TAG,"Error allocating stations cache");
+
+	// Pinned stations, wildcards are kept so no normalization
+	char pinned[] = APRS_PINNED, str[10], *ptr, *last = pinned;
+	for (ptr = pinned; *ptr; ptr++)
+		*ptr = toupper(*ptr);
+	while (*last && aprs->n_pinned < APRS_MAX_PINNED) {
+		if ((ptr = strchr(last,',')))
+			*ptr = '\0';
+		strncpy(str, last, sizeof(str)-1);
+		str[sizeof(str)-1] = '\0';
+		if (*str && !AX25_Str_To_Addr(str, &aprs->pinned[aprs->n_pinned]))
+			aprs->n_pinned++;
+		if (!ptr)
+			break;
+		last = ptr+1;
+	}
+
+	if (!(aprs->stations_retention = APRS_Log_Retention_Init(NULL, NULL, APRS_MAX_AGE*3600, APRS_MAX_STATIONS,
+					APRS_RETENTION_PERIOD, (APRS_Log_Pinned_t)APRS_Retention_Pinned, aprs)))
+		ESP_LOGI(TAG,"Stations retention disabled");
 	aprs->local_sem = xSemaphoreCreateMutexStatic(&aprs->local_sem_data);
+	aprs->objects_sem = xSemaphoreCreateMutexStatic(&aprs->objects_sem_data);
+
+	if (!(aprs->objects = APRS_Objects_Init(APRS_OBJECTS_MAX)))
+		ESP_LOGE(TAG,"Error allocating objects table");
+
+	aprs->telemetry_sem = xSemaphoreCreateMutexStatic(&aprs->telemetry_sem_data);
+
+	if (!(aprs->telemetry = APRS_Telemetry_Init(APRS_TELEMETRY_STATIONS)))
+		ESP_LOGE(TAG,"Error allocating telemetry table");
 
 	aprs->queue = xQueueCreateStatic(APRS_QUEUE_SIZE,sizeof(APRS_Event_t),aprs->queue_buff,&aprs->queue_data);
 
+	if (!(aprs->msg = APRS_Msg_Init(NULL, (APRS_Msg_Send_t)APRS_Msg_Send_Cb, aprs)))
+		ESP_LOGE(TAG,"Error initializing messaging");
+
+	if (!(aprs->query = APRS_Query_Init(NULL, (APRS_Query_Send_t)APRS_Query_Send_Cb, aprs, esp_random())))
+		ESP_LOGE(TAG,"Error initializing query responder");
+
 	aprs->ax25_lm = Ax25_Lm;
 	AX25_Lm_Register_Dl(aprs->ax25_lm, aprs, &ax25_cbs, NULL); // Get All frames from phy
 
@@ -303,57 +443,104 @@ int APRS_Start(APRS_t *Aprs) {
 	APRS_Tasks.handle = xTaskCreateStaticPinnedToCore((void(*)(void*))APRS_Task,"APRS", APRS_TASK_STACK_SIZE, Aprs, APRS_TASK_PRIORITY, APRS_Tasks.stack, &APRS_Tasks.buffer, APP_CPU_NUM);
 
 	esp_event_handler_register(GPS_EVENT,ESP_EVENT_ANY_ID, (esp_event_handler_t)APRS_Gps_Event_Handler,(void*)Aprs);
+	esp_event_handler_register(MAIN_EVENT,MAIN_EVENT_BATTERY, (esp_event_handler_t)APRS_Battery_Event_Handler,(void*)Aprs);
+	esp_event_handler_register(APRS_EVENT,APRS_EVENT_RELEASE, (esp_event_handler_t)APRS_Release_Event_Handler,(void*)Aprs);
+
+	// Flush stations cache before restart
+	APRS_Instance = Aprs;
+	esp_register_shutdown_handler(APRS_Shutdown_Handler);
 
 	return (APRS_Tasks.handle != NULL);
 }
 
+#ifndef CONFIG_ESP32S3APRS_APRS_STATIONS_LOG
+// Btree code may also loop on a damaged page : restart, next open starts empty
+static void APRS_Open_Db_Timeout(void * Arg) {
+	ESP_LOGE(TAG, "Opening %s did not complete, restarting", APRS_STATIONS_DB_FILE);
+	esp_restart();
+}
+#endif
+
 int APRS_Open_Db(APRS_t *Aprs, int Flags) {
-	BTREEINFO bt_info = {
-		.flags = 0,
-		.cachesize = 8192,
-		.maxkeypage = 4,
-		.minkeypage = 4,
-		.psize = 512,
-		.compare = APRS_Db_Station_Compare,
-		.prefix = NULL,
-		.lorder = 0,
-	};
+	const char * path;
+	APRS_Data_t data;
+	int ret;
 
 	if (!Aprs)
 		return -1;
 
-	// Try open btree file
-	Aprs->stations_fd = open(APRS_STATIONS_DB_FILE, O_RDWR | Flags, S_IRUSR | S_IWUSR);
-	if (Aprs->stations_fd < 0)
-		// Create file
-		Aprs->stations_fd = open(APRS_STATIONS_DB_FILE, O_RDWR | O_CREAT | O_EXCL | Flags, S_IRUSR | S_IWUSR);
-
-	if (Aprs->stations_fd > 0) {
-		Aprs->stations_db = __bt_open((void*)Aprs->stations_fd, NULL, &bt_info, 0);
-		if (!Aprs->stations_db) {
-			ESP_LOGE(TAG, "__bt_open return error %d", errno);
-			close(Aprs->stations_fd);
-			Aprs->stations_fd = -1;
-			return ESP_FAIL;
-		}
-		ESP_LOGI(TAG,"%s opened", APRS_STATIONS_DB_FILE);
-			int ret;
-			APRS_Data_t data;
-
-			APRS_Prepare_Data(Aprs, &data);
+#ifdef CONFIG_ESP32S3APRS_APRS_STATIONS_LOG
+	// Append only segments, compacted from task loop
+	path = APRS_STATIONS_LOG_PATH;
+	Aprs->stations_fd = -1;
+	Aprs->stations_db = APRS_Lsdb_Open(path, Flags, APRS_Db_Station_Compare,
+			CONFIG_ESP32S3APRS_APRS_STATIONS_LOG_SEGMENT,
+			Storage_Budget(APRS_STATIONS_LOG_PERCENT, CONFIG_ESP32S3APRS_APRS_STATIONS_LOG_MAX));
+	if (!Aprs->stations_db) {
+		ESP_LOGE(TAG,"Can't open %s", path);
+		return ESP_FAIL;
+	}
+#else
+	static const APRS_Log_Btree_t btree = {
+		.path = APRS_STATIONS_DB_FILE,
+		.rebuild = APRS_STATIONS_DB_NEW,
+		.journal = APRS_STATIONS_JOURNAL,
+		.recovery = APRS_STATIONS_RECOVERY,
+		.compare = APRS_Db_Station_Compare,
+		.check_max = APRS_STATIONS_CHECK_MAX,
+	};
+	const esp_timer_create_args_t timeout_args = {
+		.callback = APRS_Open_Db_Timeout,
+		.name = "stations_open",
+	};
+	esp_timer_handle_t timeout = NULL;
+	DB * db;
+
+	path = APRS_STATIONS_DB_FILE;
+	if (esp_timer_create(&timeout_args, &timeout) == ESP_OK
+			&& esp_timer_start_once(timeout, APRS_STATIONS_OPEN_TIMEOUT * 1000000ULL) != ESP_OK) {
+		esp_timer_delete(timeout);
+		timeout = NULL;
+	}
+	db = APRS_Log_Btree_Open(&btree, Flags, &Aprs->stations_fd);
+	if (timeout) {
+		esp_timer_stop(timeout);
+		esp_timer_delete(timeout);
+	}
+	if (!db) {
+		ESP_LOGE(TAG,"Can't open %s", path);
+		return ESP_FAIL;
+	}
 
-			xSemaphoreTake(Aprs->stations_sem,portMAX_DELAY);
-			ret = APRS_Log_Station(Aprs->stations_db, &data);
-			xSemaphoreGive(Aprs->stations_sem);
-			if (ret == ESP_OK)
-				ESP_LOGD(TAG, "Local station logged");
-			else
-				ESP_LOGE(TAG, "Error logging local station");
-	} else {
-		Aprs->stations_db = NULL;
-		ESP_LOGE(TAG,"Can't open %s", APRS_STATIONS_DB_FILE);
+	// Every update is journaled until next sync
+	Aprs->stations_db = APRS_Journal_Open(db, APRS_STATIONS_JOURNAL);
+	if (!Aprs->stations_db) {
+		ESP_LOGE(TAG,"Can't open %s", APRS_STATIONS_JOURNAL);
+		db->close(db);
+		close(Aprs->stations_fd);
+		Aprs->stations_fd = -1;
 		return ESP_FAIL;
 	}
+#endif
+
+	ESP_LOGI(TAG,"%s opened", path);
+
+	// Database from previous firmware has no secondary index
+	xSemaphoreTake(Aprs->stations_sem,portMAX_DELAY);
+	if (APRS_Log_Index_Rebuild(Aprs->stations_db))
+		ESP_LOGE(TAG,"Error building stations index");
+	xSemaphoreGive(Aprs->stations_sem);
+
+	// Local station
+	APRS_Prepare_Data(Aprs, &data);
+
+	xSemaphoreTake(Aprs->stations_sem,portMAX_DELAY);
+	ret = APRS_Log_Station(Aprs->stations_db, &data);
+	xSemaphoreGive(Aprs->stations_sem);
+	if (ret == ESP_OK)
+		ESP_LOGD(TAG, "Local station logged");
+	else
+		ESP_LOGE(TAG, "Error logging local station");
 
 	return 0;
 }
@@ -362,6 +549,9 @@ int APRS_Close_Db(APRS_t * Aprs) {
 	int ret = 0;
 
 	if (Aprs->stations_db) {
+		xSemaphoreTake(Aprs->stations_sem,portMAX_DELAY);
+		APRS_Log_Cache_Flush(Aprs->stations_cache, Aprs->stations_db);
+		xSemaphoreGive(Aprs->stations_sem);
 		ret = Aprs->stations_db->close(Aprs->stations_db);
 		if (ret == RET_ERROR) {
 			ESP_LOGE(TAG, "__bt_close return error %d", errno);
@@ -381,16 +571,56 @@ int APRS_Close_Db(APRS_t * Aprs) {
 void APRS_Task(APRS_t * Aprs) {
 	APRS_Event_t event;
 	APRS_Data_t data;
-	int i;
+	int i, wait, query_wait, cache_wait, retention_wait;
 	size_t len;
-	struct tm tm;
+#ifndef NDEBUG
+	UBaseType_t stack_free, stack_min = APRS_TASK_STACK_SIZE;
+#endif
 
 	while (1) {
-		xQueueReceive(Aprs->queue,&event,portMAX_DELAY);
+		// Message retries, query replies and stations cache flush are scheduled from the task loop
+		wait = APRS_Msg_Process(Aprs->msg);
+		query_wait = APRS_Query_Process(Aprs->query);
+		if (query_wait >= 0 && (wait < 0 || query_wait < wait))
+			wait = query_wait;
+		xSemaphoreTake(Aprs->stations_sem,portMAX_DELAY);
+		cache_wait = APRS_Log_Cache_Process(Aprs->stations_cache, Aprs->stations_db);
+		// Bounded retention slice, stations_sem is held for at most one batch
+		retention_wait = Aprs->stations_db?APRS_Log_Retention_Process(Aprs->stations_retention, Aprs->stations_db,
+				Aprs->stations_cache, APRS_RETENTION_BUDGET):-1;
+		xSemaphoreGive(Aprs->stations_sem);
+		if (cache_wait >= 0 && (wait < 0 || cache_wait < wait))
+			wait = cache_wait;
+		if (retention_wait >= 0 && (wait < 0 || retention_wait < wait))
+			wait = retention_wait;
+#ifdef CONFIG_ESP32S3APRS_APRS_STATIONS_LOG
+		// One bounded compaction step per second while segments can be reclaimed
+		int compact;
+		xSemaphoreTake(Aprs->stations_sem,portMAX_DELAY);
+		compact = APRS_Lsdb_Compact(Aprs->stations_db, CONFIG_ESP32S3APRS_APRS_STATIONS_LOG_BUDGET);
+		xSemaphoreGive(Aprs->stations_sem);
+		if (compact > 0 && (wait < 0 || wait > 1))
+			wait = 1;
+#endif
+#ifndef NDEBUG
+		// Stack margin, logged each time it shrinks
+		stack_free = uxTaskGetStackHighWaterMark(NULL);
+		if (stack_free < stack_min) {
+			stack_min = stack_free;
+			ESP_LOGI(TAG,"Stack high water mark : %u bytes free", stack_min);
+		}
+#endif
+		if (xQueueReceive(Aprs->queue,&event,wait<0?portMAX_DELAY:pdMS_TO_TICKS(wait*1000)) != pdPASS)
+			continue;
+
 		switch (event.type) {
 			case APRS_EVENT_FRAME_RECEIVED:	// Receive frame
 				Aprs->frame_count++;
 				ESP_LOGI(TAG,"%lu frame received",Aprs->frame_count);
+#ifdef CONFIG_ESP32S3APRS_APRS_PARSE_STATS
+				if (!(Aprs->frame_count % APRS_PARSE_STATS_PERIOD))
+					APRS_Log_Parse_Stats();
+#endif
 
 				// Parse frame and fill data struct
 				if ((i = APRS_Parse(event.frame,&data)) == -1) {
@@ -398,7 +628,6 @@ void APRS_Task(APRS_t * Aprs) {
 					Framebuff_Free_Frame(event.frame);
 					break;
 				}
-				Framebuff_Free_Frame(event.frame);
 
 				ESP_LOGD(TAG, "Frame parsed");
 
@@ -416,7 +645,10 @@ void APRS_Task(APRS_t * Aprs) {
 				if (Aprs->stations_db) {
 					int ret;
 					xSemaphoreTake(Aprs->stations_sem,portMAX_DELAY);
-					 ret = APRS_Log_Station(Aprs->stations_db, &data);
+					if (Aprs->stations_cache)
+						ret = APRS_Log_Cache_Station(Aprs->stations_cache, Aprs->stations_db, &data);
+					else
+						ret = APRS_Log_Station(Aprs->stations_db, &data);
 					xSemaphoreGive(Aprs->stations_sem);
 					if (ret == ESP_OK)
 						ESP_LOGD(TAG, "Frame logged");
@@ -429,8 +661,40 @@ void APRS_Task(APRS_t * Aprs) {
 					data.symbol[1] = APRS_Ssid_Symbol[(data.address[1].ssid>>1)&15][1];
 				}
 
+				// Objects and items
+				if (data.type == APRS_DTI_OBJECT || data.type == APRS_DTI_ITEM) {
+					xSemaphoreTake(Aprs->objects_sem, portMAX_DELAY);
+					APRS_Objects_Update(Aprs->objects, &data);
+					xSemaphoreGive(Aprs->objects_sem);
+				}
+
+				// Telemetry reports and definitions (PARM/UNIT/EQNS/BITS sent to self)
+				if (data.type == APRS_DTI_TELEMETRIE) {
+					xSemaphoreTake(Aprs->telemetry_sem, portMAX_DELAY);
+					APRS_Telemetry_Update(Aprs->telemetry, &data);
+					xSemaphoreGive(Aprs->telemetry_sem);
+				} else if (data.type == APRS_DTI_MESSAGE && data.message.type == APRS_MSG_TYPE_MESSAGE) {
+					xSemaphoreTake(Aprs->telemetry_sem, portMAX_DELAY);
+					APRS_Telemetry_Define(Aprs->telemetry, data.message.addressee, data.message.text, data.timestamp);
+					xSemaphoreGive(Aprs->telemetry_sem);
+				}
+
+				// General query
+				if (data.type == APRS_DTI_QUERY)
+					APRS_Handle_Query(Aprs, &data, data.query.name, false);
+
+				// Message addressed to local station, directed queries are answered, not shown
+				if (data.type == APRS_DTI_MESSAGE && APRS_Is_Local(Aprs, data.message.addressee)
+						&& !APRS_Msg_Received(Aprs->msg, &data.address[1], &data.message)
+						&& data.message.type == APRS_MSG_TYPE_MESSAGE
+						&& (data.message.text[0] != '?' || APRS_Handle_Query(Aprs, &data, data.message.text+1, true))) {
+					ESP_LOGI(TAG,"Message received : %s", data.message.text);
+					i = APRS_EVENT_MESSAGE;
+				}
+
 				// Notifie HMI of new incomming data
-				esp_event_post(APRS_EVENT, i, &data, sizeof(APRS_Data_t), portMAX_DELAY);
+				APRS_Post_Event(i, event.frame, &data);
+				Framebuff_Free_Frame(event.frame);
 
 				ESP_LOGD(TAG, "Frame event sent");
 
@@ -467,80 +731,24 @@ void APRS_Task(APRS_t * Aprs) {
 				Aprs->first_beacon = true;
 				/* FALLTHRU */
 			case APRS_SEND_POSITION:	// Send APRS Position report with timestamp, course/speed, default status text
-				if (APRS_Prepare_Data(Aprs,&data)) {
-					ESP_LOGE(TAG,"Error preparing data for position send request");
-					break;
-				}
-
-				// Fill data to send
-				data.type = APRS_DTI_POS_W_TS;
-				data.extension = APRS_DATA_EXT_CSE;
-
-				// Set timestamp of local station position
-				gmtime_r(&Aprs->local.timestamp, &tm);
-				data.time.month = 0;
-				data.time.day = tm.tm_mday;
-				data.time.hours = tm.tm_hour;
-				data.time.minutes = tm.tm_min;
-				data.time.seconds = 0;
-
-				// Set position
-				memcpy(&data.position, &Aprs->local.position, sizeof(struct APRS_Position));
-				if (Aprs->tx_ambiguity > data.position.ambiguity)
-					data.position.ambiguity = Aprs->tx_ambiguity;
-
-				// Set data extension
-				data.extension = APRS_DATA_EXT_CSE;
-				memcpy(&data.course, &Aprs->local.course, sizeof(struct APRS_Course));
-
-				// Copy comment from event
-				if (event.text[0])
-					memcpy(data.text, event.text, sizeof(data.text));
-
-				APRS_Send_Data(Aprs,&data);
+				APRS_Tx_Position(Aprs, event.text);
 				break;
 			case APRS_SEND_STATUS:	// Send APRS status report without timestamp, locator
-				if (APRS_Prepare_Data(Aprs,&data)) {
-					ESP_LOGE(TAG,"Error preparing data for status send request");
-					break;
-				}
-
-				// Fill data to send
-				data.type = APRS_DTI_STATUS;
-				data.extension = APRS_DATA_EXT_NONE;
-
-#ifdef APRS_SEND_STATUS_WITH_TIMESTAMP
-				// use Time stamp of event
-				gmtime_r(&event.timestamp, &tm);
-
-				// set time for DDHHMM format
-				data.time.month = 0;
-				data.time.day = tm.tm_mday;
-				data.time.hours = tm.tm_hour;
-				data.time.minutes = tm.tm_min;
-				data.time.seconds = 0;
-#elif defined(APRS_SEND_STATUS_WITH_LOCATOR)
-				// set position for status with locator
-				memcpy(&data.position, &Aprs->local.position, sizeof(struct APRS_Position));
-				if (Aprs->tx_ambiguity > data.position.ambiguity)
-					data.position.ambiguity = Aprs->tx_ambiguity;
-#endif
-				if (event.text[0]) {
-					// Update local station status
-					xSemaphoreTake(Aprs->local_sem, portMAX_DELAY);
-					// Copy status text in local station info
-					strncpy(Aprs->local.status, event.text, sizeof(Aprs->local.status));
-					xSemaphoreGive(Aprs->local_sem);
-				}
-				// Copy status text in data status text
-				strncpy(data.text, Aprs->local.status, sizeof(data.text));
+				APRS_Tx_Status(Aprs, event.text, event.timestamp);
+				break;
 
-				APRS_Send_Data(Aprs,&data);
+			case APRS_SEND_MESSAGE:
+				if (APRS_Msg_Queue(Aprs->msg, event.message.addressee, event.message.text, true))
+					ESP_LOGE(TAG,"Error queuing message for %s", event.message.addressee);
 				break;
 
 			case APRS_RESET_DB:
+				xSemaphoreTake(Aprs->stations_sem,portMAX_DELAY);
+				APRS_Log_Cache_Clear(Aprs->stations_cache);
+				xSemaphoreGive(Aprs->stations_sem);
 				APRS_Close_Db(Aprs);
 				unlink(APRS_STATIONS_DB_FILE);
+				unlink(APRS_STATIONS_JOURNAL);
 				APRS_Open_Db(Aprs, O_TRUNC);
 				if (Aprs->stations_db) {
 					int ret;
@@ -557,6 +765,12 @@ void APRS_Task(APRS_t * Aprs) {
 				}
 				break;
 
+			case APRS_FLUSH_DB:
+				xSemaphoreTake(Aprs->stations_sem,portMAX_DELAY);
+				APRS_Log_Cache_Flush(Aprs->stations_cache, Aprs->stations_db);
+				xSemaphoreGive(Aprs->stations_sem);
+				break;
+
 			default:
 				ESP_LOGW(TAG,"Unknown event received : %d",event.type);
 		}
@@ -631,18 +845,19 @@ static int APRS_Send_Data(APRS_t * Aprs, APRS_Data_t * Data) {
 	if (Aprs->callid_set) {
 		if (AX25_Lm_Data_Request(Aprs->ax25_lm, Aprs, frame)) {
 			ESP_LOGE(TAG,"Error sending frame to AX25 LM");
+			Framebuff_Free_Frame(frame);
 			return -1;
 		}
 	} else
 		ESP_LOGE(TAG,"You _MUST_ set your Callid");
 
-	// Loop back to APRS for decoding
-	event.timestamp = Data->timestamp;;
+	// Loop back to APRS for decoding, called from APRS task : don't wait on our own queue
+	event.timestamp = Data->timestamp;
 	event.type = APRS_EVENT_FRAME_RECEIVED;
 	event.frame = frame;
 	Framebuff_Inc_Frame_Usage(frame);
-	if (xQueueSend(Aprs->queue, &event, portMAX_DELAY) != pdPASS) {
-		ESP_LOGE(TAG,"Error sending frame received event");
+	if (xQueueSend(Aprs->queue, &event, 0) != pdPASS) {
+		ESP_LOGW(TAG,"Queue full, sent frame not looped back");
 		Framebuff_Free_Frame(frame);
 	}
 
@@ -655,6 +870,241 @@ static int APRS_Send_Data(APRS_t * Aprs, APRS_Data_t * Data) {
 	return 0;
 }
 
+static int APRS_Msg_Send_Cb(APRS_t * Aprs, const struct APRS_Message * Message) {
+	APRS_Data_t data;
+
+	if (APRS_Prepare_Data(Aprs, &data)) {
+		ESP_LOGE(TAG,"Error preparing data for message send");
+		return -1;
+	}
+
+	data.type = APRS_DTI_MESSAGE;
+	memcpy(&data.message, Message, sizeof(struct APRS_Message));
+
+	return APRS_Send_Data(Aprs, &data);
+}
+
+static int APRS_Tx_Position(APRS_t * Aprs, const char * Text) {
+	APRS_Data_t data;
+	struct tm tm;
+
+	if (APRS_Prepare_Data(Aprs,&data)) {
+		ESP_LOGE(TAG,"Error preparing data for position send request");
+		return -1;
+	}
+
+	// Fill data to send
+	data.type = APRS_DTI_POS_W_TS;
+
+	// Set timestamp of local station position
+	gmtime_r(&Aprs->local.timestamp, &tm);
+	data.time.month = 0;
+	data.time.day = tm.tm_mday;
+	data.time.hours = tm.tm_hour;
+	data.time.minutes = tm.tm_min;
+	data.time.seconds = 0;
+
+	// Set position
+	memcpy(&data.position, &Aprs->local.position, sizeof(struct APRS_Position));
+	if (Aprs->tx_ambiguity > data.position.ambiguity)
+		data.position.ambiguity = Aprs->tx_ambiguity;
+
+	// Set data extension
+	data.extension = APRS_DATA_EXT_CSE;
+	memcpy(&data.course, &Aprs->local.course, sizeof(struct APRS_Course));
+
+	// Copy comment
+	if (Text && Text[0])
+		strncpy(data.text, Text, sizeof(data.text)-1);
+
+	return APRS_Send_Data(Aprs,&data);
+}
+
+static int APRS_Tx_Status(APRS_t * Aprs, const char * Text, time_t Timestamp) {
+	APRS_Data_t data;
+#ifdef APRS_SEND_STATUS_WITH_TIMESTAMP
+	struct tm tm;
+#endif
+
+	if (APRS_Prepare_Data(Aprs,&data)) {
+		ESP_LOGE(TAG,"Error preparing data for status send request");
+		return -1;
+	}
+
+	// Fill data to send
+	data.type = APRS_DTI_STATUS;
+	data.extension = APRS_DATA_EXT_NONE;
+
+#ifdef APRS_SEND_STATUS_WITH_TIMESTAMP
+	// use Time stamp of request
+	gmtime_r(&Timestamp, &tm);
+
+	// set time for DDHHMM format
+	data.time.month = 0;
+	data.time.day = tm.tm_mday;
+	data.time.hours = tm.tm_hour;
+	data.time.minutes = tm.tm_min;
+	data.time.seconds = 0;
+#elif defined(APRS_SEND_STATUS_WITH_LOCATOR)
+	// set position for status with locator
+	memcpy(&data.position, &Aprs->local.position, sizeof(struct APRS_Position));
+	if (Aprs->tx_ambiguity > data.position.ambiguity)
+		data.position.ambiguity = Aprs->tx_ambiguity;
+#endif
+	xSemaphoreTake(Aprs->local_sem, portMAX_DELAY);
+	// Copy status text in local station info
+	if (Text && Text[0])
+		strncpy(Aprs->local.status, Text, sizeof(Aprs->local.status));
+	// Copy status text in data status text
+	strncpy(data.text, Aprs->local.status, sizeof(data.text));
+	xSemaphoreGive(Aprs->local_sem);
+
+	return APRS_Send_Data(Aprs,&data);
+}
+
+static int APRS_Query_Send_Cb(APRS_t * Aprs, enum APRS_Query_Reply_E Reply, const AX25_Addr_t * Requester, const char * Text) {
+	APRS_Data_t data;
+	char addressee[10];
+
+	switch (Reply) {
+		case APRS_QUERY_REPLY_POSITION:
+			return APRS_Tx_Position(Aprs, NULL);
+		case APRS_QUERY_REPLY_STATUS:
+			return APRS_Tx_Status(Aprs, NULL, time(NULL));
+		case APRS_QUERY_REPLY_CAPABILITIES:
+			if (APRS_Prepare_Data(Aprs, &data)) {
+				ESP_LOGE(TAG,"Error preparing data for capabilities send");
+				return -1;
+			}
+			data.type = APRS_DTI_STATION_CAP;
+			strncpy(data.text, "IGATE", sizeof(data.text)-1);
+			return APRS_Send_Data(Aprs, &data);
+		case APRS_QUERY_REPLY_TRACE:
+			AX25_Addr_To_Str(Requester, addressee, sizeof(addressee));
+			return APRS_Msg_Queue(Aprs->msg, addressee, Text, false);
+		default:
+			return -1;
+	}
+}
+
+// Check query applies to local station and schedule the reply, -1 if not a known query
+static int APRS_Handle_Query(APRS_t * Aprs, const APRS_Data_t * Data, const char * Query, bool Directed) {
+	const struct APRS_Query * query = &Data->query;
+	char route[68];
+	double lat, dlat, dlon;
+	bool weather;
+	int i, len, reply;
+
+	if ((reply = APRS_Query_Reply_Type(Query, Directed)) == -1)
+		return -1;
+
+	// Never answer our own queries
+	xSemaphoreTake(Aprs->local_sem, portMAX_DELAY);
+	if (!AX25_Addr_Cmp(&Data->address[1], &Aprs->local.callid)) {
+		xSemaphoreGive(Aprs->local_sem);
+		return 0;
+	}
+	weather = Aprs->local.symbol[1] == '_';
+
+	// General query with footprint : only stations in the circle reply
+	if (!Directed && query->footprint) {
+		lat = (double)Aprs->local.position.latitude / (1<<22) * M_PI / 180.0;
+		dlat = lat - (double)query->center.latitude / (1<<22) * M_PI / 180.0;
+		dlon = (double)(Aprs->local.position.longitude - query->center.longitude) / (1<<22) * M_PI / 180.0;
+		dlon *= cos(lat);
+		if (APRS_EARTH_RADIUS * sqrt(dlat*dlat + dlon*dlon) > query->radius) {
+			xSemaphoreGive(Aprs->local_sem);
+			return 0;
+		}
+	}
+	xSemaphoreGive(Aprs->local_sem);
+
+	// ?WX? is for weather stations only
+	if (!Directed && !strncmp(Query, "WX", 2) && !weather)
+		return 0;
+#ifndef CONFIG_ESP32S3APRS_APRS_IGATE
+	if (reply == APRS_QUERY_REPLY_CAPABILITIES)
+		return 0;
+#endif
+
+	// Trace reply is the route the query came through
+	route[0] = '\0';
+	if (reply == APRS_QUERY_REPLY_TRACE) {
+		AX25_Addr_To_Str(&Data->address[1], route, sizeof(route));
+		strcat(route, ">");
+		len = strlen(route);
+		AX25_Addr_To_Str(&Data->address[0], route+len, sizeof(route)-len);
+		for (i=2; i < (2+APRS_MAX_DIGI) && !(Data->address[i-1].ssid & 1); i++) {
+			len = strlen(route);
+			if (len+11 >= sizeof(route))
+				break;
+			route[len++] = ',';
+			AX25_Addr_To_Str(&Data->address[i], route+len, sizeof(route)-len);
+			if (Data->address[i].ssid & 0x80)
+				strcat(route, "*");
+		}
+	}
+
+	if (APRS_Query_Request(Aprs->query, reply, &Data->address[1], route) == -1)
+		ESP_LOGE(TAG,"Error scheduling query reply");
+
+	return 0;
+}
+
+// Post frame descriptor, the frame is referenced until every handler ran
+static void APRS_Post_Event(int32_t Id, Frame_t * Frame, const APRS_Data_t * Data) {
+	APRS_Event_Data_t event;
+
+	APRS_Event_Init(&event, Frame, Data);
+	Framebuff_Inc_Frame_Usage(Frame);
+	esp_event_post(APRS_EVENT, Id, &event, sizeof(event), portMAX_DELAY);
+
+	// Default event loop runs events in order
+	if (esp_event_post(APRS_EVENT, APRS_EVENT_RELEASE, &Frame, sizeof(Frame), portMAX_DELAY) != ESP_OK)
+		Framebuff_Free_Frame(Frame);
+}
+
+static void APRS_Release_Event_Handler(APRS_t * Aprs, esp_event_base_t Base, int32_t Id, Frame_t ** Frame) {
+	Framebuff_Free_Frame(*Frame);
+}
+
+static bool APRS_Is_Local(APRS_t * Aprs, const char * Addressee) {
+	AX25_Addr_t addr;
+	char str[10];
+	bool ret;
+
+	strncpy(str, Addressee, sizeof(str)-1);
+	str[sizeof(str)-1] = '\0';
+	AX25_Str_To_Addr(str, &addr);
+	AX25_Norm_Addr(&addr);
+
+	xSemaphoreTake(Aprs->local_sem, portMAX_DELAY);
+	ret = !AX25_Addr_Cmp(&addr, &Aprs->local.callid);
+	xSemaphoreGive(Aprs->local_sem);
+
+	return ret;
+}
+
+// Own callid (any ssid) and configured stations are never evicted
+static bool APRS_Retention_Pinned(const AX25_Addr_t * Callid, APRS_t * Aprs) {
+	AX25_Addr_t local;
+	int i;
+
+	xSemaphoreTake(Aprs->local_sem, portMAX_DELAY);
+	memcpy(&local, &Aprs->local.callid, sizeof(AX25_Addr_t));
+	xSemaphoreGive(Aprs->local_sem);
+	local.ssid = 0;
+
+	if (!AX25_Addr_Cmp(Callid, &local))
+		return true;
+
+	for (i=0; i<Aprs->n_pinned; i++)
+		if (!AX25_Addr_Cmp(Callid, &Aprs->pinned[i]))
+			return true;
+
+	return false;
+}
+
 // Get/Set methode
 int APRS_Get_Symbol(APRS_t * Aprs, char Str[2]) {
 	if (!Aprs)
@@ -966,101 +1416,43 @@ int APRS_Get_Local(APRS_t * Aprs, APRS_Station_t * Station) {
 	return 0;
 }
 
-int APRS_Position_To_Locator(struct APRS_Position * Position, char * Grid,int len) {
-	int pos;
-	int n_pair;
-	uint32_t lon, lat;
-
-	if (Position->ambiguity <= APRS_AMBIGUITY_LOC_EXT_SQUARE)
-		n_pair = 4;
-	else if (Position->ambiguity <= APRS_AMBIGUITY_LOC_SUBSQUARE)
-		n_pair = 3;
-	else if (Position->ambiguity <= APRS_AMBIGUITY_LOC_SQUARE)
-		n_pair = 2;
-	else 
-		n_pair = 1;
+int APRS_Get_Object(APRS_t *Aprs, const char * Name, const AX25_Addr_t * Originator, APRS_Obj_t * Obj) {
+	int ret;
 
-	if (len < (n_pair<<1)) {
+	if (!Aprs || !Obj)
 		return -1;
-	}
 
-	lon = Position->longitude + (180<<GPS_FIXED_POINT_DEG);
-	lat = Position->latitude + (90<<GPS_FIXED_POINT_DEG);
-
-	lon /= 20;
-	lat /= 10;
-
-	pos = 0;
-	while (n_pair && (pos+3)<len) {
-		if ((pos>>1)&1) {
-			Grid[pos] = (lon>>GPS_FIXED_POINT_DEG) + '0';
-			Grid[pos+1] = (lat>>GPS_FIXED_POINT_DEG) + '0';
-			lon = (lon & ((1<<GPS_FIXED_POINT_DEG)-1))*24;
-			lat = (lat & ((1<<GPS_FIXED_POINT_DEG)-1))*24;
-		} else {
-			Grid[pos] = (lon>>GPS_FIXED_POINT_DEG) + 'A';
-			Grid[pos+1] = (lat>>GPS_FIXED_POINT_DEG) + 'A';
-			lon = (lon & ((1<<GPS_FIXED_POINT_DEG)-1))*10;
-			lat = (lat & ((1<<GPS_FIXED_POINT_DEG)-1))*10;
-		}
-		n_pair--;
-		pos += 2;
-	}
+	xSemaphoreTake(Aprs->objects_sem, portMAX_DELAY);
+	ret = APRS_Objects_Get(Aprs->objects, Name, Originator, Obj);
+	xSemaphoreGive(Aprs->objects_sem);
 
-	if (pos < len)
-		Grid[pos] = '\0';
+	return ret;
+}
 
-	return pos;
+int APRS_Get_Object_Nth(APRS_t *Aprs, int n, APRS_Obj_t * Obj) {
+	int ret;
+
+	if (!Aprs || !Obj)
+		return -1;
+
+	xSemaphoreTake(Aprs->objects_sem, portMAX_DELAY);
+	ret = APRS_Objects_Get_Nth(Aprs->objects, n, Obj);
+	xSemaphoreGive(Aprs->objects_sem);
+
+	return ret;
 }
 
-int APRS_Locator_To_Position(char * Locator, int Len, struct APRS_Position * Pos) {
-	int n_pair;
-	uint32_t mult;
+int APRS_Get_Telemetry(APRS_t *Aprs, const AX25_Addr_t * Callid, APRS_Tlm_t * Tlm) {
+	int ret;
 
-	if (Len&1 || Len < 2)
+	if (!Aprs || !Callid || !Tlm)
 		return -1;
-	n_pair = 0;
-	mult = 1;
-	while (Len) {
-		if ((n_pair>>1)&1) {
-			Pos->longitude *= 10;
-			Pos->latitude  *= 10;
-			mult *= 10;
-			Pos->longitude += Locator[n_pair<<1]-'0';
-			Pos->latitude += Locator[n_pair<<1]-'0';
-		} else {
-			if (n_pair) {
-				Pos->longitude *= 24;
-				Pos->latitude  *= 24;
-				mult *= 24;
-				Pos->longitude += Locator[(n_pair<<1)+1]-'A';
-				Pos->latitude += Locator[(n_pair<<1)+1]-'A';
-			} else {
-				Pos->longitude = (Locator[(n_pair<<1)+1]-'A') * 20;
-				Pos->latitude = (Locator[(n_pair<<1)+1]-'A') * 10;
-			}
-		}
-		n_pair++;
-		Len -=2;
-	}
-	
-	Pos->longitude = ((((uint64_t)Pos->longitude)<<GPS_FIXED_POINT_DEG)/mult) - (180<<GPS_FIXED_POINT_DEG);
-	Pos->latitude = ((((uint64_t)Pos->latitude)<<GPS_FIXED_POINT_DEG)/mult) - (90<<GPS_FIXED_POINT_DEG);
-	
-	if (n_pair > 4) {
-			ESP_LOGW(TAG,"Locator precision > extended square");
-			Pos->ambiguity = APRS_AMBIGUITY_LOC_EXT_SQUARE;
-	} else if (n_pair == 4)
-		Pos->ambiguity = APRS_AMBIGUITY_LOC_EXT_SQUARE;
-	else if (n_pair == 3)
-		Pos->ambiguity = APRS_AMBIGUITY_LOC_SUBSQUARE;
-	else if (n_pair == 2)
-		Pos->ambiguity = APRS_AMBIGUITY_LOC_SQUARE;
-	else if (n_pair == 1)
-		Pos->ambiguity = APRS_AMBIGUITY_LOC_FIELD;
-	else Pos->ambiguity = APRS_AMBIGUITY_MAX;
-
-	return n_pair<<1;
+
+	xSemaphoreTake(Aprs->telemetry_sem, portMAX_DELAY);
+	ret = APRS_Telemetry_Get(Aprs->telemetry, Callid, Tlm);
+	xSemaphoreGive(Aprs->telemetry_sem);
+
+	return ret;
 }
 
 int APRS_Send_Status(APRS_t * Aprs, const char * Status) {
@@ -1104,6 +1496,25 @@ int APRS_Send_Position(APRS_t * Aprs, const char * Comment) {
 	return 0;
 }
 
+int APRS_Send_Message(APRS_t * Aprs, const char * Addressee, const char * Text) {
+	APRS_Event_t event;
+
+	if (!Aprs || !Addressee || !*Addressee || !Text)
+		return -1;
+
+	event.type = APRS_SEND_MESSAGE;
+	strncpy(event.message.addressee, Addressee, sizeof(event.message.addressee)-1);
+	event.message.addressee[sizeof(event.message.addressee)-1] = '\0';
+	strncpy(event.message.text, Text, sizeof(event.message.text)-1);
+	event.message.text[sizeof(event.message.text)-1] = '\0';
+	if (xQueueSend(Aprs->queue, &event, portMAX_DELAY) != pdPASS) {
+		ESP_LOGE(TAG,"Error requesting sending message");
+		return -1;
+	}
+
+	return 0;
+}
+
 int APRS_Get_Station(APRS_t * Aprs, AX25_Addr_t *Id, APRS_Station_t * Station) {
 	DBT key, data;
 	int ret;
@@ -1111,11 +1522,20 @@ int APRS_Get_Station(APRS_t * Aprs, AX25_Addr_t *Id, APRS_Station_t * Station) {
 	if (!Aprs || !Id || !Station)
 		return -1;
 
+	// Recently heard stations are read without waiting for APRS task
+	if (!APRS_Log_Cache_Read(Aprs->stations_cache, Id, Station))
+		return 0;
+
 	if (Aprs->stations_db) {
 		key.size = sizeof(AX25_Addr_t);
 		key.data = Id;
 	
 		xSemaphoreTake(Aprs->stations_sem,portMAX_DELAY);
+		// Cached record is the most recent
+		if (!APRS_Log_Cache_Get(Aprs->stations_cache, Id, Station)) {
+			xSemaphoreGive(Aprs->stations_sem);
+			return 0;
+		}
 		if ((ret = Aprs->stations_db->get(Aprs->stations_db, &key, &data, 0))<0) {
 			ESP_LOGE(TAG,"Error getting station db");
 		}
@@ -1138,9 +1558,26 @@ int APRS_Get_Station(APRS_t * Aprs, AX25_Addr_t *Id, APRS_Station_t * Station) {
 	return ret;
 }
 
+// Lock free snapshot of a recently heard station, NULL if not cached
+// Data read through the pointer is consistent if APRS_Station_Snapshot_Valid returns true afterward
+const APRS_Station_t * APRS_Station_Snapshot(APRS_t * Aprs, const AX25_Addr_t * Id, uint32_t * Version) {
+	if (!Aprs || !Id || !Version)
+		return NULL;
+
+	return APRS_Log_Cache_Peek(Aprs->stations_cache, Id, Version);
+}
+
+bool APRS_Station_Snapshot_Valid(APRS_t * Aprs, const APRS_Station_t * Station, uint32_t Version) {
+	if (!Aprs)
+		return false;
+
+	return APRS_Log_Cache_Valid(Aprs->stations_cache, Station, Version);
+}
+
 int APRS_Stations_Seq(APRS_t * Aprs, AX25_Addr_t *Addr, int flags, APRS_Station_t *Station) {
 	int ret;
 	DBT key, data;
+	APRS_Log_Index_t index;
 	AX25_Addr_t addr = {.addr = {0,0,0,0,0,0,0}};
 
 	if (Aprs->stations_db) {
@@ -1151,7 +1588,23 @@ int APRS_Stations_Seq(APRS_t * Aprs, AX25_Addr_t *Addr, int flags, APRS_Station_
 		key.size = sizeof(AX25_Addr_t);
 
 		xSemaphoreTake(Aprs->stations_sem, portMAX_DELAY);
-		ret = Aprs->stations_db->seq(Aprs->stations_db, &key, &data, flags);
+		// Iterate on up to date DB
+		APRS_Log_Cache_Flush(Aprs->stations_cache, Aprs->stations_db);
+		if (flags == R_LAST) {
+			// Last station is just before first index entry
+			bzero(&index, sizeof(index));
+			key.data = &index;
+			key.size = sizeof(index);
+			ret = Aprs->stations_db->seq(Aprs->stations_db, &key, &data, R_CURSOR);
+			if (!ret)
+				ret = Aprs->stations_db->seq(Aprs->stations_db, &key, &data, R_PREV);
+			else if (ret == 1)
+				ret = Aprs->stations_db->seq(Aprs->stations_db, &key, &data, R_LAST);
+		} else
+			ret = Aprs->stations_db->seq(Aprs->stations_db, &key, &data, flags);
+		// Stop at index entries
+		if (!ret && key.size != sizeof(AX25_Addr_t))
+			ret = 1;
 		if (!ret && Station)
 			memcpy(Station, data.data, sizeof(APRS_Station_t));
 		xSemaphoreGive(Aprs->stations_sem);
@@ -1161,6 +1614,69 @@ int APRS_Stations_Seq(APRS_t * Aprs, AX25_Addr_t *Addr, int flags, APRS_Station_
 	return ret;
 }
 
+// Next station matching Filter (wildcards as from AX25_Str_To_Addr), Cursor keeps position
+int APRS_Stations_Match(APRS_t * Aprs, const AX25_Addr_t * Filter, AX25_Addr_t * Cursor, int Flags, APRS_Station_t * Station) {
+	int ret;
+
+	if (!Aprs || !Aprs->stations_db)
+		return -1;
+
+	xSemaphoreTake(Aprs->stations_sem, portMAX_DELAY);
+	APRS_Log_Cache_Flush(Aprs->stations_cache, Aprs->stations_db);
+	ret = APRS_Log_Match(Aprs->stations_db, Filter, Cursor, Flags, Station);
+	xSemaphoreGive(Aprs->stations_sem);
+
+	return ret;
+}
+
+// Stations heard since Since, newest first, return number of stations
+int APRS_Stations_Last_Heard(APRS_t * Aprs, time_t Since, APRS_Station_t * Stations, int Max) {
+	int ret;
+
+	if (!Aprs || !Aprs->stations_db)
+		return -1;
+
+	xSemaphoreTake(Aprs->stations_sem, portMAX_DELAY);
+	APRS_Log_Cache_Flush(Aprs->stations_cache, Aprs->stations_db);
+	ret = APRS_Log_Last_Heard(Aprs->stations_db, Since, Stations, Max);
+	xSemaphoreGive(Aprs->stations_sem);
+
+	return ret;
+}
+
+// Stations within Radius miles of Center, return number of stations
+int APRS_Stations_Near(APRS_t * Aprs, const struct APRS_Position * Center, uint16_t Radius, APRS_Station_t * Stations, int Max) {
+	int ret;
+
+	if (!Aprs || !Aprs->stations_db)
+		return -1;
+
+	xSemaphoreTake(Aprs->stations_sem, portMAX_DELAY);
+	APRS_Log_Cache_Flush(Aprs->stations_cache, Aprs->stations_db);
+	ret = APRS_Log_Near(Aprs->stations_db, Center, Radius, Stations, Max);
+	xSemaphoreGive(Aprs->stations_sem);
+
+	return ret;
+}
+
+// Merge a batch of station records, one sync for the whole batch, return number of records written
+int APRS_Stations_Import(APRS_t * Aprs, APRS_Station_t * Stations, int N) {
+	int i, ret;
+
+	if (!Aprs || !Aprs->stations_db)
+		return -1;
+
+	xSemaphoreTake(Aprs->stations_sem, portMAX_DELAY);
+	// Compare with up to date records
+	APRS_Log_Cache_Flush(Aprs->stations_cache, Aprs->stations_db);
+	ret = APRS_Log_Import(Aprs->stations_db, Stations, N);
+	for (i=0; i<N; i++)
+		APRS_Log_Cache_Drop(Aprs->stations_cache, &Stations[i].callid);
+	xSemaphoreGive(Aprs->stations_sem);
+
+	return ret;
+}
+
 int APRS_Stations_Db_Reset(APRS_t * Aprs) {
 	APRS_Event_t event;
 	struct timeval tv;
@@ -1197,6 +1713,33 @@ int APRS_Frame_Received_Cb(APRS_t * Aprs, Frame_t * Frame) {
 	return 0;
 }
 
+// Battery event : save cached stations before power is lost
+static void APRS_Battery_Event_Handler(APRS_t * Aprs, esp_event_base_t event_base, int32_t event_id, int * Voltage) {
+	APRS_Event_t event;
+
+	if (event_base != MAIN_EVENT || event_id != MAIN_EVENT_BATTERY || !Voltage)
+		return;
+
+	if (*Voltage <= 0 || *Voltage >= APRS_CACHE_LOW_BATTERY)
+		return;
+
+	ESP_LOGW(TAG,"Low battery (%d mV), flushing stations cache", *Voltage);
+	event.type = APRS_FLUSH_DB;
+	event.frame = NULL;
+	xQueueSend(Aprs->queue, &event, 0);
+}
+
+static void APRS_Shutdown_Handler(void) {
+	APRS_t * aprs = APRS_Instance;
+
+	if (!aprs || !aprs->stations_db)
+		return;
+
+	xSemaphoreTake(aprs->stations_sem,portMAX_DELAY);
+	APRS_Log_Cache_Flush(aprs->stations_cache, aprs->stations_db);
+	xSemaphoreGive(aprs->stations_sem);
+}
+
 // GPS Event loop handler
 static void APRS_Gps_Event_Handler(APRS_t * Aprs,esp_event_base_t event_base, int32_t event_id, GPS_Data_t * Gps_Data) {
 	APRS_Event_t event;
@@ -30,6 +30,7 @@
 #include "ax25_lm.h"
 
 #define APRS_MAX_DIGI	8
+#define APRS_MAX_THIRD_PARTY	3	// Max nested third-party headers
 #define APRS_MAX_FRAME_LEN	(2+((APRS_MAX_DIGI)*sizeof(AX25_Addr_t)) + 2 + 64 + 2)	// SRC+DST+DIGIS[8]+CTRL+PID+INFO[64]+CRC[2]
 
 //#define APRS_SEND_STATUS_WITH_TIMESTAMP
@@ -81,6 +82,53 @@ enum APRS_DATA_EXT_E {	// DATA extension type
 };
 
 
+enum APRS_Mice_Msg_E {	// Mic-E message code
+	APRS_MICE_MSG_OFF_DUTY = 0,	// M0
+	APRS_MICE_MSG_EN_ROUTE,		// M1
+	APRS_MICE_MSG_IN_SERVICE,	// M2
+	APRS_MICE_MSG_RETURNING,	// M3
+	APRS_MICE_MSG_COMMITTED,	// M4
+	APRS_MICE_MSG_SPECIAL,		// M5
+	APRS_MICE_MSG_PRIORITY,		// M6
+	APRS_MICE_MSG_EMERGENCY,	// Emergency
+	APRS_MICE_MSG_CUSTOM = 0x08,	// Custom message flag (C0-C6)
+};
+
+enum APRS_Mice_Device_E {	// Mic-E device from type byte and suffix
+	APRS_MICE_DEV_UNKNOWN = 0,
+	APRS_MICE_DEV_KENWOOD_TH_D7A,
+	APRS_MICE_DEV_KENWOOD_TH_D72,
+	APRS_MICE_DEV_KENWOOD_TH_D74,
+	APRS_MICE_DEV_KENWOOD_TH_D75,
+	APRS_MICE_DEV_KENWOOD_TM_D700,
+	APRS_MICE_DEV_KENWOOD_TM_D710,
+	APRS_MICE_DEV_YAESU_VX_8,
+	APRS_MICE_DEV_YAESU_VX_8G,
+	APRS_MICE_DEV_YAESU_FTM_350,
+	APRS_MICE_DEV_YAESU_FTM_400DR,
+	APRS_MICE_DEV_YAESU_FTM_100D,
+	APRS_MICE_DEV_YAESU_FTM_300D,
+	APRS_MICE_DEV_YAESU_FT1D,
+	APRS_MICE_DEV_YAESU_FT2D,
+	APRS_MICE_DEV_YAESU_FT3D,
+	APRS_MICE_DEV_YAESU_FT5D,
+	APRS_MICE_DEV_ANYTONE_D578UV,
+	APRS_MICE_DEV_ANYTONE_D878UV,
+	APRS_MICE_DEV_BYONICS_TT3,
+	APRS_MICE_DEV_BYONICS_TT4,
+	APRS_MICE_DEV_SCS_DR7400,
+	APRS_MICE_DEV_SCS_DR7800,
+	APRS_MICE_DEV_MAX,
+};
+
+enum APRS_Msg_Type_E {	// Message type
+	APRS_MSG_TYPE_MESSAGE = 0,
+	APRS_MSG_TYPE_ACK,
+	APRS_MSG_TYPE_REJ,
+	APRS_MSG_TYPE_BULLETIN,
+	APRS_MSG_TYPE_ANNOUNCEMENT,
+};
+
 enum APRS_Status_Type_E {
 	APRS_Status_Type_Msg,
 	APRS_Status_Type_DHM_Msg,
@@ -167,11 +215,27 @@ struct APRS_Object {
 	};
 };
 
-struct APRS_Weather {
+enum APRS_WX_E {	// Weather fields, bit in APRS_Weather.valid
+	APRS_WX_WIND_DIR = 0,
+	APRS_WX_WIND_SPEED,
+	APRS_WX_GUST,
+	APRS_WX_TEMP,
+	APRS_WX_RAIN_1H,
+	APRS_WX_RAIN_24H,
+	APRS_WX_RAIN_MIDNIGHT,
+	APRS_WX_HUMIDITY,
+	APRS_WX_PRESSURE,
+	APRS_WX_LUMINOSITY,
+	APRS_WX_SNOW,
+	APRS_WX_RAIN_COUNTER,
+	APRS_WX_MAX
+};
+
+struct APRS_Weather {	// Values in APRS units
 	int16_t wind_dir;	// °
-	int16_t wind_speed;	// knot
-	int16_t gust;		// knot
-	int16_t temp;		// °C
+	int16_t wind_speed;	// mph
+	int16_t gust;		// mph
+	int16_t temp;		// °F
 	int16_t rain_last_1h;	// 1/100 inch
 	int16_t rain_last_24h;	// 1/100 inch
 	int16_t rain_since_midnight; // 1/100 inch
@@ -180,6 +244,7 @@ struct APRS_Weather {
 	int16_t luminosity;	// W/(m^2)
 	int16_t snow_fall;	// inch
 	int16_t rain_counter;
+	uint16_t valid;		// Present fields (1<<APRS_WX_*)
 };
 
 struct APRS_Storm {
@@ -194,6 +259,33 @@ struct APRS_Storm {
 	int32_t r_gale;		// radius of whole gale wind
 };
 
+struct APRS_Message {
+	uint8_t type;		// enum APRS_Msg_Type_E
+	char addressee[10];	// 9 chars addressee
+	char id[6];		// Message number (acked/rejected number for ack/rej)
+	char reply_ack[6];	// Reply-ack number if any
+	bool reply_ack_cap;	// Reply-ack capable ({MM} form)
+	char text[68];		// Message text
+};
+
+struct APRS_Query {
+	char name[8];		// "APRS", "IGATE", "WX" ...
+	bool footprint;		// Only stations in area must reply
+	struct APRS_Position center;
+	uint16_t radius;	// miles
+};
+
+#define APRS_TLM_ANALOG	5	// Analog channels
+#define APRS_TLM_BITS	8	// Digital channels
+
+struct APRS_Telemetry {
+	int16_t seq;		// Sequence number (-1 for MIC)
+	uint8_t n_analog;	// Analog values present
+	bool has_bits;		// Digital values present
+	uint8_t bits;		// B1 in msb
+	float analog[APRS_TLM_ANALOG];	// Raw analog values
+};
+
 typedef struct APRS_Data_S {
 	time_t timestamp;			// Time of arrival
 	AX25_Addr_t address[2 + APRS_MAX_DIGI];	// AX25 address : dst, src, digipeatiers
@@ -203,6 +295,14 @@ typedef struct APRS_Data_S {
 	char symbol[2];				// 2 char symbol identifier
 	bool messaging;				// Station have messaging capability
 	uint8_t comp_type;			// T byte of compressed report
+	uint8_t mice_msg;			// Mic-E message code (enum APRS_Mice_Msg_E)
+	uint8_t mice_device;			// Mic-E device (enum APRS_Mice_Device_E)
+	char object_name[10];			// Object or item name
+	bool object_killed;			// Object or item killed
+	uint8_t third_party;			// Third-party headers unwrapped
+	uint16_t text_pos;			// Offset of comment or message text in frame, 0 if not there as is
+	uint8_t text_len;			// and its length
+	AX25_Addr_t gateway;			// Third-party gateway (RF source)
 	union {
 		struct {
 			struct APRS_Time time;
@@ -220,11 +320,16 @@ typedef struct APRS_Data_S {
 				struct APRS_Beam beam;
 				struct APRS_Weather weather;
 				struct APRS_Storm storm;
+				struct APRS_Telemetry telemetry;
 			};
 			char text[64];
 		};
 		// Raw gps data
 		char nmea[NMEA_MAX_LENGTH];
+		// Message, ack, rej, bulletin
+		struct APRS_Message message;
+		// General query
+		struct APRS_Query query;
 	};
 } APRS_Data_t;
 
@@ -242,9 +347,63 @@ typedef struct APRS_Station_S {
 		struct APRS_NRQ nrq;
 	};
 	char status[64];
+	struct APRS_Weather weather;	// Last weather report
 } APRS_Station_t;
 
+typedef struct APRS_Obj_S {	// Object or item
+	time_t timestamp;		// Last update
+	AX25_Addr_t originator;
+	char name[10];
+	bool killed;
+	bool item;
+	char symbol[2];
+	struct APRS_Position position;
+	struct APRS_Course course;
+	char comment[44];
+} APRS_Obj_t;
+
+#define APRS_TLM_RING	8	// Telemetry points kept per station
+
+typedef struct APRS_Tlm_Point_S {	// Telemetry point
+	uint32_t timestamp;
+	int16_t seq;
+	uint8_t bits;
+	float analog[APRS_TLM_ANALOG];	// Raw values
+} APRS_Tlm_Point_t;
+
+typedef struct APRS_Tlm_S {	// Station telemetry definitions and history
+	AX25_Addr_t callid;
+	time_t timestamp;		// Last update
+	char parm[APRS_TLM_ANALOG+APRS_TLM_BITS][8];	// PARM. channel names
+	char unit[APRS_TLM_ANALOG+APRS_TLM_BITS][8];	// UNIT. units / labels
+	float eqns[APRS_TLM_ANALOG][3];	// EQNS. a,b,c : a*x^2 + b*x + c
+	uint8_t bits_sense;		// BITS. active state, B1 in msb
+	char project[24];		// BITS. project title
+	uint8_t head;			// Next point in ring
+	uint8_t count;			// Points in ring
+	APRS_Tlm_Point_t ring[APRS_TLM_RING];
+} APRS_Tlm_t;
+
 #define APRS_EVENT_RECEIVE	0
+#define APRS_EVENT_MESSAGE	1	// Message addressed to local station
+#define APRS_EVENT_RELEASE	2	// Internal, frame of previous event released
+
+// Frame descriptor posted with APRS_EVENT. The frame is referenced until every
+// handler ran, text stays in it and the rest is decoded on demand (APRS_Event_Decode)
+typedef struct APRS_Event_Data_S {
+	Frame_t * frame;			// Received frame
+	time_t timestamp;			// Time of arrival
+	enum APRS_DTI_E	type;			// APRS data type identifier
+	enum APRS_DATA_EXT_E extension;		// APRS data extension type if any
+	AX25_Addr_t src;			// Source station (third party one if unwrapped)
+	AX25_Addr_t via;			// Digipeater heard from (if from > 1)
+	uint8_t from;				// Index of heard station in frame path
+	char symbol[2];				// 2 char symbol identifier
+	struct APRS_Position position;
+	struct APRS_Course course;
+	uint16_t text;				// Offset of message text or comment in frame, 0 to decode it
+	uint8_t text_len;
+} APRS_Event_Data_t;
 
 extern const char *APRS_Ssid_Symbol[16];
 
@@ -273,11 +432,21 @@ int APRS_Get_Status(APRS_t * Aprs, char * Status, int len);
 int APRS_Send_Status(APRS_t * Aprs, const char * Status);
 int APRS_Get_Position(APRS_t * Aprs, struct APRS_Position * Position);
 int APRS_Send_Position(APRS_t * Aprs, const char * Comment);
+int APRS_Send_Message(APRS_t * Aprs, const char * Addressee, const char * Text);
 
 int APRS_Get_Local(APRS_t * Aprs, APRS_Station_t * Station);
 int APRS_Get_Station(APRS_t * Aprs, AX25_Addr_t *Id, APRS_Station_t * Station);
+const APRS_Station_t * APRS_Station_Snapshot(APRS_t * Aprs, const AX25_Addr_t * Id, uint32_t * Version);
+bool APRS_Station_Snapshot_Valid(APRS_t * Aprs, const APRS_Station_t * Station, uint32_t Version);
 int APRS_Stations_Seq(APRS_t *Aprs, AX25_Addr_t *Addr, int flags, APRS_Station_t *Station);
+int APRS_Stations_Match(APRS_t * Aprs, const AX25_Addr_t * Filter, AX25_Addr_t * Cursor, int Flags, APRS_Station_t * Station);
+int APRS_Stations_Last_Heard(APRS_t * Aprs, time_t Since, APRS_Station_t * Stations, int Max);
+int APRS_Stations_Near(APRS_t * Aprs, const struct APRS_Position * Center, uint16_t Radius, APRS_Station_t * Stations, int Max);
+int APRS_Stations_Import(APRS_t * Aprs, APRS_Station_t * Stations, int N);
 int APRS_Stations_Db_Reset(APRS_t *Aprs);
+int APRS_Get_Object(APRS_t *Aprs, const char * Name, const AX25_Addr_t * Originator, APRS_Obj_t * Obj);
+int APRS_Get_Object_Nth(APRS_t *Aprs, int n, APRS_Obj_t * Obj);
+int APRS_Get_Telemetry(APRS_t *Aprs, const AX25_Addr_t * Callid, APRS_Tlm_t * Tlm);
 
 // Maidenhead locator helper
 int APRS_Position_To_Locator(struct APRS_Position * Pos, char * Grid,int len);
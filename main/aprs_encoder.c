@@ -22,6 +22,7 @@
  */
 
 #include <math.h>
+#include <stdio.h>
 
 #include <esp_log.h>
 
@@ -37,9 +38,14 @@ static int APRS_Encode_Locator(APRS_Data_t * Data, uint8_t * ptr, int len);
 static int APRS_Encode_Altitude(APRS_Data_t * Data, uint8_t * ptr, int len);
 static int APRS_Encode_Comment(APRS_Data_t * Data, uint8_t * ptr, int len);
 static int APRS_Encode_Beam(APRS_Data_t * Data, uint8_t * ptr, int len);
+static int APRS_Encode_Mice(APRS_Data_t * Data, AX25_Addr_t * Dst, uint8_t * ptr, int len);
+static int APRS_Encode_Message(APRS_Data_t * Data, uint8_t * ptr, int len);
+static int APRS_Encode_Telemetry(APRS_Data_t * Data, uint8_t * ptr, int len);
 
 static int APRS_Encode_Extension(APRS_Data_t * Data, uint8_t * ptr, int len);
 
+static void APRS_Encode_Dmc(int32_t Pos, uint32_t * Deg, uint32_t * Min, uint32_t * Cent);
+
 int APRS_Encode(APRS_Data_t * Data, Frame_t * Frame) {
 	uint8_t *ptr;
 	int ret, pos, i;
@@ -84,16 +90,31 @@ int APRS_Encode(APRS_Data_t * Data, Frame_t * Frame) {
 
 	// Set Datas
 	switch (Data->type) {
-		case APRS_DTI_POS_W_TS:
-		case APRS_DTI_POS_W_TS_W_MSG:
-			ret = APRS_Encode_Ts(Data, ptr, APRS_MAX_FRAME_LEN-2 - pos);
-			if (ret < 0) {
-				ESP_LOGE(TAG,"Error encoding timestamp");
+		case APRS_DTI_OBJECT:	// 9 chars name space padded, '*' live or '_' killed
+		case APRS_DTI_ITEM:	// 3-9 chars name, '!' live or '_' killed
+			ret = strlen(Data->object_name);
+			if ((Data->type == APRS_DTI_OBJECT && ret < 1) || (Data->type == APRS_DTI_ITEM && ret < 3)
+					|| ret > 9 || strpbrk(Data->object_name, "!_*")) {
+				ESP_LOGE(TAG,"Invalid object name \"%s\"", Data->object_name);
 				return -1;
 			}
+			ret = snprintf((char*)ptr, APRS_MAX_FRAME_LEN-2 - pos, Data->type == APRS_DTI_OBJECT?"%-9s%c":"%s%c",
+					Data->object_name, Data->object_killed?'_':(Data->type == APRS_DTI_OBJECT?'*':'!'));
 			pos += ret;
 			ptr += ret;
 			/* FALLTHRU */
+		case APRS_DTI_POS_W_TS:
+		case APRS_DTI_POS_W_TS_W_MSG:
+			if (Data->type != APRS_DTI_ITEM) {
+				ret = APRS_Encode_Ts(Data, ptr, APRS_MAX_FRAME_LEN-2 - pos);
+				if (ret < 0) {
+					ESP_LOGE(TAG,"Error encoding timestamp");
+					return -1;
+				}
+				pos += ret;
+				ptr += ret;
+			}
+			/* FALLTHRU */
 		case APRS_DTI_POS:
 		case APRS_DTI_POS_W_MSG:
 			if (!Data->position.latitude && !Data->position.longitude) { // no position information
@@ -189,6 +210,83 @@ int APRS_Encode(APRS_Data_t * Data, Frame_t * Frame) {
 			Frame->frame_len = pos;
 			return pos;
 
+		case APRS_DTI_CUR_MICE:
+		case APRS_DTI_OLD_MICE_TMD700:
+			ret = APRS_Encode_Mice(Data, (AX25_Addr_t*)Frame->frame, ptr, APRS_MAX_FRAME_LEN-2 - pos);
+			if (ret < 0) {
+				ESP_LOGE(TAG,"Error encoding Mic-E report");
+				return -1;
+			}
+			pos += ret;
+			ptr += ret;
+
+			ret = APRS_Encode_Comment(Data, ptr, APRS_MAX_FRAME_LEN-2 - pos);
+			if (ret < 0) {
+				ESP_LOGE(TAG,"Error encoding comment text");
+				return -1;
+			}
+			pos += ret;
+			ptr += ret;
+
+			Frame->frame_len = pos;
+			return pos;
+
+		case APRS_DTI_MESSAGE:
+			ret = APRS_Encode_Message(Data, ptr, APRS_MAX_FRAME_LEN-2 - pos);
+			if (ret < 0) {
+				ESP_LOGE(TAG,"Error encoding message");
+				return -1;
+			}
+			pos += ret;
+			ptr += ret;
+
+			Frame->frame_len = pos;
+			return pos;
+
+		case APRS_DTI_STATION_CAP:	// Capabilities list in text
+			ret = APRS_Encode_Comment(Data, ptr, APRS_MAX_FRAME_LEN-2 - pos);
+			if (ret <= 0) {
+				ESP_LOGE(TAG,"Error encoding station capabilities");
+				return -1;
+			}
+			pos += ret;
+			ptr += ret;
+
+			Frame->frame_len = pos;
+			return pos;
+
+		case APRS_DTI_QUERY:
+			ret = snprintf((char*)ptr, APRS_MAX_FRAME_LEN-2 - pos, "%s?", Data->query.name);
+			if (ret <= 1 || ret >= APRS_MAX_FRAME_LEN-2 - pos) {
+				ESP_LOGE(TAG,"Error encoding query");
+				return -1;
+			}
+			pos += ret;
+			ptr += ret;
+
+			Frame->frame_len = pos;
+			return pos;
+
+		case APRS_DTI_TELEMETRIE:
+			ret = APRS_Encode_Telemetry(Data, ptr, APRS_MAX_FRAME_LEN-2 - pos);
+			if (ret < 0) {
+				ESP_LOGE(TAG,"Error encoding telemetry");
+				return -1;
+			}
+			pos += ret;
+			ptr += ret;
+
+			ret = APRS_Encode_Comment(Data, ptr, APRS_MAX_FRAME_LEN-2 - pos);
+			if (ret < 0) {
+				ESP_LOGE(TAG,"Error encoding comment text");
+				return -1;
+			}
+			pos += ret;
+			ptr += ret;
+
+			Frame->frame_len = pos;
+			return pos;
+
 		default:
 			ESP_LOGE(TAG,"Unimplemented encoder for DTI \"%c\".",Data->type);
 			return -1;
@@ -258,18 +356,8 @@ int APRS_Encode_Pos(APRS_Data_t * Data, uint8_t * ptr, int len) {
 		return -1;
 	}
 
-	if (Data->position.latitude<0) {
-		deg = -Data->position.latitude;
-		dir = 'S';
-	} else {
-		deg = Data->position.latitude;
-		dir = 'N';
-	}
-
-	min = ((deg&((1<<GPS_FIXED_POINT_DEG)-1))*60);
-	deg = deg>>GPS_FIXED_POINT_DEG;
-	cent = ((min&((1<<GPS_FIXED_POINT_DEG)-1))*100 + (1<<(GPS_FIXED_POINT_DEG-1)))>>GPS_FIXED_POINT_DEG;
-	min >>= GPS_FIXED_POINT_DEG;
+	dir = Data->position.latitude<0 ? 'S' : 'N';
+	APRS_Encode_Dmc(Data->position.latitude, &deg, &min, &cent);
 
 	ESP_LOGD(TAG,"latitude = %ld, deg = %lu, min = %lu , cent = %lu",Data->position.latitude,deg,min,cent);
 
@@ -317,18 +405,8 @@ int APRS_Encode_Pos(APRS_Data_t * Data, uint8_t * ptr, int len) {
 	*(ptr++) = dir;
 	*(ptr++) = Data->symbol[0];
 
-	if (Data->position.longitude<0) {
-		deg = -Data->position.longitude;
-		dir = 'W';
-	} else {
-		deg = Data->position.longitude;
-		dir = 'E';
-	}
-
-	min = ((deg&((1<<GPS_FIXED_POINT_DEG)-1))*60);
-	deg = deg>>GPS_FIXED_POINT_DEG;
-	cent = ((min&((1<<GPS_FIXED_POINT_DEG)-1))*100 + (1<<(GPS_FIXED_POINT_DEG-1)))>>GPS_FIXED_POINT_DEG;
-	min >>= GPS_FIXED_POINT_DEG;
+	dir = Data->position.longitude<0 ? 'W' : 'E';
+	APRS_Encode_Dmc(Data->position.longitude, &deg, &min, &cent);
 
 	*(ptr++) = (deg/100) + '0';
 	deg %= 100;
@@ -382,14 +460,15 @@ int APRS_Encode_Pos(APRS_Data_t * Data, uint8_t * ptr, int len) {
 int APRS_Encode_Locator(APRS_Data_t * Data, uint8_t * ptr, int len) {
 	int pos;
 
-	pos = APRS_Position_To_Locator(&Data->position, (char*)ptr, len);
+	if ((pos = APRS_Position_To_Locator(&Data->position, (char*)ptr, len)) < 0)
+		return -1;
 
 	ptr[pos] = '\0';
 	ESP_LOGD(TAG,"latitude %d.%03d longitude %d.%03d\n\t\tlocator %s",
 			(int)(Data->position.latitude>>GPS_FIXED_POINT_DEG),
-			(int)((Data->position.latitude&((1<<GPS_FIXED_POINT_DEG)-1))*1000)>>GPS_FIXED_POINT_DEG,
+			(int)((((int64_t)Data->position.latitude&((1<<GPS_FIXED_POINT_DEG)-1))*1000)>>GPS_FIXED_POINT_DEG),
 			(int)(Data->position.longitude>>GPS_FIXED_POINT_DEG),
-			(int)((Data->position.longitude&((1<<GPS_FIXED_POINT_DEG)-1))*1000)>>GPS_FIXED_POINT_DEG,
+			(int)((((int64_t)Data->position.longitude&((1<<GPS_FIXED_POINT_DEG)-1))*1000)>>GPS_FIXED_POINT_DEG),
 			ptr
 		);
 
@@ -551,3 +630,278 @@ static int APRS_Encode_Extension(APRS_Data_t * Data, uint8_t * ptr, int len) {
 
 	return pos;
 }
+
+// Split fixed point position in degrees, minutes and hundredths of minute,
+// rounding carried over to minutes and degrees
+static void APRS_Encode_Dmc(int32_t Pos, uint32_t * Deg, uint32_t * Min, uint32_t * Cent) {
+	uint32_t deg, min, cent;
+
+	deg = Pos<0?-Pos:Pos;
+	min = ((deg&((1<<GPS_FIXED_POINT_DEG)-1))*60);
+	deg = deg>>GPS_FIXED_POINT_DEG;
+	cent = ((min&((1<<GPS_FIXED_POINT_DEG)-1))*100 + (1<<(GPS_FIXED_POINT_DEG-1)))>>GPS_FIXED_POINT_DEG;
+	min >>= GPS_FIXED_POINT_DEG;
+
+	if (cent > 99) {
+		cent -= 100;
+		min++;
+	}
+	if (min > 59) {
+		min -= 60;
+		deg++;
+	}
+
+	*Deg = deg;
+	*Min = min;
+	*Cent = cent;
+}
+
+// Mic-E report : latitude and message in destination address, rest in info field
+static int APRS_Encode_Mice(APRS_Data_t * Data, AX25_Addr_t * Dst, uint8_t * ptr, int len) {
+	uint32_t deg, min, cent;
+	uint8_t digit[6];
+	uint8_t msg, sp, dc, se;
+	bool custom, bit;
+	int i, amb, pos;
+	int32_t alt;
+	uint16_t course, speed;
+
+	if (len < 8)
+		return -1;
+
+	switch (Data->position.ambiguity) {
+		case APRS_AMBIGUITY_NONE:
+			amb = 0;
+			break;
+		case APRS_AMBIGUITY_TENTH_MIN:
+			amb = 1;
+			break;
+		case APRS_AMBIGUITY_MIN:
+			amb = 2;
+			break;
+		case APRS_AMBIGUITY_TEN_MIN:
+			amb = 3;
+			break;
+		case APRS_AMBIGUITY_DEG:
+			amb = 4;
+			break;
+		default:
+			ESP_LOGE(TAG,"Mic-E ambiguity can't be more than 1°.");
+			return -1;
+	}
+
+	// Latitude digits
+	APRS_Encode_Dmc(Data->position.latitude, &deg, &min, &cent);
+
+	digit[0] = deg/10;
+	digit[1] = deg%10;
+	digit[2] = min/10;
+	digit[3] = min%10;
+	digit[4] = cent/10;
+	digit[5] = cent%10;
+
+	// Message bits A/B/C
+	if ((Data->mice_msg&7) == APRS_MICE_MSG_EMERGENCY) {
+		msg = 0;
+		custom = false;
+	} else {
+		msg = 7 - (Data->mice_msg&7);
+		custom = Data->mice_msg&APRS_MICE_MSG_CUSTOM;
+	}
+
+	// Longitude, degrees needed for the offset bit
+	APRS_Encode_Dmc(Data->position.longitude, &deg, &min, &cent);
+
+	// Destination address
+	for (i=0;i<6;i++) {
+		if (i < 3)
+			bit = (msg>>(2-i))&1;
+		else if (i == 3)
+			bit = Data->position.latitude >= 0;	// North
+		else if (i == 4)
+			bit = deg < 10 || deg > 99;		// Longitude offset
+		else
+			bit = Data->position.longitude < 0;	// West
+
+		if (i >= 6-amb)
+			Dst->callid[i] = (bit?(custom && i<3?'K':'Z'):'L')<<1;
+		else if (bit)
+			Dst->callid[i] = ((custom && i<3?'A':'P') + digit[i])<<1;
+		else
+			Dst->callid[i] = ('0' + digit[i])<<1;
+	}
+
+	// Longitude
+	if (deg < 10)
+		*(ptr++) = deg + 118;
+	else if (deg < 100)
+		*(ptr++) = deg + 28;
+	else if (deg < 110)
+		*(ptr++) = deg + 8;
+	else
+		*(ptr++) = deg - 72;
+
+	if (min < 10)
+		*(ptr++) = min + 88;
+	else
+		*(ptr++) = min + 28;
+
+	*(ptr++) = cent + 28;
+
+	// Speed and course
+	if (Data->extension == APRS_DATA_EXT_CSE || Data->extension == APRS_DATA_EXT_CSE_NRQ) {
+		speed = Data->course.speed>799?799:Data->course.speed;
+		course = Data->course.dir%360;
+	} else
+		speed = course = 0;
+
+	sp = speed/10;
+	if (sp < 20)
+		sp += 80;
+	dc = (speed%10)*10 + course/100;
+	if (dc < 4)
+		dc += 4;
+	se = course%100;
+
+	*(ptr++) = sp + 28;
+	*(ptr++) = dc + 28;
+	*(ptr++) = se + 28;
+
+	*(ptr++) = Data->symbol[1];
+	*(ptr++) = Data->symbol[0];
+	pos = 8;
+
+	// Altitude
+	if (Data->position.altitude && (len-pos) >= 4) {
+		alt = lroundf((float)Data->position.altitude * 0.3048f) + 10000;	// meters
+		if (alt < 0)
+			alt = 0;
+		*(ptr++) = (alt/(91*91))%91 + '!';
+		*(ptr++) = (alt/91)%91 + '!';
+		*(ptr++) = alt%91 + '!';
+		*(ptr++) = '}';
+		pos += 4;
+	}
+
+	return pos;
+}
+
+// Message, ack or rej : ":ADDRESSEE:text{MM}AA"
+static int APRS_Encode_Message(APRS_Data_t * Data, uint8_t * ptr, int len) {
+	struct APRS_Message * msg = &Data->message;
+	int pos, i;
+
+	if (len < 10)
+		return -1;
+
+	for (i=0; i<9 && msg->addressee[i]; i++)
+		*(ptr++) = msg->addressee[i];
+	for (; i<9; i++)
+		*(ptr++) = ' ';
+	*(ptr++) = ':';
+	pos = 10;
+
+	switch (msg->type) {
+		case APRS_MSG_TYPE_ACK:
+		case APRS_MSG_TYPE_REJ:
+			i = snprintf((char*)ptr, len-pos, "%s%s", msg->type==APRS_MSG_TYPE_ACK?"ack":"rej", msg->id);
+			break;
+		default:
+			if (!msg->id[0])
+				i = snprintf((char*)ptr, len-pos, "%s", msg->text);
+			else if (msg->reply_ack_cap)
+				i = snprintf((char*)ptr, len-pos, "%s{%s}%s", msg->text, msg->id, msg->reply_ack);
+			else
+				i = snprintf((char*)ptr, len-pos, "%s{%s", msg->text, msg->id);
+	}
+
+	if (i < 0 || i >= len-pos) {
+		ESP_LOGE(TAG,"Message too long");
+		return -1;
+	}
+
+	return pos + i;
+}
+
+// Telemetry : "#sss,aaa,aaa,aaa,aaa,aaa,bbbbbbbb"
+static int APRS_Encode_Telemetry(APRS_Data_t * Data, uint8_t * ptr, int len) {
+	struct APRS_Telemetry * tlm = &Data->telemetry;
+	int pos, i, ret;
+
+	if (tlm->seq < 0)
+		pos = snprintf((char*)ptr, len, "#MIC");
+	else
+		pos = snprintf((char*)ptr, len, "#%03d", tlm->seq % 1000);
+	if (pos < 0 || pos >= len)
+		return -1;
+
+	for (i = 0; i < tlm->n_analog && i < APRS_TLM_ANALOG; i++) {
+		ret = snprintf((char*)ptr + pos, len - pos, ",%g", tlm->analog[i]);
+		if (ret < 0 || ret >= len - pos)
+			return -1;
+		pos += ret;
+	}
+
+	if (tlm->has_bits) {
+		// Keep the analog fields positional
+		for (; i < APRS_TLM_ANALOG; i++) {
+			if (pos + 1 >= len)
+				return -1;
+			ptr[pos++] = ',';
+		}
+		if (pos + 1 + APRS_TLM_BITS > len)
+			return -1;
+		ptr[pos++] = ',';
+		for (i = 0; i < APRS_TLM_BITS; i++)
+			ptr[pos++] = (tlm->bits & (0x80>>i)) ? '1' : '0';
+	}
+
+	return pos;
+}
+
+int APRS_Position_To_Locator(struct APRS_Position * Position, char * Grid,int len) {
+	int pos;
+	int n_pair;
+	uint32_t lon, lat;
+
+	if (Position->ambiguity <= APRS_AMBIGUITY_LOC_EXT_SQUARE)
+		n_pair = 4;
+	else if (Position->ambiguity <= APRS_AMBIGUITY_LOC_SUBSQUARE)
+		n_pair = 3;
+	else if (Position->ambiguity <= APRS_AMBIGUITY_LOC_SQUARE)
+		n_pair = 2;
+	else 
+		n_pair = 1;
+
+	if (len < (n_pair<<1)) {
+		return -1;
+	}
+
+	lon = Position->longitude + (180<<GPS_FIXED_POINT_DEG);
+	lat = Position->latitude + (90<<GPS_FIXED_POINT_DEG);
+
+	lon /= 20;
+	lat /= 10;
+
+	pos = 0;
+	while (n_pair && (pos+3)<len) {
+		if ((pos>>1)&1) {
+			Grid[pos] = (lon>>GPS_FIXED_POINT_DEG) + '0';
+			Grid[pos+1] = (lat>>GPS_FIXED_POINT_DEG) + '0';
+			lon = (lon & ((1<<GPS_FIXED_POINT_DEG)-1))*24;
+			lat = (lat & ((1<<GPS_FIXED_POINT_DEG)-1))*24;
+		} else {
+			Grid[pos] = (lon>>GPS_FIXED_POINT_DEG) + 'A';
+			Grid[pos+1] = (lat>>GPS_FIXED_POINT_DEG) + 'A';
+			lon = (lon & ((1<<GPS_FIXED_POINT_DEG)-1))*10;
+			lat = (lat & ((1<<GPS_FIXED_POINT_DEG)-1))*10;
+		}
+		n_pair--;
+		pos += 2;
+	}
+
+	if (pos < len)
+		Grid[pos] = '\0';
+
+	return pos;
+}
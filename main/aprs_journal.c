@@ -0,0 +1,365 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * main/aprs_journal.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __P
+#define __P(arg) arg
+#endif
+
+#ifndef __BEGIN_DECLS
+#define __BEGIN_DECLS
+#endif
+
+#ifndef __END_DECLS
+#define __END_DECLS
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include "aprs_lsdb.h"
+#include "aprs_journal.h"
+
+#define TAG "APRS_JOURNAL"
+
+#define APRS_JOURNAL_DATA_MAX	(UINT16_MAX - sizeof(APRS_Lsdb_Rec_t) - APRS_LSDB_KEY_MAX)
+
+typedef struct APRS_Journal_S {
+	DB db;			// Must be first, DB * is also APRS_Journal_t *
+	DB * inner;		// Journaled DB
+	int fd;			// Journal file, append only
+	char * path;
+	uint8_t * buf;		// Record write buffer
+	size_t buf_size;
+	uint32_t records;	// Records appended since last commit
+} APRS_Journal_t;
+
+static uint32_t APRS_Journal_Crc(const APRS_Lsdb_Rec_t * Rec, const uint8_t * Body) {
+	uint32_t crc;
+
+	crc = esp_rom_crc32_le(0, (const uint8_t *)&Rec->data_size, sizeof(APRS_Lsdb_Rec_t) - sizeof(Rec->crc));
+	return esp_rom_crc32_le(crc, Body, Rec->key_size + Rec->data_size);
+}
+
+static uint8_t * APRS_Journal_Buf(uint8_t ** Buf, size_t * Buf_Size, size_t Size) {
+	uint8_t * buf;
+
+	if (Size <= *Buf_Size)
+		return *Buf;
+
+	buf = realloc(*Buf, Size);
+	if (!buf) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	*Buf = buf;
+	*Buf_Size = Size;
+
+	return buf;
+}
+
+// Read next record, body (key then data) in *Buf
+// return 1 if a valid record was read, 0 at end of file or on damaged record
+static int APRS_Journal_Next(int Fd, APRS_Lsdb_Rec_t * Rec, uint8_t ** Buf, size_t * Buf_Size) {
+	size_t size;
+
+	if (read(Fd, Rec, sizeof(APRS_Lsdb_Rec_t)) != sizeof(APRS_Lsdb_Rec_t))
+		return 0;
+
+	switch (Rec->type) {
+		case APRS_LSDB_PUT:
+		case APRS_LSDB_DEL:
+			if (!Rec->key_size || Rec->key_size > APRS_LSDB_KEY_MAX)
+				return 0;
+			break;
+		case APRS_JOURNAL_COMMIT:
+			if (Rec->key_size || Rec->data_size)
+				return 0;
+			break;
+		default:
+			return 0;
+	}
+
+	size = Rec->key_size + Rec->data_size;
+	if (!APRS_Journal_Buf(Buf, Buf_Size, size ? size : 1))
+		return 0;
+	if (size && read(Fd, *Buf, size) != size)
+		return 0;
+
+	return APRS_Journal_Crc(Rec, *Buf) == Rec->crc;
+}
+
+// Offset following the last valid commit record, file size in *Size (-1 if missing)
+static off_t APRS_Journal_Scan(const char * Path, off_t * Size) {
+	APRS_Lsdb_Rec_t rec;
+	uint8_t * buf = NULL;
+	size_t buf_size = 0;
+	off_t offset = 0, end = 0;
+	int fd;
+
+	*Size = -1;
+	fd = open(Path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+
+	while (APRS_Journal_Next(fd, &rec, &buf, &buf_size)) {
+		offset += sizeof(APRS_Lsdb_Rec_t) + rec.key_size + rec.data_size;
+		if (rec.type == APRS_JOURNAL_COMMIT)
+			end = offset;
+	}
+	*Size = lseek(fd, 0, SEEK_END);
+
+	free(buf);
+	close(fd);
+
+	return end;
+}
+
+int APRS_Journal_State(const char * Path) {
+	off_t size, end;
+
+	if (!Path)
+		return -1;
+
+	end = APRS_Journal_Scan(Path, &size);
+	if (size <= 0)
+		return APRS_JOURNAL_EMPTY;
+
+	return end ? APRS_JOURNAL_COMMITTED : APRS_JOURNAL_PENDING;
+}
+
+int APRS_Journal_Replay(const char * Path, DB * Db) {
+	APRS_Lsdb_Rec_t rec;
+	uint8_t * buf = NULL;
+	size_t buf_size = 0;
+	off_t size, end, offset = 0;
+	DBT key, data;
+	int fd, count = 0, ret;
+
+	if (!Path || !Db)
+		return -1;
+
+	end = APRS_Journal_Scan(Path, &size);
+	if (!end)
+		return 0;
+
+	fd = open(Path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	// Records of the committed prefix, applied in order
+	while (offset < end && APRS_Journal_Next(fd, &rec, &buf, &buf_size)) {
+		offset += sizeof(APRS_Lsdb_Rec_t) + rec.key_size + rec.data_size;
+		key.data = buf;
+		key.size = rec.key_size;
+		data.data = buf + rec.key_size;
+		data.size = rec.data_size;
+
+		if (rec.type == APRS_LSDB_PUT)
+			ret = Db->put(Db, &key, &data, 0);
+		else if (rec.type == APRS_LSDB_DEL)
+			ret = Db->del(Db, &key, 0);
+		else
+			continue;
+
+		if (ret == RET_ERROR) {
+			ESP_LOGE(TAG, "%s : error applying record at %ld (%d)", Path, (long)offset, errno);
+			count = -1;
+			break;
+		}
+		count++;
+	}
+
+	free(buf);
+	close(fd);
+
+	if (count >= 0)
+		ESP_LOGI(TAG, "%s : %d records replayed, %ld bytes not committed", Path, count, (long)(size - end));
+
+	return count;
+}
+
+static int APRS_Journal_Append(APRS_Journal_t * Journal, uint8_t Type, const void * Key, size_t Key_Size, const void * Data, size_t Data_Size) {
+	APRS_Lsdb_Rec_t rec;
+	size_t size = sizeof(APRS_Lsdb_Rec_t) + Key_Size + Data_Size;
+	uint8_t * buf;
+
+	// Whole record in one write
+	if (!(buf = APRS_Journal_Buf(&Journal->buf, &Journal->buf_size, size)))
+		return -1;
+	rec.data_size = Data_Size;
+	rec.key_size = Key_Size;
+	rec.type = Type;
+	if (Key_Size)
+		memcpy(buf + sizeof(APRS_Lsdb_Rec_t), Key, Key_Size);
+	if (Data_Size)
+		memcpy(buf + sizeof(APRS_Lsdb_Rec_t) + Key_Size, Data, Data_Size);
+	rec.crc = APRS_Journal_Crc(&rec, buf + sizeof(APRS_Lsdb_Rec_t));
+	memcpy(buf, &rec, sizeof(APRS_Lsdb_Rec_t));
+
+	if (write(Journal->fd, buf, size) != size) {
+		ESP_LOGE(TAG, "Error writing %s (%d)", Journal->path, errno);
+		return -1;
+	}
+	Journal->records++;
+
+	return 0;
+}
+
+static int APRS_Journal_Get(const DB * Db, const DBT * Key, DBT * Data, unsigned int Flags) {
+	APRS_Journal_t * journal = Db->internal;
+
+	return journal->inner->get(journal->inner, Key, Data, Flags);
+}
+
+static int APRS_Journal_Put(const DB * Db, DBT * Key, const DBT * Data, unsigned int Flags) {
+	APRS_Journal_t * journal = Db->internal;
+	DBT data;
+
+	if (!Key->size || Key->size > APRS_LSDB_KEY_MAX || Data->size > APRS_JOURNAL_DATA_MAX
+			|| (Flags && Flags != R_NOOVERWRITE)) {
+		errno = EINVAL;
+		return RET_ERROR;
+	}
+
+	// A refused put must not be replayed
+	if (Flags == R_NOOVERWRITE && !journal->inner->get(journal->inner, Key, &data, 0))
+		return RET_SPECIAL;
+
+	if (APRS_Journal_Append(journal, APRS_LSDB_PUT, Key->data, Key->size, Data->data, Data->size))
+		return RET_ERROR;
+
+	return journal->inner->put(journal->inner, Key, Data, Flags);
+}
+
+static int APRS_Journal_Del(const DB * Db, const DBT * Key, unsigned int Flags) {
+	APRS_Journal_t * journal = Db->internal;
+
+	if (!Key->size || Key->size > APRS_LSDB_KEY_MAX || Flags) {
+		errno = EINVAL;
+		return RET_ERROR;
+	}
+
+	if (APRS_Journal_Append(journal, APRS_LSDB_DEL, Key->data, Key->size, NULL, 0))
+		return RET_ERROR;
+
+	return journal->inner->del(journal->inner, Key, Flags);
+}
+
+static int APRS_Journal_Seq(const DB * Db, DBT * Key, DBT * Data, unsigned int Flags) {
+	APRS_Journal_t * journal = Db->internal;
+
+	return journal->inner->seq(journal->inner, Key, Data, Flags);
+}
+
+static int APRS_Journal_Sync(const DB * Db, unsigned int Flags) {
+	APRS_Journal_t * journal = Db->internal;
+
+	if (!journal->records)
+		return journal->inner->sync(journal->inner, Flags);
+
+	// Commit is durable before DB pages are written
+	if (APRS_Journal_Append(journal, APRS_JOURNAL_COMMIT, NULL, 0, NULL, 0))
+		return RET_ERROR;
+	if (fsync(journal->fd)) {
+		ESP_LOGE(TAG, "Error syncing %s (%d)", journal->path, errno);
+		return RET_ERROR;
+	}
+
+	if (journal->inner->sync(journal->inner, Flags))
+		return RET_ERROR;
+
+	// DB holds every committed update, journal is replayed at boot if truncation is lost
+	if (ftruncate(journal->fd, 0)) {
+		ESP_LOGE(TAG, "Error truncating %s (%d)", journal->path, errno);
+		return RET_ERROR;
+	}
+	journal->records = 0;
+
+	return RET_SUCCESS;
+}
+
+static int APRS_Journal_Fd(const DB * Db) {
+	APRS_Journal_t * journal = Db->internal;
+
+	return journal->inner->fd(journal->inner);
+}
+
+static void APRS_Journal_Free(APRS_Journal_t * Journal) {
+	if (Journal->fd >= 0)
+		close(Journal->fd);
+	free(Journal->buf);
+	free(Journal->path);
+	free(Journal);
+}
+
+static int APRS_Journal_Close(DB * Db) {
+	APRS_Journal_t * journal = Db->internal;
+	int ret;
+
+	ret = APRS_Journal_Sync(Db, 0);
+	if (journal->inner->close(journal->inner))
+		ret = RET_ERROR;
+	APRS_Journal_Free(journal);
+
+	return ret;
+}
+
+DB * APRS_Journal_Open(DB * Db, const char * Path) {
+	APRS_Journal_t * journal;
+
+	if (!Db || !Path)
+		return NULL;
+
+	journal = malloc(sizeof(APRS_Journal_t));
+	if (!journal)
+		return NULL;
+	bzero(journal, sizeof(APRS_Journal_t));
+	journal->inner = Db;
+	journal->path = strdup(Path);
+
+	journal->db.type = Db->type;
+	journal->db.close = APRS_Journal_Close;
+	journal->db.del = APRS_Journal_Del;
+	journal->db.get = APRS_Journal_Get;
+	journal->db.put = APRS_Journal_Put;
+	journal->db.seq = APRS_Journal_Seq;
+	journal->db.sync = APRS_Journal_Sync;
+	journal->db.internal = journal;
+	journal->db.fd = APRS_Journal_Fd;
+
+	journal->fd = open(Path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, S_IRUSR | S_IWUSR);
+	if (!journal->path || journal->fd < 0) {
+		ESP_LOGE(TAG, "Can't open %s (%d)", Path, errno);
+		journal->fd = -1;
+		APRS_Journal_Free(journal);
+		return NULL;
+	}
+
+	return &journal->db;
+}
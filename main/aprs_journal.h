@@ -0,0 +1,47 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * main/aprs_journal.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _APRS_JOURNAL_H_
+#define _APRS_JOURNAL_H_
+
+#include <berkeley-db/db.h>
+
+// Write-ahead journal in front of a DB : put and del are appended to the journal
+// file before being applied, sync appends a commit record and fsyncs the journal
+// before syncing the DB, then empties the journal
+// Records are the APRS_Lsdb_Rec_t ones, records following the last commit are ignored
+
+#define APRS_JOURNAL_COMMIT	'C'	// Record type closing a committed group
+
+#define APRS_JOURNAL_EMPTY	0	// Clean close or last sync completed
+#define APRS_JOURNAL_PENDING	1	// Updates not committed, DB may hold part of them
+#define APRS_JOURNAL_COMMITTED	2	// Committed updates DB sync may not have completed
+
+// return journal state of Path, -1 on error
+int APRS_Journal_State(const char * Path);
+// Apply committed records of journal Path to Db (idempotent), return records applied, -1 on error
+int APRS_Journal_Replay(const char * Path, DB * Db);
+// Wrap Db, journal Path is emptied, closing returned DB closes Db
+DB * APRS_Journal_Open(DB * Db, const char * Path);
+
+#endif
@@ -37,13 +37,47 @@
 #include <berkeley-db/db.h>
 #include "aprs.h"
 #include "aprs_log.h"
+#include "aprs_journal.h"
+#include <stdio.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <math.h>
 
 
 #include <esp_log.h>
 
 #define TAG	"APRS_LOG"
 
+#define APRS_LOG_MILES_PER_DEG	69.05	// Latitude degree length
+#define APRS_LOG_REBUILD_BATCH	32	// Stations indexed per btree walk
+#define APRS_LOG_RETENTION_BATCH	32	// Max index entries visited per retention slice
+#define APRS_LOG_READ_RETRIES	16	// Lock free cache read attempts before giving up
+#define APRS_LOG_SALVAGE_BATCH	16	// Stations copied per sync on salvage
+
+typedef struct APRS_Log_Entry_S {
+	atomic_uint seq;	// Odd while station or used are written
+	uint32_t used;		// Last access (LRU), 0 if free
+	time_t dirty;		// First update not written to DB, 0 if clean
+	APRS_Station_t station;
+} APRS_Log_Entry_t;
+
+struct APRS_Log_Cache_S {
+	APRS_Log_Clock_t clock;
+	void * ctx;
+	int size;
+	int max_dirty;
+	int max_age;
+	int n_dirty;
+	uint32_t tick;		// Access counter
+	APRS_Log_Entry_t entries[];
+};
+
 int APRS_Show_Station(APRS_Station_t * Station) {
 	char str[16];
 	struct tm tm;
@@ -96,74 +130,51 @@ int APRS_Show_Station(APRS_Station_t * Station) {
 
 		if (Station->course.speed || Station->course.dir) {
 			if (Station->symbol[1] == '_')
-				ESP_LOGI(TAG, "Wind : %dkn / %d°", Station->course.speed, Station->course.dir);
+				ESP_LOGI(TAG, "Wind : %dmph / %d°", Station->course.speed, Station->course.dir);
 			else
 				ESP_LOGI(TAG, "Course : %dkn / %d°", Station->course.speed, Station->course.dir);
 		}
 	}
 
+	if (Station->weather.valid & (1<<APRS_WX_TEMP))
+		ESP_LOGI(TAG,"Temperature : %d°F", Station->weather.temp);
+	if (Station->weather.valid & (1<<APRS_WX_HUMIDITY))
+		ESP_LOGI(TAG,"Humidity : %d%%", Station->weather.humidity);
+	if (Station->weather.valid & (1<<APRS_WX_PRESSURE))
+		ESP_LOGI(TAG,"Pressure : %d.%dhPa", Station->weather.pressure/10, Station->weather.pressure%10);
+
 	return 0;
 }
 
-int APRS_Log_Station(DB * Station_db, APRS_Data_t * Data) {
+// Merge received data in station record, true if record changed
+static bool APRS_Log_Merge(APRS_Station_t * Station, APRS_Data_t * Data) {
 	struct tm tm;
-	DBT key, data;
 	char str[16];
 	bool mod = false;
-	int ret;
-	APRS_Station_t station;
 
-	if (!Station_db || !Data)
-		return -1;
-
-	// Get Last data
-	bzero(&station, sizeof(station));
-	
-	memcpy(&station.callid,&Data->address[1],sizeof(AX25_Addr_t));
-	AX25_Norm_Addr(&station.callid);
-
-	key.data = &station.callid;
-	key.size = sizeof(AX25_Addr_t);
-	ret = Station_db->get(Station_db, &key, &data, 0);
-	if (ret <0) {
-		ESP_LOGE(TAG,"Error geting station from db)");
-		return -1;
-	}
-
-	if (ret == 1) {
-		AX25_Addr_To_Str(&station.callid,str,sizeof(str));
-		ESP_LOGI(TAG,"New station : %s",str);
-		mod = true;
-		ret = 0;
-	} else {
-		memcpy(&station, data.data, data.size<sizeof(station)?data.size:sizeof(station));
-		AX25_Norm_Addr(&station.callid);
-		AX25_Addr_To_Str(&station.callid,str,sizeof(str));
-		ESP_LOGI(TAG,"station : %s",str);
-	}
 	if (Data->from>1)  {
 		AX25_Addr_To_Str(&Data->address[Data->from],str,sizeof(str));
 		ESP_LOGI(TAG,"\tvia %s",str);
 	}
 
-	if (station.timestamp != Data->timestamp) {
-		station.timestamp = Data->timestamp;
+	if (Station->timestamp != Data->timestamp) {
+		Station->timestamp = Data->timestamp;
 		mod = true;
 	}
 
 	if (Data->symbol[0] && Data->symbol[1]) {
-		if (station.symbol[0] != Data->symbol[0]) {
-			station.symbol[0] = Data->symbol[0];
+		if (Station->symbol[0] != Data->symbol[0]) {
+			Station->symbol[0] = Data->symbol[0];
 			mod = true;
 		}
 
-		if (station.symbol[1] != Data->symbol[1]) {
-			station.symbol[1] = Data->symbol[1];
+		if (Station->symbol[1] != Data->symbol[1]) {
+			Station->symbol[1] = Data->symbol[1];
 			mod = true;
 		}
-	} else if (station.symbol[0]) {
-		Data->symbol[0] = station.symbol[0];
-		Data->symbol[1] = station.symbol[1];
+	} else if (Station->symbol[0]) {
+		Data->symbol[0] = Station->symbol[0];
+		Data->symbol[1] = Station->symbol[1];
 	}
 
 	gmtime_r(&Data->timestamp, &tm);
@@ -192,8 +203,8 @@ int APRS_Log_Station(DB * Station_db, APRS_Data_t * Data) {
 	}
 
 	time_t ts = mktime(&tm);
-	if (ts>0 && ts != station.timestamp) {
-		station.timestamp = ts;
+	if (ts>0 && ts != Station->timestamp) {
+		Station->timestamp = ts;
 		mod = true;
 	}
 
@@ -202,71 +213,89 @@ int APRS_Log_Station(DB * Station_db, APRS_Data_t * Data) {
 		case APRS_DTI_POS_W_TS:
 		case APRS_DTI_POS_W_MSG:
 		case APRS_DTI_POS:
-			if (memcmp(&station.position, &Data->position, sizeof(struct APRS_Position))) {
-				memcpy(&station.position, &Data->position, sizeof(struct APRS_Position));
+		case APRS_DTI_CUR_MICE:
+		case APRS_DTI_OLD_MICE_TMD700:
+		case APRS_DTI_CUR_MICE_R0:
+		case APRS_DTI_OLD_MICE_R0:
+		case APRS_DTI_RAW_GPS:
+		case APRS_DTI_MH_LOCATOR:
+			if (memcmp(&Station->position, &Data->position, sizeof(struct APRS_Position))) {
+				memcpy(&Station->position, &Data->position, sizeof(struct APRS_Position));
 				mod = true;
 			}
 			switch (Data->extension) {
 				case APRS_DATA_EXT_CSE_NRQ:
-					if (memcmp(&station.nrq, &Data->nrq, sizeof(struct APRS_NRQ))) {
-						memcpy(&station.nrq, &Data->nrq, sizeof(struct APRS_NRQ));
+					if (memcmp(&Station->nrq, &Data->nrq, sizeof(struct APRS_NRQ))) {
+						memcpy(&Station->nrq, &Data->nrq, sizeof(struct APRS_NRQ));
 						mod = true;
 					}
 					/* FALLTHRU */
 				case APRS_DATA_EXT_CSE:
-					if (memcmp(&station.course, &Data->course, sizeof(struct APRS_Course))) {
-						memcpy(&station.course, &Data->course, sizeof(struct APRS_Course));
+					if (memcmp(&Station->course, &Data->course, sizeof(struct APRS_Course))) {
+						memcpy(&Station->course, &Data->course, sizeof(struct APRS_Course));
 						mod = true;
 					}
 					break;
 				case APRS_DATA_EXT_PHG:
-					if (memcmp(&station.phg, &Data->phg, sizeof(struct APRS_PHG))) {
-						memcpy(&station.phg, &Data->phg, sizeof(struct APRS_PHG));
+					if (memcmp(&Station->phg, &Data->phg, sizeof(struct APRS_PHG))) {
+						memcpy(&Station->phg, &Data->phg, sizeof(struct APRS_PHG));
 						mod = true;
 					}
 					break;
 				case APRS_DATA_EXT_DFS:
-					if (memcmp(&station.dfs, &Data->dfs, sizeof(struct APRS_DFS))) {
-						memcpy(&station.dfs, &Data->dfs, sizeof(struct APRS_DFS));
+					if (memcmp(&Station->dfs, &Data->dfs, sizeof(struct APRS_DFS))) {
+						memcpy(&Station->dfs, &Data->dfs, sizeof(struct APRS_DFS));
 						mod = true;
 					}
 					break;
 				case APRS_DATA_EXT_RNG:
-					if (station.range != Data->range) {
-						station.range = Data->range;
+					if (Station->range != Data->range) {
+						Station->range = Data->range;
 						mod = true;
 					}
 					break;
 				case APRS_DATA_EXT_WTH:
-					if (memcmp(&station.course, &Data->weather, sizeof(struct APRS_Course))) {
-						memcpy(&station.course, &Data->weather, sizeof(struct APRS_Course));
+					if (memcmp(&Station->course, &Data->weather, sizeof(struct APRS_Course))) {
+						memcpy(&Station->course, &Data->weather, sizeof(struct APRS_Course));
+						mod = true;
+					}
+					/* FALLTHRU */
+				case APRS_DATA_EXT_WEATHER:
+					if (memcmp(&Station->weather, &Data->weather, sizeof(struct APRS_Weather))) {
+						memcpy(&Station->weather, &Data->weather, sizeof(struct APRS_Weather));
 						mod = true;
 					}
 					break;
 				default:
-					bzero(&station.course, sizeof(struct APRS_Course));
-					station.range = 0;
-					bzero(&station.dfs, sizeof(struct APRS_DFS));
-					bzero(&station.phg, sizeof(struct APRS_PHG));
-					bzero(&station.nrq, sizeof(struct APRS_NRQ));
+					bzero(&Station->course, sizeof(struct APRS_Course));
+					Station->range = 0;
+					bzero(&Station->dfs, sizeof(struct APRS_DFS));
+					bzero(&Station->phg, sizeof(struct APRS_PHG));
+					bzero(&Station->nrq, sizeof(struct APRS_NRQ));
 			}
 
+			break;
+		case APRS_DTI_WEATHER:
+			if (memcmp(&Station->weather, &Data->weather, sizeof(struct APRS_Weather))) {
+				memcpy(&Station->weather, &Data->weather, sizeof(struct APRS_Weather));
+				mod = true;
+			}
 			break;
 		case APRS_DTI_STATUS:
 			if (Data->position.ambiguity >= APRS_AMBIGUITY_LOC_EXT_SQUARE) {
-				if (memcmp(&station.position, &Data->position, sizeof(struct APRS_Position))) {
-					memcpy(&station.position, &Data->position, sizeof(struct APRS_Position));
+				if (memcmp(&Station->position, &Data->position, sizeof(struct APRS_Position))) {
+					memcpy(&Station->position, &Data->position, sizeof(struct APRS_Position));
 					mod = true;
 				}
 			}
 			if (Data->extension == APRS_DATA_EXT_BEAM)
-				if (memcmp(&station.beam, &Data->beam, sizeof(struct APRS_Beam))) {
-					memcpy(&station.beam, &Data->beam, sizeof(struct APRS_Beam));
+				if (memcmp(&Station->beam, &Data->beam, sizeof(struct APRS_Beam))) {
+					memcpy(&Station->beam, &Data->beam, sizeof(struct APRS_Beam));
 					mod = true;
 				}
 	
-			if (Data->text[0] && memcmp(station.status, Data->text, sizeof(station.status))) { 
-				strncpy(station.status, Data->text, sizeof(station.status)); 
+			if (Data->text[0] && memcmp(Station->status, Data->text, sizeof(Station->status))) { 
+				strncpy(Station->status, Data->text, sizeof(Station->status)); 
 				mod = true;
 			}
 		
@@ -274,20 +303,210 @@ int APRS_Log_Station(DB * Station_db, APRS_Data_t * Data) {
 		default:
 	}
 
+	return mod;
+}
+
+// Read station record (callid set by caller), 0 found, 1 new station, -1 on error
+static int APRS_Log_Get(DB * Station_db, APRS_Station_t * Station) {
+	DBT key, data;
+	char str[16];
+	int ret;
+
+	key.data = &Station->callid;
+	key.size = sizeof(AX25_Addr_t);
+	ret = Station_db->get(Station_db, &key, &data, 0);
+	if (ret <0) {
+		ESP_LOGE(TAG,"Error geting station from db)");
+		return -1;
+	}
+
+	if (ret == 1) {
+		AX25_Addr_To_Str(&Station->callid,str,sizeof(str));
+		ESP_LOGI(TAG,"New station : %s",str);
+	} else {
+		memcpy(Station, data.data, data.size<sizeof(APRS_Station_t)?data.size:sizeof(APRS_Station_t));
+		AX25_Norm_Addr(&Station->callid);
+		AX25_Addr_To_Str(&Station->callid,str,sizeof(str));
+		ESP_LOGI(TAG,"station : %s",str);
+	}
+
+	return ret;
+}
+
+// Spread 32 bits on even bits of 64
+static uint64_t APRS_Log_Spread(uint32_t Val) {
+	uint64_t x = Val;
+
+	x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+	x = (x | (x << 8)) & 0x00ff00ff00ff00ffULL;
+	x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	x = (x | (x << 2)) & 0x3333333333333333ULL;
+	x = (x | (x << 1)) & 0x5555555555555555ULL;
+
+	return x;
+}
+
+// Gather even bits of 64 in 32 bits
+static uint32_t APRS_Log_Compact(uint64_t Val) {
+	uint64_t x = Val & 0x5555555555555555ULL;
+
+	x = (x | (x >> 1)) & 0x3333333333333333ULL;
+	x = (x | (x >> 2)) & 0x0f0f0f0f0f0f0f0fULL;
+	x = (x | (x >> 4)) & 0x00ff00ff00ff00ffULL;
+	x = (x | (x >> 8)) & 0x0000ffff0000ffffULL;
+	x = (x | (x >> 16)) & 0x00000000ffffffffULL;
+
+	return x;
+}
+
+// Position scaled to full 32 bits range
+static uint32_t APRS_Log_Lat_U32(int64_t Lat) {
+	if (Lat < -(90<<GPS_FIXED_POINT_DEG))
+		Lat = -(90<<GPS_FIXED_POINT_DEG);
+	if (Lat > (90<<GPS_FIXED_POINT_DEG))
+		Lat = (90<<GPS_FIXED_POINT_DEG);
+	return (((uint64_t)(Lat + (90<<GPS_FIXED_POINT_DEG))) << 32) / ((180<<GPS_FIXED_POINT_DEG) + 1);
+}
+
+static uint32_t APRS_Log_Lon_U32(int64_t Lon) {
+	if (Lon < -(180<<GPS_FIXED_POINT_DEG))
+		Lon = -(180<<GPS_FIXED_POINT_DEG);
+	if (Lon > (180<<GPS_FIXED_POINT_DEG))
+		Lon = (180<<GPS_FIXED_POINT_DEG);
+	return (((uint64_t)(Lon + (180LL<<GPS_FIXED_POINT_DEG))) << 32) / ((360ULL<<GPS_FIXED_POINT_DEG) + 1);
+}
+
+// Binary geohash : longitude and latitude bits interleaved, longitude first
+uint64_t APRS_Log_Geohash(const struct APRS_Position * Position) {
+	return (APRS_Log_Spread(APRS_Log_Lon_U32(Position->longitude)) << 1)
+		| APRS_Log_Spread(APRS_Log_Lat_U32(Position->latitude));
+}
+
+static void APRS_Log_Index_Key(APRS_Log_Index_t * Key, uint8_t Index, uint64_t Value, const AX25_Addr_t * Callid) {
+	int i;
+
+	Key->index = Index;
+	for (i=0; i<8; i++)
+		Key->value[i] = Value >> (56-8*i);
+	memcpy(&Key->callid, Callid, sizeof(AX25_Addr_t));
+}
+
+static uint64_t APRS_Log_Index_Value(const APRS_Log_Index_t * Key) {
+	uint64_t value = 0;
+	int i;
+
+	for (i=0; i<8; i++)
+		value = (value << 8) | Key->value[i];
+
+	return value;
+}
+
+static bool APRS_Log_Has_Position(const APRS_Station_t * Station) {
+	return Station->position.latitude || Station->position.longitude;
+}
+
+static int APRS_Log_Index_Update(DB * Station_db, uint8_t Index, bool Old, uint64_t Old_Value, bool New, uint64_t New_Value, const AX25_Addr_t * Callid) {
+	APRS_Log_Index_t index;
+	DBT key, data;
+	int ret = 0;
+
+	if (Old == New && Old_Value == New_Value)
+		return 0;
+
+	key.data = &index;
+	key.size = sizeof(APRS_Log_Index_t);
+
+	if (Old) {
+		APRS_Log_Index_Key(&index, Index, Old_Value, Callid);
+		if (Station_db->del(Station_db, &key, 0) == -1)
+			ret = -1;
+	}
+
+	if (New) {
+		APRS_Log_Index_Key(&index, Index, New_Value, Callid);
+		data.data = NULL;
+		data.size = 0;
+		if (Station_db->put(Station_db, &key, &data, 0))
+			ret = -1;
+	}
+
+	if (ret)
+		ESP_LOGE(TAG,"Error updating index %c (%d)", Index, errno);
+
+	return ret;
+}
+
+// Write station record and its index entries, no sync
+static int APRS_Log_Put(DB * Station_db, APRS_Station_t * Station) {
+	DBT key, data;
+	bool found, had_pos = false;
+	time_t old_ts = 0;
+	uint64_t old_geo = 0;
+	int ret;
+
+	key.data = &Station->callid;
+	key.size = sizeof(AX25_Addr_t);
+
+	// Index entries of previous record
+	if ((found = !Station_db->get(Station_db, &key, &data, 0))) {
+		APRS_Station_t * old = data.data;
+		old_ts = old->timestamp;
+		if ((had_pos = APRS_Log_Has_Position(old)))
+			old_geo = APRS_Log_Geohash(&old->position);
+	}
+
+	data.size = sizeof(APRS_Station_t);
+	data.data = Station;
+
+	ret = Station_db->put(Station_db, &key, &data, 0);
+	if (ret == -1)
+		ESP_LOGE(TAG,"Error putting station in DB (%d)",errno);
+	if (ret == 1)
+		ESP_LOGE(TAG,"Can't overwrite station in DB (%d)",errno);
+	if (ret)
+		return ret;
+
+	if (APRS_Log_Index_Update(Station_db, APRS_LOG_INDEX_TIME, found, ~(uint64_t)old_ts,
+				true, ~(uint64_t)Station->timestamp, &Station->callid))
+		ret = -1;
+	if (APRS_Log_Index_Update(Station_db, APRS_LOG_INDEX_GEO, had_pos, old_geo,
+				APRS_Log_Has_Position(Station), APRS_Log_Geohash(&Station->position), &Station->callid))
+		ret = -1;
+
+	return ret;
+}
+
+int APRS_Log_Station(DB * Station_db, APRS_Data_t * Data) {
+	bool mod = false;
+	int ret;
+	APRS_Station_t station;
+
+	if (!Station_db || !Data)
+		return -1;
+
+	// Get Last data
+	bzero(&station, sizeof(station));
+	
+	memcpy(&station.callid,&Data->address[1],sizeof(AX25_Addr_t));
+	AX25_Norm_Addr(&station.callid);
+
+	if ((ret = APRS_Log_Get(Station_db, &station)) == -1)
+		return -1;
+
+	if (ret == 1) {
+		mod = true;
+		ret = 0;
+	}
+
+	if (APRS_Log_Merge(&station, Data))
+		mod = true;
+
 	if (mod) {
 		memcpy(&station.callid,&Data->address[1],sizeof(AX25_Addr_t));
 		AX25_Norm_Addr(&station.callid);
 
-		data.size = sizeof(APRS_Station_t);
-		data.data = &station;
-		key.data = &station.callid;
-		key.size = sizeof(AX25_Addr_t);
-
-		ret = Station_db->put(Station_db, &key, &data, 0);
-		if (ret == -1)
-			ESP_LOGE(TAG,"Error putting station in DB (%d)",errno);
-		if (ret == 1)
-			ESP_LOGE(TAG,"Can't overwrite station in DB (%d)",errno);
+		if ((ret = APRS_Log_Put(Station_db, &station)))
+			return ret;
 
 		ret = Station_db->sync(Station_db, 0);
 		if (ret)
@@ -296,3 +515,1002 @@ int APRS_Log_Station(DB * Station_db, APRS_Data_t * Data) {
 
 	return ret;
 }
+
+static time_t APRS_Log_Default_Clock(void * Ctx) {
+	return time(NULL);
+}
+
+APRS_Log_Cache_t * APRS_Log_Cache_Init(APRS_Log_Clock_t Clock, void * Ctx, int Size, int Max_Dirty, int Max_Age) {
+	APRS_Log_Cache_t * cache;
+
+	if (Size <= 0)
+		return NULL;
+
+	if (!(cache = malloc(sizeof(APRS_Log_Cache_t) + Size*sizeof(APRS_Log_Entry_t))))
+		return NULL;
+
+	bzero(cache, sizeof(APRS_Log_Cache_t) + Size*sizeof(APRS_Log_Entry_t));
+	cache->clock = Clock?Clock:APRS_Log_Default_Clock;
+	cache->ctx = Ctx;
+	cache->size = Size;
+	cache->max_dirty = (Max_Dirty > 0 && Max_Dirty <= Size)?Max_Dirty:Size;
+	cache->max_age = Max_Age;
+
+	return cache;
+}
+
+static APRS_Log_Entry_t * APRS_Log_Cache_Find(APRS_Log_Cache_t * Cache, const AX25_Addr_t * Callid) {
+	int i;
+
+	for (i=0; i<Cache->size; i++)
+		if (Cache->entries[i].used && !AX25_Addr_Cmp(&Cache->entries[i].station.callid, Callid))
+			return &Cache->entries[i];
+
+	return NULL;
+}
+
+// Entry updates are seen by lock free readers as a sequence change,
+// writers are serialized by the caller (stations_sem)
+static void APRS_Log_Write_Begin(APRS_Log_Entry_t * Entry) {
+	atomic_store_explicit(&Entry->seq, atomic_load_explicit(&Entry->seq, memory_order_relaxed)+1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+}
+
+static void APRS_Log_Write_End(APRS_Log_Entry_t * Entry) {
+	atomic_store_explicit(&Entry->seq, atomic_load_explicit(&Entry->seq, memory_order_relaxed)+1, memory_order_release);
+}
+
+// Free entry, sequence is kept
+static void APRS_Log_Entry_Reset(APRS_Log_Entry_t * Entry) {
+	Entry->used = 0;
+	Entry->dirty = 0;
+	bzero(&Entry->station, sizeof(APRS_Station_t));
+}
+
+// Write dirty records and sync DB once
+int APRS_Log_Cache_Flush(APRS_Log_Cache_t * Cache, DB * Station_db) {
+	int i, ret = 0;
+
+	if (!Cache || !Station_db)
+		return -1;
+
+	if (!Cache->n_dirty)
+		return 0;
+
+	for (i=0; i<Cache->size; i++) {
+		APRS_Log_Entry_t * entry = &Cache->entries[i];
+		if (!entry->used || !entry->dirty)
+			continue;
+		if (APRS_Log_Put(Station_db, &entry->station))
+			ret = -1;
+		entry->dirty = 0;
+	}
+	Cache->n_dirty = 0;
+
+	if (Station_db->sync(Station_db, 0)) {
+		ESP_LOGE(TAG,"Error syncing db file (%d)",errno);
+		ret = -1;
+	}
+
+	ESP_LOGD(TAG,"Station cache flushed");
+
+	return ret;
+}
+
+int APRS_Log_Cache_Station(APRS_Log_Cache_t * Cache, DB * Station_db, APRS_Data_t * Data) {
+	APRS_Log_Entry_t * entry, * victim;
+	AX25_Addr_t callid;
+	int i, ret;
+
+	if (!Cache || !Station_db || !Data)
+		return -1;
+
+	memcpy(&callid, &Data->address[1], sizeof(AX25_Addr_t));
+	AX25_Norm_Addr(&callid);
+
+	if (!(entry = APRS_Log_Cache_Find(Cache, &callid))) {
+		// Take free or least recently used entry, prefer clean ones
+		victim = NULL;
+		for (i=0; i<Cache->size; i++) {
+			entry = &Cache->entries[i];
+			if (!entry->used) {
+				victim = entry;
+				break;
+			}
+			if (!victim || (!entry->dirty && victim->dirty)
+					|| (!entry->dirty == !victim->dirty && entry->used < victim->used))
+				victim = entry;
+		}
+		entry = victim;
+
+		if (entry->used && entry->dirty) {
+			if (APRS_Log_Put(Station_db, &entry->station))
+				ESP_LOGE(TAG,"Error writing back evicted station");
+			Cache->n_dirty--;
+		}
+
+		APRS_Log_Write_Begin(entry);
+		APRS_Log_Entry_Reset(entry);
+		memcpy(&entry->station.callid, &callid, sizeof(AX25_Addr_t));
+		if ((ret = APRS_Log_Get(Station_db, &entry->station)) == -1) {
+			APRS_Log_Entry_Reset(entry);
+			APRS_Log_Write_End(entry);
+			return -1;
+		}
+		if (ret == 1)
+			entry->dirty = Cache->clock(Cache->ctx);
+		if (entry->dirty)
+			Cache->n_dirty++;
+		memcpy(&entry->station.callid, &callid, sizeof(AX25_Addr_t));
+	} else
+		APRS_Log_Write_Begin(entry);
+
+	entry->used = ++Cache->tick;
+
+	if (APRS_Log_Merge(&entry->station, Data) && !entry->dirty) {
+		entry->dirty = Cache->clock(Cache->ctx);
+		Cache->n_dirty++;
+	}
+	APRS_Log_Write_End(entry);
+
+	if (Cache->n_dirty >= Cache->max_dirty)
+		return APRS_Log_Cache_Flush(Cache, Station_db);
+
+	return APRS_Log_Cache_Process(Cache, Station_db) == -2?-1:0;
+}
+
+// Flush if oldest pending update is too old, return seconds until next flush, -1 if clean, -2 on error
+int APRS_Log_Cache_Process(APRS_Log_Cache_t * Cache, DB * Station_db) {
+	time_t now, oldest = 0;
+	int i;
+
+	if (!Cache || !Cache->n_dirty)
+		return -1;
+
+	for (i=0; i<Cache->size; i++) {
+		APRS_Log_Entry_t * entry = &Cache->entries[i];
+		if (entry->used && entry->dirty && (!oldest || entry->dirty < oldest))
+			oldest = entry->dirty;
+	}
+
+	now = Cache->clock(Cache->ctx);
+	if ((now - oldest) >= Cache->max_age)
+		return APRS_Log_Cache_Flush(Cache, Station_db)?-2:-1;
+
+	return oldest + Cache->max_age - now;
+}
+
+// Cached record is newer than DB one
+int APRS_Log_Cache_Get(APRS_Log_Cache_t * Cache, const AX25_Addr_t * Callid, APRS_Station_t * Station) {
+	APRS_Log_Entry_t * entry;
+	AX25_Addr_t callid;
+
+	if (!Cache || !Callid || !Station)
+		return -1;
+
+	memcpy(&callid, Callid, sizeof(AX25_Addr_t));
+	AX25_Norm_Addr(&callid);
+
+	if (!(entry = APRS_Log_Cache_Find(Cache, &callid)))
+		return 1;
+
+	memcpy(Station, &entry->station, sizeof(APRS_Station_t));
+
+	return 0;
+}
+
+// Drop record of a deleted station
+void APRS_Log_Cache_Drop(APRS_Log_Cache_t * Cache, const AX25_Addr_t * Callid) {
+	APRS_Log_Entry_t * entry;
+
+	if (!Cache || !Callid || !(entry = APRS_Log_Cache_Find(Cache, Callid)))
+		return;
+
+	if (entry->dirty)
+		Cache->n_dirty--;
+	APRS_Log_Write_Begin(entry);
+	APRS_Log_Entry_Reset(entry);
+	APRS_Log_Write_End(entry);
+}
+
+// Drop all records (DB reset)
+void APRS_Log_Cache_Clear(APRS_Log_Cache_t * Cache) {
+	int i;
+
+	if (!Cache)
+		return;
+
+	for (i=0; i<Cache->size; i++) {
+		APRS_Log_Write_Begin(&Cache->entries[i]);
+		APRS_Log_Entry_Reset(&Cache->entries[i]);
+		APRS_Log_Write_End(&Cache->entries[i]);
+	}
+	Cache->n_dirty = 0;
+}
+
+// Lock free lookup : stable pointer to the cached station, valid as long as
+// APRS_Log_Cache_Valid returns true for Version
+// return NULL if not cached or if the entry is being written
+const APRS_Station_t * APRS_Log_Cache_Peek(APRS_Log_Cache_t * Cache, const AX25_Addr_t * Callid, uint32_t * Version) {
+	APRS_Log_Entry_t * entry;
+	AX25_Addr_t callid;
+	uint32_t seq;
+	bool busy;
+	int i, try;
+
+	if (!Cache || !Callid || !Version)
+		return NULL;
+
+	memcpy(&callid, Callid, sizeof(AX25_Addr_t));
+	AX25_Norm_Addr(&callid);
+
+	for (try=0; try<APRS_LOG_READ_RETRIES; try++) {
+		busy = false;
+		for (i=0; i<Cache->size; i++) {
+			entry = &Cache->entries[i];
+			seq = atomic_load_explicit(&entry->seq, memory_order_acquire);
+			if (seq & 1) {
+				busy = true;
+				continue;
+			}
+			if (!entry->used || AX25_Addr_Cmp(&entry->station.callid, &callid))
+				continue;
+			atomic_thread_fence(memory_order_acquire);
+			if (atomic_load_explicit(&entry->seq, memory_order_relaxed) != seq) {
+				busy = true;
+				continue;
+			}
+			*Version = seq;
+			return &entry->station;
+		}
+		// Station may be in an entry being written
+		if (!busy)
+			break;
+	}
+
+	return NULL;
+}
+
+// Station from APRS_Log_Cache_Peek was not modified since
+bool APRS_Log_Cache_Valid(APRS_Log_Cache_t * Cache, const APRS_Station_t * Station, uint32_t Version) {
+	APRS_Log_Entry_t * entry;
+
+	if (!Cache || !Station)
+		return false;
+
+	entry = (APRS_Log_Entry_t *)((char *)Station - offsetof(APRS_Log_Entry_t, station));
+	atomic_thread_fence(memory_order_acquire);
+
+	return atomic_load_explicit(&entry->seq, memory_order_relaxed) == Version;
+}
+
+// Lock free copy of a cached station, return 0 if copied, 1 if not cached or busy
+int APRS_Log_Cache_Read(APRS_Log_Cache_t * Cache, const AX25_Addr_t * Callid, APRS_Station_t * Station) {
+	const APRS_Station_t * station;
+	uint32_t version;
+	int try;
+
+	if (!Cache || !Callid || !Station)
+		return -1;
+
+	for (try=0; try<APRS_LOG_READ_RETRIES; try++) {
+		if (!(station = APRS_Log_Cache_Peek(Cache, Callid, &version)))
+			return 1;
+		memcpy(Station, station, sizeof(APRS_Station_t));
+		if (APRS_Log_Cache_Valid(Cache, station, version))
+			return 0;
+	}
+
+	return 1;
+}
+
+// Create index entries of a database written without them
+int APRS_Log_Index_Rebuild(DB * Station_db) {
+	APRS_Log_Index_t index;
+	AX25_Addr_t last, callid[APRS_LOG_REBUILD_BATCH];
+	APRS_Station_t * station;
+	DBT key, data;
+	int i, n, ret, count = 0;
+	unsigned int flags;
+
+	if (!Station_db)
+		return -1;
+
+	// Index entries sort after station records
+	bzero(&index, sizeof(index));
+	key.data = &index;
+	key.size = sizeof(index);
+	ret = Station_db->seq(Station_db, &key, &data, R_CURSOR);
+	if (ret == -1)
+		return -1;
+	if (!ret)
+		return 0;
+
+	flags = R_FIRST;
+	do {
+		// Collect a batch, btree can't be modified while walking it
+		n = 0;
+		while (n < APRS_LOG_REBUILD_BATCH && !(ret = Station_db->seq(Station_db, &key, &data, flags))) {
+			flags = R_NEXT;
+			if (key.size != sizeof(AX25_Addr_t)) {
+				ret = 1;
+				break;
+			}
+			memcpy(&callid[n++], key.data, sizeof(AX25_Addr_t));
+		}
+		if (ret == -1)
+			return -1;
+		if (n)
+			memcpy(&last, &callid[n-1], sizeof(AX25_Addr_t));
+
+		for (i=0; i<n; i++) {
+			key.data = &callid[i];
+			key.size = sizeof(AX25_Addr_t);
+			if (Station_db->get(Station_db, &key, &data, 0))
+				continue;
+			station = data.data;
+			APRS_Log_Index_Update(Station_db, APRS_LOG_INDEX_TIME, false, 0, true, ~(uint64_t)station->timestamp, &callid[i]);
+			if (Station_db->get(Station_db, &key, &data, 0))
+				continue;
+			station = data.data;
+			if (APRS_Log_Has_Position(station))
+				APRS_Log_Index_Update(Station_db, APRS_LOG_INDEX_GEO, false, 0, true, APRS_Log_Geohash(&station->position), &callid[i]);
+			count++;
+		}
+
+		if (n == APRS_LOG_REBUILD_BATCH) {
+			// Resume after last indexed station
+			key.data = &last;
+			key.size = sizeof(AX25_Addr_t);
+			if (Station_db->seq(Station_db, &key, &data, R_CURSOR))
+				break;
+			flags = R_NEXT;
+		}
+	} while (n == APRS_LOG_REBUILD_BATCH);
+
+	ESP_LOGI(TAG,"%d stations indexed", count);
+
+	return Station_db->sync(Station_db, 0);
+}
+
+// Walk entries of an index with From <= value <= To, filter and copy stations, return count
+static int APRS_Log_Index_Scan(DB * Station_db, uint8_t Index, uint64_t From, uint64_t To,
+		bool (*Key_Filter)(uint64_t Value, const void * Arg),
+		bool (*Filter)(const APRS_Station_t * Station, const void * Arg), const void * Arg,
+		APRS_Station_t * Stations, int Max) {
+	APRS_Log_Index_t index, * found;
+	AX25_Addr_t callid;
+	DBT key, data, skey, sdata;
+	unsigned int flags = R_CURSOR;
+	int n = 0;
+
+	bzero(&callid, sizeof(AX25_Addr_t));
+	APRS_Log_Index_Key(&index, Index, From, &callid);
+	key.data = &index;
+	key.size = sizeof(index);
+
+	while (n < Max && !Station_db->seq(Station_db, &key, &data, flags)) {
+		flags = R_NEXT;
+		found = key.data;
+		if (key.size != sizeof(APRS_Log_Index_t) || found->index != Index || APRS_Log_Index_Value(found) > To)
+			break;
+		// Skip station read when index value is enough
+		if (Key_Filter && !Key_Filter(APRS_Log_Index_Value(found), Arg))
+			continue;
+
+		memcpy(&callid, &found->callid, sizeof(AX25_Addr_t));
+		skey.data = &callid;
+		skey.size = sizeof(AX25_Addr_t);
+		if (Station_db->get(Station_db, &skey, &sdata, 0))
+			continue;
+
+		if (!Filter || Filter(sdata.data, Arg))
+			memcpy(&Stations[n++], sdata.data, sizeof(APRS_Station_t));
+	}
+
+	return n;
+}
+
+// Next station matching Filter after Cursor (R_FIRST or R_NEXT), Cursor is updated
+// Filter callid ends with '\0' for prefix wildcard, null ssid for any ssid
+int APRS_Log_Match(DB * Station_db, const AX25_Addr_t * Filter, AX25_Addr_t * Cursor, int Flags, APRS_Station_t * Station) {
+	AX25_Addr_t bound;
+	DBT key, data;
+	int i, ret, cmp;
+
+	if (!Station_db || !Filter || !Cursor || (Flags != R_FIRST && Flags != R_NEXT))
+		return -1;
+
+	if (Flags == R_FIRST) {
+		// Lowest key of the prefix range
+		memcpy(&bound, Filter, sizeof(AX25_Addr_t));
+		for (i=0; i<6 && bound.callid[i]; i++);
+		for (; i<6; i++)
+			bound.callid[i] = 0x02;
+		if (!bound.ssid)
+			bound.ssid = 0x60;
+		key.data = &bound;
+	} else
+		key.data = Cursor;
+	key.size = sizeof(AX25_Addr_t);
+
+	ret = Station_db->seq(Station_db, &key, &data, R_CURSOR);
+	// Skip previous match if still there
+	if (!ret && Flags != R_FIRST && key.size == sizeof(AX25_Addr_t) && !AX25_Addr_Cmp(key.data, Cursor))
+		ret = Station_db->seq(Station_db, &key, &data, R_NEXT);
+
+	while (!ret) {
+		if (key.size != sizeof(AX25_Addr_t))
+			return 1;
+		cmp = AX25_Addr_Cmp(Filter, key.data);
+		// Past the prefix range
+		if (cmp < 0 && cmp >= -6)
+			return 1;
+		if (!cmp) {
+			memcpy(Cursor, key.data, sizeof(AX25_Addr_t));
+			if (Station)
+				memcpy(Station, data.data, sizeof(APRS_Station_t));
+			return 0;
+		}
+		// Same prefix, other ssid
+		ret = Station_db->seq(Station_db, &key, &data, R_NEXT);
+	}
+
+	return ret;
+}
+
+// Stations heard since Since, newest first
+int APRS_Log_Last_Heard(DB * Station_db, time_t Since, APRS_Station_t * Stations, int Max) {
+	if (!Station_db || !Stations || Max <= 0)
+		return -1;
+
+	return APRS_Log_Index_Scan(Station_db, APRS_LOG_INDEX_TIME, 0, ~(uint64_t)Since, NULL, NULL, NULL, Stations, Max);
+}
+
+struct APRS_Log_Near_S {
+	const struct APRS_Position * center;
+	double radius;	// miles
+	uint32_t lat[2], lon[2];	// bounding box
+};
+
+static bool APRS_Log_Near_Key_Filter(uint64_t Value, const void * Arg) {
+	const struct APRS_Log_Near_S * near = Arg;
+	uint32_t lat = APRS_Log_Compact(Value), lon = APRS_Log_Compact(Value >> 1);
+
+	return lat >= near->lat[0] && lat <= near->lat[1] && lon >= near->lon[0] && lon <= near->lon[1];
+}
+
+static bool APRS_Log_Near_Filter(const APRS_Station_t * Station, const void * Arg) {
+	const struct APRS_Log_Near_S * near = Arg;
+	double lat, dlat, dlon;
+
+	lat = (double)near->center->latitude / (1<<GPS_FIXED_POINT_DEG);
+	dlat = (double)Station->position.latitude / (1<<GPS_FIXED_POINT_DEG) - lat;
+	dlon = ((double)Station->position.longitude - near->center->longitude) / (1<<GPS_FIXED_POINT_DEG);
+	dlon *= cos(lat * M_PI / 180.0);
+
+	return APRS_LOG_MILES_PER_DEG * sqrt(dlat*dlat + dlon*dlon) <= near->radius;
+}
+
+// Stations within Radius miles of Center, scans the geohash cells covering the area
+int APRS_Log_Near(DB * Station_db, const struct APRS_Position * Center, uint16_t Radius, APRS_Station_t * Stations, int Max) {
+	struct APRS_Log_Near_S near = {.center = Center, .radius = Radius};
+	uint32_t * lat = near.lat, * lon = near.lon, la, lo;
+	int64_t dlat, dlon;
+	uint64_t mask;
+	double cosl;
+	int shift, i, j, n = 0;
+
+	if (!Station_db || !Center || !Stations || Max <= 0)
+		return -1;
+
+	// Bounding box
+	dlat = (double)Radius / APRS_LOG_MILES_PER_DEG * (1<<GPS_FIXED_POINT_DEG);
+	cosl = cos((double)Center->latitude / (1<<GPS_FIXED_POINT_DEG) * M_PI / 180.0);
+	dlon = (cosl > 0.01)?dlat / cosl:(360LL<<GPS_FIXED_POINT_DEG);
+	lat[0] = APRS_Log_Lat_U32(Center->latitude - dlat);
+	lat[1] = APRS_Log_Lat_U32(Center->latitude + dlat);
+	lon[0] = APRS_Log_Lon_U32(Center->longitude - dlon);
+	lon[1] = APRS_Log_Lon_U32(Center->longitude + dlon);
+
+	// Smallest cells with box on at most 2x2 of them
+	for (shift=0; shift<31; shift++)
+		if ((lat[1]>>shift) - (lat[0]>>shift) <= 1 && (lon[1]>>shift) - (lon[0]>>shift) <= 1)
+			break;
+	mask = (1ULL<<(2*shift))-1;
+
+	for (i=0; i<2; i++) {
+		if (i && (lat[1]>>shift) == (lat[0]>>shift))
+			break;
+		la = (lat[i]>>shift)<<shift;
+		for (j=0; j<2 && n<Max; j++) {
+			uint64_t from;
+			if (j && (lon[1]>>shift) == (lon[0]>>shift))
+				break;
+			lo = (lon[j]>>shift)<<shift;
+			from = (APRS_Log_Spread(lo) << 1) | APRS_Log_Spread(la);
+			n += APRS_Log_Index_Scan(Station_db, APRS_LOG_INDEX_GEO, from, from | mask,
+					APRS_Log_Near_Key_Filter, APRS_Log_Near_Filter, &near, Stations+n, Max-n);
+		}
+	}
+
+	return n;
+}
+
+// Remove station record and its index entries, no sync, return 1 if not found
+int APRS_Log_Delete(DB * Station_db, const AX25_Addr_t * Callid) {
+	AX25_Addr_t callid;
+	DBT key, data;
+	time_t ts;
+	bool has_pos;
+	uint64_t geo = 0;
+	int ret = 0;
+
+	if (!Station_db || !Callid)
+		return -1;
+
+	memcpy(&callid, Callid, sizeof(AX25_Addr_t));
+	key.data = &callid;
+	key.size = sizeof(AX25_Addr_t);
+	if ((ret = Station_db->get(Station_db, &key, &data, 0)))
+		return ret;
+
+	ts = ((APRS_Station_t *)data.data)->timestamp;
+	if ((has_pos = APRS_Log_Has_Position(data.data)))
+		geo = APRS_Log_Geohash(&((APRS_Station_t *)data.data)->position);
+
+	if (APRS_Log_Index_Update(Station_db, APRS_LOG_INDEX_TIME, true, ~(uint64_t)ts, false, 0, &callid))
+		ret = -1;
+	if (APRS_Log_Index_Update(Station_db, APRS_LOG_INDEX_GEO, has_pos, geo, false, 0, &callid))
+		ret = -1;
+
+	key.data = &callid;
+	key.size = sizeof(AX25_Addr_t);
+	if (Station_db->del(Station_db, &key, 0) == -1) {
+		ESP_LOGE(TAG,"Error deleting station from DB (%d)",errno);
+		ret = -1;
+	}
+
+	return ret;
+}
+
+// Write a batch of station records and sync once, records older than the stored ones are skipped
+// return number of records written, -1 on error
+int APRS_Log_Import(DB * Station_db, APRS_Station_t * Stations, int N) {
+	AX25_Addr_t callid;
+	DBT key, data;
+	int i, n = 0, ret = 0;
+
+	if (!Station_db || !Stations || N < 0)
+		return -1;
+
+	for (i=0; i<N; i++) {
+		if (!Stations[i].callid.callid[0])
+			continue;
+
+		memcpy(&callid, &Stations[i].callid, sizeof(AX25_Addr_t));
+		key.data = &callid;
+		key.size = sizeof(AX25_Addr_t);
+		if (!Station_db->get(Station_db, &key, &data, 0)
+				&& ((APRS_Station_t *)data.data)->timestamp > Stations[i].timestamp)
+			continue;
+
+		if (APRS_Log_Put(Station_db, &Stations[i]))
+			ret = -1;
+		else
+			n++;
+	}
+
+	if (n && Station_db->sync(Station_db, 0)) {
+		ESP_LOGE(TAG,"Error syncing db file (%d)",errno);
+		ret = -1;
+	}
+
+	return ret?ret:n;
+}
+
+// Bounded walk of the whole DB : keys in order, records of expected size and
+// exactly one time entry per station and one geo entry per positioned station
+// return 0 if consistent, 1 if not or if more than Max entries, -1 on error
+int APRS_Log_Check(DB * Station_db, int Max) {
+	APRS_Log_Index_t index, last_index;
+	AX25_Addr_t callid, last;
+	const APRS_Station_t * station;
+	DBT key, data;
+	bool indexes = false;
+	unsigned int flags = R_FIRST;
+	int ret, n = 0, stations = 0, positions = 0, times = 0, geos = 0;
+
+	if (!Station_db || Max <= 0)
+		return -1;
+
+	while (!(ret = Station_db->seq(Station_db, &key, &data, flags))) {
+		flags = R_NEXT;
+		if (++n > Max) {
+			ESP_LOGW(TAG,"Check stopped after %d entries", Max);
+			return 1;
+		}
+
+		if (key.size == sizeof(AX25_Addr_t)) {
+			station = data.data;
+			if (indexes || data.size != sizeof(APRS_Station_t)
+					|| memcmp(&station->callid, key.data, sizeof(AX25_Addr_t)))
+				goto inconsistent;
+			memcpy(&callid, key.data, sizeof(AX25_Addr_t));
+			if (stations && AX25_Addr_Cmp(&last, &callid) > 0)
+				goto inconsistent;
+			memcpy(&last, &callid, sizeof(AX25_Addr_t));
+			stations++;
+			if (APRS_Log_Has_Position(station))
+				positions++;
+		} else if (key.size == sizeof(APRS_Log_Index_t)) {
+			memcpy(&index, key.data, sizeof(APRS_Log_Index_t));
+			if (data.size || (indexes && memcmp(&last_index, &index, sizeof(APRS_Log_Index_t)) >= 0))
+				goto inconsistent;
+			memcpy(&last_index, &index, sizeof(APRS_Log_Index_t));
+			indexes = true;
+
+			// Entry must match its station record
+			memcpy(&callid, &index.callid, sizeof(AX25_Addr_t));
+			key.data = &callid;
+			key.size = sizeof(AX25_Addr_t);
+			if (Station_db->get(Station_db, &key, &data, 0) || data.size != sizeof(APRS_Station_t))
+				goto inconsistent;
+			station = data.data;
+			if (index.index == APRS_LOG_INDEX_TIME && APRS_Log_Index_Value(&index) == ~(uint64_t)station->timestamp)
+				times++;
+			else if (index.index == APRS_LOG_INDEX_GEO && APRS_Log_Has_Position(station)
+					&& APRS_Log_Index_Value(&index) == APRS_Log_Geohash(&station->position))
+				geos++;
+			else
+				goto inconsistent;
+		} else
+			goto inconsistent;
+	}
+
+	if (ret == -1) {
+		ESP_LOGW(TAG,"Check : read error after %d entries (%d)", n, errno);
+		return 1;
+	}
+
+	if (times != stations || geos != positions) {
+		ESP_LOGW(TAG,"Check : %d stations, %d time and %d geo entries for %d positions", stations, times, geos, positions);
+		return 1;
+	}
+
+	ESP_LOGI(TAG,"Check : %d stations consistent", stations);
+
+	return 0;
+
+inconsistent:
+	ESP_LOGW(TAG,"Check : inconsistent entry %d", n);
+	return 1;
+}
+
+// Copy station records of Old to New by batch, walking from Flags (R_FIRST forward,
+// R_CURSOR on first index entry or R_LAST backward) down to station Last if not NULL
+// return 0 when walk completed, 1 on read error, 2 if start point is unreadable, -1 on error
+static int APRS_Log_Salvage_Walk(DB * Old, DB * New, unsigned int Flags, const AX25_Addr_t * Last,
+		APRS_Station_t * Batch, AX25_Addr_t * Walked, int * Budget, int * Count, int * Skipped) {
+	APRS_Log_Index_t index;
+	DBT key, data;
+	unsigned int next = (Flags == R_FIRST)?R_NEXT:R_PREV;
+	bool started = false;
+	int ret = 0, n = 0, imported;
+
+	bzero(&index, sizeof(index));
+	key.data = &index;
+	key.size = sizeof(index);
+
+	while (*Budget > 0 && !(ret = Old->seq(Old, &key, &data, Flags))) {
+		(*Budget)--;
+		Flags = next;
+		started = true;
+		// Index entries follow station records
+		if (key.size == sizeof(APRS_Log_Index_t)) {
+			if (next == R_NEXT)
+				break;
+			continue;
+		}
+		if (key.size != sizeof(AX25_Addr_t) || data.size != sizeof(APRS_Station_t)
+				|| memcmp(&((APRS_Station_t *)data.data)->callid, key.data, sizeof(AX25_Addr_t))) {
+			(*Skipped)++;
+			continue;
+		}
+		if (Last && AX25_Addr_Cmp(key.data, Last) <= 0)
+			break;
+
+		memcpy(Walked, key.data, sizeof(AX25_Addr_t));
+		memcpy(&Batch[n++], data.data, sizeof(APRS_Station_t));
+		if (n == APRS_LOG_SALVAGE_BATCH) {
+			if ((imported = APRS_Log_Import(New, Batch, n)) < 0)
+				return -1;
+			*Count += imported;
+			n = 0;
+		}
+	}
+
+	if (n) {
+		if ((imported = APRS_Log_Import(New, Batch, n)) < 0)
+			return -1;
+		*Count += imported;
+	}
+
+	if (!started && Flags == R_CURSOR)
+		return 2;
+	if (ret == -1) {
+		ESP_LOGW(TAG,"Salvage : read error walking %s (%d)", (next == R_NEXT)?"forward":"backward", errno);
+		return 1;
+	}
+
+	return 0;
+}
+
+// Copy readable station records of Old to New, index entries are rebuilt from them
+// A damaged page ends forward walk, stations following it are read backward from the last one
+// at most Max entries visited, return number of stations copied, -1 on error
+int APRS_Log_Salvage(DB * Old, DB * New, int Max) {
+	APRS_Station_t * batch;
+	AX25_Addr_t last, walked;
+	bool forward;
+	int ret, count = 0, skipped = 0;
+
+	if (!Old || !New || Max <= 0)
+		return -1;
+
+	if (!(batch = malloc(APRS_LOG_SALVAGE_BATCH * sizeof(APRS_Station_t))))
+		return -1;
+
+	bzero(&last, sizeof(AX25_Addr_t));
+	ret = APRS_Log_Salvage_Walk(Old, New, R_FIRST, NULL, batch, &last, &Max, &count, &skipped);
+	if (ret > 0) {
+		forward = last.callid[0] != 0;
+		ret = APRS_Log_Salvage_Walk(Old, New, R_CURSOR, forward?&last:NULL, batch, &walked, &Max, &count, &skipped);
+		if (ret == 2)
+			ret = APRS_Log_Salvage_Walk(Old, New, R_LAST, forward?&last:NULL, batch, &walked, &Max, &count, &skipped);
+	}
+	free(batch);
+
+	ESP_LOGI(TAG,"Salvage : %d stations copied, %d damaged records skipped", count, skipped);
+
+	return (ret < 0)?-1:count;
+}
+
+static DB * APRS_Log_Btree_File(const APRS_Log_Btree_t * Btree, const char * Path, int Flags, int * Fd) {
+	BTREEINFO bt_info = {
+		.flags = 0,
+		.cachesize = 8192,
+		.maxkeypage = 4,
+		.minkeypage = 4,
+		.psize = 512,
+		.compare = Btree->compare,
+		.prefix = NULL,
+		.lorder = 0,
+	};
+	DB * db;
+
+	// Try open btree file
+	*Fd = open(Path, O_RDWR | Flags, S_IRUSR | S_IWUSR);
+	if (*Fd < 0)
+		// Create file
+		*Fd = open(Path, O_RDWR | O_CREAT | O_EXCL | Flags, S_IRUSR | S_IWUSR);
+	if (*Fd < 0)
+		return NULL;
+
+	db = __bt_open((void*)(intptr_t)*Fd, NULL, &bt_info, 0);
+	if (!db) {
+		ESP_LOGE(TAG, "__bt_open return error %d", errno);
+		close(*Fd);
+		*Fd = -1;
+	}
+
+	return db;
+}
+
+// Copy readable stations of btree (NULL if it can't be opened) to a new file replacing it
+static DB * APRS_Log_Btree_Rebuild(const APRS_Log_Btree_t * Btree, DB * Db, int * Fd) {
+	DB * db;
+	int fd;
+
+	ESP_LOGW(TAG, "Rebuilding %s", Btree->path);
+	unlink(Btree->rebuild);
+	if (!(db = APRS_Log_Btree_File(Btree, Btree->rebuild, O_TRUNC, &fd)))
+		return Db;
+	if (Db && APRS_Log_Salvage(Db, db, Btree->check_max) < 0)
+		ESP_LOGE(TAG, "Error salvaging stations");
+	db->close(db);
+	close(fd);
+	if (Db) {
+		Db->close(Db);
+		close(*Fd);
+	}
+
+	// Rebuilt file is complete, old one is kept until then
+	unlink(Btree->path);
+	if (rename(Btree->rebuild, Btree->path))
+		ESP_LOGE(TAG, "Error renaming %s (%d)", Btree->rebuild, errno);
+
+	return APRS_Log_Btree_File(Btree, Btree->path, 0, Fd);
+}
+
+// Bring btree back to its last committed state after an unclean stop
+static DB * APRS_Log_Btree_Recover(const APRS_Log_Btree_t * Btree, DB * Db, int * Fd) {
+	int state, ret;
+
+	state = APRS_Journal_State(Btree->journal);
+	if (Db && state == APRS_JOURNAL_EMPTY)
+		return Db;
+
+	// Pages written since last sync may be torn, internal and free ones too, and
+	// a walk can't see them all : keep only station records
+	ESP_LOGW(TAG, "%s not closed cleanly", Btree->path);
+	Db = APRS_Log_Btree_Rebuild(Btree, Db, Fd);
+	if (!Db || state != APRS_JOURNAL_COMMITTED)
+		return Db;
+
+	// Updates committed before btree sync completed
+	ret = APRS_Journal_Replay(Btree->journal, Db);
+	if (ret < 0 || Db->sync(Db, 0))
+		ESP_LOGE(TAG, "Error replaying %s", Btree->journal);
+	if (ret && APRS_Log_Check(Db, Btree->check_max))
+		Db = APRS_Log_Btree_Rebuild(Btree, Db, Fd);
+
+	return Db;
+}
+
+DB * APRS_Log_Btree_Open(const APRS_Log_Btree_t * Btree, int Flags, int * Fd) {
+	struct stat st;
+	DB * db;
+	int fd;
+
+	if (!Btree || !Fd)
+		return NULL;
+
+	// Btree code trusts pages, a damaged one may crash it : don't loop on it
+	if (!(Flags & O_TRUNC) && !stat(Btree->recovery, &st)) {
+		ESP_LOGE(TAG, "Previous open of %s did not complete, starting empty", Btree->path);
+		unlink(Btree->path);
+		Flags |= O_TRUNC;
+	}
+	if ((fd = open(Btree->recovery, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR)) >= 0)
+		close(fd);
+
+	// Stop between removal of a damaged file and rename of its rebuild
+	if (!(Flags & O_TRUNC) && stat(Btree->path, &st) && !stat(Btree->rebuild, &st))
+		rename(Btree->rebuild, Btree->path);
+
+	db = APRS_Log_Btree_File(Btree, Btree->path, Flags, Fd);
+	if (!(Flags & O_TRUNC))
+		db = APRS_Log_Btree_Recover(Btree, db, Fd);
+	unlink(Btree->recovery);
+
+	return db;
+}
+
+struct APRS_Log_Retention_S {
+	APRS_Log_Clock_t clock;
+	void * ctx;
+	time_t max_age;
+	int max_stations;
+	int period;
+	APRS_Log_Pinned_t pinned;
+	void * pinned_ctx;
+	time_t next;		// Start of next pass
+	bool running;
+	APRS_Log_Index_t cursor;	// Last visited time index entry
+	time_t limit;		// Oldest timestamp kept in this pass
+	int rank;		// Unpinned stations seen in this pass
+	int deleted;
+};
+
+APRS_Log_Retention_t * APRS_Log_Retention_Init(APRS_Log_Clock_t Clock, void * Ctx, time_t Max_Age, int Max_Stations, int Period, APRS_Log_Pinned_t Pinned, void * Pinned_Ctx) {
+	APRS_Log_Retention_t * retention;
+
+	if (Max_Age <= 0 && Max_Stations <= 0)
+		return NULL;
+
+	if (!(retention = malloc(sizeof(APRS_Log_Retention_t))))
+		return NULL;
+
+	bzero(retention, sizeof(APRS_Log_Retention_t));
+	retention->clock = Clock?Clock:APRS_Log_Default_Clock;
+	retention->ctx = Ctx;
+	retention->max_age = Max_Age;
+	retention->max_stations = Max_Stations;
+	retention->period = Period>0?Period:1;
+	retention->pinned = Pinned;
+	retention->pinned_ctx = Pinned_Ctx;
+
+	return retention;
+}
+
+// Walk at most Budget entries of the time index (newest first) and delete stations
+// older than Max_Age or beyond the Max_Stations most recent, pinned stations are kept
+// return seconds until next call, -1 on error
+int APRS_Log_Retention_Process(APRS_Log_Retention_t * Retention, DB * Station_db, APRS_Log_Cache_t * Cache, int Budget) {
+	AX25_Addr_t victims[APRS_LOG_RETENTION_BATCH];
+	APRS_Log_Entry_t * entry;
+	APRS_Log_Index_t * found;
+	DBT key, data;
+	unsigned int flags = R_CURSOR;
+	time_t now, ts;
+	int i, n = 0, visited = 0, ret = 0;
+	bool end = true;
+
+	if (!Retention || !Station_db)
+		return -1;
+
+	now = Retention->clock(Retention->ctx);
+	if (!Retention->running) {
+		if (now < Retention->next)
+			return Retention->next - now;
+		// Time index must be up to date
+		if (Cache && APRS_Log_Cache_Flush(Cache, Station_db))
+			return -1;
+		bzero(&Retention->cursor, sizeof(APRS_Log_Index_t));
+		Retention->cursor.index = APRS_LOG_INDEX_TIME;
+		Retention->limit = (Retention->max_age > 0)?now - Retention->max_age:0;
+		Retention->rank = 0;
+		Retention->deleted = 0;
+		Retention->running = true;
+	}
+
+	if (Budget <= 0 || Budget > APRS_LOG_RETENTION_BATCH)
+		Budget = APRS_LOG_RETENTION_BATCH;
+
+	// Resume after last visited entry, index is not modified while walking
+	key.data = &Retention->cursor;
+	key.size = sizeof(APRS_Log_Index_t);
+	while (!Station_db->seq(Station_db, &key, &data, flags)) {
+		found = key.data;
+		if (key.size != sizeof(APRS_Log_Index_t) || found->index != APRS_LOG_INDEX_TIME)
+			break;
+		if (flags == R_CURSOR && !memcmp(found, &Retention->cursor, sizeof(APRS_Log_Index_t))) {
+			flags = R_NEXT;
+			continue;
+		}
+		flags = R_NEXT;
+
+		if (visited++ == Budget) {
+			end = false;
+			break;
+		}
+		memcpy(&Retention->cursor, found, sizeof(APRS_Log_Index_t));
+
+		if (Retention->pinned && Retention->pinned(&Retention->cursor.callid, Retention->pinned_ctx))
+			continue;
+
+		ts = ~APRS_Log_Index_Value(&Retention->cursor);
+		Retention->rank++;
+		if ((Retention->max_stations > 0 && Retention->rank > Retention->max_stations) || ts < Retention->limit) {
+			// Heard again since pass start, not yet written
+			if (Cache && (entry = APRS_Log_Cache_Find(Cache, &Retention->cursor.callid)) && entry->dirty)
+				continue;
+			memcpy(&victims[n++], &Retention->cursor.callid, sizeof(AX25_Addr_t));
+		}
+	}
+
+	for (i=0; i<n; i++) {
+		if (APRS_Log_Delete(Station_db, &victims[i]) == -1)
+			ret = -1;
+		APRS_Log_Cache_Drop(Cache, &victims[i]);
+	}
+	Retention->deleted += n;
+
+	if (n && Station_db->sync(Station_db, 0)) {
+		ESP_LOGE(TAG,"Error syncing db file (%d)",errno);
+		ret = -1;
+	}
+
+	if (end) {
+		Retention->running = false;
+		Retention->next = now + Retention->period;
+		if (Retention->deleted)
+			ESP_LOGI(TAG,"Retention : %d stations removed, %d kept", Retention->deleted, Retention->rank - Retention->deleted);
+	}
+
+	if (ret)
+		return -1;
+
+	return end?Retention->period:1;
+}
@@ -27,6 +27,65 @@
 #include "aprs.h"
 #include <berkeley-db/db.h>
 
+// Secondary index entries are stored in the stations btree, after station records
+#define APRS_LOG_INDEX_GEO	'G'	// value is geohash of position
+#define APRS_LOG_INDEX_TIME	'T'	// value is ~timestamp (newest first)
+
+typedef struct __attribute__((packed)) APRS_Log_Index_S {
+	uint8_t index;		// APRS_LOG_INDEX_xxx
+	uint8_t value[8];	// big endian sort value
+	AX25_Addr_t callid;
+} APRS_Log_Index_t;
+
+typedef struct APRS_Log_Cache_S APRS_Log_Cache_t;
+typedef struct APRS_Log_Retention_S APRS_Log_Retention_t;
+
+// Journaled btree station store
+typedef struct APRS_Log_Btree_S {
+	const char * path;		// Btree file
+	const char * rebuild;		// Btree rebuilt at boot
+	const char * journal;		// Updates since last btree sync
+	const char * recovery;		// Present while btree is opened and recovered
+	int (*compare)(const DBT *, const DBT *);
+	int check_max;			// Entries visited by boot check and rebuild
+} APRS_Log_Btree_t;
+
+// Time source (seconds), injectable for host testing
+typedef time_t (*APRS_Log_Clock_t)(void * Ctx);
+// Stations never removed by retention
+typedef bool (*APRS_Log_Pinned_t)(const AX25_Addr_t * Callid, void * Ctx);
+
 int APRS_Log_Station(DB * Station_db, APRS_Data_t * Data);
+int APRS_Log_Delete(DB * Station_db, const AX25_Addr_t * Callid);
+int APRS_Log_Import(DB * Station_db, APRS_Station_t * Stations, int N);
+int APRS_Log_Match(DB * Station_db, const AX25_Addr_t * Filter, AX25_Addr_t * Cursor, int Flags, APRS_Station_t * Station);
+int APRS_Log_Index_Rebuild(DB * Station_db);
+int APRS_Log_Check(DB * Station_db, int Max);
+int APRS_Log_Salvage(DB * Old, DB * New, int Max);
+// Open btree, rebuilt and brought back to its last committed state by the journal
+// after an unclean stop, *Fd is its file descriptor. Returned DB is not journaled
+DB * APRS_Log_Btree_Open(const APRS_Log_Btree_t * Btree, int Flags, int * Fd);
+uint64_t APRS_Log_Geohash(const struct APRS_Position * Position);
+int APRS_Log_Last_Heard(DB * Station_db, time_t Since, APRS_Station_t * Stations, int Max);
+int APRS_Log_Near(DB * Station_db, const struct APRS_Position * Center, uint16_t Radius, APRS_Station_t * Stations, int Max);
+
+// Write-back cache of station records : DB is synced when Max_Dirty records
+// are pending, when the oldest pending update is Max_Age seconds old or on flush
+APRS_Log_Cache_t * APRS_Log_Cache_Init(APRS_Log_Clock_t Clock, void * Ctx, int Size, int Max_Dirty, int Max_Age);
+int APRS_Log_Cache_Station(APRS_Log_Cache_t * Cache, DB * Station_db, APRS_Data_t * Data);
+int APRS_Log_Cache_Get(APRS_Log_Cache_t * Cache, const AX25_Addr_t * Callid, APRS_Station_t * Station);
+int APRS_Log_Cache_Flush(APRS_Log_Cache_t * Cache, DB * Station_db);
+int APRS_Log_Cache_Process(APRS_Log_Cache_t * Cache, DB * Station_db);
+void APRS_Log_Cache_Drop(APRS_Log_Cache_t * Cache, const AX25_Addr_t * Callid);
+void APRS_Log_Cache_Clear(APRS_Log_Cache_t * Cache);
+// Lock free readers, never blocked by writers holding stations_sem
+const APRS_Station_t * APRS_Log_Cache_Peek(APRS_Log_Cache_t * Cache, const AX25_Addr_t * Callid, uint32_t * Version);
+bool APRS_Log_Cache_Valid(APRS_Log_Cache_t * Cache, const APRS_Station_t * Station, uint32_t Version);
+int APRS_Log_Cache_Read(APRS_Log_Cache_t * Cache, const AX25_Addr_t * Callid, APRS_Station_t * Station);
+
+// Retention : a pass over the time index runs every Period seconds, Budget entries at a time,
+// and removes stations not heard for Max_Age seconds or beyond the Max_Stations most recent
+APRS_Log_Retention_t * APRS_Log_Retention_Init(APRS_Log_Clock_t Clock, void * Ctx, time_t Max_Age, int Max_Stations, int Period, APRS_Log_Pinned_t Pinned, void * Pinned_Ctx);
+int APRS_Log_Retention_Process(APRS_Log_Retention_t * Retention, DB * Station_db, APRS_Log_Cache_t * Cache, int Budget);
 
 #endif
@@ -0,0 +1,837 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * main/aprs_lsdb.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __P
+#define __P(arg) arg
+#endif
+
+#ifndef __BEGIN_DECLS
+#define __BEGIN_DECLS
+#endif
+
+#ifndef __END_DECLS
+#define __END_DECLS
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include "aprs_lsdb.h"
+
+#define TAG "APRS_LSDB"
+
+#define APRS_LSDB_ALLOC_STEP	64	// Index entries added on realloc
+
+typedef struct APRS_Lsdb_Entry_S {
+	uint8_t key[APRS_LSDB_KEY_MAX];
+	uint8_t key_size;
+	uint8_t deleted;	// Entry is a tombstone
+	uint16_t size;		// Record size
+	uint32_t segment;
+	uint32_t offset;	// Record offset in segment
+	uint32_t first;		// Oldest segment that may hold a record of key
+} APRS_Lsdb_Entry_t;
+
+typedef struct APRS_Lsdb_Segment_S {
+	uint32_t number;
+	uint32_t size;		// Valid records size
+	uint32_t live;		// Size of records still referenced
+} APRS_Lsdb_Segment_t;
+
+typedef struct APRS_Lsdb_S {
+	DB db;
+	char * path;
+	int (*compare)(const DBT *, const DBT *);
+	uint32_t segment_size;
+	uint32_t max_size;		// Compact above this size whatever utilization
+
+	APRS_Lsdb_Entry_t * entries;	// Sorted by key
+	int count;
+	int alloc;
+
+	APRS_Lsdb_Segment_t * segments;	// Sorted by number, last one is active
+	int segments_count;
+	int fd;				// Active segment
+	int rd_fd;			// Last read sealed segment
+	uint32_t rd_segment;
+
+	// Cursor, relocated by key when index changed
+	int cursor;
+	uint32_t gen, cursor_gen;
+	uint8_t cursor_key[APRS_LSDB_KEY_MAX];
+	uint8_t cursor_key_size;
+
+	// Compaction in progress
+	uint32_t victim;
+	uint32_t victim_offset;
+	int victim_fd;
+
+	uint8_t key[APRS_LSDB_KEY_MAX];	// Returned key
+	uint8_t * buf;			// Returned data, read records
+	size_t buf_size;
+	uint8_t * wbuf;			// Appended record
+	size_t wbuf_size;
+} APRS_Lsdb_t;
+
+static uint32_t APRS_Lsdb_Crc(const APRS_Lsdb_Rec_t * Rec, const uint8_t * Body) {
+	uint32_t crc;
+
+	crc = esp_rom_crc32_le(0, (const uint8_t *)&Rec->data_size, sizeof(APRS_Lsdb_Rec_t) - sizeof(Rec->crc));
+	return esp_rom_crc32_le(crc, Body, Rec->key_size + Rec->data_size);
+}
+
+static void APRS_Lsdb_Segment_Name(const APRS_Lsdb_t * Lsdb, uint32_t Number, char * Name, size_t Len) {
+	snprintf(Name, Len, "%s.%06lu", Lsdb->path, (unsigned long)Number);
+}
+
+static uint8_t * APRS_Lsdb_Buf(uint8_t ** Buf, size_t * Buf_Size, size_t Size) {
+	uint8_t * buf;
+
+	if (Size <= *Buf_Size)
+		return *Buf;
+
+	buf = realloc(*Buf, Size);
+	if (!buf) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	*Buf = buf;
+	*Buf_Size = Size;
+
+	return buf;
+}
+
+static APRS_Lsdb_Segment_t * APRS_Lsdb_Segment(APRS_Lsdb_t * Lsdb, uint32_t Number) {
+	int lo = 0, hi = Lsdb->segments_count, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (Lsdb->segments[mid].number < Number)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < Lsdb->segments_count && Lsdb->segments[lo].number == Number)
+		return &Lsdb->segments[lo];
+
+	return NULL;
+}
+
+static APRS_Lsdb_Segment_t * APRS_Lsdb_Active(APRS_Lsdb_t * Lsdb) {
+	return &Lsdb->segments[Lsdb->segments_count-1];
+}
+
+// Lower bound of key in index
+static int APRS_Lsdb_Search(APRS_Lsdb_t * Lsdb, const void * Key, size_t Size, bool * Found) {
+	DBT key = {.data = (void*)Key, .size = Size}, entry;
+	int lo = 0, hi = Lsdb->count, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		entry.data = Lsdb->entries[mid].key;
+		entry.size = Lsdb->entries[mid].key_size;
+		if (Lsdb->compare(&entry, &key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (Found) {
+		*Found = false;
+		if (lo < Lsdb->count) {
+			entry.data = Lsdb->entries[lo].key;
+			entry.size = Lsdb->entries[lo].key_size;
+			*Found = !Lsdb->compare(&entry, &key);
+		}
+	}
+
+	return lo;
+}
+
+static int APRS_Lsdb_Insert(APRS_Lsdb_t * Lsdb, int Pos, const void * Key, size_t Size) {
+	APRS_Lsdb_Entry_t * entries;
+
+	if (Lsdb->count == Lsdb->alloc) {
+		entries = realloc(Lsdb->entries, (Lsdb->alloc + APRS_LSDB_ALLOC_STEP) * sizeof(APRS_Lsdb_Entry_t));
+		if (!entries) {
+			errno = ENOMEM;
+			return -1;
+		}
+		Lsdb->entries = entries;
+		Lsdb->alloc += APRS_LSDB_ALLOC_STEP;
+	}
+
+	memmove(&Lsdb->entries[Pos+1], &Lsdb->entries[Pos], (Lsdb->count - Pos) * sizeof(APRS_Lsdb_Entry_t));
+	Lsdb->count++;
+	bzero(&Lsdb->entries[Pos], sizeof(APRS_Lsdb_Entry_t));
+	memcpy(Lsdb->entries[Pos].key, Key, Size);
+	Lsdb->entries[Pos].key_size = Size;
+
+	return 0;
+}
+
+// Release record of an index entry
+static void APRS_Lsdb_Unref(APRS_Lsdb_t * Lsdb, const APRS_Lsdb_Entry_t * Entry) {
+	APRS_Lsdb_Segment_t * segment = APRS_Lsdb_Segment(Lsdb, Entry->segment);
+
+	if (segment)
+		segment->live -= Entry->size;
+}
+
+// Tombstone hides records of its key until segments from first to its own one are gone
+static bool APRS_Lsdb_Needed(APRS_Lsdb_t * Lsdb, const APRS_Lsdb_Entry_t * Entry) {
+	int lo = 0, hi = Lsdb->segments_count, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (Lsdb->segments[mid].number < Entry->first)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo < Lsdb->segments_count && Lsdb->segments[lo].number < Entry->segment;
+}
+
+// Drop tombstones no more needed
+static void APRS_Lsdb_Sweep(APRS_Lsdb_t * Lsdb) {
+	int i, j;
+
+	for (i=0, j=0; i<Lsdb->count; i++) {
+		if (Lsdb->entries[i].deleted && !APRS_Lsdb_Needed(Lsdb, &Lsdb->entries[i])) {
+			APRS_Lsdb_Unref(Lsdb, &Lsdb->entries[i]);
+			continue;
+		}
+		if (i != j)
+			Lsdb->entries[j] = Lsdb->entries[i];
+		j++;
+	}
+
+	if (j != Lsdb->count) {
+		Lsdb->count = j;
+		Lsdb->gen++;
+	}
+}
+
+static int APRS_Lsdb_New_Segment(APRS_Lsdb_t * Lsdb) {
+	APRS_Lsdb_Segment_t * segments;
+	char name[64];
+	uint32_t number = 1;
+	int fd;
+
+	if (Lsdb->segments_count) {
+		number = APRS_Lsdb_Active(Lsdb)->number + 1;
+		if (Lsdb->fd >= 0) {
+			fsync(Lsdb->fd);
+			close(Lsdb->fd);
+			Lsdb->fd = -1;
+		}
+	}
+
+	APRS_Lsdb_Segment_Name(Lsdb, number, name, sizeof(name));
+	fd = open(name, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		ESP_LOGE(TAG, "Can't create %s (%d)", name, errno);
+		return -1;
+	}
+
+	segments = realloc(Lsdb->segments, (Lsdb->segments_count + 1) * sizeof(APRS_Lsdb_Segment_t));
+	if (!segments) {
+		close(fd);
+		unlink(name);
+		errno = ENOMEM;
+		return -1;
+	}
+	Lsdb->segments = segments;
+	segments[Lsdb->segments_count].number = number;
+	segments[Lsdb->segments_count].size = 0;
+	segments[Lsdb->segments_count].live = 0;
+	Lsdb->segments_count++;
+	Lsdb->fd = fd;
+
+	ESP_LOGD(TAG, "Segment %s created", name);
+
+	return 0;
+}
+
+// Append a record to active segment, return its offset or -1
+static int32_t APRS_Lsdb_Append(APRS_Lsdb_t * Lsdb, uint8_t Type, const void * Key, size_t Key_Size, const void * Data, size_t Data_Size, uint32_t * Segment) {
+	APRS_Lsdb_Segment_t * active = APRS_Lsdb_Active(Lsdb);
+	APRS_Lsdb_Rec_t rec;
+	size_t size = sizeof(APRS_Lsdb_Rec_t) + Key_Size + Data_Size;
+	uint8_t * buf;
+	uint32_t offset;
+
+	if (active->size && active->size + size > Lsdb->segment_size) {
+		if (APRS_Lsdb_New_Segment(Lsdb))
+			return -1;
+		active = APRS_Lsdb_Active(Lsdb);
+	}
+
+	// Whole record in one write
+	if (!(buf = APRS_Lsdb_Buf(&Lsdb->wbuf, &Lsdb->wbuf_size, size)))
+		return -1;
+	rec.data_size = Data_Size;
+	rec.key_size = Key_Size;
+	rec.type = Type;
+	memcpy(buf + sizeof(APRS_Lsdb_Rec_t), Key, Key_Size);
+	if (Data_Size)
+		memcpy(buf + sizeof(APRS_Lsdb_Rec_t) + Key_Size, Data, Data_Size);
+	rec.crc = APRS_Lsdb_Crc(&rec, buf + sizeof(APRS_Lsdb_Rec_t));
+	memcpy(buf, &rec, sizeof(APRS_Lsdb_Rec_t));
+
+	offset = active->size;
+	if (lseek(Lsdb->fd, offset, SEEK_SET) != offset || write(Lsdb->fd, buf, size) != size) {
+		ESP_LOGE(TAG, "Error writing segment %lu (%d)", (unsigned long)active->number, errno);
+		return -1;
+	}
+
+	active->size += size;
+	active->live += size;
+	*Segment = active->number;
+
+	return offset;
+}
+
+static int APRS_Lsdb_Read(APRS_Lsdb_t * Lsdb, uint32_t Segment, uint32_t Offset, void * Buf, size_t Size) {
+	char name[64];
+	int fd;
+
+	if (Segment == APRS_Lsdb_Active(Lsdb)->number)
+		fd = Lsdb->fd;
+	else {
+		if (Lsdb->rd_fd < 0 || Lsdb->rd_segment != Segment) {
+			if (Lsdb->rd_fd >= 0)
+				close(Lsdb->rd_fd);
+			APRS_Lsdb_Segment_Name(Lsdb, Segment, name, sizeof(name));
+			Lsdb->rd_fd = open(name, O_RDONLY);
+			Lsdb->rd_segment = Segment;
+		}
+		fd = Lsdb->rd_fd;
+	}
+
+	if (fd < 0 || lseek(fd, Offset, SEEK_SET) != Offset || read(fd, Buf, Size) != Size) {
+		ESP_LOGE(TAG, "Error reading segment %lu (%d)", (unsigned long)Segment, errno);
+		return -1;
+	}
+
+	return 0;
+}
+
+// Read data of an index entry in buffer
+static int APRS_Lsdb_Get_Data(APRS_Lsdb_t * Lsdb, const APRS_Lsdb_Entry_t * Entry, DBT * Data) {
+	size_t size = Entry->size - sizeof(APRS_Lsdb_Rec_t) - Entry->key_size;
+	uint8_t * buf;
+
+	if (!(buf = APRS_Lsdb_Buf(&Lsdb->buf, &Lsdb->buf_size, size ? size : 1)))
+		return -1;
+	if (size && APRS_Lsdb_Read(Lsdb, Entry->segment, Entry->offset + sizeof(APRS_Lsdb_Rec_t) + Entry->key_size, buf, size))
+		return -1;
+
+	Data->data = buf;
+	Data->size = size;
+
+	return 0;
+}
+
+static int APRS_Lsdb_Get(const DB * Db, const DBT * Key, DBT * Data, unsigned int Flags) {
+	APRS_Lsdb_t * lsdb = Db->internal;
+	bool found;
+	int pos;
+
+	pos = APRS_Lsdb_Search(lsdb, Key->data, Key->size, &found);
+	if (!found || lsdb->entries[pos].deleted)
+		return RET_SPECIAL;
+
+	return APRS_Lsdb_Get_Data(lsdb, &lsdb->entries[pos], Data);
+}
+
+static int APRS_Lsdb_Put(const DB * Db, DBT * Key, const DBT * Data, unsigned int Flags) {
+	APRS_Lsdb_t * lsdb = Db->internal;
+	APRS_Lsdb_Entry_t * entry;
+	uint32_t segment;
+	int32_t offset;
+	bool found;
+	int pos;
+
+	if (!Key->size || Key->size > APRS_LSDB_KEY_MAX || Data->size > UINT16_MAX - sizeof(APRS_Lsdb_Rec_t) - APRS_LSDB_KEY_MAX) {
+		errno = EINVAL;
+		return RET_ERROR;
+	}
+
+	pos = APRS_Lsdb_Search(lsdb, Key->data, Key->size, &found);
+	if (found && !lsdb->entries[pos].deleted && (Flags & R_NOOVERWRITE))
+		return RET_SPECIAL;
+
+	offset = APRS_Lsdb_Append(lsdb, APRS_LSDB_PUT, Key->data, Key->size, Data->data, Data->size, &segment);
+	if (offset < 0)
+		return RET_ERROR;
+
+	if (!found) {
+		if (APRS_Lsdb_Insert(lsdb, pos, Key->data, Key->size))
+			return RET_ERROR;
+		lsdb->entries[pos].first = segment;
+		lsdb->gen++;
+	} else
+		APRS_Lsdb_Unref(lsdb, &lsdb->entries[pos]);
+
+	entry = &lsdb->entries[pos];
+	entry->deleted = 0;
+	entry->size = sizeof(APRS_Lsdb_Rec_t) + Key->size + Data->size;
+	entry->segment = segment;
+	entry->offset = offset;
+
+	return RET_SUCCESS;
+}
+
+static int APRS_Lsdb_Del(const DB * Db, const DBT * Key, unsigned int Flags) {
+	APRS_Lsdb_t * lsdb = Db->internal;
+	uint32_t segment;
+	bool found;
+	int pos;
+	APRS_Lsdb_Entry_t * entry;
+	int32_t offset;
+
+	pos = APRS_Lsdb_Search(lsdb, Key->data, Key->size, &found);
+	if (!found || lsdb->entries[pos].deleted)
+		return RET_SPECIAL;
+
+	entry = &lsdb->entries[pos];
+	offset = APRS_Lsdb_Append(lsdb, APRS_LSDB_DEL, entry->key, entry->key_size, NULL, 0, &segment);
+	if (offset < 0)
+		return RET_ERROR;
+
+	APRS_Lsdb_Unref(lsdb, entry);
+	entry->deleted = 1;
+	entry->size = sizeof(APRS_Lsdb_Rec_t) + entry->key_size;
+	entry->segment = segment;
+	entry->offset = offset;
+
+	return RET_SUCCESS;
+}
+
+static int APRS_Lsdb_Seq(const DB * Db, DBT * Key, DBT * Data, unsigned int Flags) {
+	APRS_Lsdb_t * lsdb = Db->internal;
+	APRS_Lsdb_Entry_t * entry;
+	bool found;
+	int pos, dir = (Flags == R_LAST || Flags == R_PREV)?-1:1;
+
+	switch (Flags) {
+		case R_CURSOR:
+			pos = APRS_Lsdb_Search(lsdb, Key->data, Key->size, NULL);
+			break;
+		case R_FIRST:
+			pos = 0;
+			break;
+		case R_LAST:
+			pos = lsdb->count - 1;
+			break;
+		case R_NEXT:
+		case R_PREV:
+			if (lsdb->cursor < 0) {
+				pos = (Flags == R_NEXT)?0:lsdb->count - 1;
+				break;
+			}
+			pos = lsdb->cursor;
+			if (lsdb->cursor_gen != lsdb->gen) {
+				// Keys inserted or deleted since last call
+				pos = APRS_Lsdb_Search(lsdb, lsdb->cursor_key, lsdb->cursor_key_size, &found);
+				if (!found && Flags == R_NEXT)
+					pos--;
+			}
+			pos += dir;
+			break;
+		default:
+			errno = EINVAL;
+			return RET_ERROR;
+	}
+
+	// Skip tombstones
+	while (pos >= 0 && pos < lsdb->count && lsdb->entries[pos].deleted)
+		pos += dir;
+
+	if (pos < 0 || pos >= lsdb->count)
+		return RET_SPECIAL;
+
+	entry = &lsdb->entries[pos];
+	if (APRS_Lsdb_Get_Data(lsdb, entry, Data))
+		return RET_ERROR;
+
+	lsdb->cursor = pos;
+	lsdb->cursor_gen = lsdb->gen;
+	memcpy(lsdb->cursor_key, entry->key, entry->key_size);
+	lsdb->cursor_key_size = entry->key_size;
+
+	memcpy(lsdb->key, entry->key, entry->key_size);
+	Key->data = lsdb->key;
+	Key->size = entry->key_size;
+
+	return RET_SUCCESS;
+}
+
+static int APRS_Lsdb_Sync(const DB * Db, unsigned int Flags) {
+	APRS_Lsdb_t * lsdb = Db->internal;
+
+	if (fsync(lsdb->fd)) {
+		ESP_LOGE(TAG, "Error syncing segment (%d)", errno);
+		return RET_ERROR;
+	}
+
+	return RET_SUCCESS;
+}
+
+static int APRS_Lsdb_Fd(const DB * Db) {
+	APRS_Lsdb_t * lsdb = Db->internal;
+
+	return lsdb->fd;
+}
+
+static void APRS_Lsdb_Free(APRS_Lsdb_t * Lsdb) {
+	if (Lsdb->fd >= 0)
+		close(Lsdb->fd);
+	if (Lsdb->rd_fd >= 0)
+		close(Lsdb->rd_fd);
+	if (Lsdb->victim_fd >= 0)
+		close(Lsdb->victim_fd);
+	free(Lsdb->entries);
+	free(Lsdb->segments);
+	free(Lsdb->buf);
+	free(Lsdb->wbuf);
+	free(Lsdb->path);
+	free(Lsdb);
+}
+
+static int APRS_Lsdb_Close(DB * Db) {
+	APRS_Lsdb_t * lsdb = Db->internal;
+	int ret = RET_SUCCESS;
+
+	if (lsdb->fd >= 0 && fsync(lsdb->fd))
+		ret = RET_ERROR;
+	APRS_Lsdb_Free(lsdb);
+
+	return ret;
+}
+
+// Apply records of a segment to index, return valid size
+static uint32_t APRS_Lsdb_Replay(APRS_Lsdb_t * Lsdb, APRS_Lsdb_Segment_t * Segment) {
+	APRS_Lsdb_Entry_t * entry;
+	APRS_Lsdb_Rec_t rec;
+	char name[64];
+	uint8_t * body;
+	uint32_t offset = 0;
+	size_t size;
+	bool found;
+	int fd, pos;
+
+	APRS_Lsdb_Segment_Name(Lsdb, Segment->number, name, sizeof(name));
+	fd = open(name, O_RDONLY);
+	if (fd < 0)
+		return 0;
+
+	while (read(fd, &rec, sizeof(rec)) == sizeof(rec)) {
+		if (!rec.key_size || rec.key_size > APRS_LSDB_KEY_MAX || (rec.type != APRS_LSDB_PUT && rec.type != APRS_LSDB_DEL))
+			break;
+		size = rec.key_size + rec.data_size;
+		if (!(body = APRS_Lsdb_Buf(&Lsdb->buf, &Lsdb->buf_size, size)) || read(fd, body, size) != size || APRS_Lsdb_Crc(&rec, body) != rec.crc)
+			break;
+
+		// Tombstone of a key without previous record is useless
+		pos = APRS_Lsdb_Search(Lsdb, body, rec.key_size, &found);
+		if (found || rec.type == APRS_LSDB_PUT) {
+			if (found)
+				APRS_Lsdb_Unref(Lsdb, &Lsdb->entries[pos]);
+			else if (APRS_Lsdb_Insert(Lsdb, pos, body, rec.key_size))
+				break;
+			else
+				Lsdb->entries[pos].first = Segment->number;
+			entry = &Lsdb->entries[pos];
+			entry->deleted = (rec.type == APRS_LSDB_DEL);
+			entry->size = sizeof(rec) + size;
+			entry->segment = Segment->number;
+			entry->offset = offset;
+			Segment->live += sizeof(rec) + size;
+		}
+
+		offset += sizeof(rec) + size;
+	}
+
+	close(fd);
+
+	return offset;
+}
+
+static int APRS_Lsdb_Cmp_Number(const void * A, const void * B) {
+	uint32_t a = ((const APRS_Lsdb_Segment_t *)A)->number;
+	uint32_t b = ((const APRS_Lsdb_Segment_t *)B)->number;
+
+	return (a > b) - (a < b);
+}
+
+// List segment files of Lsdb
+static int APRS_Lsdb_Scan(APRS_Lsdb_t * Lsdb) {
+	APRS_Lsdb_Segment_t * segments;
+	const char * base;
+	char * dir, * end;
+	struct dirent * ent;
+	unsigned long number;
+	size_t len;
+	DIR * d;
+
+	base = strrchr(Lsdb->path, '/');
+	if (base) {
+		dir = strndup(Lsdb->path, base - Lsdb->path);
+		base++;
+	} else {
+		dir = strdup(".");
+		base = Lsdb->path;
+	}
+	if (!dir)
+		return -1;
+
+	d = opendir(*dir ? dir : "/");
+	free(dir);
+	if (!d) {
+		ESP_LOGE(TAG, "Can't open directory of %s (%d)", Lsdb->path, errno);
+		return -1;
+	}
+
+	len = strlen(base);
+	while ((ent = readdir(d))) {
+		if (strncmp(ent->d_name, base, len) || ent->d_name[len] != '.')
+			continue;
+		number = strtoul(&ent->d_name[len+1], &end, 10);
+		if (*end || end == &ent->d_name[len+1] || !number)
+			continue;
+
+		segments = realloc(Lsdb->segments, (Lsdb->segments_count + 1) * sizeof(APRS_Lsdb_Segment_t));
+		if (!segments) {
+			closedir(d);
+			return -1;
+		}
+		Lsdb->segments = segments;
+		bzero(&segments[Lsdb->segments_count], sizeof(APRS_Lsdb_Segment_t));
+		segments[Lsdb->segments_count++].number = number;
+	}
+	closedir(d);
+
+	if (Lsdb->segments_count)
+		qsort(Lsdb->segments, Lsdb->segments_count, sizeof(APRS_Lsdb_Segment_t), APRS_Lsdb_Cmp_Number);
+
+	return 0;
+}
+
+DB * APRS_Lsdb_Open(const char * Path, int Flags, int (*Compare)(const DBT *, const DBT *), int Segment_Size, int Max_Size) {
+	APRS_Lsdb_t * lsdb;
+	char name[64];
+	uint32_t size;
+	off_t end;
+	int i;
+
+	if (!Path || !Compare || Segment_Size <= 0)
+		return NULL;
+
+	lsdb = malloc(sizeof(APRS_Lsdb_t));
+	if (!lsdb)
+		return NULL;
+	bzero(lsdb, sizeof(APRS_Lsdb_t));
+	lsdb->fd = lsdb->rd_fd = lsdb->victim_fd = -1;
+	lsdb->cursor = -1;
+	lsdb->compare = Compare;
+	lsdb->segment_size = Segment_Size;
+	lsdb->max_size = Max_Size;
+	lsdb->path = strdup(Path);
+
+	lsdb->db.type = DB_BTREE;
+	lsdb->db.close = APRS_Lsdb_Close;
+	lsdb->db.del = APRS_Lsdb_Del;
+	lsdb->db.get = APRS_Lsdb_Get;
+	lsdb->db.put = APRS_Lsdb_Put;
+	lsdb->db.seq = APRS_Lsdb_Seq;
+	lsdb->db.sync = APRS_Lsdb_Sync;
+	lsdb->db.internal = lsdb;
+	lsdb->db.fd = APRS_Lsdb_Fd;
+
+	if (!lsdb->path || APRS_Lsdb_Scan(lsdb)) {
+		APRS_Lsdb_Free(lsdb);
+		return NULL;
+	}
+
+	if (Flags & O_TRUNC) {
+		for (i=0; i<lsdb->segments_count; i++) {
+			APRS_Lsdb_Segment_Name(lsdb, lsdb->segments[i].number, name, sizeof(name));
+			unlink(name);
+		}
+		lsdb->segments_count = 0;
+	}
+
+	for (i=0; i<lsdb->segments_count; i++)
+		lsdb->segments[i].size = APRS_Lsdb_Replay(lsdb, &lsdb->segments[i]);
+	APRS_Lsdb_Sweep(lsdb);
+
+	// Append to last segment unless its tail is damaged
+	if (lsdb->segments_count) {
+		APRS_Lsdb_Segment_t * last = APRS_Lsdb_Active(lsdb);
+
+		APRS_Lsdb_Segment_Name(lsdb, last->number, name, sizeof(name));
+		lsdb->fd = open(name, O_RDWR);
+		size = last->size;
+		end = (lsdb->fd >= 0)?lseek(lsdb->fd, 0, SEEK_END):-1;
+		if (end != size) {
+			ESP_LOGW(TAG, "%s : %ld bytes of incomplete records ignored", name, (long)(end - size));
+			if (APRS_Lsdb_New_Segment(lsdb)) {
+				APRS_Lsdb_Free(lsdb);
+				return NULL;
+			}
+		}
+	} else if (APRS_Lsdb_New_Segment(lsdb)) {
+		APRS_Lsdb_Free(lsdb);
+		return NULL;
+	}
+
+	ESP_LOGI(TAG, "%s : %d index entries in %d segments", Path, lsdb->count, lsdb->segments_count);
+
+	return &lsdb->db;
+}
+
+// Greedy cost-benefit choice (LFS) : free space weighted by segment age, so
+// cold segments are rewritten too and writes spread over the whole partition
+static uint32_t APRS_Lsdb_Victim(APRS_Lsdb_t * Lsdb) {
+	APRS_Lsdb_Segment_t * active = APRS_Lsdb_Active(Lsdb), * segment;
+	uint64_t dead = 0, live = 0, score, best_score = 0;
+	uint32_t best = 0;
+	int i;
+
+	for (i=0; i<Lsdb->segments_count-1; i++) {
+		segment = &Lsdb->segments[i];
+		dead += segment->size - segment->live;
+		live += segment->live;
+		if (segment->size == segment->live)
+			continue;
+		score = (uint64_t)(segment->size - segment->live) * (active->number - segment->number) * 1024
+			/ (segment->size + segment->live);
+		if (!best || score > best_score) {
+			best = segment->number;
+			best_score = score;
+		}
+	}
+
+	// Copy cost grows as 1/(1-u), wait for a whole segment and at most 50% utilization
+	if (dead < Lsdb->segment_size || (dead < live && dead + live + active->size < Lsdb->max_size))
+		return 0;
+
+	return best;
+}
+
+int APRS_Lsdb_Compact(DB * Db, int Budget) {
+	APRS_Lsdb_t * lsdb;
+	APRS_Lsdb_Segment_t * victim;
+	APRS_Lsdb_Rec_t rec;
+	APRS_Lsdb_Entry_t * entry;
+	uint8_t * buf;
+	char name[64];
+	uint32_t segment;
+	int32_t offset;
+	size_t size;
+	bool found, live;
+	int pos, done = 0;
+
+	if (!Db || Db->close != APRS_Lsdb_Close)
+		return -1;
+	lsdb = Db->internal;
+
+	if (!lsdb->victim) {
+		if (!(lsdb->victim = APRS_Lsdb_Victim(lsdb)))
+			return 0;
+		APRS_Lsdb_Segment_Name(lsdb, lsdb->victim, name, sizeof(name));
+		lsdb->victim_fd = open(name, O_RDONLY);
+		lsdb->victim_offset = 0;
+		if (lsdb->victim_fd < 0) {
+			ESP_LOGE(TAG, "Can't open %s (%d)", name, errno);
+			lsdb->victim = 0;
+			return -1;
+		}
+		ESP_LOGD(TAG, "Compacting %s", name);
+	}
+
+	victim = APRS_Lsdb_Segment(lsdb, lsdb->victim);
+	while (done < Budget && lsdb->victim_offset < victim->size) {
+		if (lseek(lsdb->victim_fd, lsdb->victim_offset, SEEK_SET) != lsdb->victim_offset
+				|| read(lsdb->victim_fd, &rec, sizeof(rec)) != sizeof(rec))
+			return -1;
+		size = rec.key_size + rec.data_size;
+		if (!(buf = APRS_Lsdb_Buf(&lsdb->buf, &lsdb->buf_size, size)) || read(lsdb->victim_fd, buf, size) != size)
+			return -1;
+
+		// Only last record of a key is copied, tombstones while still needed
+		pos = APRS_Lsdb_Search(lsdb, buf, rec.key_size, &found);
+		entry = &lsdb->entries[pos];
+		live = found && entry->segment == lsdb->victim && entry->offset == lsdb->victim_offset
+			&& (rec.type == APRS_LSDB_PUT || APRS_Lsdb_Needed(lsdb, entry));
+
+		if (live) {
+			offset = APRS_Lsdb_Append(lsdb, rec.type, buf, rec.key_size, buf + rec.key_size, rec.data_size, &segment);
+			if (offset < 0)
+				return -1;
+			// Segments table may have moved
+			victim = APRS_Lsdb_Segment(lsdb, lsdb->victim);
+			victim->live -= sizeof(rec) + size;
+			entry->segment = segment;
+			entry->offset = offset;
+		}
+
+		lsdb->victim_offset += sizeof(rec) + size;
+		done += sizeof(rec) + size;
+	}
+
+	if (lsdb->victim_offset < victim->size)
+		return 1;
+
+	// Copies are durable before the segment goes away
+	if (fsync(lsdb->fd))
+		return -1;
+	close(lsdb->victim_fd);
+	lsdb->victim_fd = -1;
+	if (lsdb->rd_fd >= 0 && lsdb->rd_segment == lsdb->victim) {
+		close(lsdb->rd_fd);
+		lsdb->rd_fd = -1;
+	}
+	APRS_Lsdb_Segment_Name(lsdb, lsdb->victim, name, sizeof(name));
+	unlink(name);
+	pos = victim - lsdb->segments;
+	memmove(victim, victim + 1, (lsdb->segments_count - pos - 1) * sizeof(APRS_Lsdb_Segment_t));
+	lsdb->segments_count--;
+	lsdb->victim = 0;
+	APRS_Lsdb_Sweep(lsdb);
+	ESP_LOGD(TAG, "%s reclaimed", name);
+
+	return APRS_Lsdb_Victim(lsdb)?1:0;
+}
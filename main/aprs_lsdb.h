@@ -0,0 +1,52 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * main/aprs_lsdb.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _APRS_LSDB_H_
+#define _APRS_LSDB_H_
+
+#include <stdint.h>
+#include <berkeley-db/db.h>
+
+// Log-structured key/value store with the berkeley-db DB interface
+// Records are appended to segment files <Path>.<number>, an in RAM index sorted
+// with Compare keeps the location of the last record of each key
+
+#define APRS_LSDB_KEY_MAX	16	// Max key size
+#define APRS_LSDB_PUT		'P'	// Record types
+#define APRS_LSDB_DEL		'D'
+
+typedef struct __attribute__((packed)) APRS_Lsdb_Rec_S {
+	uint32_t crc;		// crc32 of following fields, key and data
+	uint16_t data_size;
+	uint8_t key_size;
+	uint8_t type;		// APRS_LSDB_PUT or APRS_LSDB_DEL
+} APRS_Lsdb_Rec_t;
+
+// Flags : O_TRUNC remove existing segments
+// Compaction starts when half of the store is dead or when it grows over Max_Size
+DB * APRS_Lsdb_Open(const char * Path, int Flags, int (*Compare)(const DBT *, const DBT *), int Segment_Size, int Max_Size);
+// Copy live records of the best segment to reclaim, at most Budget bytes per call
+// return 1 if more work is pending, 0 if nothing to do, -1 on error
+int APRS_Lsdb_Compact(DB * Db, int Budget);
+
+#endif
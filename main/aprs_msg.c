@@ -0,0 +1,304 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * main/aprs_msg.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <esp_log.h>
+
+#include "aprs.h"
+#include "aprs_msg.h"
+
+#define TAG "APRS_MSG"
+
+// Outbound message
+typedef struct APRS_Msg_Out_S {
+	bool used;
+	bool ack;		// Wait for ack
+	uint32_t seq;		// Queuing order
+	uint8_t tries;
+	uint16_t delay;		// Current retry delay
+	time_t next;		// Next transmission time
+	AX25_Addr_t dst;
+	struct APRS_Message message;
+} APRS_Msg_Out_t;
+
+// Received message history
+typedef struct APRS_Msg_Dup_S {
+	time_t timestamp;
+	AX25_Addr_t from;
+	char id[6];
+	bool reply_ack_cap;
+} APRS_Msg_Dup_t;
+
+struct APRS_Msg_S {
+	APRS_Msg_Clock_t clock;
+	APRS_Msg_Send_t send;
+	void * ctx;
+
+	uint32_t seq;
+	uint16_t next_id;
+	APRS_Msg_Out_t out[APRS_MSG_MAX_OUT];
+
+	uint8_t dup_idx;
+	APRS_Msg_Dup_t dup[APRS_MSG_MAX_DUP];
+};
+
+static time_t APRS_Msg_Default_Clock(void * Ctx) {
+	return time(NULL);
+}
+
+APRS_Msg_t * APRS_Msg_Init(APRS_Msg_Clock_t Clock, APRS_Msg_Send_t Send, void * Ctx) {
+	APRS_Msg_t * msg;
+
+	if (!Send)
+		return NULL;
+
+	if (!(msg = malloc(sizeof(APRS_Msg_t)))) {
+		ESP_LOGE(TAG,"Error allocating message struct");
+		return NULL;
+	}
+	bzero(msg, sizeof(APRS_Msg_t));
+
+	msg->clock = Clock?Clock:APRS_Msg_Default_Clock;
+	msg->send = Send;
+	msg->ctx = Ctx;
+	msg->next_id = 1;
+
+	return msg;
+}
+
+// Last received history entry from station
+static APRS_Msg_Dup_t * APRS_Msg_Last_From(APRS_Msg_t * Msg, const AX25_Addr_t * From, time_t Now) {
+	APRS_Msg_Dup_t * last = NULL;
+	int i;
+
+	for (i=0; i<APRS_MSG_MAX_DUP; i++) {
+		APRS_Msg_Dup_t * dup = &Msg->dup[i];
+		if (!dup->timestamp || (Now - dup->timestamp) > APRS_MSG_DUP_TIMEOUT)
+			continue;
+		if (AX25_Addr_Cmp(&dup->from, From))
+			continue;
+		if (!last || dup->timestamp >= last->timestamp)
+			last = dup;
+	}
+
+	return last;
+}
+
+int APRS_Msg_Queue(APRS_Msg_t * Msg, const char * Addressee, const char * Text, bool Ack) {
+	APRS_Msg_Out_t * out = NULL;
+	APRS_Msg_Dup_t * last;
+	char addr[10];
+	time_t now;
+	int i;
+
+	if (!Msg || !Addressee || !*Addressee || !Text)
+		return -1;
+
+	for (i=0; i<APRS_MSG_MAX_OUT; i++)
+		if (!Msg->out[i].used) {
+			out = &Msg->out[i];
+			break;
+		}
+
+	if (!out) {
+		ESP_LOGE(TAG,"Outbound message queue full");
+		return -1;
+	}
+
+	now = Msg->clock(Msg->ctx);
+
+	bzero(out, sizeof(APRS_Msg_Out_t));
+	strncpy(addr, Addressee, sizeof(addr)-1);
+	addr[sizeof(addr)-1] = '\0';
+	AX25_Str_To_Addr(addr, &out->dst);
+	AX25_Norm_Addr(&out->dst);
+
+	out->message.type = APRS_MSG_TYPE_MESSAGE;
+	strncpy(out->message.addressee, Addressee, sizeof(out->message.addressee)-1);
+	strncpy(out->message.text, Text, sizeof(out->message.text)-1);
+
+	if (Ack) {
+		// 2 chars base 36 message number, with reply-ack
+		out->message.id[0] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ"[(Msg->next_id/36)%36];
+		out->message.id[1] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ"[Msg->next_id%36];
+		Msg->next_id = (Msg->next_id+1)%(36*36);
+		if (!Msg->next_id)
+			Msg->next_id = 1;
+
+		out->message.reply_ack_cap = true;
+		last = APRS_Msg_Last_From(Msg, &out->dst, now);
+		if (last && last->reply_ack_cap)
+			strncpy(out->message.reply_ack, last->id, sizeof(out->message.reply_ack)-1);
+	}
+
+	out->used = true;
+	out->ack = Ack;
+	out->seq = Msg->seq++;
+	out->delay = APRS_MSG_RETRY_DELAY;
+	out->next = now;
+
+	ESP_LOGI(TAG,"Message queued for %s {%s}", out->message.addressee, out->message.id);
+
+	return 0;
+}
+
+// Message acked or rejected by remote station
+static int APRS_Msg_Acked(APRS_Msg_t * Msg, const AX25_Addr_t * From, const char * Id, bool Rej) {
+	int i;
+
+	for (i=0; i<APRS_MSG_MAX_OUT; i++) {
+		APRS_Msg_Out_t * out = &Msg->out[i];
+		if (!out->used || !out->ack || AX25_Addr_Cmp(&out->dst, From) || strcmp(out->message.id, Id))
+			continue;
+		if (Rej)
+			ESP_LOGW(TAG,"Message {%s} to %s rejected", Id, out->message.addressee);
+		else
+			ESP_LOGI(TAG,"Message {%s} to %s acked", Id, out->message.addressee);
+		out->used = false;
+		return 0;
+	}
+
+	return 1;
+}
+
+// Return 0 if message must be delivered, 1 if consumed or duplicate
+int APRS_Msg_Received(APRS_Msg_t * Msg, const AX25_Addr_t * From, const struct APRS_Message * Message) {
+	struct APRS_Message ack;
+	APRS_Msg_Dup_t * dup;
+	time_t now;
+	int i;
+
+	if (!Msg || !From || !Message)
+		return -1;
+
+	switch (Message->type) {
+		case APRS_MSG_TYPE_ACK:
+		case APRS_MSG_TYPE_REJ:
+			APRS_Msg_Acked(Msg, From, Message->id, Message->type == APRS_MSG_TYPE_REJ);
+			if (Message->reply_ack[0])
+				APRS_Msg_Acked(Msg, From, Message->reply_ack, false);
+			return 1;
+		case APRS_MSG_TYPE_MESSAGE:
+			break;
+		default:
+			return 0;
+	}
+
+	// Reply-ack of one of our messages
+	if (Message->reply_ack[0])
+		APRS_Msg_Acked(Msg, From, Message->reply_ack, false);
+
+	if (!Message->id[0])
+		return 0;
+
+	// Ack it, even if duplicate (our ack may have been lost)
+	bzero(&ack, sizeof(ack));
+	ack.type = APRS_MSG_TYPE_ACK;
+	AX25_Addr_To_Str(From, ack.addressee, sizeof(ack.addressee));
+	strncpy(ack.id, Message->id, sizeof(ack.id)-1);
+	if (Msg->send(Msg->ctx, &ack))
+		ESP_LOGE(TAG,"Error sending ack {%s} to %s", ack.id, ack.addressee);
+
+	// Duplicate suppression on sender and message number
+	now = Msg->clock(Msg->ctx);
+	for (i=0; i<APRS_MSG_MAX_DUP; i++) {
+		dup = &Msg->dup[i];
+		if (dup->timestamp && (now - dup->timestamp) <= APRS_MSG_DUP_TIMEOUT
+				&& !AX25_Addr_Cmp(&dup->from, From) && !strcmp(dup->id, Message->id)) {
+			ESP_LOGD(TAG,"Duplicate message {%s} from %s", Message->id, ack.addressee);
+			return 1;
+		}
+	}
+
+	dup = &Msg->dup[Msg->dup_idx];
+	Msg->dup_idx = (Msg->dup_idx+1)%APRS_MSG_MAX_DUP;
+	dup->timestamp = now;
+	memcpy(&dup->from, From, sizeof(AX25_Addr_t));
+	AX25_Norm_Addr(&dup->from);
+	strncpy(dup->id, Message->id, sizeof(dup->id)-1);
+	dup->id[sizeof(dup->id)-1] = '\0';
+	dup->reply_ack_cap = Message->reply_ack_cap;
+
+	return 0;
+}
+
+// Send due messages, return delay (s) to next transmission or -1 if none
+int APRS_Msg_Process(APRS_Msg_t * Msg) {
+	APRS_Msg_Out_t * out, * first;
+	time_t now;
+	int i, j, wait;
+
+	if (!Msg)
+		return -1;
+
+	now = Msg->clock(Msg->ctx);
+	wait = -1;
+
+	for (i=0; i<APRS_MSG_MAX_OUT; i++) {
+		out = &Msg->out[i];
+		if (!out->used)
+			continue;
+
+		// One message at a time per destination, in queuing order
+		first = out;
+		for (j=0; j<APRS_MSG_MAX_OUT; j++)
+			if (Msg->out[j].used && Msg->out[j].seq < first->seq && !AX25_Addr_Cmp(&Msg->out[j].dst, &out->dst))
+				first = &Msg->out[j];
+		if (first != out)
+			continue;
+
+		if (now >= out->next) {
+			if (out->tries >= APRS_MSG_MAX_TRY) {
+				ESP_LOGW(TAG,"Message {%s} to %s not acked", out->message.id, out->message.addressee);
+				out->used = false;
+				// Next message for this destination can go now
+				wait = 0;
+				continue;
+			}
+
+			if (Msg->send(Msg->ctx, &out->message))
+				ESP_LOGE(TAG,"Error sending message {%s} to %s", out->message.id, out->message.addressee);
+
+			// No ack expected : sent once
+			if (!out->ack) {
+				out->used = false;
+				wait = 0;
+				continue;
+			}
+
+			out->tries++;
+			out->next = now + out->delay;
+			out->delay <<= 1;
+			if (out->delay > APRS_MSG_MAX_DELAY)
+				out->delay = APRS_MSG_MAX_DELAY;
+		}
+
+		if (wait < 0 || (out->next - now) < wait)
+			wait = out->next - now;
+	}
+
+	return wait;
+}
@@ -0,0 +1,53 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * main/aprs_msg.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _APRS_MSG_H_
+#define _APRS_MSG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "ax25.h"
+
+#define APRS_MSG_MAX_OUT	8	// Outbound message queue size
+#define APRS_MSG_MAX_DUP	16	// Received message history for duplicate suppression
+#define APRS_MSG_MAX_TRY	5	// Transmissions before giving up
+#define APRS_MSG_RETRY_DELAY	30	// First retry delay (s)
+#define APRS_MSG_MAX_DELAY	480	// Max retry delay (s)
+#define APRS_MSG_DUP_TIMEOUT	1800	// Duplicate suppression window (s)
+
+typedef struct APRS_Msg_S APRS_Msg_t;
+struct APRS_Message;
+
+// Time source (seconds), injectable for host testing
+typedef time_t (*APRS_Msg_Clock_t)(void * Ctx);
+// Transmit a message, ack or rej
+typedef int (*APRS_Msg_Send_t)(void * Ctx, const struct APRS_Message * Message);
+
+APRS_Msg_t * APRS_Msg_Init(APRS_Msg_Clock_t Clock, APRS_Msg_Send_t Send, void * Ctx);
+int APRS_Msg_Queue(APRS_Msg_t * Msg, const char * Addressee, const char * Text, bool Ack);
+int APRS_Msg_Received(APRS_Msg_t * Msg, const AX25_Addr_t * From, const struct APRS_Message * Message);
+int APRS_Msg_Process(APRS_Msg_t * Msg);
+
+#endif
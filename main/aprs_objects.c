@@ -0,0 +1,257 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * main/aprs_objects.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <esp_log.h>
+
+#include "aprs.h"
+#include "aprs_objects.h"
+
+#define TAG "APRS_OBJECTS"
+
+#define APRS_OBJECTS_NIL	0xffff
+
+// Object table : fixed pool, index sorted on (name, originator)
+// for binary search, and LRU list for eviction when full
+struct APRS_Objects_S {
+	uint16_t size;
+	uint16_t count;
+	uint16_t lru_head;	// Most recently updated
+	uint16_t lru_tail;	// Least recently updated
+	struct {
+		uint16_t prev;
+		uint16_t next;
+	} * lru;
+	uint16_t * index;	// Slots sorted by key
+	APRS_Obj_t * obj;
+};
+
+APRS_Objects_t * APRS_Objects_Init(int Size) {
+	APRS_Objects_t * objects;
+
+	if (Size <= 0 || Size >= APRS_OBJECTS_NIL)
+		return NULL;
+
+	if (!(objects = malloc(sizeof(APRS_Objects_t)))) {
+		ESP_LOGE(TAG,"Error allocating objects table");
+		return NULL;
+	}
+	bzero(objects, sizeof(APRS_Objects_t));
+
+	objects->lru = malloc(Size * sizeof(objects->lru[0]));
+	objects->index = malloc(Size * sizeof(objects->index[0]));
+	objects->obj = malloc(Size * sizeof(APRS_Obj_t));
+	if (!objects->lru || !objects->index || !objects->obj) {
+		ESP_LOGE(TAG,"Error allocating %d objects", Size);
+		free(objects->lru);
+		free(objects->index);
+		free(objects->obj);
+		free(objects);
+		return NULL;
+	}
+	bzero(objects->obj, Size * sizeof(APRS_Obj_t));
+
+	objects->size = Size;
+	objects->lru_head = objects->lru_tail = APRS_OBJECTS_NIL;
+
+	return objects;
+}
+
+static int APRS_Objects_Cmp(const APRS_Obj_t * Obj, const char * Name, const AX25_Addr_t * Originator) {
+	int ret;
+
+	if ((ret = strncmp(Obj->name, Name, sizeof(Obj->name))))
+		return ret;
+
+	return AX25_Addr_Cmp(&Obj->originator, Originator);
+}
+
+// Binary search, return index position of key or insertion point
+static int APRS_Objects_Find(APRS_Objects_t * Objects, const char * Name, const AX25_Addr_t * Originator, bool * Found) {
+	int lo = 0, hi = Objects->count, mid, ret;
+
+	*Found = false;
+	while (lo < hi) {
+		mid = (lo + hi) >> 1;
+		ret = APRS_Objects_Cmp(&Objects->obj[Objects->index[mid]], Name, Originator);
+		if (!ret) {
+			*Found = true;
+			return mid;
+		}
+		if (ret < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static void APRS_Objects_Lru_Unlink(APRS_Objects_t * Objects, uint16_t Slot) {
+	uint16_t prev = Objects->lru[Slot].prev;
+	uint16_t next = Objects->lru[Slot].next;
+
+	if (prev != APRS_OBJECTS_NIL)
+		Objects->lru[prev].next = next;
+	else
+		Objects->lru_head = next;
+
+	if (next != APRS_OBJECTS_NIL)
+		Objects->lru[next].prev = prev;
+	else
+		Objects->lru_tail = prev;
+}
+
+static void APRS_Objects_Lru_Push(APRS_Objects_t * Objects, uint16_t Slot) {
+	Objects->lru[Slot].prev = APRS_OBJECTS_NIL;
+	Objects->lru[Slot].next = Objects->lru_head;
+	if (Objects->lru_head != APRS_OBJECTS_NIL)
+		Objects->lru[Objects->lru_head].prev = Slot;
+	else
+		Objects->lru_tail = Slot;
+	Objects->lru_head = Slot;
+}
+
+// Remove least recently updated object, return its free slot
+static uint16_t APRS_Objects_Evict(APRS_Objects_t * Objects) {
+	uint16_t slot = Objects->lru_tail;
+	bool found;
+	int idx;
+
+	idx = APRS_Objects_Find(Objects, Objects->obj[slot].name, &Objects->obj[slot].originator, &found);
+	if (found) {
+		memmove(&Objects->index[idx], &Objects->index[idx+1], (Objects->count-idx-1)*sizeof(Objects->index[0]));
+		Objects->count--;
+	}
+	APRS_Objects_Lru_Unlink(Objects, slot);
+
+	ESP_LOGD(TAG,"Object %s evicted", Objects->obj[slot].name);
+
+	return slot;
+}
+
+// Create, update or kill object from parsed report
+int APRS_Objects_Update(APRS_Objects_t * Objects, const APRS_Data_t * Data) {
+	AX25_Addr_t originator;
+	APRS_Obj_t * obj;
+	uint16_t slot;
+	bool found;
+	int idx;
+
+	if (!Objects || !Data || !Data->object_name[0])
+		return -1;
+
+	memcpy(&originator, &Data->address[1], sizeof(AX25_Addr_t));
+	AX25_Norm_Addr(&originator);
+
+	idx = APRS_Objects_Find(Objects, Data->object_name, &originator, &found);
+	if (found) {
+		slot = Objects->index[idx];
+		APRS_Objects_Lru_Unlink(Objects, slot);
+	} else {
+		if (Data->object_killed)	// Nothing to kill
+			return 0;
+
+		if (Objects->count < Objects->size)
+			slot = Objects->count;
+		else {
+			slot = APRS_Objects_Evict(Objects);
+			idx = APRS_Objects_Find(Objects, Data->object_name, &originator, &found);
+		}
+
+		memmove(&Objects->index[idx+1], &Objects->index[idx], (Objects->count-idx)*sizeof(Objects->index[0]));
+		Objects->index[idx] = slot;
+		Objects->count++;
+
+		obj = &Objects->obj[slot];
+		bzero(obj, sizeof(APRS_Obj_t));
+		strncpy(obj->name, Data->object_name, sizeof(obj->name)-1);
+		memcpy(&obj->originator, &originator, sizeof(AX25_Addr_t));
+		ESP_LOGI(TAG,"New %s %s", Data->type == APRS_DTI_ITEM?"item":"object", obj->name);
+	}
+	APRS_Objects_Lru_Push(Objects, slot);
+
+	obj = &Objects->obj[slot];
+	obj->timestamp = Data->timestamp;
+	obj->item = (Data->type == APRS_DTI_ITEM);
+	obj->killed = Data->object_killed;
+	if (Data->symbol[0] && Data->symbol[1]) {
+		obj->symbol[0] = Data->symbol[0];
+		obj->symbol[1] = Data->symbol[1];
+	}
+	memcpy(&obj->position, &Data->position, sizeof(struct APRS_Position));
+	if (Data->extension == APRS_DATA_EXT_CSE || Data->extension == APRS_DATA_EXT_CSE_NRQ)
+		memcpy(&obj->course, &Data->course, sizeof(struct APRS_Course));
+	else
+		bzero(&obj->course, sizeof(struct APRS_Course));
+	strncpy(obj->comment, Data->text, sizeof(obj->comment)-1);
+	obj->comment[sizeof(obj->comment)-1] = '\0';
+
+	if (obj->killed)
+		ESP_LOGI(TAG,"%s %s killed", obj->item?"Item":"Object", obj->name);
+
+	return 0;
+}
+
+int APRS_Objects_Get(APRS_Objects_t * Objects, const char * Name, const AX25_Addr_t * Originator, APRS_Obj_t * Obj) {
+	AX25_Addr_t originator;
+	bool found;
+	int idx;
+
+	if (!Objects || !Name || !Originator || !Obj)
+		return -1;
+
+	memcpy(&originator, Originator, sizeof(AX25_Addr_t));
+	AX25_Norm_Addr(&originator);
+
+	idx = APRS_Objects_Find(Objects, Name, &originator, &found);
+	if (!found)
+		return 1;
+
+	memcpy(Obj, &Objects->obj[Objects->index[idx]], sizeof(APRS_Obj_t));
+
+	return 0;
+}
+
+// Objects in (name, originator) order
+int APRS_Objects_Get_Nth(APRS_Objects_t * Objects, int n, APRS_Obj_t * Obj) {
+	if (!Objects || !Obj || n < 0)
+		return -1;
+
+	if (n >= Objects->count)
+		return 1;
+
+	memcpy(Obj, &Objects->obj[Objects->index[n]], sizeof(APRS_Obj_t));
+
+	return 0;
+}
+
+int APRS_Objects_Count(APRS_Objects_t * Objects) {
+	if (!Objects)
+		return -1;
+
+	return Objects->count;
+}
@@ -0,0 +1,37 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * main/aprs_objects.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _APRS_OBJECTS_H_
+#define _APRS_OBJECTS_H_
+
+#include "aprs.h"
+
+typedef struct APRS_Objects_S APRS_Objects_t;
+
+APRS_Objects_t * APRS_Objects_Init(int Size);
+int APRS_Objects_Update(APRS_Objects_t * Objects, const APRS_Data_t * Data);
+int APRS_Objects_Get(APRS_Objects_t * Objects, const char * Name, const AX25_Addr_t * Originator, APRS_Obj_t * Obj);
+int APRS_Objects_Get_Nth(APRS_Objects_t * Objects, int n, APRS_Obj_t * Obj);
+int APRS_Objects_Count(APRS_Objects_t * Objects);
+
+#endif
@@ -33,14 +33,20 @@
 #include <esp_log.h>
 #include <math.h>
 #include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+
+#ifdef CONFIG_ESP32S3APRS_APRS_PARSE_STATS
+#include <esp_timer.h>
+#endif
 
 #define TAG "APRS_PARSERS"
 
-static int APRS_Parser_CUR_MICE_R0(int pos, Frame_t * Frame, APRS_Data_t * Data);
-static int APRS_Parser_OLD_MICE_R0(int pos, Frame_t * Frame, APRS_Data_t * Data);
+static int APRS_Get_Position_Report(int pos, Frame_t * Frame, APRS_Data_t * Data);
+static int APRS_Parser_MICE(int pos, Frame_t * Frame, APRS_Data_t * Data);
 static int APRS_Parser_POS(int pos, Frame_t * Frame, APRS_Data_t * Data);
 static int APRS_Parser_RAW_GPS(int pos, Frame_t * Frame, APRS_Data_t * Data);
-static int APRS_Parser_OLD_MICE_TMD700(int pos, Frame_t * Frame, APRS_Data_t * Data);
 static int APRS_Parser_ITEM(int pos, Frame_t * Frame, APRS_Data_t * Data);
 static int APRS_Parser_TEST(int pos, Frame_t * Frame, APRS_Data_t * Data);
 static int APRS_Parser_MESSAGE(int pos, Frame_t * Frame, APRS_Data_t * Data);
@@ -51,7 +57,6 @@ static int APRS_Parser_QUERY(int pos, Frame_t * Frame, APRS_Data_t * Data);
 static int APRS_Parser_TELEMETRIE(int pos, Frame_t * Frame, APRS_Data_t * Data);
 static int APRS_Parser_MH_LOCATOR(int pos, Frame_t * Frame, APRS_Data_t * Data);
 static int APRS_Parser_WEATHER(int pos, Frame_t * Frame, APRS_Data_t * Data);
-static int APRS_Parser_CUR_MICE(int pos, Frame_t * Frame, APRS_Data_t * Data);
 static int APRS_Parser_USER_DEF(int pos, Frame_t * Frame, APRS_Data_t * Data);
 static int APRS_Parser_THIRD_PARTY(int pos, Frame_t * Frame, APRS_Data_t * Data);
 
@@ -59,11 +64,11 @@ const struct APRS_Parsers_S {
 	enum APRS_DTI_E	type;
 	int	(*parser)(int pos, Frame_t * Frame, APRS_Data_t * Date);
 } APRS_Parsers[] = {
-	{APRS_DTI_CUR_MICE_R0, APRS_Parser_CUR_MICE_R0},
-	{APRS_DTI_OLD_MICE_R0, APRS_Parser_OLD_MICE_R0},
+	{APRS_DTI_CUR_MICE_R0, APRS_Parser_MICE},
+	{APRS_DTI_OLD_MICE_R0, APRS_Parser_MICE},
 	{APRS_DTI_POS, APRS_Parser_POS},
 	{APRS_DTI_RAW_GPS, APRS_Parser_RAW_GPS},
-	{APRS_DTI_OLD_MICE_TMD700, APRS_Parser_OLD_MICE_TMD700},
+	{APRS_DTI_OLD_MICE_TMD700, APRS_Parser_MICE},
 	{APRS_DTI_ITEM, APRS_Parser_ITEM},
 	{APRS_DTI_TEST, APRS_Parser_TEST},
 	{APRS_DTI_POS_W_TS, APRS_Parser_POS},
@@ -77,21 +82,89 @@ const struct APRS_Parsers_S {
 	{APRS_DTI_TELEMETRIE, APRS_Parser_TELEMETRIE},
 	{APRS_DTI_MH_LOCATOR, APRS_Parser_MH_LOCATOR},
 	{APRS_DTI_WEATHER, APRS_Parser_WEATHER},
-	{APRS_DTI_CUR_MICE, APRS_Parser_CUR_MICE},
+	{APRS_DTI_CUR_MICE, APRS_Parser_MICE},
 	{APRS_DTI_USER_DEF, APRS_Parser_USER_DEF},
 	{APRS_DTI_THIRD_PARTY, APRS_Parser_THIRD_PARTY},
 	{0,NULL}		// end marker
 };
 
+#define APRS_PARSERS_COUNT	(sizeof(APRS_Parsers)/sizeof(APRS_Parsers[0]))
+
+#ifdef CONFIG_ESP32S3APRS_APRS_PARSE_STATS
+// Indexed as APRS_Parsers, end marker slot counts unknown DTI
+static APRS_Parse_Stats_t APRS_Stats[APRS_PARSERS_COUNT];
+
+static void APRS_Parse_Stats_Add(int Idx, int Ret, int64_t Start) {
+	APRS_Parse_Stats_t * stats = &APRS_Stats[Idx];
+	uint32_t time = esp_timer_get_time() - Start;
+
+	stats->count++;
+	if (Ret == -1)
+		stats->errors++;
+	stats->time += time;
+	if (time > stats->max_time)
+		stats->max_time = time;
+}
+
+// Copy stats of parsers that have seen frames, return number of entries
+int APRS_Get_Parse_Stats(APRS_Parse_Stats_t * Stats, int Max) {
+	int i, n = 0;
+
+	if (!Stats)
+		return -1;
+
+	for (i=0; i<APRS_PARSERS_COUNT && n<Max; i++) {
+		if (!APRS_Stats[i].count)
+			continue;
+		Stats[n] = APRS_Stats[i];
+		Stats[n].type = APRS_Parsers[i].type;
+		n++;
+	}
+
+	return n;
+}
+
+void APRS_Log_Parse_Stats(void) {
+	uint32_t count = 0;
+	uint64_t time = 0;
+	int i;
+
+	for (i=0; i<APRS_PARSERS_COUNT; i++) {
+		APRS_Parse_Stats_t * stats = &APRS_Stats[i];
+		if (!stats->count)
+			continue;
+		ESP_LOGI(TAG,"DTI %c : %lu frames, %lu errors, avg %llu us, max %lu us",
+				isprint((int)APRS_Parsers[i].type)?APRS_Parsers[i].type:'?',
+				stats->count, stats->errors, stats->time/stats->count, stats->max_time);
+		count += stats->count;
+		time += stats->time;
+	}
+
+	if (time)
+		ESP_LOGI(TAG,"%lu frames parsed, %llu frames/s",count, (uint64_t)count*1000000/time);
+}
+#else
+int APRS_Get_Parse_Stats(APRS_Parse_Stats_t * Stats, int Max) {
+	return -1;
+}
+
+void APRS_Log_Parse_Stats(void) {
+}
+#endif
+
 int APRS_Parse(Frame_t * Frame, APRS_Data_t * Data) {
 	int i, pos, ret;
 	char addr[10];
-	char store = Frame->frame[Frame->frame_len-2];
-
+	char store;
+#ifdef CONFIG_ESP32S3APRS_APRS_PARSE_STATS
+	int64_t start = esp_timer_get_time();
+#endif
 
 	if (!Frame || Frame->frame_len < (HDLC_MIN_FRAME_LEN+2) || !Data)
 		return -1;
 
+	store = Frame->frame[Frame->frame_len-2];
+
 	bzero(Data,sizeof(APRS_Data_t));
 
 	pos = 0;
@@ -107,7 +180,7 @@ int APRS_Parse(Frame_t * Frame, APRS_Data_t * Data) {
 		pos+=sizeof(AX25_Addr_t);
 	} while (!(Data->address[i-1].ssid & 1) && i < (2+APRS_MAX_DIGI));
 
-	if (i == (2+APRS_MAX_DIGI)) {
+	if (!(Data->address[i-1].ssid & 1)) {
 		ESP_LOGE(TAG,"Too many digipeater");
 		return -1;
 	}
@@ -140,6 +213,9 @@ int APRS_Parse(Frame_t * Frame, APRS_Data_t * Data) {
 			ESP_LOGD(TAG,"DTI = %c",Data->type);
 			pos++;
 			ret = APRS_Parsers[i].parser(pos,Frame,Data);
+#ifdef CONFIG_ESP32S3APRS_APRS_PARSE_STATS
+			APRS_Parse_Stats_Add(i, ret, start);
+#endif
 			break;
 
 		}
@@ -149,7 +225,7 @@ int APRS_Parse(Frame_t * Frame, APRS_Data_t * Data) {
 	if (!APRS_Parsers[i].type) {
 		// Exeption for '!' on X1J TNC digipeaters
 		i=1;
-		while (i<40) {
+		while (i<40 && (pos+i) < (Frame->frame_len-2)) {
 			if (Frame->frame[pos+i] == APRS_DTI_POS) {
 				Data->type = APRS_DTI_POS;
 				ESP_LOGD(TAG,"Found DTI = %c at pos %d ", Frame->frame[pos+i],i);
@@ -159,15 +235,20 @@ int APRS_Parse(Frame_t * Frame, APRS_Data_t * Data) {
 					memcpy(Data->text,Frame->frame+pos,i);
 					pos += ret + i;
 
-					ret = Frame->frame_len-(pos+1);
-					if (ret > sizeof(Data->text)-1)
-						ret = sizeof(Data->text)-1;
-					if (ret) {
+					ret = Frame->frame_len-2-pos;
+					if (ret > (int)sizeof(Data->text)-2-i)
+						ret = sizeof(Data->text)-2-i;
+					if (ret > 0) {
 						Data->text[i] = ' ';
 						i++;
 						memcpy(Data->text+i,&Frame->frame[pos],ret);
-					}
+					} else
+						ret = 0;
 					Data->text[i+ret] = '\0';
+					Frame->frame[Frame->frame_len-2] = store;
+#ifdef CONFIG_ESP32S3APRS_APRS_PARSE_STATS
+					APRS_Parse_Stats_Add(APRS_PARSERS_COUNT-1, 0, start);
+#endif
 					return Data->type;
 				}
 				
@@ -175,8 +256,12 @@ int APRS_Parse(Frame_t * Frame, APRS_Data_t * Data) {
 			i++;
 		}
 
-		if (i==40) {
+		if (i==40 || (pos+i) >= (Frame->frame_len-2)) {
 			ESP_LOGE(TAG,"Unknown DTI = %c",Frame->frame[pos]);
+			Frame->frame[Frame->frame_len-2] = store;
+#ifdef CONFIG_ESP32S3APRS_APRS_PARSE_STATS
+			APRS_Parse_Stats_Add(APRS_PARSERS_COUNT-1, -1, start);
+#endif
 			return -1;
 		}
 	}
@@ -192,21 +277,110 @@ int APRS_Parse(Frame_t * Frame, APRS_Data_t * Data) {
 
 	// Get Comment if any
 	i = Frame->frame_len-(pos+2);
-	if (i > sizeof(Data->text)-1)
+	if (i > (int)sizeof(Data->text)-1)
 		i = sizeof(Data->text)-1;
-	if (i) {
+	if (i > 0) {
 		memcpy(Data->text,&Frame->frame[pos],i);
+		Data->text[i] = '\0';
 		ESP_LOGD(TAG,"Comment : %s",Data->text);
+		if (i == Frame->frame_len-(pos+2)) {
+			Data->text_pos = pos;
+			Data->text_len = i;
+		}
 	}
 
-	Data->text[i] = '\0';
-
 
 	return Data->type;
 }
 
+// Descriptor of a parsed frame, text is left in the frame
+int APRS_Event_Init(APRS_Event_Data_t * Event, Frame_t * Frame, const APRS_Data_t * Data) {
+	if (!Event || !Frame || !Data)
+		return -1;
+
+	Event->frame = Frame;
+	Event->timestamp = Data->timestamp;
+	Event->type = Data->type;
+	Event->extension = Data->extension;
+	Event->src = Data->address[1];
+	Event->via = Data->address[Data->from];
+	Event->from = Data->from;
+	Event->symbol[0] = Data->symbol[0];
+	Event->symbol[1] = Data->symbol[1];
+	Event->position = Data->position;
+	Event->course = Data->course;
+
+	// Text left in frame, measured here only if it has to be decoded again
+	switch (Data->type) {
+		case APRS_DTI_RAW_GPS:
+		case APRS_DTI_QUERY:
+			Event->text = 0;
+			Event->text_len = 0;
+			break;
+		default:
+			Event->text = Data->text_pos;
+			if (Data->text_pos)
+				Event->text_len = Data->text_len;
+			else
+				Event->text_len = strnlen((Data->type == APRS_DTI_MESSAGE)?Data->message.text:Data->text,
+						sizeof(Data->message.text)-1);
+	}
+
+	return 0;
+}
+
+// Full decode of a descriptor frame
+int APRS_Event_Decode(const APRS_Event_Data_t * Event, APRS_Data_t * Data) {
+	int ret;
+
+	if (!Event || !Event->frame)
+		return -1;
+
+	if ((ret = APRS_Parse(Event->frame, Data)) == -1)
+		return -1;
+
+	Data->timestamp = Event->timestamp;
+	Data->symbol[0] = Event->symbol[0];
+	Data->symbol[1] = Event->symbol[1];
+
+	return ret;
+}
+
+// Message text or comment, decoded again if it was not in the frame as is
+int APRS_Event_Text(const APRS_Event_Data_t * Event, char * Buff, size_t Size) {
+	APRS_Data_t data;
+	const char * text;
+	size_t len;
+
+	if (!Event || !Buff || !Size)
+		return -1;
+
+	if (Event->text || !Event->text_len) {
+		text = (const char*)&Event->frame->frame[Event->text];
+		len = Event->text_len;
+	} else if (APRS_Event_Decode(Event, &data) != -1) {
+		text = (data.type == APRS_DTI_MESSAGE)?data.message.text:data.text;
+		len = strnlen(text, sizeof(data.message.text)-1);
+	} else {
+		text = "";
+		len = 0;
+	}
+
+	if (len > Size-1)
+		len = Size-1;
+	memcpy(Buff, text, len);
+	Buff[len] = '\0';
+
+	return len;
+}
+
 static int APRS_Get_Time(uint8_t * Ptr, APRS_Data_t * Data) {
 	int n;
+
+	// Info field is nul terminated while parsing
+	if (strnlen((char*)Ptr, 7) < 7)
+		return -1;
+
 	// Count number of digit
 	for (n=0;n<8 && isdigit(Ptr[n]);n++);
 	if (n==0 && (Ptr[6] == 'z' || Ptr[6] == '/' || Ptr [6] == 'h') && (strncmp((char*)Ptr,"......",6) || strncmp((char*)Ptr,"      ",6))) {
@@ -243,7 +417,7 @@ static int APRS_Get_Time(uint8_t * Ptr, APRS_Data_t * Data) {
 		Data->time.month = (Ptr[0]-'0')*10 + (Ptr[1]-'0');
 		Data->time.day = (Ptr[2]-'0')*10 + (Ptr[3]-'0');
 		Data->time.hours = (Ptr[4]-'0')*10 + (Ptr[5]-'0');
-		Data->time.minutes = (Ptr[6]-'6')*10 + (Ptr[7]-'7');
+		Data->time.minutes = (Ptr[6]-'0')*10 + (Ptr[7]-'0');
 		Data->time.seconds = 255;
 		Data->time.local = false;
 		ESP_LOGD(TAG,"MDHM : %02d%02d%02d%02d",
@@ -382,13 +556,13 @@ uint32_t APRS_To91(uint32_t val, int i) {
 	return b91;
 }
 
-uint32_t APRS_From91(uint32_t b91, int i) {
+// Decode I base91 digits, most significant first (byte access, frame data is unaligned)
+uint32_t APRS_From91(const uint8_t * Ptr, int i) {
 	uint32_t val = 0;
 
 	while(i) {
 		val *= 91;
-		val += ((b91&0xff)-'!');
-		b91 >>= 8;
+		val += (*Ptr++ - '!');
 		i--;
 	}
 
@@ -397,7 +571,7 @@ uint32_t APRS_From91(uint32_t b91, int i) {
 
 
 static int APRS_Get_Compressed_Data(uint8_t *Ptr, APRS_Data_t *Data) {
-	int pos = 0;
+	int i, pos = 0;
 
 	if (*Ptr >= 'a' && *Ptr <= 'j')
 		Data->symbol[0] = *Ptr-'a'+'0';
@@ -408,11 +582,15 @@ static int APRS_Get_Compressed_Data(uint8_t *Ptr, APRS_Data_t *Data) {
 	pos++;
 	Ptr++;
 
-	Data->position.latitude = (90<<GPS_FIXED_POINT_DEG) - ((uint64_t)APRS_From91(*(uint32_t*)Ptr,4)<<GPS_FIXED_POINT_DEG) / 380926;
+	for (i=0; i<8; i++)
+		if (Ptr[i] < '!' || Ptr[i] > '{')
+			return -1;
+
+	Data->position.latitude = (90<<GPS_FIXED_POINT_DEG) - ((uint64_t)APRS_From91(Ptr,4)<<GPS_FIXED_POINT_DEG) / 380926;
 	Ptr+=4;
 	pos+=4;
 
-	Data->position.longitude = (180<<GPS_FIXED_POINT_DEG) - ((uint64_t)APRS_From91(*(uint32_t*)Ptr,4)<<GPS_FIXED_POINT_DEG) / 190463;
+	Data->position.longitude = (180<<GPS_FIXED_POINT_DEG) - ((uint64_t)APRS_From91(Ptr,4)<<GPS_FIXED_POINT_DEG) / 190463;
 	Ptr+=4;
 	pos+=4;
 
@@ -429,7 +607,7 @@ static int APRS_Get_Compressed_Data(uint8_t *Ptr, APRS_Data_t *Data) {
 	if (*Ptr != ' ') {
 		if ((*(Ptr+3) & 0X18) == 0x10) {
 			// Altitude in feet
-			Data->position.altitude = (int16_t)(pow(1.002,APRS_From91(*(uint16_t*)Ptr,2)) + 0.5f);
+			Data->position.altitude = (int16_t)(pow(1.002,APRS_From91(Ptr,2)) + 0.5f);
 			Ptr+=2;
 			pos+=2;
 			ESP_LOGD(TAG,"Altitude %dft",Data->position.altitude);
@@ -465,6 +643,80 @@ static int APRS_Get_Compressed_Data(uint8_t *Ptr, APRS_Data_t *Data) {
 	return pos;
 }
 
+// Weather field : key char followed by width digits ('.' or ' ' if unknown)
+struct APRS_Wx_Field {
+	uint8_t width;		// Number of digits, 0 for unknown key
+	uint8_t field;		// enum APRS_WX_E
+	uint8_t offset;		// Offset in struct APRS_Weather
+	uint8_t size;		// Size of struct APRS_Weather member
+	int16_t add;		// Added to raw value
+};
+
+#define APRS_WX_FIELD(Width, Field, Member, Add) \
+	{Width, Field, offsetof(struct APRS_Weather, Member), sizeof(((struct APRS_Weather*)0)->Member), Add}
+
+// Indexed by key char
+static const struct APRS_Wx_Field APRS_Wx_Fields[128] = {
+	['c'] = APRS_WX_FIELD(3, APRS_WX_WIND_DIR, wind_dir, 0),
+	['g'] = APRS_WX_FIELD(3, APRS_WX_GUST, gust, 0),
+	['t'] = APRS_WX_FIELD(3, APRS_WX_TEMP, temp, 0),
+	['r'] = APRS_WX_FIELD(3, APRS_WX_RAIN_1H, rain_last_1h, 0),
+	['p'] = APRS_WX_FIELD(3, APRS_WX_RAIN_24H, rain_last_24h, 0),
+	['P'] = APRS_WX_FIELD(3, APRS_WX_RAIN_MIDNIGHT, rain_since_midnight, 0),
+	['h'] = APRS_WX_FIELD(2, APRS_WX_HUMIDITY, humidity, 0),
+	['b'] = APRS_WX_FIELD(5, APRS_WX_PRESSURE, pressure, 0),
+	['L'] = APRS_WX_FIELD(3, APRS_WX_LUMINOSITY, luminosity, 0),
+	['l'] = APRS_WX_FIELD(3, APRS_WX_LUMINOSITY, luminosity, 1000),
+	['s'] = APRS_WX_FIELD(3, APRS_WX_SNOW, snow_fall, 0),
+	['#'] = APRS_WX_FIELD(3, APRS_WX_RAIN_COUNTER, rain_counter, 0),
+};
+
+// 's' is wind speed right after 'c' in positionless report
+static const struct APRS_Wx_Field APRS_Wx_Wind_Speed = APRS_WX_FIELD(3, APRS_WX_WIND_SPEED, wind_speed, 0);
+
+static int APRS_Get_Weather_Field(const uint8_t *Ptr, const uint8_t *End, const struct APRS_Wx_Field *Field, struct APRS_Weather *Wx) {
+	int i, val, sign;
+
+	if (!Field->width || (End - Ptr) <= Field->width)
+		return -1;
+	Ptr++;
+
+	if (strspn((char*)Ptr, ". ") >= Field->width)	// Unknown value
+		return Field->width + 1;
+
+	sign = (*Ptr == '-') ? -1 : 1;
+	for (i = (sign < 0), val = 0; i < Field->width; i++) {
+		if (!isdigit(Ptr[i]))
+			return -1;
+		val = val*10 + (Ptr[i]-'0');
+	}
+	val = val*sign + Field->add;
+
+	if (Field->field == APRS_WX_HUMIDITY && !val)	// "h00" is 100%
+		val = 100;
+
+	if (Field->size == 1)
+		*((int8_t*)Wx + Field->offset) = val;
+	else
+		*(int16_t*)((uint8_t*)Wx + Field->offset) = val;
+	Wx->valid |= 1<<Field->field;
+
+	return Field->width + 1;
+}
+
+// Weather fields until first unknown key (software/unit type and comment follow)
+static int APRS_Get_Weather(const uint8_t *Ptr, const uint8_t *End, struct APRS_Weather *Wx) {
+	int pos = 0, ret;
+
+	while ((Ptr + pos) < End && Ptr[pos] < 128
+			&& (ret = APRS_Get_Weather_Field(Ptr + pos, End, &APRS_Wx_Fields[Ptr[pos]], Wx)) > 0)
+		pos += ret;
+
+	ESP_LOGD(TAG,"Weather fields %03x", Wx->valid);
+
+	return pos;
+}
+
 // Data extension for uncompressed position report
 static int APRS_Get_Pos_Extended_Data(uint8_t *Ptr, APRS_Data_t *Data) {
 	int pos = 0;
@@ -487,22 +739,14 @@ static int APRS_Get_Pos_Extended_Data(uint8_t *Ptr, APRS_Data_t *Data) {
 		if (n == 7) {
 			// Valid course/speed ( or wind dir/speed )
 			if (Data->extension == APRS_DATA_EXT_WTH) {
-				Data->weather.wind_dir = (*(Ptr++) -'0') * 100;
-				Data->weather.wind_dir = (*(Ptr++) -'0') * 10;
-				Data->weather.wind_dir = (*(Ptr++) -'0') * 10;
-				Ptr++;
-				Data->weather.wind_speed = (*(Ptr++) -'0') *100;
-				Data->weather.wind_speed = (*(Ptr++) -'0') *10;
-				Data->weather.wind_speed = (*(Ptr++) -'0') *1;
+				Data->weather.wind_dir = (Ptr[0]-'0')*100 + (Ptr[1]-'0')*10 + (Ptr[2]-'0');
+				Data->weather.wind_speed = (Ptr[4]-'0')*100 + (Ptr[5]-'0')*10 + (Ptr[6]-'0');
+				Data->weather.valid |= (1<<APRS_WX_WIND_DIR) | (1<<APRS_WX_WIND_SPEED);
 			} else {
-				Data->course.dir = (*(Ptr++) -'0') * 100;
-				Data->course.dir = (*(Ptr++) -'0') * 10;
-				Data->course.dir = (*(Ptr++) -'0') * 10;
-				Ptr++;
-				Data->course.speed = (*(Ptr++) -'0') *100;
-				Data->course.speed = (*(Ptr++) -'0') *10;
-				Data->course.speed = (*(Ptr++) -'0') *1;
+				Data->course.dir = (Ptr[0]-'0')*100 + (Ptr[1]-'0')*10 + (Ptr[2]-'0');
+				Data->course.speed = (Ptr[4]-'0')*100 + (Ptr[5]-'0')*10 + (Ptr[6]-'0');
 			}
+			Ptr += 7;
 			pos+=7;
 		} else if ( (!strncmp((char*)Ptr,"   ",3) && !strncmp((char*)Ptr+4,"   ",3)) ||
 			    (!strncmp((char*)Ptr,"...",3) && !strncmp((char*)Ptr+4,"...",3)) ) {
@@ -518,7 +762,7 @@ static int APRS_Get_Pos_Extended_Data(uint8_t *Ptr, APRS_Data_t *Data) {
 			Ptr+=7;
 		}
 
-		if (Data->extension && *Ptr == '/' && *(Ptr+4) == '/') {
+		if (Data->extension && *Ptr == '/' && strnlen((char*)Ptr, 5) == 5 && *(Ptr+4) == '/') {
 			if (Data->extension == APRS_DATA_EXT_CSE || Data->extension == APRS_DATA_EXT_CSE_NRQ) {
 				// Count number of digit
 				for (n=1;n<4 && isdigit(Ptr[n]);n++);
@@ -539,21 +783,21 @@ static int APRS_Get_Pos_Extended_Data(uint8_t *Ptr, APRS_Data_t *Data) {
 		
 	}
 
-	if (!Data->extension && !strncmp((char*)Ptr,"PHG",3)) {
+	if (!Data->extension && strnlen((char*)Ptr, 7) == 7 && !strncmp((char*)Ptr,"PHG",3)) {
 	       Data->extension = APRS_DATA_EXT_PHG;
 		ESP_LOGD(TAG,"PHG Found : not implemented");
 		Ptr+=7;
 		pos+=7;
 	}
        
-       if (!Data->extension && !strncmp((char*)Ptr,"RNG",3)) {
+       if (!Data->extension && strnlen((char*)Ptr, 7) == 7 && !strncmp((char*)Ptr,"RNG",3)) {
 	       Data->extension = APRS_DATA_EXT_RNG;
 		ESP_LOGD(TAG,"RNG Found : not implemented");
 		Ptr+=7;
 		pos+=7;
 	}
        
-       if (!Data->extension && !strncmp((char*)Ptr,"DFS",3)) {
+       if (!Data->extension && strnlen((char*)Ptr, 7) == 7 && !strncmp((char*)Ptr,"DFS",3)) {
 	       Data->extension = APRS_DATA_EXT_DFS;
 		ESP_LOGD(TAG,"DFS Found : not implemented");
 		Ptr+=7;
@@ -563,12 +807,259 @@ static int APRS_Get_Pos_Extended_Data(uint8_t *Ptr, APRS_Data_t *Data) {
 	return pos;
 }
 
-static int APRS_Parser_CUR_MICE_R0(int pos, Frame_t * Frame, APRS_Data_t * Data) {
-	return 0;
+// Mic-E type byte and status suffix to device
+static const struct APRS_Mice_Device_S {
+	char type;		// Type byte following symbol
+	const char * suffix;	// Suffix at end of status text
+	enum APRS_Mice_Device_E device;
+} APRS_Mice_Devices[] = {
+	{'>', "=", APRS_MICE_DEV_KENWOOD_TH_D72},
+	{'>', "^", APRS_MICE_DEV_KENWOOD_TH_D74},
+	{'>', "&", APRS_MICE_DEV_KENWOOD_TH_D75},
+	{'>', "", APRS_MICE_DEV_KENWOOD_TH_D7A},
+	{']', "=", APRS_MICE_DEV_KENWOOD_TM_D710},
+	{']', "", APRS_MICE_DEV_KENWOOD_TM_D700},
+	{'`', "_ ", APRS_MICE_DEV_YAESU_VX_8},
+	{'`', "_\"", APRS_MICE_DEV_YAESU_FTM_350},
+	{'`', "_#", APRS_MICE_DEV_YAESU_VX_8G},
+	{'`', "_$", APRS_MICE_DEV_YAESU_FT1D},
+	{'`', "_%", APRS_MICE_DEV_YAESU_FTM_400DR},
+	{'`', "_)", APRS_MICE_DEV_YAESU_FTM_100D},
+	{'`', "_(", APRS_MICE_DEV_YAESU_FT2D},
+	{'`', "_0", APRS_MICE_DEV_YAESU_FT3D},
+	{'`', "_1", APRS_MICE_DEV_YAESU_FTM_300D},
+	{'`', "_3", APRS_MICE_DEV_YAESU_FT5D},
+	{'`', "(5", APRS_MICE_DEV_ANYTONE_D578UV},
+	{'`', "(8", APRS_MICE_DEV_ANYTONE_D878UV},
+	{'\'', "|3", APRS_MICE_DEV_BYONICS_TT3},
+	{'\'', "|4", APRS_MICE_DEV_BYONICS_TT4},
+	{'\'', ":4", APRS_MICE_DEV_SCS_DR7400},
+	{'\'', ":8", APRS_MICE_DEV_SCS_DR7800},
+	{0, NULL, APRS_MICE_DEV_UNKNOWN}	// end marker
+};
+
+// Mic-E type bytes (first char of status text)
+#define APRS_MICE_TYPES ">]`'"
+
+static bool APRS_Mice_Is_Alt(uint8_t * Ptr, uint8_t * End) {
+	int i;
+
+	if ((End-Ptr) < 4 || Ptr[3] != '}')
+		return false;
+
+	for (i=0;i<3;i++)
+		if (Ptr[i] < '!' || Ptr[i] > '{')
+			return false;
+
+	return true;
 }
 
-static int APRS_Parser_OLD_MICE_R0(int pos, Frame_t * Frame, APRS_Data_t * Data) {
-	return 0;
+// Mic-E (current, old and rev 0) position report
+static int APRS_Parser_MICE(int pos, Frame_t * Frame, APRS_Data_t * Data) {
+	static const enum APRS_Ambiguity_E ambiguity[] = {
+		APRS_AMBIGUITY_NONE,
+		APRS_AMBIGUITY_TENTH_MIN,
+		APRS_AMBIGUITY_MIN,
+		APRS_AMBIGUITY_TEN_MIN,
+		APRS_AMBIGUITY_DEG,
+	};
+	const struct APRS_Mice_Device_S * dev;
+	uint8_t *ptr, *end;
+	uint8_t digit[6];
+	bool north, lon_off, west, custom;
+	int i, n, amb, msg, bit, len;
+	int deg, min, cent, speed, course;
+	int32_t alt;
+	char c, type;
+
+	ptr = &Frame->frame[pos];
+	end = &Frame->frame[Frame->frame_len-2];
+
+	if ((end-ptr) < 8) {
+		ESP_LOGE(TAG,"Mic-E information field too short");
+		return -1;
+	}
+
+	// Destination address : latitude, message bits and flags
+	amb = 0;
+	msg = 0;
+	custom = north = lon_off = west = false;
+	for (i=0;i<6;i++) {
+		c = Data->address[0].callid[i]>>1;
+		if (c >= '0' && c <= '9') {
+			n = c - '0';
+			bit = 0;
+		} else if (i < 3 && c >= 'A' && c <= 'J') {
+			n = c - 'A';
+			bit = 1;
+			custom = true;
+		} else if (i < 3 && c == 'K') {
+			n = -1;
+			bit = 1;
+			custom = true;
+		} else if (c == 'L') {
+			n = -1;
+			bit = 0;
+		} else if (c >= 'P' && c <= 'Y') {
+			n = c - 'P';
+			bit = 1;
+		} else if (c == 'Z') {
+			n = -1;
+			bit = 1;
+		} else {
+			ESP_LOGE(TAG,"Invalid Mic-E destination char '%c'",c);
+			return -1;
+		}
+
+		if (n < 0) {	// Position ambiguity
+			amb++;
+			n = 0;
+		}
+		digit[i] = n;
+
+		if (i < 3)
+			msg = (msg<<1) | bit;
+		else if (i == 3)
+			north = bit;
+		else if (i == 4)
+			lon_off = bit;
+		else
+			west = bit;
+	}
+
+	if (amb >= sizeof(ambiguity)/sizeof(ambiguity[0])) {
+		ESP_LOGE(TAG,"Invalid Mic-E position ambiguity");
+		return -1;
+	}
+
+	deg = digit[0]*10 + digit[1];
+	min = digit[2]*10 + digit[3];
+	cent = digit[4]*10 + digit[5];
+	if (deg > 89 || min > 59) {
+		ESP_LOGE(TAG,"Invalid Mic-E latitude");
+		return -1;
+	}
+
+	Data->position.ambiguity = ambiguity[amb];
+	Data->position.latitude = (deg<<GPS_FIXED_POINT_DEG) + (((int64_t)(min*100+cent)<<GPS_FIXED_POINT_DEG)/6000);
+	if (!north)
+		Data->position.latitude = -Data->position.latitude;
+
+	if (msg == 0)
+		Data->mice_msg = APRS_MICE_MSG_EMERGENCY;
+	else
+		Data->mice_msg = (7-msg) | (custom?APRS_MICE_MSG_CUSTOM:0);
+
+	// Information field : longitude
+	for (i=0;i<6;i++)
+		if (ptr[i] < 28 || ptr[i] > 127) {
+			ESP_LOGE(TAG,"Invalid Mic-E information field");
+			return -1;
+		}
+
+	deg = ptr[0] - 28;
+	if (lon_off)
+		deg += 100;
+	if (deg >= 180 && deg <= 189)
+		deg -= 80;
+	else if (deg >= 190 && deg <= 199)
+		deg -= 190;
+
+	min = ptr[1] - 28;
+	if (min >= 60)
+		min -= 60;
+
+	cent = ptr[2] - 28;
+
+	if (deg > 179 || min > 59 || cent > 99) {
+		ESP_LOGE(TAG,"Invalid Mic-E longitude");
+		return -1;
+	}
+
+	// Longitude ambiguity follow latitude one
+	if (amb >= 1)
+		cent -= cent%10;
+	if (amb >= 2)
+		cent = 0;
+	if (amb >= 3)
+		min -= min%10;
+	if (amb >= 4)
+		min = 0;
+
+	Data->position.longitude = (deg<<GPS_FIXED_POINT_DEG) + (((int64_t)(min*100+cent)<<GPS_FIXED_POINT_DEG)/6000);
+	if (west)
+		Data->position.longitude = -Data->position.longitude;
+
+	// Speed and course
+	speed = (ptr[3]-28)*10 + (ptr[4]-28)/10;
+	if (speed >= 800)
+		speed -= 800;
+	course = ((ptr[4]-28)%10)*100 + (ptr[5]-28);
+	if (course >= 400)
+		course -= 400;
+
+	Data->extension = APRS_DATA_EXT_CSE;
+	Data->course.speed = speed;
+	Data->course.dir = course;
+
+	// Symbol code then table
+	Data->symbol[1] = ptr[6];
+	Data->symbol[0] = ptr[7];
+	ptr += 8;
+
+	// Type byte, may be followed by altitude
+	type = 0;
+	if (ptr < end && *ptr && strchr(APRS_MICE_TYPES, *ptr) && (APRS_Mice_Is_Alt(ptr+1, end) || !APRS_Mice_Is_Alt(ptr, end)))
+		type = *(ptr++);
+
+	Data->messaging = (type == '>' || type == ']');
+
+	// Altitude (meters from -10000 in base 91)
+	if (APRS_Mice_Is_Alt(ptr, end)) {
+		alt = ((ptr[0]-'!')*91 + (ptr[1]-'!'))*91 + (ptr[2]-'!') - 10000;
+		alt = lroundf((float)alt * 3.28084f);	// feet
+		if (alt > INT16_MAX)
+			alt = INT16_MAX;
+		else if (alt < INT16_MIN)
+			alt = INT16_MIN;
+		Data->position.altitude = alt;
+		ptr += 4;
+	}
+
+	// Manufacturer suffix
+	Data->mice_device = APRS_MICE_DEV_UNKNOWN;
+	if (type) {
+		for (dev = APRS_Mice_Devices; dev->type; dev++) {
+			if (dev->type != type)
+				continue;
+			len = strlen(dev->suffix);
+			if ((end-ptr) >= len && !memcmp(end-len, dev->suffix, len)) {
+				Data->mice_device = dev->device;
+				end -= len;
+				break;
+			}
+		}
+	}
+
+	// Status text
+	len = end-ptr;
+	if (len > sizeof(Data->text)-1)
+		len = sizeof(Data->text)-1;
+	memcpy(Data->text, ptr, len);
+	Data->text[len] = '\0';
+
+	ESP_LOGD(TAG,"Mic-E : lon %f, lat %f, %d kn / %d°, alt %d ft, msg %d, device %d, symbol %c%c",
+			(float)Data->position.longitude/((float)(1<<GPS_FIXED_POINT_DEG)),
+			(float)Data->position.latitude/((float)(1<<GPS_FIXED_POINT_DEG)),
+			speed, course,
+			Data->position.altitude,
+			Data->mice_msg,
+			Data->mice_device,
+			Data->symbol[0],
+			Data->symbol[1]);
+
+	// Whole information field consumed
+	return Frame->frame_len-2-pos;
 }
 
 static int APRS_Parser_POS(int pos, Frame_t * Frame, APRS_Data_t * Data) {
@@ -591,7 +1082,18 @@ static int APRS_Parser_POS(int pos, Frame_t * Frame, APRS_Data_t * Data) {
 	} else
 		Data->messaging = false;
 
-	if (((pos+21)<Frame->frame_len) && (ret = APRS_Parser_Get_Position(&Frame->frame[pos],Data)) != -1) {
+	if ((ret = APRS_Get_Position_Report(pos, Frame, Data)) == -1)
+		return -1;
+
+	return i + ret;
+}
+
+// Uncompressed or compressed position with data extension
+static int APRS_Get_Position_Report(int pos, Frame_t * Frame, APRS_Data_t * Data) {
+	int ret, i = 0;
+
+	// 19 chars uncompressed or 13 chars compressed position, then crc
+	if (((pos+21)<=Frame->frame_len) && (ret = APRS_Parser_Get_Position(&Frame->frame[pos],Data)) != -1) {
 		// Uncompressed data format
 		pos+= ret;
 		i+=ret;
@@ -600,28 +1102,113 @@ static int APRS_Parser_POS(int pos, Frame_t * Frame, APRS_Data_t * Data) {
 			pos += ret;
 			i += ret;
 		}
-
-		// TODO : get weather extra data if Symbol[1] == '_'
-	} else if (((pos+16)<Frame->frame_len) && (ret = APRS_Get_Compressed_Data(&Frame->frame[pos],Data)) != -1) {
+	} else if (((pos+15)<=Frame->frame_len) && (ret = APRS_Get_Compressed_Data(&Frame->frame[pos],Data)) != -1) {
 		// Compressed data format
 		pos+=ret;
 		i+=ret;
+
+		// Course/speed is wind direction/speed (knot) for weather station
+		if (Data->symbol[1] == '_' && Data->extension == APRS_DATA_EXT_CSE) {
+			Data->extension = APRS_DATA_EXT_WTH;
+			Data->weather.wind_speed = lroundf(Data->weather.wind_speed * 1.15078f);
+			Data->weather.valid |= (1<<APRS_WX_WIND_DIR) | (1<<APRS_WX_WIND_SPEED);
+		}
 	} else
 		return -1;
 
+	// Weather report following position
+	if (Data->symbol[1] == '_') {
+		ret = APRS_Get_Weather(&Frame->frame[pos], &Frame->frame[Frame->frame_len-2], &Data->weather);
+		if (ret && Data->extension == APRS_DATA_EXT_NONE)
+			Data->extension = APRS_DATA_EXT_WEATHER;
+		i += ret;
+	}
+
 	return i;
 }
 
+// Raw NMEA sentence : "$GPRMC,...", "$GPGGA,..." or "$GPGLL,..."
 static int APRS_Parser_RAW_GPS(int pos, Frame_t * Frame, APRS_Data_t * Data) {
-	return 0;
-}
+	GPS_Data_t gps;
+	char *buff, *star;
+	int id, len;
 
-static int APRS_Parser_OLD_MICE_TMD700(int pos, Frame_t * Frame, APRS_Data_t * Data) {
-	return 0;
+	buff = (char*)&Frame->frame[pos-1];	// From '$'
+	len = Frame->frame_len-2 - (pos-1);
+
+	id = GPS_Parse(buff, len, &gps);
+	if (id != GPS_PARSER_RMC && id != GPS_PARSER_GGA && id != GPS_PARSER_GLL) {
+		ESP_LOGE(TAG,"Unsupported or invalid NMEA sentence");
+		return -1;
+	}
+
+	if (!GPS_IS_DATA_VALID(gps.valid, GPS_DATA_VALID_2D_FIX)
+			|| (GPS_IS_DATA_VALID(gps.valid, GPS_DATA_VALID_FIX_STATUS) && !gps.fix_status)) {
+		ESP_LOGE(TAG,"NMEA sentence without fix");
+		return -1;
+	}
+
+	Data->position.latitude = gps.latitude;
+	Data->position.longitude = gps.longitude;
+	if (gps.fix_status == GPS_FIX_STATUS_ESTIMATED)
+		Data->position.ambiguity = APRS_AMBIGUITY_TENTH_MIN;
+	else
+		Data->position.ambiguity = APRS_AMBIGUITY_NONE;
+
+	if (GPS_IS_DATA_VALID(gps.valid, GPS_DATA_VALID_ALTITUDE))	// Altitude in feet
+		Data->position.altitude = (((((int64_t)gps.altitude)*10000/(12*254)) + (1<<(GPS_FIXED_POINT-1))))>>GPS_FIXED_POINT;
+
+	if (GPS_IS_DATA_VALID(gps.valid, GPS_DATA_VALID_HEADING | GPS_DATA_VALID_SPEED_KN)) {
+		Data->course.speed = (gps.speed_kn + (1<<(GPS_FIXED_POINT-1))) >>GPS_FIXED_POINT;
+		Data->course.dir = (gps.heading +(1<<(GPS_FIXED_POINT-1))) >> GPS_FIXED_POINT;
+		Data->extension = APRS_DATA_EXT_CSE;
+	}
+
+	if (GPS_IS_DATA_VALID(gps.valid, GPS_DATA_VALID_TIME)) {
+		Data->time.hours = gps.time.hours;
+		Data->time.minutes = gps.time.minutes;
+		Data->time.seconds = gps.time.seconds;
+		if (GPS_IS_DATA_VALID(gps.valid, GPS_DATA_VALID_DATE)) {
+			Data->time.month = gps.date.month;
+			Data->time.day = gps.date.day;
+		}
+	}
+
+	ESP_LOGD(TAG,"NMEA %s position", gps.type);
+
+	// Sentence up to checksum, comment may follow
+	if ((star = memchr(buff, '*', len)) && (star+3) <= (buff+len))
+		return star+3 - (buff+1);
+
+	return len-1;
 }
 
+// Item : ")NAME!" (3-9 chars name, '!' live or '_' killed) and position
 static int APRS_Parser_ITEM(int pos, Frame_t * Frame, APRS_Data_t * Data) {
-	return 0;
+	uint8_t * ptr;
+	int len, ret;
+
+	ptr = &Frame->frame[pos];
+
+	for (len = 0; len < 10 && (pos+len) < (Frame->frame_len-2) && ptr[len] != '!' && ptr[len] != '_'; len++);
+	if (len < 3 || len > 9 || (pos+len) >= (Frame->frame_len-2)) {
+		ESP_LOGE(TAG,"Invalid item name");
+		return -1;
+	}
+
+	memcpy(Data->object_name, ptr, len);
+	Data->object_name[len] = '\0';
+	Data->object_killed = (ptr[len] == '_');
+	pos += len+1;
+
+	if ((ret = APRS_Get_Position_Report(pos, Frame, Data)) == -1) {
+		ESP_LOGE(TAG,"Error getting item position");
+		return -1;
+	}
+
+	ESP_LOGD(TAG,"Item %s %s", Data->object_name, Data->object_killed?"killed":"live");
+
+	return len + 1 + ret;
 }
 
 static int APRS_Parser_TEST(int pos, Frame_t * Frame, APRS_Data_t * Data) {
@@ -629,14 +1216,138 @@ static int APRS_Parser_TEST(int pos, Frame_t * Frame, APRS_Data_t * Data) {
 }
 
 static int APRS_Parser_MESSAGE(int pos, Frame_t * Frame, APRS_Data_t * Data) {
-	return 0;
+	struct APRS_Message * msg = &Data->message;
+	uint8_t *ptr, *end, *brace;
+	int len;
+
+	ptr = &Frame->frame[pos];
+	end = &Frame->frame[Frame->frame_len-2];
+
+	if ((end-ptr) < 10 || ptr[9] != ':') {
+		ESP_LOGE(TAG,"Invalid message addressee");
+		return -1;
+	}
+
+	// Addressee (9 chars, space padded)
+	memcpy(msg->addressee, ptr, 9);
+	len = 9;
+	while (len && msg->addressee[len-1] == ' ')
+		len--;
+	msg->addressee[len] = '\0';
+	ptr += 10;
+
+	if (!strncmp(msg->addressee, "BLN", 3) && isdigit((int)msg->addressee[3]))
+		msg->type = APRS_MSG_TYPE_BULLETIN;
+	else if (!strncmp(msg->addressee, "BLN", 3) && isupper((int)msg->addressee[3]))
+		msg->type = APRS_MSG_TYPE_ANNOUNCEMENT;
+	else if (!strncmp(msg->addressee, "NWS", 3))
+		msg->type = APRS_MSG_TYPE_BULLETIN;
+	else
+		msg->type = APRS_MSG_TYPE_MESSAGE;
+
+	// Ack or Rej
+	if (msg->type == APRS_MSG_TYPE_MESSAGE && (end-ptr) > 3 && (end-ptr) <= 9
+			&& (!strncmp((char*)ptr, "ack", 3) || !strncmp((char*)ptr, "rej", 3))) {
+		msg->type = (ptr[0] == 'a')?APRS_MSG_TYPE_ACK:APRS_MSG_TYPE_REJ;
+		ptr += 3;
+		for (len = 0; (ptr+len) < end && ptr[len] != '}' && len < sizeof(msg->id)-1; len++)
+			msg->id[len] = ptr[len];
+		msg->id[len] = '\0';
+		ptr += len;
+		// Reply-ack in ack ("ackMM}AA")
+		if (ptr < end && *ptr == '}') {
+			ptr++;
+			msg->reply_ack_cap = true;
+			for (len = 0; (ptr+len) < end && len < sizeof(msg->reply_ack)-1; len++)
+				msg->reply_ack[len] = ptr[len];
+			msg->reply_ack[len] = '\0';
+		}
+
+		ESP_LOGD(TAG,"%s %s for %s", msg->type==APRS_MSG_TYPE_ACK?"Ack":"Rej", msg->id, msg->addressee);
+
+		return Frame->frame_len-2-pos;
+	}
+
+	// Message number ("{MM" or reply-ack "{MM}AA")
+	brace = NULL;
+	if (msg->type != APRS_MSG_TYPE_BULLETIN && msg->type != APRS_MSG_TYPE_ANNOUNCEMENT)
+		for (brace = end-1; brace >= ptr && *brace != '{'; brace--);
+	if (brace && brace >= ptr && (end-brace) <= 12) {
+		uint8_t * id = brace+1;
+
+		for (len = 0; (id+len) < end && id[len] != '}' && len < sizeof(msg->id)-1; len++)
+			msg->id[len] = id[len];
+		msg->id[len] = '\0';
+		id += len;
+		if (id < end && *id == '}') {
+			id++;
+			msg->reply_ack_cap = true;
+			for (len = 0; (id+len) < end && len < sizeof(msg->reply_ack)-1; len++)
+				msg->reply_ack[len] = id[len];
+			msg->reply_ack[len] = '\0';
+		}
+	} else
+		brace = end;
+
+	// Message text
+	len = brace-ptr;
+	if (len > sizeof(msg->text)-1)
+		len = sizeof(msg->text)-1;
+	else {
+		Data->text_pos = ptr-Frame->frame;
+		Data->text_len = len;
+	}
+	memcpy(msg->text, ptr, len);
+	msg->text[len] = '\0';
+
+	ESP_LOGD(TAG,"Message to %s : %s {%s}%s", msg->addressee, msg->text, msg->id, msg->reply_ack);
+
+	return Frame->frame_len-2-pos;
 }
 
+// Object : ";NAME     *DDHHMMz" (9 chars name, '*' live or '_' killed) and position
 static int APRS_Parser_OBJECT(int pos, Frame_t * Frame, APRS_Data_t * Data) {
-	return 0;
+	uint8_t * ptr;
+	int len, ret;
+
+	ptr = &Frame->frame[pos];
+
+	if ((pos+17) >= Frame->frame_len-2 || (ptr[9] != '*' && ptr[9] != '_')) {
+		ESP_LOGE(TAG,"Invalid object name");
+		return -1;
+	}
+
+	memcpy(Data->object_name, ptr, 9);
+	len = 9;
+	while (len && Data->object_name[len-1] == ' ')
+		len--;
+	Data->object_name[len] = '\0';
+	Data->object_killed = (ptr[9] == '_');
+	pos += 10;
+
+	if ((ret = APRS_Get_Time(&Frame->frame[pos], Data)) != 7) {
+		ESP_LOGE(TAG,"Error getting object timestamp");
+		return -1;
+	}
+	pos += ret;
+
+	if ((ret = APRS_Get_Position_Report(pos, Frame, Data)) == -1) {
+		ESP_LOGE(TAG,"Error getting object position");
+		return -1;
+	}
+
+	ESP_LOGD(TAG,"Object %s %s", Data->object_name, Data->object_killed?"killed":"live");
+
+	return 10 + 7 + ret;
 }
 
+// Station capabilities : "<IGATE,MSG_CNT=n,LOC_CNT=n", token list kept as text
 static int APRS_Parser_STATION_CAP(int pos, Frame_t * Frame, APRS_Data_t * Data) {
+	if (pos >= Frame->frame_len-2 || !isalnum(Frame->frame[pos])) {
+		ESP_LOGE(TAG,"Empty station capabilities");
+		return -1;
+	}
+
 	return 0;
 }
 
@@ -659,7 +1370,8 @@ static int APRS_Parser_STATUS(int pos, Frame_t * Frame, APRS_Data_t * Data) {
 		|| ((Frame->frame_len  > pos+11) && (*(Frame->frame+pos+8) == ' ') && (ret = APRS_Get_Locator(Frame->frame+pos,Data))==8) ) {
 		pos += ret+1; // status with locator and comment
 		ret++;
-	}
+	} else
+		ret = 0; // status text only
 	
 	// Meteor scatter beam heading and ERP
 	if (Frame->frame[Frame->frame_len-5] == '^') {
@@ -683,31 +1395,340 @@ static int APRS_Parser_STATUS(int pos, Frame_t * Frame, APRS_Data_t * Data) {
 	return ret;
 }
 
+// Coordinate of query footprint : "ddmm.mmN" or "dddmm.mmW"
+static int APRS_Get_Footprint_Coord(char * Ptr, char Pos, char Neg, int32_t * Coord) {
+	int ret;
+
+	if ((ret = GPS_Parser_Get_Coord(Coord, Ptr)) == -1)
+		return -1;
+	if (Ptr[ret] == Neg)
+		*Coord = -*Coord;
+	else if (Ptr[ret] != Pos)
+		return -1;
+
+	return ret+1;
+}
+
+// General query : "?APRS?" with optional footprint " ddmm.mmN dddmm.mmW rrrr"
 static int APRS_Parser_QUERY(int pos, Frame_t * Frame, APRS_Data_t * Data) {
-	return 0;
+	struct APRS_Query * query = &Data->query;
+	char *ptr, *start;
+	int i, ret;
+
+	start = ptr = (char*)&Frame->frame[pos];
+
+	for (i=0; i<sizeof(query->name)-1 && isalnum((int)ptr[i]); i++)
+		query->name[i] = toupper((int)ptr[i]);
+	query->name[i] = '\0';
+
+	if (!i || ptr[i] != '?') {
+		ESP_LOGE(TAG,"Invalid query");
+		return -1;
+	}
+	ptr += i+1;
+
+	// Target footprint
+	if (*ptr == ' ') {
+		if ((ret = APRS_Get_Footprint_Coord(ptr+1, 'N', 'S', &query->center.latitude)) != -1
+				&& ptr[ret+1] == ' '
+				&& (i = APRS_Get_Footprint_Coord(ptr+ret+2, 'E', 'W', &query->center.longitude)) != -1
+				&& ptr[ret+i+2] == ' ' && isdigit((int)ptr[ret+i+3])) {
+			ptr += ret+i+3;
+			query->radius = strtol(ptr, &ptr, 10);
+			query->footprint = true;
+		} else
+			ESP_LOGW(TAG,"Invalid query footprint");
+	}
+
+	ESP_LOGD(TAG,"Query %s%s", query->name, query->footprint?" with footprint":"");
+
+	return ptr - start;
 }
 
+// Telemetry : "T#sss,aaa,aaa,aaa,aaa,aaa,bbbbbbbb"
 static int APRS_Parser_TELEMETRIE(int pos, Frame_t * Frame, APRS_Data_t * Data) {
-	return 0;
+	struct APRS_Telemetry * tlm = &Data->telemetry;
+	char *ptr, *start, *end, *next;
+	float val;
+	int i;
+
+	start = ptr = (char*)&Frame->frame[pos];
+	end = (char*)&Frame->frame[Frame->frame_len-2];
+
+	if ((end-ptr) < 5 || ptr[0] != '#') {
+		ESP_LOGE(TAG,"Invalid telemetry");
+		return -1;
+	}
+	ptr++;
+
+	// Sequence number
+	if (!strncmp(ptr, "MIC", 3)) {
+		tlm->seq = -1;
+		ptr += 3;
+	} else {
+		tlm->seq = strtol(ptr, &next, 10);
+		if (next == ptr) {
+			ESP_LOGE(TAG,"Invalid telemetry sequence");
+			return -1;
+		}
+		ptr = next;
+	}
+	if (ptr < end && *ptr == ',')
+		ptr++;
+
+	// Analog values
+	for (i = 0; i < APRS_TLM_ANALOG && ptr < end; i++) {
+		if (*ptr == ',') {	// Empty field
+			tlm->analog[i] = 0;
+			ptr++;
+			continue;
+		}
+		if (strspn(ptr, "01") >= APRS_TLM_BITS)	// Digital field
+			break;
+		val = strtof(ptr, &next);
+		if (next == ptr || next > end)
+			break;
+		tlm->analog[i] = val;
+		ptr = next;
+		if (ptr < end && *ptr == ',')
+			ptr++;
+		else {
+			i++;
+			break;
+		}
+	}
+	tlm->n_analog = i;
+
+	// Digital values
+	if ((end-ptr) >= APRS_TLM_BITS && strspn(ptr, "01") >= APRS_TLM_BITS) {
+		tlm->bits = 0;
+		for (i = 0; i < APRS_TLM_BITS; i++)
+			tlm->bits = (tlm->bits<<1) | (ptr[i] - '0');
+		tlm->has_bits = true;
+		ptr += APRS_TLM_BITS;
+	}
+
+	ESP_LOGD(TAG,"Telemetry %d : %d analog, bits %02x", tlm->seq, tlm->n_analog, tlm->bits);
+
+	return ptr - start;
 }
 
+// Maidenhead locator beacon : "[IO91SX] comment"
 static int APRS_Parser_MH_LOCATOR(int pos, Frame_t * Frame, APRS_Data_t * Data) {
-	return 0;
+	int ret;
+
+	if ((ret = APRS_Get_Locator(&Frame->frame[pos], Data)) == -1)
+		return -1;
+
+	if ((pos+ret) >= (Frame->frame_len-2) || Frame->frame[pos+ret] != ']') {
+		ESP_LOGE(TAG,"Invalid locator beacon");
+		return -1;
+	}
+
+	return ret+1;
 }
 
+// Positionless weather : "_MMDDHHMMc...s...g...t...r...p...P...h..b....."
 static int APRS_Parser_WEATHER(int pos, Frame_t * Frame, APRS_Data_t * Data) {
-	return 0;
+	uint8_t *ptr = &Frame->frame[pos];
+	uint8_t *end = &Frame->frame[Frame->frame_len-2];
+	int i, ret;
+
+	if ((end - ptr) < 8 || (i = APRS_Get_Time(ptr, Data)) != 8) {
+		ESP_LOGE(TAG,"Invalid weather report timestamp");
+		return -1;
+	}
+
+	// Wind direction and speed
+	if (ptr[i] == 'c' && (ret = APRS_Get_Weather_Field(ptr+i, end, &APRS_Wx_Fields['c'], &Data->weather)) > 0)
+		i += ret;
+	if (ptr[i] == 's' && (ret = APRS_Get_Weather_Field(ptr+i, end, &APRS_Wx_Wind_Speed, &Data->weather)) > 0)
+		i += ret;
+
+	i += APRS_Get_Weather(ptr+i, end, &Data->weather);
+
+	Data->extension = APRS_DATA_EXT_WEATHER;
+
+	return i;
 }
 
-static int APRS_Parser_CUR_MICE(int pos, Frame_t * Frame, APRS_Data_t * Data) {
+static int APRS_Parser_USER_DEF(int pos, Frame_t * Frame, APRS_Data_t * Data) {
 	return 0;
 }
 
-static int APRS_Parser_USER_DEF(int pos, Frame_t * Frame, APRS_Data_t * Data) {
+// TNC2 address : "CALL[-SSID][*]", fails if not a valid AX25 address
+static int APRS_Get_Tnc2_Addr(const char * Str, int Len, AX25_Addr_t * Addr) {
+	int i, n, ssid = 0;
+
+	if (Len && Str[Len-1] == '*') {
+		Addr->ssid = 0x80;	// Has been repeated
+		Len--;
+	} else
+		Addr->ssid = 0;
+
+	for (i = 0; i < Len && i < 6 && isalnum((int)Str[i]); i++)
+		Addr->addr[i] = toupper((int)Str[i])<<1;
+	if (!i)
+		return -1;
+
+	if (i < Len) {
+		if (Str[i] != '-' || (Len-i) < 2 || (Len-i) > 3)
+			return -1;
+		for (n = i+1; n < Len; n++) {
+			if (!isdigit((int)Str[n]))
+				return -1;
+			ssid = ssid*10 + Str[n]-'0';
+		}
+		if (ssid > 15)
+			return -1;
+	}
+
+	for (; i < 6; i++)
+		Addr->addr[i] = ' '<<1;
+	Addr->ssid |= 0x60 | (ssid<<1);
+
 	return 0;
 }
 
+// Third-party : "}SRC>DST,PATH*:payload", inner frame re-dispatched through APRS_Parse
 static int APRS_Parser_THIRD_PARTY(int pos, Frame_t * Frame, APRS_Data_t * Data) {
-	return 0;
+	union {
+		Frame_t frame;
+		uint8_t buff[sizeof(Frame_t) + (2+APRS_MAX_DIGI)*sizeof(AX25_Addr_t) + 2 + 2];
+	} * inner;
+	AX25_Addr_t gateway;
+	char *ptr, *end, *hdr, *sep;
+	int depth, n_addr, len;
+
+	gateway = Data->address[1];
+	ptr = (char*)&Frame->frame[pos];
+	end = (char*)&Frame->frame[Frame->frame_len-2];
+
+	// Unwrap nested headers, only innermost header is kept
+	for (depth = 1; ; depth++) {
+		hdr = ptr;
+		if (!(ptr = memchr(hdr, ':', end-hdr))) {
+			ESP_LOGE(TAG,"Third-party header without payload");
+			return -1;
+		}
+		ptr++;
+		if (ptr >= end || *ptr != APRS_DTI_THIRD_PARTY)
+			break;
+		if (depth == APRS_MAX_THIRD_PARTY) {
+			ESP_LOGE(TAG,"Third-party headers too deeply nested");
+			return -1;
+		}
+		ptr++;
+	}
+
+	if (ptr >= end) {
+		ESP_LOGE(TAG,"Third-party payload empty");
+		return -1;
+	}
+
+	len = end - ptr;
+	if (!(inner = malloc(sizeof(*inner) + len))) {
+		ESP_LOGE(TAG,"Error allocating third-party frame");
+		return -1;
+	}
+	bzero(inner, sizeof(*inner) + len);
+
+	// Source, destination then path
+	n_addr = 0;
+	if (!(sep = memchr(hdr, '>', ptr-1-hdr)) || APRS_Get_Tnc2_Addr(hdr, sep-hdr, (AX25_Addr_t*)&inner->frame.frame[7])) {
+		ESP_LOGE(TAG,"Invalid third-party source");
+		free(inner);
+		return -1;
+	}
+	hdr = sep+1;
+	do {
+		for (sep = hdr; sep < ptr-1 && *sep != ','; sep++);
+		if (!APRS_Get_Tnc2_Addr(hdr, sep-hdr, (AX25_Addr_t*)&inner->frame.frame[n_addr*sizeof(AX25_Addr_t)])) {
+			n_addr = n_addr?n_addr+1:2;
+		} else if (!n_addr) {
+			ESP_LOGE(TAG,"Invalid third-party destination");
+			free(inner);
+			return -1;
+		}
+		// Non AX25 path element (q construct, long name) are dropped
+		hdr = sep+1;
+	} while (sep < ptr-1 && n_addr < (2+APRS_MAX_DIGI));
+	inner->frame.frame[n_addr*sizeof(AX25_Addr_t)-1] |= 1;	// Last address
+
+	len = n_addr*sizeof(AX25_Addr_t);
+	inner->frame.frame[len++] = 0x03;	// UI
+	inner->frame.frame[len++] = 0xf0;	// No layer 3
+	memcpy(&inner->frame.frame[len], ptr, end-ptr);
+	len += end-ptr;
+	inner->frame.frame_len = len + 2;	// + crc
+	inner->frame.frame_size = inner->frame.frame_len;
+
+	if (APRS_Parse(&inner->frame, Data) == -1) {
+		ESP_LOGE(TAG,"Invalid third-party payload");
+		free(inner);
+		return -1;
+	}
+	free(inner);
+
+	// Text offset in outer frame
+	if (Data->text_pos)
+		Data->text_pos += (uint8_t*)ptr-Frame->frame - (n_addr*sizeof(AX25_Addr_t)+2);
+
+	Data->third_party = depth;
+	Data->gateway = gateway;
+
+	// Whole frame consumed, comment already in inner data
+	return Frame->frame_len-2-pos;
 }
 
+int APRS_Locator_To_Position(char * Locator, int Len, struct APRS_Position * Pos) {
+	int n_pair, base, c_lon, c_lat;
+	int64_t lon, lat, mult;
+
+	if (Len&1 || Len < 2)
+		return -1;
+
+	lon = lat = 0;
+	mult = 1;
+	for (n_pair = 0; (n_pair<<1) < Len; n_pair++) {
+		c_lon = toupper((int)Locator[n_pair<<1]);
+		c_lat = toupper((int)Locator[(n_pair<<1)+1]);
+		if (n_pair & 1) {	// Square or extended square : digits
+			base = 10;
+			c_lon -= '0';
+			c_lat -= '0';
+		} else {		// Field (A-R) or subsquare (A-X)
+			base = n_pair ? 24 : 18;
+			c_lon -= 'A';
+			c_lat -= 'A';
+		}
+		if (c_lon < 0 || c_lon >= base || c_lat < 0 || c_lat >= base)
+			return -1;
+		lon = lon*base + c_lon;
+		lat = lat*base + c_lat;
+		mult *= base;
+	}
+
+	// Center of the square
+	lon = lon*2 + 1;
+	lat = lat*2 + 1;
+	mult *= 2;
+
+	Pos->longitude = ((lon*360)<<GPS_FIXED_POINT_DEG)/mult - (180<<GPS_FIXED_POINT_DEG);
+	Pos->latitude = ((lat*180)<<GPS_FIXED_POINT_DEG)/mult - (90<<GPS_FIXED_POINT_DEG);
+	
+	if (n_pair > 4) {
+			ESP_LOGW(TAG,"Locator precision > extended square");
+			Pos->ambiguity = APRS_AMBIGUITY_LOC_EXT_SQUARE;
+	} else if (n_pair == 4)
+		Pos->ambiguity = APRS_AMBIGUITY_LOC_EXT_SQUARE;
+	else if (n_pair == 3)
+		Pos->ambiguity = APRS_AMBIGUITY_LOC_SUBSQUARE;
+	else if (n_pair == 2)
+		Pos->ambiguity = APRS_AMBIGUITY_LOC_SQUARE;
+	else if (n_pair == 1)
+		Pos->ambiguity = APRS_AMBIGUITY_LOC_FIELD;
+	else Pos->ambiguity = APRS_AMBIGUITY_MAX;
+
+	return n_pair<<1;
+}
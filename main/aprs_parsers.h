@@ -24,9 +24,27 @@
 #ifndef _APRS_PARSERS_
 #define _APRS_PARSERS_
 
+#include <stdint.h>
+#include <stddef.h>
+
 typedef struct Framebuff_Frame_S Frame_t;
 typedef struct APRS_Data_S APRS_Data_t;
+typedef struct APRS_Event_Data_S APRS_Event_Data_t;
+
+// Per parser cost (CONFIG_ESP32S3APRS_APRS_PARSE_STATS)
+typedef struct APRS_Parse_Stats_S {
+	char type;		// DTI, '\0' for unknown DTI
+	uint32_t count;		// Frames seen
+	uint32_t errors;	// Frames rejected
+	uint64_t time;		// Total parse time (us), nested third party frames included
+	uint32_t max_time;	// Slowest frame (us)
+} APRS_Parse_Stats_t;
 
 int APRS_Parse(Frame_t * Frame, APRS_Data_t * Data);
+int APRS_Event_Init(APRS_Event_Data_t * Event, Frame_t * Frame, const APRS_Data_t * Data);
+int APRS_Event_Decode(const APRS_Event_Data_t * Event, APRS_Data_t * Data);
+int APRS_Event_Text(const APRS_Event_Data_t * Event, char * Buff, size_t Size);
+int APRS_Get_Parse_Stats(APRS_Parse_Stats_t * Stats, int Max);
+void APRS_Log_Parse_Stats(void);
 
 #endif
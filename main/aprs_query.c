@@ -0,0 +1,221 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * main/aprs_query.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include <esp_log.h>
+
+#include "aprs_query.h"
+
+#define TAG "APRS_QUERY"
+
+// Last reply to a requester
+typedef struct APRS_Query_Req_S {
+	time_t timestamp;
+	AX25_Addr_t from;
+	uint8_t reply;
+} APRS_Query_Req_t;
+
+// Scheduled reply
+typedef struct APRS_Query_Pending_S {
+	bool used;
+	uint8_t reply;
+	time_t due;
+	AX25_Addr_t to;
+	char text[68];
+} APRS_Query_Pending_t;
+
+struct APRS_Query_S {
+	APRS_Query_Clock_t clock;
+	APRS_Query_Send_t send;
+	void * ctx;
+	uint32_t rnd;		// xorshift state for reply jitter
+
+	APRS_Query_Req_t req[APRS_QUERY_MAX_REQ];
+	APRS_Query_Pending_t pending[APRS_QUERY_MAX_PENDING];
+};
+
+// Query name to reply, general queries are "?NAME?", directed ones are in a message
+static const struct APRS_Query_Map_S {
+	const char * name;
+	bool directed;
+	uint8_t reply;
+} APRS_Query_Map[] = {
+	{"APRS", false, APRS_QUERY_REPLY_POSITION},
+	{"WX", false, APRS_QUERY_REPLY_POSITION},
+	{"IGATE", false, APRS_QUERY_REPLY_CAPABILITIES},
+	{"PING", false, APRS_QUERY_REPLY_TRACE},
+	{"APRSP", true, APRS_QUERY_REPLY_POSITION},
+	{"APRSS", true, APRS_QUERY_REPLY_STATUS},
+	{"APRST", true, APRS_QUERY_REPLY_TRACE},
+	{"PING", true, APRS_QUERY_REPLY_TRACE},
+	{NULL, false, APRS_QUERY_REPLY_MAX}
+};
+
+static time_t APRS_Query_Default_Clock(void * Ctx) {
+	return time(NULL);
+}
+
+APRS_Query_t * APRS_Query_Init(APRS_Query_Clock_t Clock, APRS_Query_Send_t Send, void * Ctx, uint32_t Seed) {
+	APRS_Query_t * query;
+
+	if (!Send)
+		return NULL;
+
+	if (!(query = malloc(sizeof(APRS_Query_t)))) {
+		ESP_LOGE(TAG,"Error allocating query struct");
+		return NULL;
+	}
+	bzero(query, sizeof(APRS_Query_t));
+
+	query->clock = Clock?Clock:APRS_Query_Default_Clock;
+	query->send = Send;
+	query->ctx = Ctx;
+	query->rnd = Seed?Seed:1;
+
+	return query;
+}
+
+// Query name ("APRS", "?APRSP", "PING?" ...) to reply type, -1 if not supported
+int APRS_Query_Reply_Type(const char * Query, bool Directed) {
+	char name[8];
+	int i;
+
+	if (!Query)
+		return -1;
+
+	if (*Query == '?')
+		Query++;
+	for (i=0; i<sizeof(name)-1 && isalnum((int)Query[i]); i++)
+		name[i] = toupper((int)Query[i]);
+	name[i] = '\0';
+
+	for (i=0; APRS_Query_Map[i].name; i++)
+		if (APRS_Query_Map[i].directed == Directed && !strcmp(APRS_Query_Map[i].name, name))
+			return APRS_Query_Map[i].reply;
+
+	return -1;
+}
+
+static uint32_t APRS_Query_Random(APRS_Query_t * Query) {
+	uint32_t x = Query->rnd;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+
+	return Query->rnd = x;
+}
+
+// Schedule a reply, 0 if scheduled, 1 if rate limited or merged with a pending one
+int APRS_Query_Request(APRS_Query_t * Query, enum APRS_Query_Reply_E Reply, const AX25_Addr_t * Requester, const char * Text) {
+	APRS_Query_Req_t * req = NULL;
+	APRS_Query_Pending_t * pending = NULL;
+	time_t now;
+	int i;
+
+	if (!Query || !Requester || Reply >= APRS_QUERY_REPLY_MAX)
+		return -1;
+
+	now = Query->clock(Query->ctx);
+
+	// Per requester rate limit, reuse oldest entry
+	for (i=0; i<APRS_QUERY_MAX_REQ; i++) {
+		APRS_Query_Req_t * r = &Query->req[i];
+		if (r->timestamp && r->reply == Reply && !AX25_Addr_Cmp(&r->from, Requester)) {
+			req = r;
+			break;
+		}
+		if (!req || r->timestamp < req->timestamp)
+			req = r;
+	}
+
+	if (req->timestamp && req->reply == Reply && !AX25_Addr_Cmp(&req->from, Requester)
+			&& (now - req->timestamp) < APRS_QUERY_MIN_INTERVAL) {
+		ESP_LOGD(TAG,"Query rate limited");
+		return 1;
+	}
+
+	req->timestamp = now;
+	req->from = *Requester;
+	req->reply = Reply;
+
+	// Broadcast replies answer every pending requester at once
+	for (i=0; i<APRS_QUERY_MAX_PENDING; i++) {
+		APRS_Query_Pending_t * p = &Query->pending[i];
+		if (p->used && p->reply == Reply && Reply != APRS_QUERY_REPLY_TRACE) {
+			ESP_LOGD(TAG,"Query merged with pending reply");
+			return 1;
+		}
+		if (!p->used && !pending)
+			pending = p;
+	}
+
+	if (!pending) {
+		ESP_LOGW(TAG,"Too many pending query replies");
+		return -1;
+	}
+
+	bzero(pending, sizeof(APRS_Query_Pending_t));
+	pending->used = true;
+	pending->reply = Reply;
+	pending->to = *Requester;
+	if (Text)
+		strncpy(pending->text, Text, sizeof(pending->text)-1);
+
+	// Random delay so several stations do not reply at once
+	pending->due = now + APRS_QUERY_MIN_JITTER
+		+ APRS_Query_Random(Query) % (APRS_QUERY_MAX_JITTER - APRS_QUERY_MIN_JITTER + 1);
+
+	return 0;
+}
+
+// Send due replies, return seconds until next one or -1 if none pending
+int APRS_Query_Process(APRS_Query_t * Query) {
+	time_t now;
+	int i, wait = -1;
+
+	if (!Query)
+		return -1;
+
+	now = Query->clock(Query->ctx);
+
+	for (i=0; i<APRS_QUERY_MAX_PENDING; i++) {
+		APRS_Query_Pending_t * p = &Query->pending[i];
+		if (!p->used)
+			continue;
+		if (p->due <= now) {
+			if (Query->send(Query->ctx, p->reply, &p->to, p->text))
+				ESP_LOGE(TAG,"Error sending query reply");
+			p->used = false;
+			continue;
+		}
+		if (wait < 0 || (p->due - now) < wait)
+			wait = p->due - now;
+	}
+
+	return wait;
+}
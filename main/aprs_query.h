@@ -0,0 +1,59 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * main/aprs_query.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _APRS_QUERY_H_
+#define _APRS_QUERY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "ax25.h"
+
+#define APRS_QUERY_MAX_REQ	8	// Requesters tracked for rate limiting
+#define APRS_QUERY_MAX_PENDING	4	// Scheduled replies
+#define APRS_QUERY_MIN_INTERVAL	300	// Min delay between replies of same kind to a requester (s)
+#define APRS_QUERY_MIN_JITTER	2	// Reply delay lower bound (s)
+#define APRS_QUERY_MAX_JITTER	30	// Reply delay upper bound (s)
+
+enum APRS_Query_Reply_E {
+	APRS_QUERY_REPLY_POSITION,	// ?APRS? ?WX? ?APRSP : position report
+	APRS_QUERY_REPLY_STATUS,	// ?APRSS : status report
+	APRS_QUERY_REPLY_CAPABILITIES,	// ?IGATE? : station capabilities
+	APRS_QUERY_REPLY_TRACE,		// ?APRST ?PING? : route message to requester
+	APRS_QUERY_REPLY_MAX
+};
+
+typedef struct APRS_Query_S APRS_Query_t;
+
+// Time source (seconds), injectable for host testing
+typedef time_t (*APRS_Query_Clock_t)(void * Ctx);
+// Transmit a reply, Text is the route for trace reply
+typedef int (*APRS_Query_Send_t)(void * Ctx, enum APRS_Query_Reply_E Reply, const AX25_Addr_t * Requester, const char * Text);
+
+APRS_Query_t * APRS_Query_Init(APRS_Query_Clock_t Clock, APRS_Query_Send_t Send, void * Ctx, uint32_t Seed);
+int APRS_Query_Reply_Type(const char * Query, bool Directed);
+int APRS_Query_Request(APRS_Query_t * Query, enum APRS_Query_Reply_E Reply, const AX25_Addr_t * Requester, const char * Text);
+int APRS_Query_Process(APRS_Query_t * Query);
+
+#endif
@@ -0,0 +1,251 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * main/aprs_telemetry.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <esp_log.h>
+
+#include "aprs.h"
+#include "aprs_telemetry.h"
+
+#define TAG "APRS_TELEMETRY"
+
+// Telemetry table : fixed pool of stations, oldest one reused when full
+struct APRS_Telemetries_S {
+	uint16_t size;
+	uint16_t count;
+	APRS_Tlm_t * tlm;
+};
+
+APRS_Telemetries_t * APRS_Telemetry_Init(int Size) {
+	APRS_Telemetries_t * tlms;
+
+	if (Size <= 0 || Size > 0xffff)
+		return NULL;
+
+	if (!(tlms = malloc(sizeof(APRS_Telemetries_t)))) {
+		ESP_LOGE(TAG,"Error allocating telemetry table");
+		return NULL;
+	}
+	bzero(tlms, sizeof(APRS_Telemetries_t));
+
+	if (!(tlms->tlm = malloc(Size * sizeof(APRS_Tlm_t)))) {
+		ESP_LOGE(TAG,"Error allocating %d telemetry stations", Size);
+		free(tlms);
+		return NULL;
+	}
+	bzero(tlms->tlm, Size * sizeof(APRS_Tlm_t));
+
+	tlms->size = Size;
+
+	return tlms;
+}
+
+static void APRS_Telemetry_Reset(APRS_Tlm_t * Tlm, const AX25_Addr_t * Callid) {
+	int i;
+
+	bzero(Tlm, sizeof(APRS_Tlm_t));
+	Tlm->callid = *Callid;
+	for (i = 0; i < APRS_TLM_ANALOG; i++)
+		Tlm->eqns[i][1] = 1;	// Identity : 0*x^2 + 1*x + 0
+	Tlm->bits_sense = 0xff;
+}
+
+static APRS_Tlm_t * APRS_Telemetry_Find(APRS_Telemetries_t * Tlms, const AX25_Addr_t * Callid) {
+	int i;
+
+	for (i = 0; i < Tlms->count; i++)
+		if (!AX25_Addr_Cmp(&Tlms->tlm[i].callid, Callid))
+			return &Tlms->tlm[i];
+
+	return NULL;
+}
+
+static APRS_Tlm_t * APRS_Telemetry_Alloc(APRS_Telemetries_t * Tlms, const AX25_Addr_t * Callid) {
+	APRS_Tlm_t * tlm;
+	int i;
+
+	if ((tlm = APRS_Telemetry_Find(Tlms, Callid)))
+		return tlm;
+
+	if (Tlms->count < Tlms->size)
+		tlm = &Tlms->tlm[Tlms->count++];
+	else {
+		tlm = &Tlms->tlm[0];
+		for (i = 1; i < Tlms->count; i++)
+			if (Tlms->tlm[i].timestamp < tlm->timestamp)
+				tlm = &Tlms->tlm[i];
+		ESP_LOGD(TAG,"Table full, reusing oldest station");
+	}
+
+	APRS_Telemetry_Reset(tlm, Callid);
+
+	return tlm;
+}
+
+// Add a "T#" report to the sending station ring
+int APRS_Telemetry_Update(APRS_Telemetries_t * Tlms, const APRS_Data_t * Data) {
+	const struct APRS_Telemetry * data = &Data->telemetry;
+	APRS_Tlm_Point_t * point;
+	AX25_Addr_t addr;
+	APRS_Tlm_t * tlm;
+	int i;
+
+	if (!Tlms || !Data || Data->type != APRS_DTI_TELEMETRIE)
+		return -1;
+
+	addr = Data->address[1];
+	AX25_Norm_Addr(&addr);
+
+	if (!(tlm = APRS_Telemetry_Alloc(Tlms, &addr)))
+		return -1;
+
+	point = &tlm->ring[tlm->head];
+	point->timestamp = Data->timestamp;
+	point->seq = data->seq;
+	point->bits = data->has_bits ? data->bits : 0;
+	for (i = 0; i < APRS_TLM_ANALOG; i++)
+		point->analog[i] = (i < data->n_analog) ? data->analog[i] : 0;
+
+	tlm->head = (tlm->head + 1) % APRS_TLM_RING;
+	if (tlm->count < APRS_TLM_RING)
+		tlm->count++;
+	tlm->timestamp = Data->timestamp;
+
+	return 0;
+}
+
+// Split a comma separated list into fixed size labels
+static void APRS_Telemetry_Labels(const char * Text, char (*Labels)[8], int Max) {
+	const char * end;
+	int i, len;
+
+	for (i = 0; i < Max && *Text; i++) {
+		end = strchr(Text, ',');
+		len = end ? end - Text : strlen(Text);
+		if (len > 7)
+			len = 7;
+		memcpy(Labels[i], Text, len);
+		Labels[i][len] = '\0';
+		if (!end)
+			break;
+		Text = end + 1;
+	}
+}
+
+// Station definition message sent to itself : "PARM.", "UNIT.", "EQNS." or "BITS."
+int APRS_Telemetry_Define(APRS_Telemetries_t * Tlms, const char * Callid, const char * Text, time_t Timestamp) {
+	AX25_Addr_t addr;
+	APRS_Tlm_t * tlm;
+	char * next;
+	int i, len;
+
+	if (!Tlms || !Callid || !Text)
+		return -1;
+
+	if (strncmp(Text, "PARM.", 5) && strncmp(Text, "UNIT.", 5)
+			&& strncmp(Text, "EQNS.", 5) && strncmp(Text, "BITS.", 5))
+		return 1;	// Not a telemetry definition
+
+	if (AX25_Str_To_Addr(Callid, &addr) < 0)
+		return -1;
+	AX25_Norm_Addr(&addr);
+
+	if (!(tlm = APRS_Telemetry_Alloc(Tlms, &addr)))
+		return -1;
+	tlm->timestamp = Timestamp;
+
+	switch (Text[0]) {
+		case 'P':
+			bzero(tlm->parm, sizeof(tlm->parm));
+			APRS_Telemetry_Labels(Text + 5, tlm->parm, APRS_TLM_ANALOG + APRS_TLM_BITS);
+			break;
+
+		case 'U':
+			bzero(tlm->unit, sizeof(tlm->unit));
+			APRS_Telemetry_Labels(Text + 5, tlm->unit, APRS_TLM_ANALOG + APRS_TLM_BITS);
+			break;
+
+		case 'E':
+			Text += 5;
+			for (i = 0; i < APRS_TLM_ANALOG * 3 && *Text; i++) {
+				tlm->eqns[i/3][i%3] = strtof(Text, &next);
+				if (!(Text = strchr(next, ',')))
+					break;
+				Text++;
+			}
+			break;
+
+		case 'B':
+			Text += 5;
+			if (strspn(Text, "01") < APRS_TLM_BITS)
+				return -1;
+			tlm->bits_sense = 0;
+			for (i = 0; i < APRS_TLM_BITS; i++)
+				tlm->bits_sense = (tlm->bits_sense << 1) | (Text[i] - '0');
+			Text += APRS_TLM_BITS;
+			if (*Text == ',')
+				Text++;
+			len = strlen(Text);
+			if (len >= sizeof(tlm->project))
+				len = sizeof(tlm->project) - 1;
+			memcpy(tlm->project, Text, len);
+			tlm->project[len] = '\0';
+			break;
+	}
+
+	return 0;
+}
+
+int APRS_Telemetry_Get(APRS_Telemetries_t * Tlms, const AX25_Addr_t * Callid, APRS_Tlm_t * Tlm) {
+	APRS_Tlm_t * tlm;
+	AX25_Addr_t addr;
+
+	if (!Tlms || !Callid)
+		return -1;
+
+	addr = *Callid;
+	AX25_Norm_Addr(&addr);
+
+	if (!(tlm = APRS_Telemetry_Find(Tlms, &addr)))
+		return -1;
+
+	if (Tlm)
+		*Tlm = *tlm;
+
+	return 0;
+}
+
+// Raw analog value to engineering unit
+float APRS_Telemetry_Scale(const APRS_Tlm_t * Tlm, int Channel, float Raw) {
+	const float * eqn;
+
+	if (!Tlm || Channel < 0 || Channel >= APRS_TLM_ANALOG)
+		return Raw;
+
+	eqn = Tlm->eqns[Channel];
+
+	return (eqn[0] * Raw + eqn[1]) * Raw + eqn[2];
+}
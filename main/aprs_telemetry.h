@@ -0,0 +1,37 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * main/aprs_telemetry.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _APRS_TELEMETRY_H_
+#define _APRS_TELEMETRY_H_
+
+#include "aprs.h"
+
+typedef struct APRS_Telemetries_S APRS_Telemetries_t;
+
+APRS_Telemetries_t * APRS_Telemetry_Init(int Size);
+int APRS_Telemetry_Update(APRS_Telemetries_t * Tlms, const APRS_Data_t * Data);
+int APRS_Telemetry_Define(APRS_Telemetries_t * Tlms, const char * Callid, const char * Text, time_t Timestamp);
+int APRS_Telemetry_Get(APRS_Telemetries_t * Tlms, const AX25_Addr_t * Callid, APRS_Tlm_t * Tlm);
+float APRS_Telemetry_Scale(const APRS_Tlm_t * Tlm, int Channel, float Raw);
+
+#endif
@@ -0,0 +1,242 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * main/aprs_xfer.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <esp_log.h>
+#include <berkeley-db/db.h>
+#include "aprs_xfer.h"
+
+#define TAG "APRS_XFER"
+
+typedef enum {
+	APRS_XFER_IDLE = 0,
+	APRS_XFER_SEND_HEADER,
+	APRS_XFER_SEND_STATIONS,
+	APRS_XFER_SEND_DONE,
+} APRS_Xfer_State_t;
+
+// Command and Next are both called from the kiss task
+struct APRS_Xfer_S {
+	APRS_t * aprs;
+	// Export
+	APRS_Xfer_State_t state;
+	AX25_Addr_t filter;
+	AX25_Addr_t cursor;
+	bool first;
+	bool header_only;
+	uint32_t count;
+	uint8_t status;
+	// Import
+	APRS_Station_t * batch;	// Allocated on first imported station
+	int batch_size;
+	int n_batch;
+	uint32_t imported;
+	uint8_t import_status;
+	bool ack;
+};
+
+APRS_Xfer_t * APRS_Xfer_Init(APRS_t * Aprs, int Batch) {
+	APRS_Xfer_t * xfer;
+
+	if (!Aprs || Batch <= 0)
+		return NULL;
+
+	if (!(xfer = malloc(sizeof(APRS_Xfer_t))))
+		return NULL;
+	bzero(xfer, sizeof(APRS_Xfer_t));
+	xfer->aprs = Aprs;
+	xfer->batch_size = Batch;
+
+	return xfer;
+}
+
+static void APRS_Xfer_Put32(uint8_t * Data, uint32_t Value) {
+	Data[0] = Value;
+	Data[1] = Value >> 8;
+	Data[2] = Value >> 16;
+	Data[3] = Value >> 24;
+}
+
+// Write pending imported stations
+static void APRS_Xfer_Write(APRS_Xfer_t * Xfer) {
+	int ret;
+
+	if (!Xfer->n_batch)
+		return;
+
+	if ((ret = APRS_Stations_Import(Xfer->aprs, Xfer->batch, Xfer->n_batch)) < 0) {
+		ESP_LOGE(TAG,"Error importing %d stations", Xfer->n_batch);
+		Xfer->import_status = 1;
+	} else
+		Xfer->imported += ret;
+	Xfer->n_batch = 0;
+}
+
+static void APRS_Xfer_Release(APRS_Xfer_t * Xfer) {
+	free(Xfer->batch);
+	Xfer->batch = NULL;
+	Xfer->n_batch = 0;
+}
+
+static int APRS_Xfer_Export(APRS_Xfer_t * Xfer, const uint8_t * Filter, size_t Len) {
+	char str[10];
+	size_t i;
+
+	Xfer->count = 0;
+	Xfer->status = 0;
+	Xfer->first = true;
+	Xfer->header_only = false;
+	bzero(&Xfer->filter, sizeof(AX25_Addr_t));
+	Xfer->state = APRS_XFER_SEND_HEADER;
+
+	if (!Len)
+		return 0;
+
+	if (Len > sizeof(str)-1)
+		Len = sizeof(str)-1;
+	for (i=0; i<Len; i++)
+		str[i] = toupper(Filter[i]);
+	str[i] = '\0';
+	if (AX25_Str_To_Addr(str, &Xfer->filter)) {
+		ESP_LOGW(TAG,"Invalid export filter %s", str);
+		Xfer->status = 1;
+		Xfer->state = APRS_XFER_SEND_DONE;
+		return -1;
+	}
+
+	return 0;
+}
+
+int APRS_Xfer_Command(APRS_Xfer_t * Xfer, const uint8_t * Data, size_t Len) {
+	size_t size;
+
+	if (!Xfer || !Data || !Len)
+		return -1;
+
+	switch (Data[0]) {
+		case APRS_XFER_EXPORT:
+			ESP_LOGI(TAG,"Station export requested");
+			return APRS_Xfer_Export(Xfer, Data+1, Len-1);
+		case APRS_XFER_HEADER:
+			if (Xfer->state == APRS_XFER_IDLE) {
+				Xfer->header_only = true;
+				Xfer->state = APRS_XFER_SEND_HEADER;
+			}
+			break;
+		case APRS_XFER_ABORT:
+			if (Xfer->state != APRS_XFER_IDLE)
+				ESP_LOGI(TAG,"Station export aborted after %lu stations", Xfer->count);
+			Xfer->state = APRS_XFER_IDLE;
+			APRS_Xfer_Release(Xfer);
+			Xfer->imported = 0;
+			Xfer->import_status = 0;
+			break;
+		case APRS_XFER_IMPORT:
+			size = Len-1;
+			if (!size || size > sizeof(APRS_Station_t)) {
+				Xfer->import_status = 1;
+				return -1;
+			}
+			if (!Xfer->batch && !(Xfer->batch = malloc(Xfer->batch_size * sizeof(APRS_Station_t)))) {
+				ESP_LOGE(TAG,"No memory for import batch");
+				Xfer->import_status = 1;
+				return -1;
+			}
+			bzero(&Xfer->batch[Xfer->n_batch], sizeof(APRS_Station_t));
+			memcpy(&Xfer->batch[Xfer->n_batch], Data+1, size);
+			if (++Xfer->n_batch == Xfer->batch_size)
+				APRS_Xfer_Write(Xfer);
+			break;
+		case APRS_XFER_WRITE:
+			APRS_Xfer_Write(Xfer);
+			APRS_Xfer_Release(Xfer);
+			ESP_LOGI(TAG,"%lu stations imported", Xfer->imported);
+			Xfer->ack = true;
+			break;
+		default:
+			ESP_LOGD(TAG,"Unknown command 0x%02x", Data[0]);
+			return -1;
+	}
+
+	return 0;
+}
+
+int APRS_Xfer_Next(APRS_Xfer_t * Xfer, uint8_t * Data, size_t Size) {
+	APRS_Station_t station;
+	uint8_t * image = (uint8_t *)&station;
+	size_t size;
+	int ret;
+
+	if (!Xfer || !Data || Size < 1+sizeof(APRS_Station_t))
+		return -1;
+
+	if (Xfer->ack) {
+		Data[0] = APRS_XFER_ACK;
+		APRS_Xfer_Put32(Data+1, Xfer->imported);
+		Data[5] = Xfer->import_status;
+		Xfer->ack = false;
+		Xfer->imported = 0;
+		Xfer->import_status = 0;
+		return 6;
+	}
+
+	switch (Xfer->state) {
+		case APRS_XFER_IDLE:
+			break;
+		case APRS_XFER_SEND_HEADER:
+			Data[0] = APRS_XFER_HEADER;
+			Data[1] = APRS_XFER_VERSION;
+			Data[2] = sizeof(APRS_Station_t) & 0xff;
+			Data[3] = sizeof(APRS_Station_t) >> 8;
+			Xfer->state = Xfer->header_only?APRS_XFER_IDLE:APRS_XFER_SEND_STATIONS;
+			return 4;
+		case APRS_XFER_SEND_STATIONS:
+			// One station per call, stations_sem is not held between calls
+			bzero(&station, sizeof(station));
+			ret = APRS_Stations_Match(Xfer->aprs, &Xfer->filter, &Xfer->cursor, Xfer->first?R_FIRST:R_NEXT, &station);
+			Xfer->first = false;
+			if (!ret) {
+				for (size = sizeof(station); size > 1 && !image[size-1]; size--);
+				Data[0] = APRS_XFER_STATION;
+				memcpy(Data+1, image, size);
+				Xfer->count++;
+				return size+1;
+			}
+			if (ret < 0)
+				Xfer->status = 1;
+			Xfer->state = APRS_XFER_SEND_DONE;
+			// Fall through
+		case APRS_XFER_SEND_DONE:
+			Data[0] = APRS_XFER_DONE;
+			APRS_Xfer_Put32(Data+1, Xfer->count);
+			Data[5] = Xfer->status;
+			Xfer->state = APRS_XFER_IDLE;
+			ESP_LOGI(TAG,"%lu stations exported", Xfer->count);
+			return 6;
+	}
+
+	return 0;
+}
@@ -0,0 +1,66 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * main/aprs_xfer.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _APRS_XFER_H_
+#define _APRS_XFER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "aprs.h"
+
+// Station DB bulk transfer over kiss SetHardware (cmd 6) frames
+// Station images are APRS_Station_t with trailing zero bytes removed
+//
+// Host to TNC :
+//	'H'		: send export header only, for import compatibility check
+//	'E' [filter]	: export stations matching filter (as AX25_Str_To_Addr, all if none)
+//	'A'		: abort export and drop pending import batch
+//	'I' image	: import station, written by batch
+//	'W'		: write pending import batch
+// TNC to host :
+//	'H' version size	: export header, size of APRS_Station_t (16 bits le)
+//	'S' image		: exported station
+//	'D' count status	: export done, count is 32 bits le, status 0 if ok
+//	'K' count status	: import batch written, count of records written since previous 'K'
+
+#define APRS_XFER_VERSION	1
+
+#define APRS_XFER_EXPORT	'E'
+#define APRS_XFER_ABORT		'A'
+#define APRS_XFER_IMPORT	'I'
+#define APRS_XFER_WRITE		'W'
+
+#define APRS_XFER_HEADER	'H'
+#define APRS_XFER_STATION	'S'
+#define APRS_XFER_DONE		'D'
+#define APRS_XFER_ACK		'K'
+
+typedef struct APRS_Xfer_S APRS_Xfer_t;
+
+// Batch is the number of imported stations written per DB sync
+APRS_Xfer_t * APRS_Xfer_Init(APRS_t * Aprs, int Batch);
+// Kiss_Hw_Command_t and Kiss_Hw_Source_t
+int APRS_Xfer_Command(APRS_Xfer_t * Xfer, const uint8_t * Data, size_t Len);
+int APRS_Xfer_Next(APRS_Xfer_t * Xfer, uint8_t * Data, size_t Size);
+
+#endif
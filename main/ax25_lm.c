@@ -136,6 +136,7 @@ static int AX25_Lm_Impl_Phy_Seize_Confirm_Cb(AX25_Lm_Impl_t * Lm);
 static int AX25_Lm_Impl_Phy_Data_Indication_Cb(AX25_Lm_Impl_t * Lm, Frame_t * Frame);
 static int AX25_Lm_Impl_Phy_Busy_Indication_Cb(AX25_Lm_Impl_t * Lm);
 static int AX25_Lm_Impl_Phy_Quiet_Indication_Cb(AX25_Lm_Impl_t * Lm);
+static int AX25_Lm_Impl_Phy_Data_Confirm_Cb(AX25_Lm_Impl_t * Lm, Frame_t * Frame);
 
 AX25_Lm_t * AX25_Lm_Impl_Init(AX25_Phy_t * Phy) {
 	AX25_Lm_Impl_t * lm;
@@ -158,7 +159,8 @@ AX25_Lm_t * AX25_Lm_Impl_Init(AX25_Phy_t * Phy) {
 		.seize_confirm = (typeof(cbs.seize_confirm))AX25_Lm_Impl_Phy_Seize_Confirm_Cb,
 		.data_indication = (typeof(cbs.data_indication))AX25_Lm_Impl_Phy_Data_Indication_Cb,
 		.busy_indication = (typeof(cbs.busy_indication))AX25_Lm_Impl_Phy_Busy_Indication_Cb,
-		.quiet_indication = (typeof(cbs.quiet_indication))AX25_Lm_Impl_Phy_Quiet_Indication_Cb
+		.quiet_indication = (typeof(cbs.quiet_indication))AX25_Lm_Impl_Phy_Quiet_Indication_Cb,
+		.data_confirm = (typeof(cbs.data_confirm))AX25_Lm_Impl_Phy_Data_Confirm_Cb
 	};
 	if (AX25_Phy_Register_Cbs(lm->ax25_phy, lm, &cbs))
 		ESP_LOGE(TAG,"Error registerring lm callback with phy");
@@ -592,6 +594,22 @@ static int AX25_Lm_Impl_Phy_Quiet_Indication_Cb(AX25_Lm_Impl_t * Lm) {
 	return 0;
 }
 
+// Frame sent, each DL check if it own it
+static int AX25_Lm_Impl_Phy_Data_Confirm_Cb(AX25_Lm_Impl_t * Lm, Frame_t * Frame) {
+	AX25_Dl_List_t * dl_list;
+
+	xSemaphoreTake(Lm->lm_lock,portMAX_DELAY);
+	dl_list = Lm->dl_list;
+	while (dl_list) {
+		if (dl_list->dl.data_confirm)
+			dl_list->dl.data_confirm(dl_list->dl_ctx, Frame);
+		dl_list = dl_list->next;
+	}
+	xSemaphoreGive(Lm->lm_lock);
+
+	return 0;
+}
+
 // Register lm callbacks
 static int AX25_Lm_Impl_Register_Dl(AX25_Lm_Impl_t * Lm, void * Ctx, AX25_Lm_Cbs_t * Cbs, AX25_Addr_t * Filter) {
 	AX25_Dl_List_t * dl_list;
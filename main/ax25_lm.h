@@ -50,6 +50,7 @@ struct AX25_Lm_Cbs_S {
 	int (*data_indication)(AX25_Lm_t * Ctx, Frame_t * Frame);
 	int (*busy_indication)(AX25_Lm_t * Ctx);
 	int (*quiet_indication)(AX25_Lm_t * Ctx);
+	int (*data_confirm)(AX25_Lm_t * Ctx, Frame_t * Frame);	// Frame sent on air
 };
 
 extern const struct AX25_Lm_Ops_S Ax25_Lm_Ops;
@@ -112,3 +112,13 @@ void AX25_Phy_Quiet_Indication_Cb(AX25_Phy_t * Phy) {
 		cbs_list = cbs_list->next;
 	}
 }
+
+void AX25_Phy_Data_Confirm_Cb(AX25_Phy_t * Phy, Frame_t * Frame) {
+	struct AX25_Phy_Cbs_List_S * cbs_list = Phy->cbs_list;
+
+	while (cbs_list) {
+		if (cbs_list->cbs.data_confirm)
+			cbs_list->cbs.data_confirm(cbs_list->cbs_ctx, Frame);
+		cbs_list = cbs_list->next;
+	}
+}
@@ -45,6 +45,7 @@ struct AX25_Phy_Cbs_S {
 	int (*data_indication)(void * Ctx, Frame_t * Frame);
 	int (*busy_indication)(void * Ctx);
 	int (*quiet_indication)(void * Ctx);
+	int (*data_confirm)(void * Ctx, Frame_t * Frame);	// Frame sent on air
 };
 
 // Interface
@@ -81,6 +82,7 @@ void AX25_Phy_Seize_Confirm_Cb(AX25_Phy_t * Phy);
 void AX25_Phy_Data_Indication_Cb(AX25_Phy_t * Phy, Frame_t * Frame);
 void AX25_Phy_Busy_Indication_Cb(AX25_Phy_t * Phy);
 void AX25_Phy_Quiet_Indication_Cb(AX25_Phy_t * Phy);
+void AX25_Phy_Data_Confirm_Cb(AX25_Phy_t * Phy, Frame_t * Frame);
 #endif
 
 #endif
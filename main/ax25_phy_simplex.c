@@ -451,6 +451,7 @@ static void AX25_Phy_Simplex_Event_Proc(AX25_Phy_Simplex_t * Phy, AX25_Phy_Simpl
 						break;
 					case AX25_RA_FRAME_SENT:
 						if (phy_event->arg == Phy->outstanding_frame) {
+							AX25_Phy_Data_Confirm_Cb(&Phy->ax25_phy, phy_event->arg);
 							Framebuff_Free_Frame(phy_event->arg);
 							Phy->outstanding_frame = NULL;
 							Phy->phy_normal_queue_processing = true;
@@ -466,6 +467,7 @@ static void AX25_Phy_Simplex_Event_Proc(AX25_Phy_Simplex_t * Phy, AX25_Phy_Simpl
 						break;
 					case AX25_RA_FRAME_SENT:
 						if (phy_event->arg == Phy->outstanding_frame) {
+							AX25_Phy_Data_Confirm_Cb(&Phy->ax25_phy, phy_event->arg);
 							Framebuff_Free_Frame(phy_event->arg);
 							Phy->outstanding_frame = NULL;
 							if (!uxQueueMessagesWaiting(Phy->phy_prio_queue)) {
@@ -0,0 +1,555 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * main/capture.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_log.h>
+#include <esp_system.h>
+#include <esp_rom_crc.h>
+#include "capture.h"
+#include "framebuff.h"
+#include "hdlc_dec.h"
+#include "ax25_phy.h"
+
+#define TAG "CAPTURE"
+
+#define CAPTURE_MARKS	16	// Sparse time index entries per segment
+#define CAPTURE_PCAP_MAGIC	0xa1b2c3d4
+#define CAPTURE_PCAP_LINKTYPE	202	// LINKTYPE_AX25_KISS
+
+// Records before offset were all captured at or before sec
+typedef struct Capture_Mark_S {
+	uint32_t sec;
+	uint32_t offset;
+} Capture_Mark_t;
+
+typedef struct Capture_Segment_S {
+	uint32_t number;
+	uint32_t size;		// Valid records size
+	uint32_t min, max;	// Capture time range, clock may step back
+	uint8_t n_marks;
+	Capture_Mark_t marks[CAPTURE_MARKS];
+} Capture_Segment_t;
+
+struct Capture_S {
+	char * path;
+	uint32_t segment_size;
+	int max_segments;
+
+	SemaphoreHandle_t sem;		// Segments and files
+	StaticSemaphore_t sem_data;
+	Capture_Segment_t * segments;	// Sorted by number, last one is active
+	int count;
+	bool sealed;			// Active segment tail damaged, start a new one
+
+	SemaphoreHandle_t buf_sem;	// Frame buffer, taken from phy callbacks
+	StaticSemaphore_t buf_sem_data;
+	uint8_t * buf;			// Records waiting for flush
+	uint8_t * wbuf;			// Records being written
+	size_t buf_size;
+	size_t buf_len;
+	uint32_t dropped;
+	uint8_t rssi;
+};
+
+typedef struct __attribute__((packed)) Capture_Pcap_Hdr_S {
+	uint32_t magic;
+	uint16_t version_major;
+	uint16_t version_minor;
+	int32_t thiszone;
+	uint32_t sigfigs;
+	uint32_t snaplen;
+	uint32_t network;
+} Capture_Pcap_Hdr_t;
+
+typedef struct __attribute__((packed)) Capture_Pcap_Rec_S {
+	uint32_t sec;
+	uint32_t usec;
+	uint32_t incl_len;
+	uint32_t orig_len;
+} Capture_Pcap_Rec_t;
+
+static Capture_t * Capture_Instance;	// for shutdown handler
+
+static uint32_t Capture_Crc(const Capture_Rec_t * Rec, const uint8_t * Frame) {
+	uint32_t crc;
+
+	crc = esp_rom_crc32_le(0, (const uint8_t *)&Rec->sec, sizeof(Capture_Rec_t) - sizeof(Rec->crc));
+	return esp_rom_crc32_le(crc, Frame, Rec->len);
+}
+
+static void Capture_Segment_Name(const Capture_t * Capture, uint32_t Number, char * Name, size_t Len) {
+	snprintf(Name, Len, "%s.%06lu", Capture->path, (unsigned long)Number);
+}
+
+// Read record at current file position, return its size, 0 at end or on damaged record
+static size_t Capture_Read(int Fd, Capture_Rec_t * Rec, uint8_t * Frame) {
+	if (read(Fd, Rec, sizeof(Capture_Rec_t)) != sizeof(Capture_Rec_t))
+		return 0;
+	if (!Rec->len || Rec->len > HDLC_MAX_FRAME_LEN || (Rec->dir != CAPTURE_RX && Rec->dir != CAPTURE_TX))
+		return 0;
+	if (read(Fd, Frame, Rec->len) != Rec->len || Capture_Crc(Rec, Frame) != Rec->crc)
+		return 0;
+
+	return sizeof(Capture_Rec_t) + Rec->len;
+}
+
+// Update time range and sparse index with a record written at Offset
+static void Capture_Index(Capture_t * Capture, Capture_Segment_t * Segment, const Capture_Rec_t * Rec, uint32_t Offset) {
+	uint32_t step = Capture->segment_size / CAPTURE_MARKS;
+
+	if (Segment->n_marks < CAPTURE_MARKS && Offset >= Segment->n_marks * step) {
+		Segment->marks[Segment->n_marks].sec = Offset?Segment->max:0;
+		Segment->marks[Segment->n_marks].offset = Offset;
+		Segment->n_marks++;
+	}
+
+	if (!Offset || Rec->sec < Segment->min)
+		Segment->min = Rec->sec;
+	if (!Offset || Rec->sec > Segment->max)
+		Segment->max = Rec->sec;
+}
+
+// Rebuild index of a segment, return valid records size
+static uint32_t Capture_Replay(Capture_t * Capture, Capture_Segment_t * Segment) {
+	Capture_Rec_t rec;
+	uint8_t frame[HDLC_MAX_FRAME_LEN];
+	char name[64];
+	uint32_t offset = 0;
+	size_t size;
+	int fd;
+
+	Capture_Segment_Name(Capture, Segment->number, name, sizeof(name));
+	if ((fd = open(name, O_RDONLY)) < 0)
+		return 0;
+
+	while ((size = Capture_Read(fd, &rec, frame))) {
+		Capture_Index(Capture, Segment, &rec, offset);
+		offset += size;
+	}
+
+	close(fd);
+
+	return offset;
+}
+
+static int Capture_Cmp_Number(const void * A, const void * B) {
+	uint32_t a = ((const Capture_Segment_t *)A)->number;
+	uint32_t b = ((const Capture_Segment_t *)B)->number;
+
+	return (a > b) - (a < b);
+}
+
+static void Capture_Remove_Oldest(Capture_t * Capture) {
+	char name[64];
+
+	Capture_Segment_Name(Capture, Capture->segments[0].number, name, sizeof(name));
+	unlink(name);
+	memmove(&Capture->segments[0], &Capture->segments[1], (Capture->count - 1) * sizeof(Capture_Segment_t));
+	Capture->count--;
+}
+
+// List segment files, oldest first, extra ones are removed
+static int Capture_Scan(Capture_t * Capture) {
+	const char * base;
+	char * dir, * end;
+	struct dirent * ent;
+	unsigned long number;
+	Capture_Segment_t * segments;
+	int alloc = Capture->max_segments;
+	size_t len;
+	DIR * d;
+
+	base = strrchr(Capture->path, '/');
+	if (base) {
+		dir = strndup(Capture->path, base - Capture->path);
+		base++;
+	} else {
+		dir = strdup(".");
+		base = Capture->path;
+	}
+	if (!dir)
+		return -1;
+
+	d = opendir(*dir ? dir : "/");
+	free(dir);
+	if (!d) {
+		ESP_LOGE(TAG, "Can't open directory of %s (%d)", Capture->path, errno);
+		return -1;
+	}
+
+	len = strlen(base);
+	while ((ent = readdir(d))) {
+		if (strncmp(ent->d_name, base, len) || ent->d_name[len] != '.')
+			continue;
+		number = strtoul(&ent->d_name[len+1], &end, 10);
+		if (*end || end == &ent->d_name[len+1] || !number)
+			continue;
+
+		if (Capture->count == alloc) {
+			if (!(segments = realloc(Capture->segments, (alloc + Capture->max_segments) * sizeof(Capture_Segment_t)))) {
+				closedir(d);
+				return -1;
+			}
+			Capture->segments = segments;
+			alloc += Capture->max_segments;
+		}
+		bzero(&Capture->segments[Capture->count], sizeof(Capture_Segment_t));
+		Capture->segments[Capture->count++].number = number;
+	}
+	closedir(d);
+
+	qsort(Capture->segments, Capture->count, sizeof(Capture_Segment_t), Capture_Cmp_Number);
+	while (Capture->count > Capture->max_segments)
+		Capture_Remove_Oldest(Capture);
+
+	return 0;
+}
+
+static int Capture_Phy_Data_Indication_Cb(Capture_t * Capture, Frame_t * Frame) {
+	Capture_Frame(Capture, CAPTURE_RX, Frame, NULL);
+	return 0;
+}
+
+static int Capture_Phy_Data_Confirm_Cb(Capture_t * Capture, Frame_t * Frame) {
+	Capture_Frame(Capture, CAPTURE_TX, Frame, NULL);
+	return 0;
+}
+
+static void Capture_Shutdown_Handler(void) {
+	Capture_Flush(Capture_Instance);
+}
+
+Capture_t * Capture_Init(AX25_Phy_t * Phy, const char * Path, int Segment_Size, int Segments, int Buffer_Size) {
+	Capture_t * capture;
+	AX25_Phy_Cbs_t cbs = {
+		.data_indication = (typeof(cbs.data_indication))Capture_Phy_Data_Indication_Cb,
+		.data_confirm = (typeof(cbs.data_confirm))Capture_Phy_Data_Confirm_Cb,
+	};
+	int i;
+
+	if (!Path || Segment_Size < (int)(sizeof(Capture_Rec_t) + HDLC_MAX_FRAME_LEN) || Segments < 2
+			|| Buffer_Size < (int)(sizeof(Capture_Rec_t) + HDLC_MAX_FRAME_LEN))
+		return NULL;
+
+	if (!(capture = malloc(sizeof(Capture_t))))
+		return NULL;
+	bzero(capture, sizeof(Capture_t));
+	capture->segment_size = Segment_Size;
+	capture->max_segments = Segments;
+	capture->buf_size = Buffer_Size;
+	capture->path = strdup(Path);
+	capture->segments = malloc(Segments * sizeof(Capture_Segment_t));
+	capture->buf = malloc(Buffer_Size);
+	capture->wbuf = malloc(Buffer_Size);
+
+	if (!capture->path || !capture->segments || !capture->buf || !capture->wbuf || Capture_Scan(capture)) {
+		ESP_LOGE(TAG, "Error initializing capture %s", Path);
+		free(capture->path);
+		free(capture->segments);
+		free(capture->buf);
+		free(capture->wbuf);
+		free(capture);
+		return NULL;
+	}
+
+	for (i=0; i<capture->count; i++)
+		capture->segments[i].size = Capture_Replay(capture, &capture->segments[i]);
+
+	// Append to last segment unless its tail is damaged
+	if (capture->count) {
+		Capture_Segment_t * last = &capture->segments[capture->count-1];
+		char name[64];
+		struct stat st;
+
+		Capture_Segment_Name(capture, last->number, name, sizeof(name));
+		if (stat(name, &st) || st.st_size != last->size) {
+			ESP_LOGW(TAG, "%s : incomplete records ignored", name);
+			capture->sealed = true;
+		}
+	}
+
+	capture->sem = xSemaphoreCreateMutexStatic(&capture->sem_data);
+	capture->buf_sem = xSemaphoreCreateMutexStatic(&capture->buf_sem_data);
+
+	if (Phy && AX25_Phy_Register_Cbs(Phy, capture, &cbs))
+		ESP_LOGE(TAG, "Error registering phy callbacks");
+
+	Capture_Instance = capture;
+	esp_register_shutdown_handler(Capture_Shutdown_Handler);
+
+	ESP_LOGI(TAG, "%s : %d segments", Path, capture->count);
+
+	return capture;
+}
+
+void Capture_Set_Rssi(Capture_t * Capture, uint8_t Rssi) {
+	if (Capture)
+		Capture->rssi = Rssi;
+}
+
+int Capture_Frame(Capture_t * Capture, uint8_t Dir, const Frame_t * Frame, const struct timeval * Tv) {
+	Capture_Rec_t rec;
+	struct timeval tv;
+	size_t size;
+
+	if (!Capture || !Frame || !Frame->frame_len || Frame->frame_len > HDLC_MAX_FRAME_LEN)
+		return -1;
+
+	if (!Tv) {
+		gettimeofday(&tv, NULL);
+		Tv = &tv;
+	}
+
+	rec.sec = Tv->tv_sec;
+	rec.usec = Tv->tv_usec;
+	rec.len = Frame->frame_len;
+	rec.dir = Dir;
+	rec.flags = (Frame->frame_len > 2 && esp_rom_crc16_le(0, Frame->frame, Frame->frame_len) == 0x0f47)?CAPTURE_FCS_OK:0;
+	rec.rssi = Capture->rssi;
+	rec.reserved = 0;
+	rec.crc = Capture_Crc(&rec, Frame->frame);
+	size = sizeof(rec) + rec.len;
+
+	xSemaphoreTake(Capture->buf_sem, portMAX_DELAY);
+	if (Capture->buf_len + size > Capture->buf_size) {
+		Capture->dropped++;
+		xSemaphoreGive(Capture->buf_sem);
+		return -1;
+	}
+	memcpy(Capture->buf + Capture->buf_len, &rec, sizeof(rec));
+	memcpy(Capture->buf + Capture->buf_len + sizeof(rec), Frame->frame, rec.len);
+	Capture->buf_len += size;
+	xSemaphoreGive(Capture->buf_sem);
+
+	return 0;
+}
+
+static Capture_Segment_t * Capture_New_Segment(Capture_t * Capture) {
+	Capture_Segment_t * segment;
+	uint32_t number = 1;
+
+	if (Capture->count)
+		number = Capture->segments[Capture->count-1].number + 1;
+	if (Capture->count == Capture->max_segments)
+		Capture_Remove_Oldest(Capture);
+
+	segment = &Capture->segments[Capture->count++];
+	bzero(segment, sizeof(Capture_Segment_t));
+	segment->number = number;
+	Capture->sealed = false;
+
+	return segment;
+}
+
+int Capture_Flush(Capture_t * Capture) {
+	Capture_Segment_t * active;
+	Capture_Rec_t * rec;
+	uint8_t * buf;
+	size_t len, pos, run, size;
+	uint32_t dropped;
+	char name[64];
+	int fd, ret = 0;
+
+	if (!Capture)
+		return -1;
+
+	xSemaphoreTake(Capture->sem, portMAX_DELAY);
+
+	// Frames captured while writing go to the other buffer
+	xSemaphoreTake(Capture->buf_sem, portMAX_DELAY);
+	buf = Capture->buf;
+	len = Capture->buf_len;
+	Capture->buf = Capture->wbuf;
+	Capture->wbuf = buf;
+	Capture->buf_len = 0;
+	dropped = Capture->dropped;
+	Capture->dropped = 0;
+	xSemaphoreGive(Capture->buf_sem);
+
+	if (dropped)
+		ESP_LOGW(TAG, "%lu frames dropped, capture buffer full", (unsigned long)dropped);
+
+	pos = 0;
+	while (pos < len) {
+		rec = (Capture_Rec_t *)(buf + pos);
+		size = sizeof(Capture_Rec_t) + rec->len;
+		active = Capture->count?&Capture->segments[Capture->count-1]:NULL;
+		if (!active || Capture->sealed || (active->size && active->size + size > Capture->segment_size))
+			active = Capture_New_Segment(Capture);
+
+		// Records fitting in active segment, one write
+		run = 0;
+		do {
+			run += size;
+			if (pos + run >= len)
+				break;
+			size = sizeof(Capture_Rec_t) + ((Capture_Rec_t *)(buf + pos + run))->len;
+		} while (active->size + run + size <= Capture->segment_size);
+
+		Capture_Segment_Name(Capture, active->number, name, sizeof(name));
+		fd = open(name, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+		if (fd < 0 || lseek(fd, active->size, SEEK_SET) != active->size || write(fd, buf + pos, run) != run) {
+			ESP_LOGE(TAG, "Error writing %s (%d)", name, errno);
+			if (fd >= 0)
+				close(fd);
+			Capture->sealed = true;
+			ret = -1;
+			break;
+		}
+		close(fd);
+
+		for (size = 0; size < run; size += sizeof(Capture_Rec_t) + rec->len) {
+			rec = (Capture_Rec_t *)(buf + pos + size);
+			Capture_Index(Capture, active, rec, active->size + size);
+		}
+		active->size += run;
+		pos += run;
+	}
+
+	xSemaphoreGive(Capture->sem);
+
+	return ret;
+}
+
+// First segment and offset that may hold records captured at or after From
+static int Capture_Seek(Capture_t * Capture, time_t From, uint32_t * Offset) {
+	Capture_Segment_t * segment;
+	int i, j;
+
+	*Offset = 0;
+	for (i=0; i<Capture->count; i++) {
+		segment = &Capture->segments[i];
+		if (!segment->size || segment->max < From)
+			continue;
+		// Last index entry with only older records before it
+		for (j=segment->n_marks-1; j>0 && segment->marks[j].sec >= From; j--);
+		*Offset = segment->marks[j].offset;
+		break;
+	}
+
+	return i;
+}
+
+static int Capture_Export_Segment(Capture_t * Capture, const Capture_Segment_t * Segment, uint32_t Offset,
+		time_t From, time_t To, Capture_Write_t Write, void * Ctx) {
+	struct __attribute__((packed)) {
+		Capture_Pcap_Rec_t hdr;
+		uint8_t kiss;
+		uint8_t frame[HDLC_MAX_FRAME_LEN];
+	} out;
+	Capture_Rec_t rec;
+	char name[64];
+	size_t size;
+	int fd, n = 0;
+
+	Capture_Segment_Name(Capture, Segment->number, name, sizeof(name));
+	if ((fd = open(name, O_RDONLY)) < 0) {
+		ESP_LOGE(TAG, "Can't open %s (%d)", name, errno);
+		return -1;
+	}
+
+	if (lseek(fd, Offset, SEEK_SET) != Offset) {
+		close(fd);
+		return -1;
+	}
+
+	while (Offset < Segment->size && (size = Capture_Read(fd, &rec, out.frame))) {
+		Offset += size;
+		if (rec.sec < From || (To && rec.sec > To) || rec.len <= 2)
+			continue;
+
+		// Fcs is not part of LINKTYPE_AX25_KISS frames
+		out.kiss = (rec.dir == CAPTURE_TX)?0x10:(rec.flags & CAPTURE_FCS_OK)?0x00:0x20;
+		out.hdr.sec = rec.sec;
+		out.hdr.usec = rec.usec;
+		out.hdr.incl_len = out.hdr.orig_len = 1 + rec.len - 2;
+		if (Write(Ctx, &out, sizeof(out.hdr) + out.hdr.incl_len)) {
+			n = -1;
+			break;
+		}
+		n++;
+	}
+
+	close(fd);
+
+	return n;
+}
+
+int Capture_Export_Pcap(Capture_t * Capture, time_t From, time_t To, Capture_Write_t Write, void * Ctx) {
+	Capture_Pcap_Hdr_t hdr = {
+		.magic = CAPTURE_PCAP_MAGIC,
+		.version_major = 2,
+		.version_minor = 4,
+		.snaplen = HDLC_MAX_FRAME_LEN + 1,
+		.network = CAPTURE_PCAP_LINKTYPE,
+	};
+	uint32_t number, offset;
+	int i, ret, n = 0;
+
+	if (!Capture || !Write)
+		return -1;
+
+	if (Write(Ctx, &hdr, sizeof(hdr)))
+		return -1;
+
+	Capture_Flush(Capture);
+
+	xSemaphoreTake(Capture->sem, portMAX_DELAY);
+	i = Capture_Seek(Capture, From, &offset);
+	number = (i < Capture->count)?Capture->segments[i].number:0;
+	xSemaphoreGive(Capture->sem);
+
+	// One segment at a time, ring may move in between
+	while (number) {
+		xSemaphoreTake(Capture->sem, portMAX_DELAY);
+		for (i=0; i<Capture->count && Capture->segments[i].number < number; i++);
+		if (i == Capture->count) {
+			xSemaphoreGive(Capture->sem);
+			break;
+		}
+		if (Capture->segments[i].number != number)
+			offset = 0;
+		ret = Capture_Export_Segment(Capture, &Capture->segments[i], offset, From, To, Write, Ctx);
+		number = Capture->segments[i].number + 1;
+		offset = 0;
+		xSemaphoreGive(Capture->sem);
+
+		if (ret < 0)
+			return -1;
+		n += ret;
+	}
+
+	ESP_LOGI(TAG, "%d frames exported", n);
+
+	return n;
+}
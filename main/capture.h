@@ -0,0 +1,73 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * main/capture.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <sys/time.h>
+
+// Raw frame capture : received and transmitted frames are buffered in RAM and
+// appended to a ring of segment files <Path>.<number>, oldest segment is removed
+// when the ring is full
+
+typedef struct Framebuff_Frame_S Frame_t;
+typedef struct AX25_Phy_S AX25_Phy_t;
+typedef struct Capture_S Capture_t;
+
+#define CAPTURE_RX	'R'
+#define CAPTURE_TX	'T'
+
+#define CAPTURE_FCS_OK	0x01	// Frame fcs is valid
+
+typedef struct __attribute__((packed)) Capture_Rec_S {
+	uint32_t crc;		// crc32 of following fields and frame
+	uint32_t sec;		// Capture time
+	uint32_t usec;
+	uint16_t len;		// Frame bytes following, fcs included
+	uint8_t dir;		// CAPTURE_RX or CAPTURE_TX
+	uint8_t flags;		// CAPTURE_FCS_OK
+	uint8_t rssi;		// Last radio rssi sample
+	uint8_t reserved;
+} Capture_Rec_t;
+
+// Output of pcap export
+typedef int (*Capture_Write_t)(void * Ctx, const void * Data, size_t Len);
+
+// Phy may be NULL, frames are then only added with Capture_Frame
+Capture_t * Capture_Init(AX25_Phy_t * Phy, const char * Path, int Segment_Size, int Segments, int Buffer_Size);
+void Capture_Set_Rssi(Capture_t * Capture, uint8_t Rssi);
+// Buffer a frame, Tv NULL for current time
+int Capture_Frame(Capture_t * Capture, uint8_t Dir, const Frame_t * Frame, const struct timeval * Tv);
+// Write buffered frames to flash
+int Capture_Flush(Capture_t * Capture);
+
+// pcap (LINKTYPE_AX25_KISS) of frames captured between From and To (0 for no limit),
+// replay starts from the sparse time index entry preceding From
+// KISS port is 0 for received frames, 1 for transmitted frames and 2 for received frames with bad fcs
+// return number of frames exported, -1 on error
+int Capture_Export_Pcap(Capture_t * Capture, time_t From, time_t To, Capture_Write_t Write, void * Ctx);
+
+#endif
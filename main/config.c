@@ -120,12 +120,20 @@ const esp_pm_config_t pm_config = {
 #endif
 };
 
+#if CONFIG_ESP32S3APRS_STORAGE_SPIFFS
 const esp_vfs_spiffs_conf_t Spiffs_Config = {
-	.base_path = CONFIG_ESP32S3APRS_SPIFFS_MOUNT_POINT,
-	.partition_label = CONFIG_ESP32S3APRS_SPIFFS_PART_LABEL,
-	.max_files = CONFIG_ESP32S3APRS_SPIFFS_MAX_FILES,
+	.base_path = CONFIG_ESP32S3APRS_STORAGE_MOUNT_POINT,
+	.partition_label = CONFIG_ESP32S3APRS_STORAGE_PART_LABEL,
+	.max_files = CONFIG_ESP32S3APRS_STORAGE_MAX_FILES,
 	.format_if_mount_failed = true
 };
+#elif CONFIG_ESP32S3APRS_STORAGE_LITTLEFS
+const esp_vfs_littlefs_conf_t Littlefs_Config = {
+	.base_path = CONFIG_ESP32S3APRS_STORAGE_MOUNT_POINT,
+	.partition_label = CONFIG_ESP32S3APRS_STORAGE_PART_LABEL,
+	.format_if_mount_failed = true
+};
+#endif
 
 const uart_config_t console_uart_config = {
 	.baud_rate = CONFIG_ESP32S3APRS_CONSOLE_UART_BAUD_RATE,
@@ -29,7 +29,11 @@
 #include <ssd1680.h>
 #include <esp_pm.h>
 #include <driver/spi_master.h>
+#if CONFIG_ESP32S3APRS_STORAGE_SPIFFS
 #include <esp_spiffs.h>
+#elif CONFIG_ESP32S3APRS_STORAGE_LITTLEFS
+#include <esp_littlefs.h>
+#endif
 #include <driver/uart.h>
 #include <driver/usb_serial_jtag.h>
 
@@ -50,7 +54,11 @@ extern const esp_pm_config_t pm_config;
 extern const SA8x8_config_t SA8x8_config;
 extern const SSD1680_Config_t epd_config;
 extern const spi_bus_config_t spi_config;
+#if CONFIG_ESP32S3APRS_STORAGE_SPIFFS
 extern const esp_vfs_spiffs_conf_t Spiffs_Config;
+#elif CONFIG_ESP32S3APRS_STORAGE_LITTLEFS
+extern const esp_vfs_littlefs_conf_t Littlefs_Config;
+#endif
 extern const uart_config_t console_uart_config;
 
 #endif
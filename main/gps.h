@@ -65,6 +65,7 @@ enum GPS_Parser_Id_E {
 	GPS_PARSER_PMTK001,
 	GPS_PARSER_PMTK010,
 	GPS_PARSER_PMTK011,
+	GPS_PARSER_GLL,
 	GPS_PARSER_MAX
 };
 
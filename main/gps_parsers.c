@@ -22,12 +22,16 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
 #include <esp_log.h>
 #include "gps.h"
 #include "gps_parsers.h"
 
 #define TAG "GPS_PARSER"
 
+#define GPS_COORD_MAX_MULT	6000000	// 60 * 10^5 : 5 decimals of minutes
+#define GPS_FRAC_MAX_DIGITS	9	// Significant digits that fit in int32
+
 
 typedef int (*GPS_Parser_t)(GPS_Data_t *Data,char * ptr, uint8_t idx);
 
@@ -37,9 +41,9 @@ static int GPS_Parser_TXT(GPS_Data_t * Data,char * ptr, uint8_t idx);
 static int GPS_Parser_PMTK001(GPS_Data_t * Data,char * ptr, uint8_t idx);
 static int GPS_Parser_PMTK010(GPS_Data_t * Data,char * ptr, uint8_t idx);
 static int GPS_Parser_PMTK011(GPS_Data_t * Data,char * ptr, uint8_t idx);
+static int GPS_Parser_GLL(GPS_Data_t * Data,char * ptr, uint8_t idx);
 
 /*
-static int GPS_Parser_GLL(GPS_Data_t * Data,char * ptr, uint8_t idx);
 static int GPS_Parser_VTG(GPS_Data_t * Data,char * ptr, uint8_t idx);
 static int GPS_Parser_ZDA(GPS_Data_t * Data,char * ptr, uint8_t idx);
 static int GPS_Parser_GSV(GPS_Data_t * Data,char * ptr, uint8_t idx);
@@ -56,6 +60,7 @@ static const struct GPS_Parsers_S {
 	{GPS_PARSER_PMTK001,GPS_Parser_PMTK001},
 	{GPS_PARSER_PMTK010,GPS_Parser_PMTK010},
 	{GPS_PARSER_PMTK011,GPS_Parser_PMTK011},
+	{GPS_PARSER_GLL,GPS_Parser_GLL},
 	{GPS_PARSER_MAX,NULL}
 };
 
@@ -90,6 +95,7 @@ int GPS_Parse(char * Buffer, size_t Len, GPS_Data_t * Data) {
 				n++;
 				ptr = n;
 				cs = 0;
+				continue;
 			}
 
 			cs ^= *n;
@@ -201,6 +207,7 @@ int GPS_Parser_Get_Coord(int32_t * Coord,char * ptr) {
 	char * dot = strchr(ptr,'.');
 	int dlen;
 	int32_t mult;
+	int64_t val;
 	int deg;
 	int pos = 0;
 
@@ -223,35 +230,39 @@ int GPS_Parser_Get_Coord(int32_t * Coord,char * ptr) {
 		dlen--;
 	}
 
-	*Coord=0;
+	val=0;
 	while (*ptr!='.') {
 		if (*ptr >= '0' && *ptr <= '9') {
-			*Coord = *Coord*10 + (*ptr-'0');
+			val = val*10 + (*ptr-'0');
 		}
 		else
-			*Coord = *Coord*10;
+			val = val*10;
 		pos++;
 		ptr++;
 	}
-	*Coord += deg*60;
+	val += deg*60;
 	mult=60;
 
 	ptr++;
 	pos++;
 	while (*ptr >= '0' && *ptr <= '9') {
-		mult*=10;
-		*Coord = *Coord*10 + (*ptr-'0');
+		// Extra decimals are below fixed point resolution
+		if (mult < GPS_COORD_MAX_MULT) {
+			mult*=10;
+			val = val*10 + (*ptr-'0');
+		}
 		pos++;
 		ptr++;
 	}
 
-	*Coord = (int32_t)(((((int64_t)*Coord)<<(GPS_FIXED_POINT_DEG+1))/mult+1)>>1);
+	*Coord = (int32_t)(((val<<(GPS_FIXED_POINT_DEG+1))/mult+1)>>1);
 
 	return pos;
 }
 
 static int GPS_Parser_Get_Frac(int32_t * Val, char * ptr) {
 	int mult;
+	int digits = 0;
 
 	if (strlen(ptr) >=1) {
 		*Val = 0;
@@ -262,14 +273,21 @@ static int GPS_Parser_Get_Frac(int32_t * Val, char * ptr) {
 			mult = 1;
 
 		while (*ptr && *ptr!= '.') {
+			if (*ptr < '0' || *ptr > '9' || ++digits > GPS_FRAC_MAX_DIGITS)
+				return -1;
 			*Val = *Val*10 + (*ptr-'0');
 			ptr++;
 		}
 		if (*ptr == '.') {
 			ptr++;
 			while (*ptr) {
-				mult *= 10;
-				*Val = *Val*10 + (*ptr-'0');
+				if (*ptr < '0' || *ptr > '9')
+					return -1;
+				// Drop decimals that do not fit
+				if (++digits <= GPS_FRAC_MAX_DIGITS) {
+					mult *= 10;
+					*Val = *Val*10 + (*ptr-'0');
+				}
 				ptr++;
 			}
 		}
@@ -301,9 +319,12 @@ int GPS_Parser_RMC(GPS_Data_t * Data,char * ptr, uint8_t idx) {
 			}
 			return -1;
 		case 2: // Valid
-			Data->valid &= ~GPS_DATA_VALID;
+			Data->valid &= ~(GPS_DATA_VALID | GPS_DATA_VALID_FIX_STATUS);
 			if (strlen(ptr) == 1) {
 				Data->valid |= (*ptr=='A')?GPS_DATA_VALID:0;
+				// Fix status without mode field (NMEA < 2.3)
+				Data->fix_status = (*ptr=='A')?GPS_FIX_STATUS_AUTONOMOUS:GPS_FIX_STATUS_NOFIX;
+				Data->valid |= GPS_DATA_VALID_FIX_STATUS;
 				return 0;
 			}
 			return -1;
@@ -385,9 +406,8 @@ int GPS_Parser_RMC(GPS_Data_t * Data,char * ptr, uint8_t idx) {
 			}
 			Data->valid &= ~GPS_DATA_VALID_MAGVAR;
 			return -1;
-		case 12: // Fix status
-			Data->valid &= ~GPS_DATA_VALID_FIX_STATUS;
-			if (strlen(ptr) == 1) {
+		case 12: // Fix status, refine a valid status only
+			if (strlen(ptr) == 1 && Data->fix_status) {
 				if (*ptr == 'N')
 					Data->fix_status = GPS_FIX_STATUS_NOFIX;
 				else if (*ptr == 'A')
@@ -396,7 +416,6 @@ int GPS_Parser_RMC(GPS_Data_t * Data,char * ptr, uint8_t idx) {
 					Data->fix_status = GPS_FIX_STATUS_DIFFERENTIAL;
 				else
 					return -1;
-				Data->valid |= GPS_DATA_VALID_FIX_STATUS;
 				return 0;
 			}
 			return -1;
@@ -729,6 +748,84 @@ int GPS_Parser_GSA(GPS_Data_t * Data,char * ptr, uint8_t idx) {
 }
 
 int GPS_Parser_GLL(GPS_Data_t * Data,char * ptr, uint8_t idx) {
+	if (!Data || !ptr || idx>7 || *ptr == '\0')
+		return -1;
+
+	switch (idx) {
+		case 0:	// Sentence id
+			if (strlen(ptr) == 5 && !strcmp(ptr+2,"GLL")) {
+				strcpy(Data->type,ptr);
+				return 0;
+			}
+			return -1;
+		case 1: // Latitude
+			Data->valid &= ~GPS_DATA_VALID_LATITUDE;
+			if (GPS_Parser_Get_Coord(&Data->latitude,ptr) != -1) {
+				Data->valid |= GPS_DATA_VALID_LATITUDE;
+				return 0;
+			}
+			return -1;
+		case 2: // Latitude cardinal
+			if (Data->valid & GPS_DATA_VALID_LATITUDE && strlen(ptr) == 1) {
+				if (*ptr == 'S') {
+					Data->latitude = -Data->latitude;
+					return 0;
+				}
+				else if (*ptr == 'N') {
+					return 0;
+				}
+			}
+			Data->valid &= ~GPS_DATA_VALID_LATITUDE;
+			return -1;
+		case 3: // Longitude
+			Data->valid &= ~GPS_DATA_VALID_LONGITUDE;
+			if (GPS_Parser_Get_Coord(&Data->longitude,ptr) != -1) {
+				Data->valid |= GPS_DATA_VALID_LONGITUDE;
+				return 0;
+			}
+			return -1;
+		case 4: // Longitude cardinal
+			if (Data->valid & GPS_DATA_VALID_LONGITUDE && strlen(ptr) == 1) {
+				if (*ptr == 'W') {
+					Data->longitude = -Data->longitude;
+					return 0;
+				}
+				else if (*ptr == 'E') {
+					return 0;
+				}
+			}
+			Data->valid &= ~GPS_DATA_VALID_LONGITUDE;
+			return -1;
+		case 5: // Time
+			Data->valid &= ~GPS_DATA_VALID_TIME;
+			if (!GPS_Parser_Get_Time(&Data->time,ptr)) {
+				Data->valid |= GPS_DATA_VALID_TIME;
+				return 0;
+			}
+			return -1;
+		case 6: // Valid
+			Data->valid &= ~GPS_DATA_VALID_FIX_STATUS;
+			if (strlen(ptr) == 1) {
+				Data->fix_status = (*ptr=='A')?GPS_FIX_STATUS_AUTONOMOUS:GPS_FIX_STATUS_NOFIX;
+				Data->valid |= GPS_DATA_VALID_FIX_STATUS;
+				return 0;
+			}
+			return -1;
+		case 7: // Mode (NMEA 2.3)
+			if (strlen(ptr) == 1 && Data->fix_status) {
+				if (*ptr == 'N')
+					Data->fix_status = GPS_FIX_STATUS_NOFIX;
+				else if (*ptr == 'D')
+					Data->fix_status = GPS_FIX_STATUS_DIFFERENTIAL;
+				else if (*ptr == 'E')
+					Data->fix_status = GPS_FIX_STATUS_ESTIMATED;
+				else if (*ptr != 'A')
+					return -1;
+				return 0;
+			}
+			return -1;
+	}
+
 	return -1;
 }
 
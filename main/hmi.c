@@ -22,6 +22,7 @@
  */
 
 #include "hmi.h"
+#include "main.h"
 
 #include <string.h>
 #include <sys/time.h>
@@ -31,13 +32,9 @@
 #include <driver/gpio.h>
 #include <esp_event.h>
 
-ESP_EVENT_DECLARE_BASE(MAIN_EVENT);
 ESP_EVENT_DECLARE_BASE(APRS_EVENT);
 ESP_EVENT_DECLARE_BASE(GPS_EVENT);
 
-#define MAIN_EVENT_RSSI	0
-#define MAIN_EVENT_BATTERY	1
-
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/queue.h>
@@ -46,6 +43,7 @@ ESP_EVENT_DECLARE_BASE(GPS_EVENT);
 #include "lv_theme/lv_theme_mono_epd.h"
 
 #include "aprs.h"
+#include "aprs_parsers.h"
 #include "gps.h"
 
 #define TAG	"HMI"
@@ -491,9 +489,10 @@ static void HMI_Update_Station(HMI_t *Hmi) {
 
 	if (Hmi->sta.course.speed || Hmi->sta.course.dir) {
 
-		snprintf(txt, sizeof(txt), "%s : %03d° %03dkn",
+		snprintf(txt, sizeof(txt), "%s : %03d° %03d%s",
 				(Hmi->sta.symbol[1] == '_')?"Wind":"Course",
-				Hmi->sta.course.dir, Hmi->sta.course.speed);
+				Hmi->sta.course.dir, Hmi->sta.course.speed,
+				(Hmi->sta.symbol[1] == '_')?"mph":"kn");
 		lv_label_set_text(Hmi->sta_course, txt);
 		lv_obj_clear_flag(Hmi->sta_course, LV_OBJ_FLAG_HIDDEN);
 	} else
@@ -607,7 +606,7 @@ static void HMI_Prepare_Menu(HMI_t * Hmi) {
 	lv_obj_set_width(((lv_menu_t*)Hmi->w_menu)->sidebar, LV_PCT(20));
 }
 
-static void HMI_Aprs_Event(HMI_t * Hmi, esp_event_base_t event_base, int32_t event_id, APRS_Data_t * Data);
+static void HMI_Aprs_Event(HMI_t * Hmi, esp_event_base_t event_base, int32_t event_id, APRS_Event_Data_t * Data);
 
 static void HMI_Prepare_Rx(HMI_t *Hmi) {
 
@@ -927,7 +926,8 @@ void HMI_Prepare(HMI_t * Hmi) {
 	lv_menu_set_page(Hmi->w_menu, Hmi->w_rx);
 //	lv_group_focus_obj(Hmi->menu_station);
 
-	esp_event_handler_register(APRS_EVENT, ESP_EVENT_ANY_ID, (esp_event_handler_t)HMI_Aprs_Event, (void*)Hmi);
+	esp_event_handler_register(APRS_EVENT, APRS_EVENT_RECEIVE, (esp_event_handler_t)HMI_Aprs_Event, (void*)Hmi);
+	esp_event_handler_register(APRS_EVENT, APRS_EVENT_MESSAGE, (esp_event_handler_t)HMI_Aprs_Event, (void*)Hmi);
 	esp_event_handler_register(GPS_EVENT, GPS_PARSER_RMC, (esp_event_handler_t)HMI_Gps_Event_RMC, (void*)Hmi);
 	esp_event_handler_register(MAIN_EVENT, MAIN_EVENT_BATTERY, (esp_event_handler_t)HMI_Battery_Event, (void*)Hmi);
 	esp_event_handler_register(MAIN_EVENT, MAIN_EVENT_RSSI, (esp_event_handler_t)HMI_Rssi_Event, (void*)Hmi);
@@ -1004,7 +1004,7 @@ static void HMI_Rssi_Event(HMI_t * Hmi, esp_event_base_t event_base, int32_t eve
 	}
 }
 
-static void HMI_Aprs_Event(HMI_t * Hmi, esp_event_base_t event_base, int32_t event_id, APRS_Data_t * Data) {
+static void HMI_Aprs_Event(HMI_t * Hmi, esp_event_base_t event_base, int32_t event_id, APRS_Event_Data_t * Data) {
 	int i, cnt;
 	lv_obj_t * btn, *found;
 	AX25_Addr_t * addr;
@@ -1030,7 +1030,7 @@ static void HMI_Aprs_Event(HMI_t * Hmi, esp_event_base_t event_base, int32_t eve
 		ESP_LOGV(TAG,"rx list chlid %d : %s",i,lv_label_get_text(lv_obj_get_child(btn,0)));
 		addr = (AX25_Addr_t*)lv_obj_get_user_data(btn);
 		if (addr) {
-			if (!AX25_Addr_Cmp(addr,&Data->address[1])) {
+			if (!AX25_Addr_Cmp(addr,&Data->src)) {
 				ESP_LOGD(TAG,"Existing Button found");
 				found = btn;
 				break;
@@ -1046,7 +1046,7 @@ static void HMI_Aprs_Event(HMI_t * Hmi, esp_event_base_t event_base, int32_t eve
 	if (cnt >= HMI_RX_LIST_MAX_CNT && i == cnt && !found && addr) {
 		ESP_LOGD(TAG,"Recycling button %d",cnt-1);
 		found = btn;
-		memcpy(addr,&Data->address[1],sizeof(AX25_Addr_t));
+		memcpy(addr,&Data->src,sizeof(AX25_Addr_t));
 	}
 
 	// Create button text
@@ -1054,16 +1054,21 @@ static void HMI_Aprs_Event(HMI_t * Hmi, esp_event_base_t event_base, int32_t eve
 	i = strftime(txt,sizeof(txt),"%H:%M ",&tm);
 	i+= HMI_Add_Symbol(Data->symbol, txt+i);
 	txt[i++] = ' ';
-	i+= AX25_Addr_To_Str(&Data->address[1],txt+i,sizeof(txt)-i);
+	i+= AX25_Addr_To_Str(&Data->src,txt+i,sizeof(txt)-i);
 	if (i && txt[i-1] == '*')
 		i--;
 	if (Data->from >1) {
 		txt[i] = ' ';
 		i++;
-		i+= AX25_Addr_To_Str(&Data->address[Data->from],txt+i,sizeof(txt)-i);
+		i+= AX25_Addr_To_Str(&Data->via,txt+i,sizeof(txt)-i);
 		if (i && txt[i-1] == '*')
 			i--;
 	}
+	if (event_id == APRS_EVENT_MESSAGE && i < sizeof(txt)-2) {	// Message for us
+		txt[i++] = ' ';
+		txt[i++] = ':';
+		i += APRS_Event_Text(Data, txt+i, sizeof(txt)-i);
+	}
 	txt[i] = '\0';
 
 	if (!found) {
@@ -1073,7 +1078,7 @@ static void HMI_Aprs_Event(HMI_t * Hmi, esp_event_base_t event_base, int32_t eve
 			HMI_UNLOCK;
 			return;
 		}
-		memcpy(addr,&Data->address[1],sizeof(AX25_Addr_t));
+		memcpy(addr,&Data->src,sizeof(AX25_Addr_t));
 		btn = lv_list_add_btn(Hmi->rx_list,NULL,txt);
 		if (!btn) {
 			ESP_LOGE(TAG,"Error creating new button");
@@ -1140,15 +1145,16 @@ static void HMI_Aprs_Event(HMI_t * Hmi, esp_event_base_t event_base, int32_t eve
 
 			}
 
-			memcpy(Hmi->sta.status, Data->text, sizeof(Hmi->sta.status));
-		} else if (Data->type != APRS_DTI_STATUS)
+			if (event_id != APRS_EVENT_MESSAGE)
+				APRS_Event_Text(Data, Hmi->sta.status, sizeof(Hmi->sta.status));
+		} else if (Data->type != APRS_DTI_STATUS && event_id != APRS_EVENT_MESSAGE)
 			// Show comment
-			memcpy(Hmi->sta.status, Data->text, sizeof(Hmi->sta.status));
+			APRS_Event_Text(Data, Hmi->sta.status, sizeof(Hmi->sta.status));
 
 		HMI_Update_Station(Hmi);
 	}
 
-	memcpy(&Hmi->lastid, &Data->address[1], sizeof(AX25_Addr_t));
+	memcpy(&Hmi->lastid, &Data->src, sizeof(AX25_Addr_t));
 
 	HMI_UNLOCK;
 }
@@ -27,17 +27,20 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
+#include <sys/select.h>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/semphr.h>
+#include <freertos/queue.h>
 
 #include <esp_log.h>
 #include <esp_rom_crc.h>
+#include <esp_vfs_eventfd.h>
 
 #include "hdlc_dec.h"
 #include "framebuff.h"
-#include "aprs.h"
 #include "ax25_lm.h"
 
 #define TAG "KISS"
@@ -50,41 +53,115 @@
 #endif
 #define KISS_TASK_PRIORITY	2
 #define KISS_TASK_DELAY		100
-#define KISS_MAX_FRAME_LEN	(HDLC_MAX_FRAME_LEN*2+3)
+#define KISS_MAX_FRAME_LEN	(HDLC_MAX_FRAME_LEN*2+8)	// Escaped cmd, data and smack crc
 #define KISS_MAX_OUT_FRAMES		3
-#define KISS_MAX_IN_FRAMES		10
+#define KISS_MAX_IN_FRAMES		16
 
 #define KISS_FEND		0xC0
 #define KISS_FESC		0XDB
 #define KISS_TFEND		0xDC
 #define KISS_TFESC		0xDD
 
-#define KISS_WAIT_MS	100
-#define KISS_FRAME_NUM	5
+#define KISS_CMD_DATA		0x00
+#define KISS_CMD_SETHW		0x06
+#define KISS_CMD_ACKMODE	0x0C
+#define KISS_CMD_RETURN		0xFF
+#define KISS_SMACK		0x80	// Smack crc flag in cmd byte
+
+#define KISS_MAX_ACKS		8
+#ifndef KISS_ACK_TIMEOUT_MS
+#define KISS_ACK_TIMEOUT_MS	60000	// Ackmode frame not sent by then is forgotten
+#endif
+
+#define KISS_SELECT_TO_MS	1000
+#define KISS_IN_BUFF_LEN	(KISS_MAX_FRAME_LEN*2)
+#define KISS_OUT_BUFF_LEN	256
+
+// Host to radio decoder state
+typedef enum {
+	KISS_OUT_IDLE = 0,	// Waiting for FEND
+	KISS_OUT_CMD,		// Waiting for command byte
+	KISS_OUT_DATA,		// Receiving data frame
+	KISS_OUT_ESC,		// FESC received in data frame
+	KISS_OUT_SKIP,		// Skip until next FEND
+} Kiss_Out_State_t;
+
+typedef struct Kiss_Port_S {
+	Kiss_t * kiss;
+	int num;
+	Kiss_Port_Type_t type;
+	AX25_Lm_t * ax25_lm;
+	AX25_Addr_t filter[AX25_MAX_ADDR];
+	bool filter_set;
+} Kiss_Port_t;
+
+// Frame priority to host, lower first
+#define KISS_PRIO_LOCAL		0
+#define KISS_PRIO_DIRECT	1	// Heard directly
+#define KISS_PRIO_DIGI		2	// Heard via one digipeater
+#define KISS_PRIO_MULTI_DIGI	3	// Heard via more digipeaters
+
+typedef struct Kiss_In_Entry_S {
+	Frame_t * frame;
+	uint32_t seq;
+	uint8_t port;
+	uint8_t prio;
+} Kiss_In_Entry_t;
+
+// Ackmode frame waiting for transmission
+typedef struct Kiss_Ack_S {
+	Frame_t * frame;
+	TickType_t time;
+	uint8_t port;
+	uint16_t id;
+} Kiss_Ack_t;
 
 struct Kiss_S {
 	const char * path;
 	int uart_fd;
-	AX25_Lm_t * ax25_lm;
-	TaskHandle_t task;
-	uint8_t in_buff[KISS_MAX_FRAME_LEN];
+	int event_fd;
+	Kiss_Port_t ports[KISS_MAX_PORTS];
+	// IN path : radio to host, bounded priority queue
+	Kiss_In_Entry_t in_queue[KISS_MAX_IN_FRAMES];
+	int in_count;
+	uint32_t in_seq;
+	SemaphoreHandle_t in_lock;
+	StaticSemaphore_t in_lock_buff;
+	Kiss_Drop_Policy_t drop_policy;
+	uint32_t drops[KISS_DROP_REASON_MAX];
+	bool credit_mode;
+	uint32_t credits;
+	// Pre escaped frames
+	uint8_t in_buff[KISS_IN_BUFF_LEN];
 	size_t in_len, in_pos;
-	uint8_t out_buff[KISS_MAX_FRAME_LEN];
-	size_t out_pos;
-	uint8_t out_last;
+	bool smack;	// Host speak smack
+	// Acks
+	Kiss_Ack_t acks[KISS_MAX_ACKS];
+	SemaphoreHandle_t ack_lock;
+	StaticSemaphore_t ack_lock_buff;
+	QueueHandle_t ack_queue;
+	StaticQueue_t ack_queue_data;
+	uint8_t ack_queue_buff[KISS_MAX_ACKS*sizeof(Kiss_Ack_t)];
+	// OUT path : host to radio
+	uint8_t out_buff[KISS_OUT_BUFF_LEN];
+	Kiss_Out_State_t out_state;
+	Kiss_Port_t * out_port;
+	uint8_t out_cmd;
+	uint16_t out_crc;
 	Frame_t * out_frame;
-	Frame_t * in_frame;
-	bool out_enable;
-	Frame_t * last_sent;
-	SemaphoreHandle_t sem;
-	StaticSemaphore_t sem_buff;
+	size_t out_pos;
 	Framebuff_t * out_framebuff;
-	Framebuff_t * in_framebuff;
-	uint8_t *pool;
+	uint32_t crc_errors;
+	// Host frames loop back (local decoder)
+	Kiss_Loopback_t loopback;
+	void * loopback_ctx;
+	// Extra SetHardware commands
+	Kiss_Hw_Command_t hw_command;
+	Kiss_Hw_Source_t hw_source;
+	void * hw_ctx;
+	uint8_t hw_buff[HDLC_MAX_FRAME_LEN];
 };
 
-extern APRS_t * Aprs;
-
 struct {
 	TaskHandle_t handle;
 	StackType_t	stack[(KISS_TASK_STACK_SIZE)/sizeof(StackType_t)];
@@ -93,15 +170,12 @@ struct {
 
 static void Kiss_Task(void * arg);
 
+static int Kiss_Port_Frame_Received_Cb(Kiss_Port_t * Port, Frame_t * Frame);
+static int Kiss_Port_Data_Confirm_Cb(Kiss_Port_t * Port, Frame_t * Frame);
+
 Kiss_t * Kiss_Init(const char *path, AX25_Lm_t * Ax25_Lm) {
 
 	Kiss_t *kiss;
-	AX25_Lm_Cbs_t cbs = {
-		.seize_confirm = NULL,
-		.data_indication = (typeof(cbs.data_indication))Kiss_Frame_Received_Cb,
-		.busy_indication = NULL,
-		.quiet_indication = NULL
-	};
 
 	if (!path || !Ax25_Lm)
 		return NULL;
@@ -116,48 +190,725 @@ Kiss_t * Kiss_Init(const char *path, AX25_Lm_t * Ax25_Lm) {
 	kiss->path = path;
 	kiss->uart_fd = -1;
 
-	kiss->ax25_lm = Ax25_Lm;
-	AX25_Lm_Register_Dl(kiss->ax25_lm, kiss, &cbs, NULL); // Get All frames from phy
-
-	kiss->sem = xSemaphoreCreateBinaryStatic(&kiss->sem_buff);
+	// Used to wake up task when frame is queued
+	kiss->event_fd = eventfd(0, 0);
+	if (kiss->event_fd < 0) {
+		ESP_LOGE(TAG,"Error creating eventfd");
+		free(kiss);
+		return NULL;
+	}
 
 	kiss->out_framebuff = Framebuff_Init(KISS_MAX_OUT_FRAMES,HDLC_MAX_FRAME_LEN);	
 	ESP_LOGD(TAG,"Init out buffer %p",kiss->out_framebuff);
-	kiss->in_framebuff = Framebuff_Init(KISS_MAX_IN_FRAMES,0);
-	ESP_LOGD(TAG,"Init in buffer %p",kiss->in_framebuff);
+
+	kiss->in_lock = xSemaphoreCreateMutexStatic(&kiss->in_lock_buff);
+#ifdef CONFIG_ESP32S3APRS_KISS_DROP_NEWEST
+	kiss->drop_policy = KISS_DROP_NEWEST;
+#else
+	kiss->drop_policy = KISS_DROP_OLDEST;
+#endif
+
+	kiss->ack_lock = xSemaphoreCreateMutexStatic(&kiss->ack_lock_buff);
+	kiss->ack_queue = xQueueCreateStatic(KISS_MAX_ACKS,sizeof(Kiss_Ack_t),kiss->ack_queue_buff,&kiss->ack_queue_data);
+
+	// Port 0 is the main radio
+	if (Kiss_Add_Port(kiss, 0, KISS_PORT_RADIO, Ax25_Lm, NULL)) {
+		close(kiss->event_fd);
+		free(kiss);
+		return NULL;
+	}
 
 	int i= 0;
 	while (Kiss_Tasks[i].handle && i < KISS_NUM_STATIC_TASK) i++;
 	if (i == KISS_NUM_STATIC_TASK) {
 		ESP_LOGE(TAG,"Error creating task\n");
-		AX25_Lm_Unregister_Dl(kiss->ax25_lm, kiss);
+		AX25_Lm_Unregister_Dl(Ax25_Lm, &kiss->ports[0]);
+		close(kiss->event_fd);
 		free(kiss);
 		return NULL;
 	}
 
 	Kiss_Tasks[i].handle = xTaskCreateStaticPinnedToCore(Kiss_Task,"Kiss", KISS_TASK_STACK_SIZE, kiss, KISS_TASK_PRIORITY, Kiss_Tasks[i].stack, &Kiss_Tasks[i].buffer, APP_CPU_NUM);
-	
-	/*if (pdPASS != xTaskCreate(Kiss_Task,"Kiss",KISS_TASK_STACK_SIZE,kiss,KISS_TASK_PRIORITY,&kiss->task)) {
-		ESP_LOGE(TAG,"Error creating task\n");
-		AX25_Lm_Unregister_Dl(kiss->ax25_lm, kiss);
-		close(fd);
-		free(kiss);
-		return NULL;
-	}*/
 
 	return kiss;
 }
 
+int Kiss_Add_Port(Kiss_t * Kiss, int Port, Kiss_Port_Type_t Type, AX25_Lm_t * Ax25_Lm, AX25_Addr_t * Filter) {
+	Kiss_Port_t * port;
+	AX25_Lm_Cbs_t cbs = {
+		.seize_confirm = NULL,
+		.data_indication = (typeof(cbs.data_indication))Kiss_Port_Frame_Received_Cb,
+		.busy_indication = NULL,
+		.quiet_indication = NULL,
+		.data_confirm = (typeof(cbs.data_confirm))Kiss_Port_Data_Confirm_Cb
+	};
+
+	if (!Kiss || Port < 0 || Port >= KISS_MAX_PORTS || Type == KISS_PORT_NONE)
+		return -1;
+
+	if (Type == KISS_PORT_RADIO && !Ax25_Lm)
+		return -1;
+
+	port = &Kiss->ports[Port];
+	if (port->type != KISS_PORT_NONE) {
+		ESP_LOGE(TAG,"Port %d already used", Port);
+		return -1;
+	}
+
+	port->kiss = Kiss;
+	port->num = Port;
+	port->ax25_lm = Ax25_Lm;
+
+	if (Filter && Filter->addr[0]) {
+		memcpy(port->filter, Filter, sizeof(AX25_Addr_t)*AX25_Addr_Count(Filter));
+		port->filter_set = true;
+	}
+
+	if (Type == KISS_PORT_RADIO)
+		AX25_Lm_Register_Dl(Ax25_Lm, port, &cbs, NULL); // Get All frames from phy, filtered by port
+
+	port->type = Type;
+
+	ESP_LOGI(TAG,"Port %d added (type %d)", Port, Type);
+
+	return 0;
+}
+
+int Kiss_Set_Loopback(Kiss_t * Kiss, Kiss_Loopback_t Loopback, void * Ctx) {
+	if (!Kiss)
+		return -1;
+
+	Kiss->loopback_ctx = Ctx;
+	Kiss->loopback = Loopback;
+
+	return 0;
+}
+
+int Kiss_Set_Hardware(Kiss_t * Kiss, Kiss_Hw_Command_t Command, Kiss_Hw_Source_t Source, void * Ctx) {
+	if (!Kiss)
+		return -1;
+
+	Kiss->hw_ctx = Ctx;
+	Kiss->hw_command = Command;
+	Kiss->hw_source = Source;
+
+	return 0;
+}
+
+int Kiss_Set_Drop_Policy(Kiss_t * Kiss, Kiss_Drop_Policy_t Policy) {
+	if (!Kiss || (Policy != KISS_DROP_OLDEST && Policy != KISS_DROP_NEWEST))
+		return -1;
+
+	Kiss->drop_policy = Policy;
+
+	return 0;
+}
+
+uint32_t Kiss_Get_Drop_Count(Kiss_t * Kiss, Kiss_Drop_Reason_t Reason) {
+	uint32_t count;
+
+	if (!Kiss || Reason >= KISS_DROP_REASON_MAX)
+		return 0;
+
+	xSemaphoreTake(Kiss->in_lock, portMAX_DELAY);
+	count = Kiss->drops[Reason];
+	xSemaphoreGive(Kiss->in_lock);
+
+	return count;
+}
+
+int Kiss_Get_Pending_Acks(Kiss_t * Kiss) {
+	int i, count = 0;
+
+	if (!Kiss)
+		return -1;
+
+	xSemaphoreTake(Kiss->ack_lock, portMAX_DELAY);
+	for (i=0 ; i<KISS_MAX_ACKS ; i++)
+		if (Kiss->acks[i].frame)
+			count++;
+	xSemaphoreGive(Kiss->ack_lock);
+
+	return count;
+}
+
+uint32_t Kiss_Get_Crc_Errors(Kiss_t * Kiss) {
+	return Kiss ? Kiss->crc_errors : 0;
+}
+
+// Count a dropped frame, in_lock held, return drops for Reason
+static uint32_t Kiss_Drop(Kiss_t * Kiss, Kiss_Drop_Reason_t Reason) {
+	return ++Kiss->drops[Reason];
+}
+
+// Direct frames first, then by number of digipeaters used
+static uint8_t Kiss_Frame_Prio(Frame_t * Frame) {
+	AX25_Addr_t * addr = (AX25_Addr_t*)Frame->frame;
+	int n, hops = 0;
+
+	n = AX25_Addr_Count(addr);
+	if (n > 2 && (size_t)n*sizeof(AX25_Addr_t) <= Frame->frame_len) {
+		for (addr += 2, n -= 2 ; n ; n--, addr++)
+			if (addr->ssid & 0x80)
+				hops++;
+	}
+
+	if (!hops)
+		return KISS_PRIO_DIRECT;
+	if (hops == 1)
+		return KISS_PRIO_DIGI;
+	return KISS_PRIO_MULTI_DIGI;
+}
+
+// Put frame in priority queue, applying drop policy when full
+static int Kiss_Queue_Frame(Kiss_t * Kiss, int Port, uint8_t Prio, Frame_t * Frame) {
+	Kiss_In_Entry_t * entry = NULL, * victim = NULL;
+	Kiss_Drop_Reason_t reason = KISS_DROP_REASON_MAX;
+	uint32_t drops = 0;
+	uint64_t event = 1;
+	int i;
+
+	xSemaphoreTake(Kiss->in_lock, portMAX_DELAY);
+
+	if (Frame->frame_len < HDLC_MIN_FRAME_LEN || Frame->frame_len > HDLC_MAX_FRAME_LEN)
+		reason = KISS_DROP_REASON_LENGTH;
+	else if (Kiss->in_count < KISS_MAX_IN_FRAMES)
+		entry = &Kiss->in_queue[Kiss->in_count++];
+	else {
+		// Oldest frame of lowest priority
+		for (i=0 ; i<KISS_MAX_IN_FRAMES ; i++)
+			if (!victim || Kiss->in_queue[i].prio > victim->prio
+					|| (Kiss->in_queue[i].prio == victim->prio && Kiss->in_queue[i].seq < victim->seq))
+				victim = &Kiss->in_queue[i];
+
+		if (victim->prio > Prio)
+			reason = KISS_DROP_REASON_PREEMPTED;
+		else if (victim->prio == Prio && Kiss->drop_policy == KISS_DROP_OLDEST)
+			reason = KISS_DROP_REASON_EVICTED;
+		else
+			reason = KISS_DROP_REASON_FULL;
+
+		if (reason != KISS_DROP_REASON_FULL) {
+			Framebuff_Free_Frame(victim->frame);
+			entry = victim;
+		}
+	}
+
+	if (reason != KISS_DROP_REASON_MAX)
+		drops = Kiss_Drop(Kiss, reason);
+
+	if (entry) {
+		Framebuff_Inc_Frame_Usage(Frame);
+		entry->frame = Frame;
+		entry->seq = Kiss->in_seq++;
+		entry->port = Port;
+		entry->prio = Prio;
+	}
+
+	xSemaphoreGive(Kiss->in_lock);
+
+	if (reason != KISS_DROP_REASON_MAX)
+		ESP_LOGW(TAG,"Frame dropped, reason %d (%lu)", reason, (unsigned long)drops);
+
+	if (!entry)
+		return -1;
+
+	// Wake up task
+	write(Kiss->event_fd, &event, sizeof(event));
+
+	return 0;
+}
+
+// Get highest priority, oldest frame
+static int Kiss_Dequeue_Frame(Kiss_t * Kiss, Kiss_In_Entry_t * Entry) {
+	int i, best = -1;
+
+	xSemaphoreTake(Kiss->in_lock, portMAX_DELAY);
+
+	for (i=0 ; i<Kiss->in_count ; i++)
+		if (best < 0 || Kiss->in_queue[i].prio < Kiss->in_queue[best].prio
+				|| (Kiss->in_queue[i].prio == Kiss->in_queue[best].prio && Kiss->in_queue[i].seq < Kiss->in_queue[best].seq))
+			best = i;
+
+	if (best < 0) {
+		xSemaphoreGive(Kiss->in_lock);
+		return -1;
+	}
+
+	*Entry = Kiss->in_queue[best];
+	Kiss->in_queue[best] = Kiss->in_queue[--Kiss->in_count];
+
+	xSemaphoreGive(Kiss->in_lock);
+
+	return 0;
+}
+
+// Frame from radio
+static int Kiss_Port_Frame_Received_Cb(Kiss_Port_t * Port, Frame_t * Frame) {
+	if (!Port || !Frame || Frame->frame_len < HDLC_MIN_FRAME_LEN)
+		return 0;
+
+	if (Port->filter_set && AX25_Addr_Filter((AX25_Addr_t*)Frame->frame, Port->filter))
+		return 0;
+
+	Kiss_Queue_Frame(Port->kiss, Port->num, Kiss_Frame_Prio(Frame), Frame);
+
+	return 0;
+}
+
+// Smack crc (CRC-16, poly 0x8005 reflected)
+static uint16_t Kiss_Smack_Crc(uint16_t Crc, const uint8_t * Data, size_t Len) {
+	int i;
+
+	while (Len--) {
+		Crc ^= *(Data++);
+		for (i=0;i<8;i++)
+			Crc = (Crc&1) ? (Crc>>1)^0xA001 : Crc>>1;
+	}
+
+	return Crc;
+}
+
+static inline uint8_t * Kiss_In_Put(uint8_t * In, uint8_t C) {
+	switch (C) {
+		case KISS_FEND:
+			*(In++) = KISS_FESC;
+			*(In++) = KISS_TFEND;
+			break;
+		case KISS_FESC:
+			*(In++) = KISS_FESC;
+			*(In++) = KISS_TFESC;
+			break;
+		default:
+			*(In++) = C;
+			break;
+	}
+
+	return In;
+}
+
+// Escape one kiss frame into in_buff
+static void Kiss_In_Escape(Kiss_t * Kiss, uint8_t Cmd, const uint8_t * Data, size_t Len) {
+	uint8_t * in;
+	size_t i;
+	uint16_t crc;
+
+	if (Kiss->smack) {
+		// Smack flag is port MSB, only ports 0 to 7 can be told to host
+		if (Cmd & KISS_SMACK) {
+			ESP_LOGW(TAG,"Port %d not reachable in smack mode", Cmd>>4);
+			return;
+		}
+		Cmd |= KISS_SMACK;
+	}
+
+	in = Kiss->in_buff + Kiss->in_len;
+	*(in++) = KISS_FEND;
+	in = Kiss_In_Put(in, Cmd);
+	for (i=0;i<Len;i++)
+		in = Kiss_In_Put(in, Data[i]);
+
+	if (Kiss->smack) {
+		crc = Kiss_Smack_Crc(0, &Cmd, 1);
+		crc = Kiss_Smack_Crc(crc, Data, Len);
+		in = Kiss_In_Put(in, crc&0xff);
+		in = Kiss_In_Put(in, (crc>>8)&0xff);
+	}
+
+	*(in++) = KISS_FEND;
+	Kiss->in_len = in - Kiss->in_buff;
+}
+
+static void Kiss_In_Escape_Frame(Kiss_t * Kiss, int Port, Frame_t * Frame) {
+	size_t len;
+
+	ESP_LOGD(TAG,"Received frame : %p on port %d",Frame, Port);
+	len = Frame->frame_len-2;
+	if (Frame->frame_len > 2 && len <= HDLC_MAX_FRAME_LEN-2)
+		Kiss_In_Escape(Kiss, (Port<<4) | KISS_CMD_DATA, Frame->frame, len);
+}
+
+// Escape queued frames into in_buff while there is room for a full frame
+static void Kiss_In_Fill(Kiss_t * Kiss) {
+	Kiss_In_Entry_t entry;
+	Kiss_Ack_t ack;
+	uint8_t id[2];
+	int len;
+
+	if (Kiss->in_pos == Kiss->in_len) {
+		Kiss->in_pos = 0;
+		Kiss->in_len = 0;
+	}
+
+	// Acks first
+	while (KISS_IN_BUFF_LEN - Kiss->in_len >= KISS_MAX_FRAME_LEN && xQueueReceive(Kiss->ack_queue, &ack, 0) == pdPASS) {
+		id[0] = (ack.id>>8)&0xff;
+		id[1] = ack.id&0xff;
+		Kiss_In_Escape(Kiss, (ack.port<<4) | KISS_CMD_ACKMODE, id, 2);
+	}
+
+	// Frames, if host gave us credits
+	while ((!Kiss->credit_mode || Kiss->credits) && KISS_IN_BUFF_LEN - Kiss->in_len >= KISS_MAX_FRAME_LEN
+			&& !Kiss_Dequeue_Frame(Kiss, &entry)) {
+		Kiss_In_Escape_Frame(Kiss, entry.port, entry.frame);
+		Framebuff_Free_Frame(entry.frame);
+		if (Kiss->credit_mode)
+			Kiss->credits--;
+	}
+
+	// Then SetHardware replies and streams
+	while (Kiss->hw_source && KISS_IN_BUFF_LEN - Kiss->in_len >= KISS_MAX_FRAME_LEN
+			&& (len = Kiss->hw_source(Kiss->hw_ctx, Kiss->hw_buff, sizeof(Kiss->hw_buff))) > 0)
+		Kiss_In_Escape(Kiss, KISS_CMD_SETHW, Kiss->hw_buff, len);
+}
+
+// Write as much pre escaped data as possible
+static void Kiss_In_Write(Kiss_t * Kiss) {
+	int ret;
+
+	if (Kiss->in_len == Kiss->in_pos)
+		return;
+
+	ret = write(Kiss->uart_fd,Kiss->in_buff+Kiss->in_pos,Kiss->in_len-Kiss->in_pos);
+	if (ret > 0)
+		Kiss->in_pos += ret;
+	else if (ret < 0 && errno != EWOULDBLOCK && errno != EAGAIN) {
+		ESP_LOGE(TAG, "Error writing kiss frame");
+		Kiss->in_pos = Kiss->in_len;
+	}
+}
+
+// Queue ack to host
+static void Kiss_Ack_Send(Kiss_t * Kiss, uint8_t Port, uint16_t Id) {
+	uint64_t event = 1;
+	Kiss_Ack_t ack = {
+		.frame = NULL,
+		.port = Port,
+		.id = Id
+	};
+
+	if (xQueueSend(Kiss->ack_queue, &ack, 0) != pdPASS) {
+		ESP_LOGE(TAG,"Ack queue full");
+		return;
+	}
+
+	// Wake up task
+	write(Kiss->event_fd, &event, sizeof(event));
+}
+
+// Forget ackmode frames never sent, ack_lock held
+static void Kiss_Ack_Expire(Kiss_t * Kiss, TickType_t Now) {
+	int i;
+
+	for (i=0 ; i<KISS_MAX_ACKS ; i++)
+		if (Kiss->acks[i].frame && Now - Kiss->acks[i].time > pdMS_TO_TICKS(KISS_ACK_TIMEOUT_MS)) {
+			ESP_LOGW(TAG,"Ack %d timeout on port %d", Kiss->acks[i].id, Kiss->acks[i].port);
+			Framebuff_Free_Frame(Kiss->acks[i].frame);
+			Kiss->acks[i].frame = NULL;
+		}
+}
+
+// Keep frame until phy confirm it was sent
+static int Kiss_Ack_Add(Kiss_t * Kiss, uint8_t Port, uint16_t Id, Frame_t * Frame) {
+	TickType_t now = xTaskGetTickCount();
+	int i, slot = -1;
+
+	xSemaphoreTake(Kiss->ack_lock, portMAX_DELAY);
+
+	Kiss_Ack_Expire(Kiss, now);
+	for (i=0 ; i<KISS_MAX_ACKS && slot < 0 ; i++)
+		if (!Kiss->acks[i].frame)
+			slot = i;
+
+	if (slot < 0) {
+		xSemaphoreGive(Kiss->ack_lock);
+		return -1;
+	}
+
+	Framebuff_Inc_Frame_Usage(Frame);
+	Kiss->acks[slot].frame = Frame;
+	Kiss->acks[slot].time = now;
+	Kiss->acks[slot].port = Port;
+	Kiss->acks[slot].id = Id;
+
+	xSemaphoreGive(Kiss->ack_lock);
+
+	return 0;
+}
+
+static int Kiss_Ack_Remove(Kiss_t * Kiss, Frame_t * Frame, Kiss_Ack_t * Ack) {
+	int i;
+
+	xSemaphoreTake(Kiss->ack_lock, portMAX_DELAY);
+
+	for (i=0 ; i<KISS_MAX_ACKS ; i++)
+		if (Kiss->acks[i].frame == Frame) {
+			if (Ack)
+				*Ack = Kiss->acks[i];
+			Kiss->acks[i].frame = NULL;
+			xSemaphoreGive(Kiss->ack_lock);
+			Framebuff_Free_Frame(Frame);
+			return 0;
+		}
+
+	xSemaphoreGive(Kiss->ack_lock);
+
+	return -1;
+}
+
+// Frame sent on air by phy
+static int Kiss_Port_Data_Confirm_Cb(Kiss_Port_t * Port, Frame_t * Frame) {
+	Kiss_Ack_t ack;
+
+	if (!Port || !Frame)
+		return 0;
+
+	if (!Kiss_Ack_Remove(Port->kiss, Frame, &ack))
+		Kiss_Ack_Send(Port->kiss, ack.port, ack.id);
+
+	return 0;
+}
+
+// Host specific commands
+static void Kiss_Out_Set_Hardware(Kiss_t * Kiss, const uint8_t * Data, size_t Len) {
+	if (!Len)
+		return;
+
+	switch (Data[0]) {
+		case KISS_HW_CREDIT:
+			if (Len < 2)
+				break;
+			if (!Kiss->credit_mode)
+				ESP_LOGI(TAG,"Credit flow control enabled");
+			Kiss->credit_mode = true;
+			Kiss->credits += Data[1];
+			break;
+		case KISS_HW_NO_CREDIT:
+			if (Kiss->credit_mode)
+				ESP_LOGI(TAG,"Credit flow control disabled");
+			Kiss->credit_mode = false;
+			Kiss->credits = 0;
+			break;
+		default:
+			if (Kiss->hw_command)
+				Kiss->hw_command(Kiss->hw_ctx, Data, Len);
+			else
+				ESP_LOGD(TAG,"Unknown set hardware command 0x%02x", Data[0]);
+			break;
+	}
+}
+
+// Frame fully received from host
+static void Kiss_Out_Frame(Kiss_t * Kiss) {
+	Kiss_Port_t * port = Kiss->out_port;
+	Frame_t * frame = Kiss->out_frame;
+	bool ackmode = (Kiss->out_cmd & 0x0f) == KISS_CMD_ACKMODE;
+	uint16_t crc, id = 0;
+
+	if (Kiss->out_cmd & KISS_SMACK) {
+		if (Kiss->out_crc || Kiss->out_pos < 2) {
+			Kiss->crc_errors++;
+			ESP_LOGW(TAG,"Smack crc error (%lu)", Kiss->crc_errors);
+			return;
+		}
+		Kiss->out_pos -= 2;
+		if (!Kiss->smack) {
+			ESP_LOGI(TAG,"Switching to smack mode");
+			Kiss->smack = true;
+		}
+	}
+
+	if ((Kiss->out_cmd & 0x0f) == KISS_CMD_SETHW) {
+		Kiss_Out_Set_Hardware(Kiss, frame->frame, Kiss->out_pos);
+		return;
+	}
+
+	if (ackmode) {
+		if (Kiss->out_pos < 2)
+			return;
+		id = (frame->frame[0]<<8) | frame->frame[1];
+		Kiss->out_pos -= 2;
+		memmove(frame->frame, frame->frame+2, Kiss->out_pos);
+	}
+
+	if (Kiss->out_pos < HDLC_MIN_FRAME_LEN || Kiss->out_pos > frame->frame_size-2) {
+		ESP_LOGW(TAG,"Invalid frame length %d", (int)Kiss->out_pos);
+		return;
+	}
+
+	// Add crc
+	crc = esp_rom_crc16_le(0,frame->frame,Kiss->out_pos);
+	frame->frame[Kiss->out_pos++] = (crc)&0xff;
+	frame->frame[Kiss->out_pos++] = (crc>>8)&0xff;
+	frame->frame_len = Kiss->out_pos;
+
+	switch (port->type) {
+		case KISS_PORT_RADIO:
+			// Ack will be sent when phy confirm transmission
+			if (ackmode && Kiss_Ack_Add(Kiss, port->num, id, frame)) {
+				ESP_LOGW(TAG,"Ack table full");
+				Kiss_Ack_Send(Kiss, port->num, id);
+				ackmode = false;
+			}
+
+			// Send it to transmiter
+			ESP_LOGI(TAG,"Send frame : %p on port %d",frame, port->num);
+			if (AX25_Lm_Data_Request(port->ax25_lm, port, frame) && ackmode)
+				Kiss_Ack_Remove(Kiss, frame, NULL);
+
+			// Loop back to local decoder
+			if (Kiss->loopback)
+				Kiss->loopback(Kiss->loopback_ctx, frame);
+			break;
+		case KISS_PORT_LOCAL:
+			// Only feed local decoder
+			if (Kiss->loopback)
+				Kiss->loopback(Kiss->loopback_ctx, frame);
+			if (ackmode)
+				Kiss_Ack_Send(Kiss, port->num, id);
+			break;
+		default:
+			break;
+	}
+
+	Framebuff_Free_Frame(frame);
+	Kiss->out_frame = NULL;
+}
+
+static void Kiss_Out_Store(Kiss_t * Kiss, uint8_t C) {
+	if (Kiss->out_pos >= Kiss->out_frame->frame_size) {
+		ESP_LOGE(TAG,"OUT Frame too long");
+		Kiss->out_state = KISS_OUT_SKIP;
+		return;
+	}
+
+	if (Kiss->out_cmd & KISS_SMACK)
+		Kiss->out_crc = Kiss_Smack_Crc(Kiss->out_crc, &C, 1);
+
+	Kiss->out_frame->frame[Kiss->out_pos++] = C;
+}
+
+// Byte stream unescaping state machine
+static void Kiss_Out_Decode(Kiss_t * Kiss, uint8_t C) {
+	switch (Kiss->out_state) {
+		case KISS_OUT_IDLE:
+			if (C == KISS_FEND)
+				Kiss->out_state = KISS_OUT_CMD;
+			break;
+		case KISS_OUT_CMD:
+			if (C == KISS_FEND) // Back to back FEND
+				break;
+
+			if (C == KISS_CMD_RETURN) { // Exit kiss
+				Kiss->out_state = KISS_OUT_SKIP;
+				break;
+			}
+
+			// High nibble is port number, MSB is smack flag
+			Kiss->out_cmd = C;
+			Kiss->out_port = &Kiss->ports[(C & KISS_SMACK) ? (C>>4)&0x07 : C>>4];
+			if (Kiss->out_port->type == KISS_PORT_NONE) {
+				ESP_LOGD(TAG,"Frame for unknown port %d", (int)(Kiss->out_port - Kiss->ports));
+				Kiss->out_state = KISS_OUT_SKIP;
+				break;
+			}
+
+			Kiss->out_crc = (C & KISS_SMACK) ? Kiss_Smack_Crc(0, &C, 1) : 0;
+
+			switch (C & 0x0f) {
+				case KISS_CMD_DATA: // Data frame
+				case KISS_CMD_ACKMODE: // Data frame with ack
+				case KISS_CMD_SETHW: // Set Hardware
+					if (!Kiss->out_frame)
+						Kiss->out_frame = Framebuff_Get_Frame(Kiss->out_framebuff);
+					if (Kiss->out_frame) {
+						Kiss->out_pos = 0;
+						Kiss->out_state = KISS_OUT_DATA;
+					} else {
+						ESP_LOGE(TAG,"No free out frame");
+						Kiss->out_state = KISS_OUT_SKIP;
+					}
+					break;
+				case 1: // TX Delay
+				case 2: // Persistence
+				case 3: // SlotTime
+				case 4: // Tx tail
+				case 5: // Full duplex
+				default:
+					Kiss->out_state = KISS_OUT_SKIP;
+					break;
+			}
+			break;
+		case KISS_OUT_DATA:
+			switch (C) {
+				case KISS_FEND:
+					Kiss_Out_Frame(Kiss);
+					Kiss->out_state = KISS_OUT_CMD;
+					break;
+				case KISS_FESC:
+					Kiss->out_state = KISS_OUT_ESC;
+					break;
+				default:
+					Kiss_Out_Store(Kiss, C);
+					break;
+			}
+			break;
+		case KISS_OUT_ESC:
+			switch (C) {
+				case KISS_TFEND:
+					Kiss->out_state = KISS_OUT_DATA;
+					Kiss_Out_Store(Kiss, KISS_FEND);
+					break;
+				case KISS_TFESC:
+					Kiss->out_state = KISS_OUT_DATA;
+					Kiss_Out_Store(Kiss, KISS_FESC);
+					break;
+				case KISS_FEND:
+					// Protocol error, resync
+					Kiss->out_state = KISS_OUT_CMD;
+					break;
+				default:
+					// Protocol error
+					Kiss->out_state = KISS_OUT_SKIP;
+					break;
+			}
+			break;
+		case KISS_OUT_SKIP:
+		default:
+			if (C == KISS_FEND)
+				Kiss->out_state = KISS_OUT_CMD;
+			break;
+	}
+}
+
+static void Kiss_Out_Read(Kiss_t * Kiss) {
+	int i, ret;
+
+	ret = read(Kiss->uart_fd,Kiss->out_buff,KISS_OUT_BUFF_LEN);
+	if (ret < 0) {
+		if (errno == EWOULDBLOCK || errno == EAGAIN)
+			return;
+		ESP_LOGE(TAG,"Error reading kiss port");
+		close(Kiss->uart_fd);
+		Kiss->uart_fd = -1;
+		Kiss->out_state = KISS_OUT_IDLE;
+		return;
+	}
+
+	for (i=0;i<ret;i++)
+		Kiss_Out_Decode(Kiss, Kiss->out_buff[i]);
+}
+
 // IN means from radio to pc
 static void Kiss_Task(void * arg) {
 	Kiss_t * kiss = (Kiss_t *)arg;
-	int i, ret;
-	size_t in_frame_len,out_len;
-	uint8_t * in, * out;
-	char c;
+	fd_set rfds, wfds;
+	struct timeval tv;
+	uint64_t event;
+	int maxfd, ret;
 
 	kiss->out_frame = NULL;
-	kiss->out_enable = false,
+	kiss->out_state = KISS_OUT_IDLE;
 	kiss->in_len = 0;
 	kiss->in_pos = 0;
 	kiss->out_pos = 0;
@@ -166,216 +917,67 @@ static void Kiss_Task(void * arg) {
 
 		if (kiss->uart_fd < 0) {
 			kiss->uart_fd = open(kiss->path,O_RDWR);
-			if (kiss->uart_fd < 0)
+			if (kiss->uart_fd < 0) {
 				vTaskDelay(pdMS_TO_TICKS(1000));
+				continue;
+			}
 		}
 
-		if (kiss->in_len == kiss->in_pos) {
-			kiss->in_frame = Framebuff_Get_Frame(kiss->in_framebuff);
-			if (kiss->in_frame) {
-				ESP_LOGD(TAG,"Received frame : %p",kiss->in_frame);
-				in_frame_len = kiss->in_frame->frame_len-2;
-				if (in_frame_len>0 && in_frame_len <= HDLC_MAX_FRAME_LEN-2) {
-					in = kiss->in_buff;
-					*(in++) = KISS_FEND;
-					*(in++) = 0;
-					kiss->in_len = 2;
-					for (i=0;i<in_frame_len;i++) {
-						c=kiss->in_frame->frame[i];
-						switch (c) {
-							case KISS_FEND:
-								*(in++) = KISS_FESC;
-								*(in++) = KISS_TFEND;
-								kiss->in_len += 2;
-								break;
-							case KISS_FESC:
-								*(in++) = KISS_FESC;
-								*(in++) = KISS_TFESC;
-								kiss->in_len += 2;
-								break;
-							default:
-								*(in++) = c;
-								kiss->in_len ++;
-								break;
-						}
+		Kiss_In_Fill(kiss);
 
-					}
-					*(in++) = KISS_FEND;
-					kiss->in_len ++;
-					kiss->in_pos = 0;
-			       }
-			       Framebuff_Free_Frame(kiss->in_frame);
-			}
-		}
+		FD_ZERO(&rfds);
+		FD_ZERO(&wfds);
+		FD_SET(kiss->uart_fd, &rfds);
+		FD_SET(kiss->event_fd, &rfds);
+		if (kiss->in_len != kiss->in_pos)
+			FD_SET(kiss->uart_fd, &wfds);
+		maxfd = kiss->uart_fd > kiss->event_fd ? kiss->uart_fd : kiss->event_fd;
 
-		if (kiss->in_len > kiss->in_pos) {
-			i = write(kiss->uart_fd,kiss->in_buff+kiss->in_pos,kiss->in_len-kiss->in_pos);
-			if (i>0) {
-				kiss->in_pos += i;
-				if (kiss->in_len != kiss->in_pos)
-					continue;
-			} else {
-				ESP_LOGE(TAG, "Error writing kiss frame");
-				kiss->in_pos = kiss->in_len;
-			}
-		}
+		tv.tv_sec = KISS_SELECT_TO_MS/1000;
+		tv.tv_usec = (KISS_SELECT_TO_MS%1000)*1000;
 
-		ret = read(kiss->uart_fd,kiss->out_buff,KISS_MAX_FRAME_LEN);
-		out = kiss->out_buff;
-		if (ret <= 0) {
-			ESP_LOGD(TAG,"Read unlock");
-			out_len = 0;
-		}
-		else
-			out_len = ret;
-		
-		if (kiss->out_enable) {
-			if (kiss->out_frame)
-				in = kiss->out_frame->frame + kiss->out_pos;
-			else {
-				in = NULL;
-				kiss->out_enable = false;
-			}
-		} else 
-			in = NULL;
-
-		for (i=0;i<out_len;i++) {
-			if (kiss->out_enable) {
-				if (kiss->out_last == KISS_FESC) {
-					switch (*out) {
-						case KISS_TFESC:
-							*(in++) = KISS_FESC;
-							kiss->out_pos++;
-							break;
-						case KISS_TFEND:
-							*(in++) = KISS_FEND;
-							kiss->out_pos++;
-							break;
-						default:
-							// Protocol error
-							kiss->out_pos = 0;
-							in = kiss->out_frame->frame;
-							kiss->out_enable = false;
-							AX25_Lm_Release_Request(kiss->ax25_lm,  kiss);
-							break;
-					}
-				}
-				else {
-					switch (*out) {
-						case KISS_FESC:
-							// Look next char
-							break;
-						case KISS_FEND:
-/*							if (kiss->out_last == KISS_FEND) {
-								// sync
-								kiss->out_pos = 0;
-								in = kiss->out_frame->frame;
-							} else 
-*/							{							
-								// end of frame
-								if (kiss->out_pos < HDLC_MAX_FRAME_LEN-2 && kiss->out_pos >= HDLC_MIN_FRAME_LEN) {
-									uint16_t crc;
-									// Add crc
-									crc = esp_rom_crc16_le(0,kiss->out_frame->frame,kiss->out_pos);
-
-									*(in++) = (crc)&0xff;
-									*(in++) = (crc>>8)&0xff;
-									kiss->out_pos += 2;
-
-									kiss->out_frame->frame_len = kiss->out_pos;
-
-									// Send it to transmiter
-									ESP_LOGI(TAG,"Send frame : %p",kiss->out_frame);
-									AX25_Lm_Data_Request(kiss->ax25_lm, kiss, kiss->out_frame);
-
-									// Loop back to Aprs decoder
-									APRS_Frame_Received_Cb(Aprs ,kiss->out_frame);
-
-									Framebuff_Free_Frame(kiss->out_frame);
-									kiss->out_frame = NULL;
-								} else {
-									kiss->out_pos = 0;
-									in = kiss->out_frame->frame;
-								}
-							}
-							break;
-/*						case KISS_TFESC:
-							// Protocol error
-							kiss->out_pos = 0;
-							in = kiss->out_frame->frame;
-							kiss->out_enable = false;
-							AX25_Lm_Release_Request(kiss->ax25_lm, kiss);
-							break;
-*/
-						default:
-							//receive char;
-							*(in++) = *out;
-							kiss->out_pos++;
-							break;
-					}
-				}
-
-				if (kiss->out_frame && kiss->out_pos > kiss->out_frame->frame_size) {
-					ESP_LOGE(TAG,"OUT Frame too long");
-					kiss->out_enable = false;
-					AX25_Lm_Release_Request(kiss->ax25_lm, kiss);
-				}
-
-			} else if (kiss->out_last == KISS_FEND) {
-				switch (*out) {
-					case 0: // Data frame
-						// Start of frame
-						kiss->out_pos = 0;
-						if (kiss->out_frame == NULL)
-							kiss->out_frame  = Framebuff_Get_Frame(kiss->out_framebuff);
-						if (kiss->out_frame) {
-							in = kiss->out_frame->frame;
-							kiss->out_enable = true;
-							// AX25_Lm_Seize_Request(kiss->ax25_lm, kiss);
-						}
-						break;
-					case 1: // TX Delay
-						break;
-					case 2: // Persistence
-						break;
-					case 3: // SlotTime
-						break;
-					case 4: // Tx tail
-						break;
-					case 5: // Full duplex
-						break;
-					case 6: // Set Hardware
-						break;
-					case 0xff: // Exit kiss
-						break;
-					default:
-				}		
-			}
-		kiss->out_last = *out;
-		out++;
+		ret = select(maxfd+1, &rfds, &wfds, NULL, &tv);
+		if (ret < 0) {
+			ESP_LOGE(TAG,"Select error %d", errno);
+			vTaskDelay(pdMS_TO_TICKS(KISS_TASK_DELAY));
+			continue;
 		}
 
+		if (FD_ISSET(kiss->event_fd, &rfds))
+			read(kiss->event_fd, &event, sizeof(event));
+
+		if (FD_ISSET(kiss->uart_fd, &wfds))
+			Kiss_In_Write(kiss);
+
+		if (FD_ISSET(kiss->uart_fd, &rfds))
+			Kiss_Out_Read(kiss);
+
+		// Don't keep stale acks until next ackmode frame
+		xSemaphoreTake(kiss->ack_lock, portMAX_DELAY);
+		Kiss_Ack_Expire(kiss, xTaskGetTickCount());
+		xSemaphoreGive(kiss->ack_lock);
+
 	} while (1);
 
 }
 
+// Locally generated frame
 int Kiss_Frame_Received_Cb(Kiss_t * Kiss, Frame_t * Frame) {
+	int i;
+	bool local = false;
 
-	if (!Kiss || !Frame || Frame->frame_len < HDLC_MIN_FRAME_LEN)
+	if (!Kiss || !Frame)
 		return 0;
 
-	Framebuff_Inc_Frame_Usage(Frame);
-	if (Framebuff_Put_Frame(Kiss->in_framebuff,Frame)) {
-		Framebuff_Free_Frame(Frame);
-		ESP_LOGE(TAG,"Input frame buffer full");
-		return 0;
-	}
+	for (i=0 ; i<KISS_MAX_PORTS ; i++)
+		if (Kiss->ports[i].type == KISS_PORT_LOCAL) {
+			Kiss_Queue_Frame(Kiss, i, KISS_PRIO_LOCAL, Frame);
+			local = true;
+		}
 
-	if (Kiss->uart_fd) {
-		// Unlock read
-		close(Kiss->uart_fd);
-		Kiss->uart_fd = -1;
-	}
+	// No local port, send it as if received from the main radio
+	if (!local)
+		Kiss_Queue_Frame(Kiss, 0, KISS_PRIO_LOCAL, Frame);
 
 	return 0;
 }
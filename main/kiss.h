@@ -26,9 +26,57 @@
 
 #include "ax25_lm.h"
 
+#define KISS_MAX_PORTS	16
+
 typedef struct Kiss_S Kiss_t;
 
+// Called with each frame received from host
+typedef int (*Kiss_Loopback_t)(void * Ctx, Frame_t * Frame);
+// Called with SetHardware payloads not handled by kiss
+typedef int (*Kiss_Hw_Command_t)(void * Ctx, const uint8_t * Data, size_t Len);
+// Next SetHardware payload to send to host, return its length, 0 if none
+typedef int (*Kiss_Hw_Source_t)(void * Ctx, uint8_t * Data, size_t Size);
+
+typedef enum {
+	KISS_PORT_NONE = 0,
+	KISS_PORT_RADIO,	// Frames from/to an AX25 link multiplexer
+	KISS_PORT_LOCAL,	// Locally generated frames
+} Kiss_Port_Type_t;
+
+// Policy when queue to host is full
+typedef enum {
+	KISS_DROP_OLDEST = 0,	// Evict oldest frame of lowest priority
+	KISS_DROP_NEWEST,	// Reject incoming frame
+} Kiss_Drop_Policy_t;
+
+typedef enum {
+	KISS_DROP_REASON_FULL = 0,	// Queue full, incoming frame rejected
+	KISS_DROP_REASON_EVICTED,	// Queue full, oldest frame evicted
+	KISS_DROP_REASON_PREEMPTED,	// Lower priority frame evicted
+	KISS_DROP_REASON_LENGTH,	// Invalid frame length
+	KISS_DROP_REASON_MAX
+} Kiss_Drop_Reason_t;
+
+// Credit flow control (host opt-in), SetHardware (cmd 6) payload :
+//	'C' n	: grant n more data frames and enable credit mode
+//	'X'	: disable credit mode
+#define KISS_HW_CREDIT		'C'
+#define KISS_HW_NO_CREDIT	'X'
+
+// Port 0 is created on Ax25_Lm
 Kiss_t * Kiss_Init(const char *path, AX25_Lm_t * Ax25_Lm);
+// Filter is an address list as for AX25_Addr_Filter, NULL for all frames
+int Kiss_Add_Port(Kiss_t * Kiss, int Port, Kiss_Port_Type_t Type, AX25_Lm_t * Ax25_Lm, AX25_Addr_t * Filter);
+int Kiss_Set_Loopback(Kiss_t * Kiss, Kiss_Loopback_t Loopback, void * Ctx);
+// Source is polled when there is room in the host buffer, after pending frames
+int Kiss_Set_Hardware(Kiss_t * Kiss, Kiss_Hw_Command_t Command, Kiss_Hw_Source_t Source, void * Ctx);
+int Kiss_Set_Drop_Policy(Kiss_t * Kiss, Kiss_Drop_Policy_t Policy);
+uint32_t Kiss_Get_Drop_Count(Kiss_t * Kiss, Kiss_Drop_Reason_t Reason);
+// Ackmode frames waiting for transmission
+int Kiss_Get_Pending_Acks(Kiss_t * Kiss);
+// Smack frames from host dropped on crc error, updated by kiss task
+uint32_t Kiss_Get_Crc_Errors(Kiss_t * Kiss);
+// Locally generated frame, sent on local ports or on port 0 if none
 int Kiss_Frame_Received_Cb(Kiss_t * Kiss, Frame_t * Frame);
 
 #endif
@@ -40,7 +40,6 @@
 #include <driver/gpio.h>
 #include <driver/spi_master.h>
 #include <esp_sleep.h>
-#include <esp_spiffs.h>
 #include <driver/uart.h>
 #include <driver/uart_vfs.h>
 #include <driver/usb_serial_jtag.h>
@@ -78,15 +77,20 @@
 // #include <lowpower.h>
 #include "micropython.h"
 #include "usb_cdc.h"
+#include "capture.h"
+#include "storage.h"
+#include "aprs_xfer.h"
+#include "main.h"
 
 #include "config.h"
 
 #define TAG "MAIN"
 
-ESP_EVENT_DEFINE_BASE(MAIN_EVENT);
+#define CAPTURE_PATH	STORAGE_PATH("capture")	// Segments are capture.<number>
+#define CAPTURE_PERCENT	25	// Max part of filesystem used by capture ring
+#define APRS_XFER_BATCH	16	// Imported stations per DB sync
 
-#define MAIN_EVENT_RSSI	0
-#define MAIN_EVENT_ADC2	1
+ESP_EVENT_DEFINE_BASE(MAIN_EVENT);
 
 #define XBM_SWAP_BITS(bitmap) do {\
 	for (int i = 0;i<sizeof(bitmap);i++) {\
@@ -107,8 +111,10 @@ SA8x8_t * SA8x8;
 Modem_t * Modem_AFSK1200;
 Kiss_t *Kiss;
 APRS_t * Aprs;
+APRS_Xfer_t * Aprs_Xfer;
 AX25_Phy_t * Ax25_Phy;
 AX25_Lm_t * Ax25_Lm;
+Capture_t * Capture;
 uint8_t Rssi;
 uint8_t Rssi_max;
 int Battery;
@@ -317,44 +323,9 @@ void app_main(void)
 	} else
 		Symbols[0] = (lv_font_t*)LV_FONT_DEFAULT;
 
-	// Initialise SPIFFS
-	ret =esp_vfs_spiffs_register(&Spiffs_Config);
-	switch (ret) {
-		case ESP_FAIL:
-			ESP_LOGE(TAG,"Failed to mount or format spiffs partition labeled \"%s\"",Spiffs_Config.partition_label);
-			break;
-		case ESP_ERR_NOT_FOUND:
-			ESP_LOGE(TAG,"Failed to find spiffs parition labeled\"%s\"",Spiffs_Config.partition_label);
-			break;
-		case ESP_OK:
-			size_t total = 0, used = 0;
-			ret = esp_spiffs_info(Spiffs_Config.partition_label, &total, &used);
-			if (ret || used > total) {
-				ESP_LOGE(TAG,"Can't get spiffs info (%s), checking ...",esp_err_to_name(ret));
-				ret = esp_spiffs_check(Spiffs_Config.partition_label);
-				if (ret != ESP_OK) {
-					ESP_LOGE(TAG, "SPIFFS_check() failed (%s), formating ...", esp_err_to_name(ret));
-					esp_spiffs_format(Spiffs_Config.partition_label);
-				} else {
-					ESP_LOGI(TAG, "SPIFFS_check() successful");
-				}
+	// Flash filesystem
+	Storage_Mount();
 
-				ret = esp_spiffs_info(Spiffs_Config.partition_label, &total, &used);
-				if (ret != ESP_OK) {
-					ESP_LOGE(TAG,"Error Mounting spiffs partition labeled \"%s\", aborting.",Spiffs_Config.partition_label);
-				}
-			}
-			
-			if (!ret)
-				ESP_LOGI(TAG, "\"%s\" partition mounted.\n\t\tsize: total: %d, used: %d",
-						Spiffs_Config.partition_label,
-						total,
-						used);
-			break;
-		default:
-			ESP_LOGE(TAG,"Failed to initialize SPIFFS (%s)", esp_err_to_name(ret));
-	}
-	
 	nvs_flash_init();
 
    	APRS_Load_Config(Aprs);
@@ -369,8 +340,20 @@ void app_main(void)
 	// USB Init
 	USB_Init();
 
+	// Eventfd used to wake up select() based tasks
+	esp_vfs_eventfd_config_t eventfd_config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+	esp_vfs_eventfd_register(&eventfd_config);
+
 	// Kiss protocol on top of AX25 link multiplexer
 	Kiss = Kiss_Init(CONFIG_ESP32S3APRS_KISS_PORT, Ax25_Lm);
+	Kiss_Set_Loopback(Kiss, (Kiss_Loopback_t)APRS_Frame_Received_Cb, Aprs);
+	// Station DB export/import
+	if ((Aprs_Xfer = APRS_Xfer_Init(Aprs, APRS_XFER_BATCH)))
+		Kiss_Set_Hardware(Kiss, (Kiss_Hw_Command_t)APRS_Xfer_Command, (Kiss_Hw_Source_t)APRS_Xfer_Next, Aprs_Xfer);
+#ifdef CONFIG_ESP32S3APRS_KISS_LOCAL
+	if (Kiss)
+		Kiss_Add_Port(Kiss, CONFIG_ESP32S3APRS_KISS_LOCAL_PORT, KISS_PORT_LOCAL, NULL, NULL);
+#endif
 
 	// ADC Init
 	ADC_Init(ADC_UNIT_2);
@@ -391,6 +374,15 @@ void app_main(void)
 		ESP_LOGW(TAG,"Error creating HMI");
 
    	APRS_Open_Db(Aprs,0);
+
+#ifdef CONFIG_ESP32S3APRS_CAPTURE
+	// Raw frames capture ring, sized to the filesystem
+	ret = Storage_Budget(CAPTURE_PERCENT, CONFIG_ESP32S3APRS_CAPTURE_SEGMENT*CONFIG_ESP32S3APRS_CAPTURE_SEGMENTS)
+		/ CONFIG_ESP32S3APRS_CAPTURE_SEGMENT;
+	Capture = Capture_Init(Ax25_Phy, CAPTURE_PATH, CONFIG_ESP32S3APRS_CAPTURE_SEGMENT,
+			ret < 2 ? 2 : ret, CONFIG_ESP32S3APRS_CAPTURE_BUFFER);
+#endif
+
 	APRS_Start(Aprs);
 
 #ifdef CONFIG_PM_ENABLE
@@ -410,6 +402,7 @@ void app_main(void)
 		if (!(i%10)) {
 			// Get RSSI
 			SA8x8_GetRssi(SA8x8,&rssi);
+			Capture_Set_Rssi(Capture, rssi);
 			if (rssi>max_rssi)
 				max_rssi=rssi;
 			Rssi = rssi;
@@ -455,7 +448,7 @@ void app_main(void)
 				ESP_LOGI(TAG,"Battery : %d mv",Battery);
 			}
 
-			esp_event_post(MAIN_EVENT,MAIN_EVENT_ADC2,&Adc2_Voltage,sizeof(Adc2_Voltage),portMAX_DELAY);
+			esp_event_post(MAIN_EVENT,MAIN_EVENT_BATTERY,&Adc2_Voltage,sizeof(Adc2_Voltage),portMAX_DELAY);
 
 			// Send rssi event
 			if (SA8x8) {
@@ -512,6 +505,10 @@ static unsigned long Runtime;
 		}
 #endif
 
+		// Write captured frames
+		if (Capture)
+			Capture_Flush(Capture);
+
 		vTaskDelayUntil(&now, 5000/portTICK_PERIOD_MS);
 		i+=5;
 	}
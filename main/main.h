@@ -0,0 +1,35 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * main/main.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MAIN_H_
+#define _MAIN_H_
+
+#include <esp_event.h>
+
+ESP_EVENT_DECLARE_BASE(MAIN_EVENT);
+
+// MAIN_EVENT ids, posted by main task
+#define MAIN_EVENT_RSSI		0	// Max rssi since previous event (uint8_t)
+#define MAIN_EVENT_BATTERY	1	// ADC2 voltages (int[5], mV), battery first
+
+#endif
@@ -0,0 +1,175 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * main/storage.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <esp_log.h>
+#include <esp_err.h>
+#include "storage.h"
+#if CONFIG_ESP32S3APRS_STORAGE_POSIX
+#include <sys/statvfs.h>
+#else
+#include "config.h"
+#endif
+
+#define TAG "STORAGE"
+
+static bool Storage_Mounted;
+
+#if CONFIG_ESP32S3APRS_STORAGE_SPIFFS
+static int Storage_Backend_Mount(void) {
+	size_t total = 0, used = 0;
+	esp_err_t ret;
+
+	ret = esp_vfs_spiffs_register(&Spiffs_Config);
+	switch (ret) {
+		case ESP_FAIL:
+			ESP_LOGE(TAG,"Failed to mount or format spiffs partition labeled \"%s\"",Spiffs_Config.partition_label);
+			return -1;
+		case ESP_ERR_NOT_FOUND:
+			ESP_LOGE(TAG,"Failed to find spiffs parition labeled\"%s\"",Spiffs_Config.partition_label);
+			return -1;
+		case ESP_OK:
+			break;
+		default:
+			ESP_LOGE(TAG,"Failed to initialize SPIFFS (%s)", esp_err_to_name(ret));
+			return -1;
+	}
+
+	ret = esp_spiffs_info(Spiffs_Config.partition_label, &total, &used);
+	if (ret || used > total) {
+		ESP_LOGE(TAG,"Can't get spiffs info (%s), checking ...",esp_err_to_name(ret));
+		ret = esp_spiffs_check(Spiffs_Config.partition_label);
+		if (ret != ESP_OK) {
+			ESP_LOGE(TAG, "SPIFFS_check() failed (%s), formating ...", esp_err_to_name(ret));
+			esp_spiffs_format(Spiffs_Config.partition_label);
+		} else {
+			ESP_LOGI(TAG, "SPIFFS_check() successful");
+		}
+
+		if (esp_spiffs_info(Spiffs_Config.partition_label, &total, &used) != ESP_OK) {
+			ESP_LOGE(TAG,"Error Mounting spiffs partition labeled \"%s\", aborting.",Spiffs_Config.partition_label);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int Storage_Info(size_t * Total, size_t * Used) {
+	if (!Storage_Mounted || esp_spiffs_info(Spiffs_Config.partition_label, Total, Used) != ESP_OK)
+		return -1;
+
+	return 0;
+}
+
+const char * Storage_Name(void) {
+	return "spiffs";
+}
+#elif CONFIG_ESP32S3APRS_STORAGE_LITTLEFS
+static int Storage_Backend_Mount(void) {
+	esp_err_t ret;
+
+	// Formated by the driver if mount fails
+	ret = esp_vfs_littlefs_register(&Littlefs_Config);
+	switch (ret) {
+		case ESP_OK:
+			return 0;
+		case ESP_ERR_NOT_FOUND:
+			ESP_LOGE(TAG,"Failed to find littlefs parition labeled\"%s\"",Littlefs_Config.partition_label);
+			return -1;
+		default:
+			ESP_LOGE(TAG,"Failed to initialize LittleFS (%s)", esp_err_to_name(ret));
+			return -1;
+	}
+}
+
+int Storage_Info(size_t * Total, size_t * Used) {
+	if (!Storage_Mounted || esp_littlefs_info(Littlefs_Config.partition_label, Total, Used) != ESP_OK)
+		return -1;
+
+	return 0;
+}
+
+const char * Storage_Name(void) {
+	return "littlefs";
+}
+#elif CONFIG_ESP32S3APRS_STORAGE_POSIX
+static int Storage_Backend_Mount(void) {
+	if (mkdir(STORAGE_MOUNT_POINT, 0700) && errno != EEXIST) {
+		ESP_LOGE(TAG,"Can't create %s (%d)", STORAGE_MOUNT_POINT, errno);
+		return -1;
+	}
+
+	return 0;
+}
+
+int Storage_Info(size_t * Total, size_t * Used) {
+	struct statvfs st;
+
+	if (!Storage_Mounted || statvfs(STORAGE_MOUNT_POINT, &st))
+		return -1;
+
+	*Total = st.f_blocks * st.f_frsize;
+	*Used = (st.f_blocks - st.f_bfree) * st.f_frsize;
+
+	return 0;
+}
+
+const char * Storage_Name(void) {
+	return "posix";
+}
+#endif
+
+int Storage_Mount(void) {
+	size_t total = 0, used = 0;
+
+	if (Storage_Mounted)
+		return 0;
+
+	if (Storage_Backend_Mount())
+		return -1;
+	Storage_Mounted = true;
+
+	if (!Storage_Info(&total, &used))
+		ESP_LOGI(TAG, "%s mounted on %s.\n\t\tsize: total: %d, used: %d",
+				Storage_Name(), STORAGE_MOUNT_POINT, total, used);
+
+	return 0;
+}
+
+size_t Storage_Budget(int Percent, size_t Wanted) {
+	size_t total, used, budget;
+
+	if (Storage_Info(&total, &used))
+		return Wanted;
+
+	budget = total / 100 * Percent;
+	if (budget < Wanted) {
+		ESP_LOGW(TAG,"%d bytes wanted, limited to %d bytes (%d%% of %s)", Wanted, budget, Percent, Storage_Name());
+		return budget;
+	}
+
+	return Wanted;
+}
@@ -0,0 +1,43 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * main/storage.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _STORAGE_H_
+#define _STORAGE_H_
+
+#include <stddef.h>
+#include "sdkconfig.h"
+
+// Flash filesystem holding stations DB, capture ring and micropython scripts,
+// SPIFFS or LittleFS partition, or a host directory on linux target
+
+#define STORAGE_MOUNT_POINT	CONFIG_ESP32S3APRS_STORAGE_MOUNT_POINT
+#define STORAGE_PATH(Name)	STORAGE_MOUNT_POINT "/" Name
+
+// Mount, check and format if needed
+int Storage_Mount(void);
+int Storage_Info(size_t * Total, size_t * Used);
+const char * Storage_Name(void);
+// Wanted bytes limited to Percent of the filesystem size
+size_t Storage_Budget(int Percent, size_t Wanted);
+
+#endif
@@ -44,6 +44,8 @@ static ssize_t USB_CDC_write(int fd, const void *data, size_t size);
 static ssize_t USB_CDC_read(int fd, void *dst, size_t size);
 static int USB_CDC_open(const char *path, int flags, int mode);
 static int USB_CDC_close(int fd);
+static esp_err_t USB_CDC_start_select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, esp_vfs_select_sem_t sem, void **end_select_args);
+static esp_err_t USB_CDC_end_select(void *end_select_args);
 
 static const esp_vfs_t USB_CDC_vfs = {
     .flags = ESP_VFS_FLAG_DEFAULT,
@@ -51,11 +53,30 @@ static const esp_vfs_t USB_CDC_vfs = {
     .close = &USB_CDC_close,
     .read = &USB_CDC_read,
     .write = &USB_CDC_write,
+    .start_select = &USB_CDC_start_select,
+    .end_select = &USB_CDC_end_select,
 };
 
+// Pending select() calls
+#define USB_CDC_MAX_SELECT	4
+
+typedef struct USB_CDC_Select_S {
+	bool used;
+	int nfds;
+	esp_vfs_select_sem_t sem;
+	fd_set *readfds;
+	fd_set *writefds;
+	fd_set readfds_orig;
+	fd_set writefds_orig;
+} USB_CDC_Select_t;
+
+static USB_CDC_Select_t USB_CDC_select[USB_CDC_MAX_SELECT];
+static SemaphoreHandle_t USB_CDC_select_lock;
+static StaticSemaphore_t USB_CDC_select_lock_buf;
+
 static struct USB_CDC_itf {
 	int itf;
-	union {
+	struct {
 		uint8_t rts:1;
 		uint8_t dtr:1;
 	};
@@ -81,6 +102,8 @@ int USB_CDC_Init(void) {
 		USB_CDC_itf[i].writefd = -1;
 	}
 
+	USB_CDC_select_lock = xSemaphoreCreateMutexStatic(&USB_CDC_select_lock_buf);
+
 	ret = esp_vfs_register(USB_CDC_VFS_PATH, &USB_CDC_vfs, NULL);
 
 	return ret;
@@ -150,6 +173,7 @@ static int USB_CDC_get_itf(int itf) {
 static ssize_t USB_CDC_write(int fd, const void *data, size_t size) {
 	int num = USB_CDC_get_wr_fd(fd);
 	int ret, total=0;
+	size_t chunk;
 
 	if (num <0 || num >= CFG_TUD_CDC)
 		return -1;
@@ -169,26 +193,27 @@ static ssize_t USB_CDC_write(int fd, const void *data, size_t size) {
 	}
 
 	if (!tud_cdc_n_write_available(USB_CDC_itf[num].itf)) {
-		tud_cdc_n_write_clear(USB_CDC_itf[num].itf);
+		// Bytes already queued are still sent to host
 		xSemaphoreGive(USB_CDC_itf[num].write_lock);
 		errno = EWOULDBLOCK;
 		return -1;
 	}
 
-	do {
-		ret = tud_cdc_n_write(USB_CDC_itf[num].itf, data, size);
+	// Write what fits in tx fifo, caller gets a short count for the rest
+	while (size) {
+		chunk = tud_cdc_n_write_available(USB_CDC_itf[num].itf);
+		if (!chunk)
+			break;
+		if (chunk > size)
+			chunk = size;
+		ret = tud_cdc_n_write(USB_CDC_itf[num].itf, data, chunk);
 		tud_cdc_n_write_flush(USB_CDC_itf[num].itf);
-/*		if (xSemaphoreTake(USB_CDC_itf[num].tx_sem, USB_CDC_WR_TO/portTICK_PERIOD_MS) != pdPASS) {
-			tud_cdc_n_write_clear(USB_CDC_itf[num].itf);
-			xSemaphoreGive(USB_CDC_itf[num].write_lock);
-			errno = EIO;
-			ESP_LOGE(TAG,"Write Timeout");
-			return -1;
-		}
-*/		size -= ret;
+		if (ret <= 0)
+			break;
+		data = (const uint8_t *)data + ret;
+		size -= ret;
 		total += ret;
 	}
-	while (size && ret >0);
 
 	xSemaphoreGive(USB_CDC_itf[num].write_lock);
 
@@ -298,6 +323,133 @@ static int USB_CDC_close(int fd) {
 	return ret;
 }
 
+// Check if fd can be read or written without blocking
+static bool USB_CDC_rd_ready(int fd) {
+	int num = USB_CDC_get_rd_fd(fd);
+
+	if (num <0 || num >= CFG_TUD_CDC)
+		return false;
+
+	return tud_cdc_n_available(USB_CDC_itf[num].itf) != 0;
+}
+
+static bool USB_CDC_wr_ready(int fd) {
+	int num = USB_CDC_get_wr_fd(fd);
+
+	if (num <0 || num >= CFG_TUD_CDC)
+		return false;
+
+	// Write discard datas when DTR is low, so never block
+	return !USB_CDC_itf[num].dtr || tud_cdc_n_write_available(USB_CDC_itf[num].itf) != 0;
+}
+
+// Update pending selects after an interface event
+static void USB_CDC_select_notify(int num, bool rd, bool wr) {
+	int i;
+	bool triggered;
+
+	if (!USB_CDC_select_lock)
+		return;
+
+	xSemaphoreTake(USB_CDC_select_lock, portMAX_DELAY);
+
+	for (i=0 ; i<USB_CDC_MAX_SELECT ; i++) {
+		if (!USB_CDC_select[i].used)
+			continue;
+
+		triggered = false;
+
+		if (rd) {
+			int fd = USB_CDC_itf[num].readfd;
+			if (fd >= 0 && fd < USB_CDC_select[i].nfds && FD_ISSET(fd, &USB_CDC_select[i].readfds_orig)) {
+				FD_SET(fd, USB_CDC_select[i].readfds);
+				triggered = true;
+			}
+		}
+
+		if (wr) {
+			int fd = USB_CDC_itf[num].writefd;
+			if (fd >= 0 && fd < USB_CDC_select[i].nfds && FD_ISSET(fd, &USB_CDC_select[i].writefds_orig)) {
+				FD_SET(fd, USB_CDC_select[i].writefds);
+				triggered = true;
+			}
+		}
+
+		if (triggered)
+			esp_vfs_select_triggered(USB_CDC_select[i].sem);
+	}
+
+	xSemaphoreGive(USB_CDC_select_lock);
+}
+
+static esp_err_t USB_CDC_start_select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, esp_vfs_select_sem_t sem, void **end_select_args) {
+	int i, fd;
+	bool triggered = false;
+	USB_CDC_Select_t * sel = NULL;
+
+	*end_select_args = NULL;
+
+	xSemaphoreTake(USB_CDC_select_lock, portMAX_DELAY);
+
+	for (i=0 ; i<USB_CDC_MAX_SELECT ; i++)
+		if (!USB_CDC_select[i].used) {
+			sel = &USB_CDC_select[i];
+			break;
+		}
+
+	if (!sel) {
+		xSemaphoreGive(USB_CDC_select_lock);
+		ESP_LOGE(TAG,"Too many pending select");
+		return ESP_ERR_NO_MEM;
+	}
+
+	sel->used = true;
+	sel->nfds = nfds;
+	sel->sem = sem;
+	sel->readfds = readfds;
+	sel->writefds = writefds;
+	sel->readfds_orig = *readfds;
+	sel->writefds_orig = *writefds;
+
+	FD_ZERO(readfds);
+	FD_ZERO(writefds);
+	FD_ZERO(exceptfds);
+
+	// Report fds already ready
+	for (fd=0 ; fd<nfds ; fd++) {
+		if (FD_ISSET(fd, &sel->readfds_orig) && USB_CDC_rd_ready(fd)) {
+			FD_SET(fd, readfds);
+			triggered = true;
+		}
+		if (FD_ISSET(fd, &sel->writefds_orig) && USB_CDC_wr_ready(fd)) {
+			FD_SET(fd, writefds);
+			triggered = true;
+		}
+	}
+
+	*end_select_args = sel;
+
+	xSemaphoreGive(USB_CDC_select_lock);
+
+	if (triggered)
+		esp_vfs_select_triggered(sem);
+
+	return ESP_OK;
+}
+
+static esp_err_t USB_CDC_end_select(void *end_select_args) {
+	USB_CDC_Select_t * sel = end_select_args;
+
+	if (!sel)
+		return ESP_OK;
+
+	xSemaphoreTake(USB_CDC_select_lock, portMAX_DELAY);
+	sel->used = false;
+	xSemaphoreGive(USB_CDC_select_lock);
+
+	return ESP_OK;
+}
+
 // Invoked when received new data
 void tud_cdc_rx_cb(uint8_t Itf) {
 	int num = USB_CDC_get_itf(Itf);
@@ -307,6 +459,7 @@ void tud_cdc_rx_cb(uint8_t Itf) {
 	}
 
 	xSemaphoreGive(USB_CDC_itf[num].rx_sem);
+	USB_CDC_select_notify(num, true, false);
 }
 
 // Invoked when a TX is complete and therefore space becomes available in TX buffer
@@ -318,6 +471,7 @@ void tud_cdc_tx_complete_cb(uint8_t Itf) {
 	}
 
 	xSemaphoreGive(USB_CDC_itf[num].tx_sem);
+	USB_CDC_select_notify(num, false, true);
 }
 
 // Invoked when line state DTR & RTS are changed via SET_CONTROL_LINE_STATE
@@ -329,4 +483,8 @@ void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts) {
 
 	USB_CDC_itf[num].dtr = dtr;
 	USB_CDC_itf[num].rts = rts;
+
+	// Write never block when DTR is low
+	if (!dtr)
+		USB_CDC_select_notify(num, false, true);
 }
@@ -93,6 +93,13 @@
 
 #define PATHLIST_SEP_CHAR ':'
 
+// Flash filesystem holding boot.py and main.py
+#ifdef CONFIG_ESP32S3APRS_STORAGE_MOUNT_POINT
+#define MP_STORAGE_PATH	CONFIG_ESP32S3APRS_STORAGE_MOUNT_POINT
+#else
+#define MP_STORAGE_PATH	"/spiffs"
+#endif
+
 #if MICROPY_EMIT_NATIVE
 #warning " EMIT NATIVE"
 #endif
@@ -339,10 +346,10 @@ soft_reset:
 
     // run boot-up scripts
 	pyexec_frozen_module("_boot.py",false);
-    pyexec_file_if_exists("/spiffs/boot.py");
+    pyexec_file_if_exists(MP_STORAGE_PATH "/boot.py");
 
     if (pyexec_mode_kind == PYEXEC_MODE_FRIENDLY_REPL) {
-        int ret = pyexec_file_if_exists("/spiffs/main.py");
+        int ret = pyexec_file_if_exists(MP_STORAGE_PATH "/main.py");
         if (ret & PYEXEC_FORCED_EXIT) {
             goto soft_reset_exit;
         }
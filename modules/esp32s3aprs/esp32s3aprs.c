@@ -26,6 +26,7 @@
 #include "mp_aprs.h"
 #include "mp_radio.h"
 #include "mp_templ.h"
+#include "capture.h"
 
 #include <esp_log.h>
 
@@ -34,6 +35,7 @@
 extern int Battery;
 extern uint8_t Rssi;
 extern uint8_t Rssi_max;
+extern Capture_t * Capture;
 
 #if CONFIG_LOG_MASTER_LEVEL
 static mp_obj_t master_log(const mp_obj_t in) {
@@ -92,6 +94,29 @@ static mp_obj_t log_out(mp_obj_t file_in) {
 }
 static MP_DEFINE_CONST_FUN_OBJ_1(log_out_obj, log_out);
 
+static int capture_write(FILE * File, const void * Data, size_t Len) {
+	return (fwrite(Data, 1, Len, File) == Len)?0:-1;
+}
+
+// capture_export(file [, from [, to]]) : write captured frames as pcap, return frames count
+static mp_obj_t capture_export(size_t n_args, const mp_obj_t *args) {
+	const char *file = mp_obj_str_get_str(args[0]);
+	time_t from = (n_args > 1)?mp_obj_get_int(args[1]):0;
+	time_t to = (n_args > 2)?mp_obj_get_int(args[2]):0;
+	FILE *f;
+	int ret;
+
+	if (!Capture || !file || !file[0] || !(f = fopen(file, "w")))
+		return MP_OBJ_NEW_SMALL_INT(-1);
+
+	ret = Capture_Export_Pcap(Capture, from, to, (Capture_Write_t)capture_write, f);
+	if (fclose(f))
+		ret = -1;
+
+	return mp_obj_new_int(ret);
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(capture_export_obj, 1, 3, capture_export);
+
 static __attribute__((noreturn)) mp_obj_t restart(void) {
 	esp_restart();
 }
@@ -112,6 +137,7 @@ static const mp_rom_map_elem_t esp32s3aprs_globals_table[] = {
 	{ MP_ROM_QSTR(MP_QSTR_radio),     MP_ROM_PTR(&mp_type_radio) },
 //	{ MP_ROM_QSTR(MP_QSTR_ax25_addr),     MP_ROM_PTR(&mp_type_ax25_addr) },
 	{ MP_ROM_QSTR(MP_QSTR_log_out), MP_ROM_PTR(&log_out_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_capture_export), MP_ROM_PTR(&capture_export_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_restart), MP_ROM_PTR(&restart_obj) },
 //	{ MP_ROM_QSTR(MP_QSTR_templ),     MP_ROM_PTR(&mp_type_templ) },
 //	{ MP_ROM_QSTR(MP_QSTR_aprs_stations_db),     MP_ROM_PTR(&mp_type_aprs_stations_db) },
@@ -23,12 +23,44 @@
 
 #include <py/runtime.h>
 #include "mp_aprs.h"
+#include "../main/aprs_parsers.h"
 
 #include <time.h>
 #include <esp_log.h>
+#include <esp_event.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
 
 #define TAG "MP_APRS"
 
+#define MP_APRS_INBOX_SIZE	4
+
+ESP_EVENT_DECLARE_BASE(APRS_EVENT);
+
+// Inbound messages, filled from APRS event loop
+typedef struct mp_aprs_inbox_msg_S {
+	AX25_Addr_t from;
+	char text[68];
+} mp_aprs_inbox_msg_t;
+
+static QueueHandle_t mp_aprs_inbox;
+static StaticQueue_t mp_aprs_inbox_data;
+static uint8_t mp_aprs_inbox_buff[sizeof(mp_aprs_inbox_msg_t)*MP_APRS_INBOX_SIZE];
+
+static void mp_aprs_message_event(void * Arg, esp_event_base_t event_base, int32_t event_id, const APRS_Event_Data_t * Data) {
+	mp_aprs_inbox_msg_t msg;
+
+	memcpy(&msg.from, &Data->src, sizeof(AX25_Addr_t));
+	APRS_Event_Text(Data, msg.text, sizeof(msg.text));
+
+	// Drop oldest if not read
+	if (xQueueSend(mp_aprs_inbox, &msg, 0) != pdPASS) {
+		mp_aprs_inbox_msg_t old;
+		xQueueReceive(mp_aprs_inbox, &old, 0);
+		xQueueSend(mp_aprs_inbox, &msg, 0);
+	}
+}
+
 // Aprs obj methode
 static mp_obj_t aprs_status(size_t nargs, const mp_obj_t *args ) {
     mp_obj_aprs_t *o = MP_OBJ_TO_PTR(args[0]);
@@ -211,6 +243,41 @@ static mp_obj_t aprs_ambiguity(size_t nargs, const mp_obj_t *args) {
 }
 static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(aprs_ambiguity_obj, 1, 2, aprs_ambiguity) ;
 
+static mp_obj_t aprs_message(size_t nargs, const mp_obj_t *args) {
+    mp_obj_aprs_t *o = MP_OBJ_TO_PTR(args[0]);
+
+	if (nargs == 1) {	// Get next inbound message as (from, text)
+		mp_aprs_inbox_msg_t msg;
+		if (!mp_aprs_inbox || xQueueReceive(mp_aprs_inbox, &msg, 0) != pdPASS)
+			return mp_const_none;
+
+		mp_obj_ax25_addr_t *addr = mp_obj_malloc(mp_obj_ax25_addr_t, &mp_type_ax25_addr);
+		memcpy(&addr->addr, &msg.from, sizeof(AX25_Addr_t));
+		mp_obj_t items[2] = {
+			MP_OBJ_FROM_PTR(addr),
+			mp_obj_new_str(msg.text, strnlen(msg.text, sizeof(msg.text))),
+		};
+		return mp_obj_new_tuple(2, items);
+	} else if (nargs == 3 && mp_obj_is_str(args[2])) {	// Send message (addressee, text)
+		const char * text = mp_obj_str_get_str(args[2]);
+		char addressee[10];
+
+		if (mp_obj_is_type(args[1], &mp_type_ax25_addr)) {
+			mp_obj_ax25_addr_t *addr = MP_OBJ_TO_PTR(args[1]);
+			AX25_Addr_To_Str(&addr->addr, addressee, sizeof(addressee));
+		} else if (mp_obj_is_str(args[1])) {
+			strncpy(addressee, mp_obj_str_get_str(args[1]), sizeof(addressee)-1);
+			addressee[sizeof(addressee)-1] = '\0';
+		} else
+			return MP_OBJ_NEW_SMALL_INT(-1);
+
+		return MP_OBJ_NEW_SMALL_INT(APRS_Send_Message(o->aprs, addressee, text));
+	}
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(aprs_message_obj, 1, 3, aprs_message);
+
 // Aprs local dictionary
 static const mp_rom_map_elem_t aprs_locals_dict_table[] = {
 	{MP_ROM_QSTR(MP_QSTR_status), MP_ROM_PTR(&aprs_status_obj)},
@@ -221,6 +288,7 @@ static const mp_rom_map_elem_t aprs_locals_dict_table[] = {
 	{MP_ROM_QSTR(MP_QSTR_path), MP_ROM_PTR(&aprs_path_obj)},
 	{MP_ROM_QSTR(MP_QSTR_symbol), MP_ROM_PTR(&aprs_symbol_obj)},
 	{MP_ROM_QSTR(MP_QSTR_ambiguity), MP_ROM_PTR(&aprs_ambiguity_obj)},
+	{MP_ROM_QSTR(MP_QSTR_message), MP_ROM_PTR(&aprs_message_obj)},
 };
 
 static MP_DEFINE_CONST_DICT(aprs_locals_dict, aprs_locals_dict_table);
@@ -233,6 +301,11 @@ static void *aprs_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, con
 	else
 		return mp_const_none;
 
+	if (!mp_aprs_inbox) {
+		mp_aprs_inbox = xQueueCreateStatic(MP_APRS_INBOX_SIZE, sizeof(mp_aprs_inbox_msg_t), mp_aprs_inbox_buff, &mp_aprs_inbox_data);
+		esp_event_handler_register(APRS_EVENT, APRS_EVENT_MESSAGE, (esp_event_handler_t)mp_aprs_message_event, NULL);
+	}
+
     return MP_OBJ_FROM_PTR(o);
 }
 
@@ -38,6 +38,7 @@ typedef struct _mp_obj_aprs_stations_db_t {
 	AX25_Addr_t filter;
 	uint8_t filter_type;	// b0 : wildcard on ssid
 							// b1 : wildcard on callsign
+	AX25_Addr_t cursor;		// Last station returned by iterator
 	// Put your data here
 } mp_obj_aprs_stations_db_t;
 
@@ -76,10 +76,80 @@ static mp_obj_t aprs_stations_db_reset(const mp_obj_t in) {
 }
 static MP_DEFINE_CONST_FUN_OBJ_1(aprs_stations_db_reset_obj, aprs_stations_db_reset);
 
+#define APRS_STATIONS_DB_QUERY_MAX	16	// Default stations per query
+#define APRS_STATIONS_DB_QUERY_LIMIT	64
+
+// List of aprs_station from a query result
+static mp_obj_t aprs_stations_db_list(APRS_Station_t * Stations, int N) {
+	mp_obj_t list = mp_obj_new_list(0, NULL);
+	int i;
+
+	for (i=0; i<N; i++) {
+		mp_obj_aprs_station_t *sta = mp_obj_malloc(mp_obj_aprs_station_t, &mp_type_aprs_station);
+		memcpy(&sta->station, &Stations[i], sizeof(APRS_Station_t));
+		sta->station.status[sizeof(sta->station.status)-1] = '\0';
+		mp_obj_list_append(list, MP_OBJ_FROM_PTR(sta));
+	}
+
+	return list;
+}
+
+static int aprs_stations_db_max(size_t nargs, const mp_obj_t * args, size_t pos) {
+	int max = (nargs > pos)?mp_obj_get_int(args[pos]):APRS_STATIONS_DB_QUERY_MAX;
+
+	if (max < 1)
+		max = 1;
+	if (max > APRS_STATIONS_DB_QUERY_LIMIT)
+		max = APRS_STATIONS_DB_QUERY_LIMIT;
+
+	return max;
+}
+
+// last_heard([since[, max]]) : stations heard since timestamp, newest first
+static mp_obj_t aprs_stations_db_last_heard(size_t nargs, const mp_obj_t * args) {
+    mp_obj_aprs_stations_db_t *o = MP_OBJ_TO_PTR(args[0]);
+	time_t since = (nargs > 1)?mp_obj_get_int(args[1]):0;
+	int max = aprs_stations_db_max(nargs, args, 2);
+	APRS_Station_t * stations = m_new(APRS_Station_t, max);
+	mp_obj_t list;
+	int n;
+
+	n = APRS_Stations_Last_Heard(o->aprs, since, stations, max);
+	list = aprs_stations_db_list(stations, n>0?n:0);
+	m_del(APRS_Station_t, stations, max);
+
+	return list;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(aprs_stations_db_last_heard_obj, 1, 3, aprs_stations_db_last_heard);
+
+// near(position, radius[, max]) : stations within radius miles of position
+static mp_obj_t aprs_stations_db_near(size_t nargs, const mp_obj_t * args) {
+    mp_obj_aprs_stations_db_t *o = MP_OBJ_TO_PTR(args[0]);
+	int max = aprs_stations_db_max(nargs, args, 3);
+	mp_obj_aprs_position_t *pos;
+	APRS_Station_t * stations;
+	mp_obj_t list;
+	int n;
+
+	if (!mp_obj_is_type(args[1], &mp_type_aprs_position))
+		return mp_const_none;
+	pos = MP_OBJ_TO_PTR(args[1]);
+
+	stations = m_new(APRS_Station_t, max);
+	n = APRS_Stations_Near(o->aprs, &pos->position, mp_obj_get_int(args[2]), stations, max);
+	list = aprs_stations_db_list(stations, n>0?n:0);
+	m_del(APRS_Station_t, stations, max);
+
+	return list;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(aprs_stations_db_near_obj, 3, 4, aprs_stations_db_near);
+
 // Aprs stations database local dictionary
 static const mp_rom_map_elem_t aprs_stations_db_locals_dict_table[] = {
 	{MP_ROM_QSTR(MP_QSTR_filter), MP_ROM_PTR(&aprs_stations_db_filter_obj)},
 	{MP_ROM_QSTR(MP_QSTR_reset), MP_ROM_PTR(&aprs_stations_db_reset_obj)},
+	{MP_ROM_QSTR(MP_QSTR_last_heard), MP_ROM_PTR(&aprs_stations_db_last_heard_obj)},
+	{MP_ROM_QSTR(MP_QSTR_near), MP_ROM_PTR(&aprs_stations_db_near_obj)},
 };
 
 static MP_DEFINE_CONST_DICT(aprs_stations_db_locals_dict, aprs_stations_db_locals_dict_table);
@@ -142,14 +212,10 @@ mp_obj_t aprs_stations_db_it_iternext(mp_obj_t self) {
 	mp_obj_aprs_station_t *sta = mp_obj_malloc(mp_obj_aprs_station_t, &mp_type_aprs_station);
 
 	if (sta) {
-		ret = APRS_Stations_Seq(o->aprs_stations_db->aprs, &o->aprs_stations_db->filter, o->next_flag, &sta->station);
+		// Range scan on filter prefix, stops after last match
+		ret = APRS_Stations_Match(o->aprs_stations_db->aprs, &o->aprs_stations_db->filter,
+				&o->aprs_stations_db->cursor, o->next_flag, &sta->station);
 		o->next_flag = R_NEXT;
-		// for case where filter is in form 'CALL*-10'
-		if (o->aprs_stations_db->filter_type == 2) {
-			// so walk db until the end
-			while (!ret && o->aprs_stations_db->filter.ssid && AX25_Addr_Cmp(&o->aprs_stations_db->filter, &sta->station.callid)) 
-				ret = APRS_Stations_Seq(o->aprs_stations_db->aprs, &o->aprs_stations_db->filter, o->next_flag, &sta->station);
-		}
 
 	   if (!ret) {
 			return MP_OBJ_FROM_PTR(sta);
@@ -165,14 +231,11 @@ static mp_obj_t mp_obj_new_aprs_stations_db_iterator(mp_obj_t self, AX25_Addr_t
     o->base.type = &mp_type_polymorph_iter;
 	o->iternext = aprs_stations_db_it_iternext,
     o->aprs_stations_db = MP_OBJ_TO_PTR(self);
-	if (First) {
+	if (First)
 		memcpy(&o->aprs_stations_db->filter, First, sizeof(AX25_Addr_t));
-		o->next_flag = R_CURSOR;
-	}
-	else {
+	else
 		bzero(&o->aprs_stations_db->filter, sizeof(AX25_Addr_t));
-		o->next_flag = R_FIRST;
-	}
+	o->next_flag = R_FIRST;
     return MP_OBJ_FROM_PTR(o);
 }
 
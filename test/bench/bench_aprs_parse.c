@@ -0,0 +1,226 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/bench/bench_aprs_parse.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// APRS_Parse throughput on a frame corpus (same input format as the fuzz
+// target : 6 chars destination then information field). Reports frames
+// per second and, per data type, the distribution of the cost of a frame,
+// then the cost of posting the APRS_EVENT descriptor against APRS_Data_t.
+//
+//	bench_aprs_parse [-i iterations] corpus_dir|file ...
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <esp_log.h>
+
+#include "aprs.h"
+#include "aprs_parsers.h"
+#include "test.h"
+
+#define BENCH_MAX_FRAMES	4096
+#define BENCH_DST_LEN	6
+
+typedef struct Bench_Frame_S {
+	Frame_t * frame;
+	char dti;		// First info byte
+	bool error;		// Rejected by parser
+	double cost;		// ns per parse
+} Bench_Frame_t;
+
+static Bench_Frame_t Frames[BENCH_MAX_FRAMES];
+static int N_Frames;
+
+static int Load_File(const char * Path) {
+	char buff[512], dst[BENCH_DST_LEN+1];
+	Frame_t * frame;
+	FILE * file;
+	size_t len;
+
+	if (N_Frames == BENCH_MAX_FRAMES)
+		return -1;
+
+	if (!(file = fopen(Path, "rb"))) {
+		perror(Path);
+		return -1;
+	}
+	len = fread(buff, 1, sizeof(buff)-1, file);
+	fclose(file);
+	if (len <= BENCH_DST_LEN)
+		return -1;
+	buff[len] = '\0';
+
+	memcpy(dst, buff, BENCH_DST_LEN);
+	dst[BENCH_DST_LEN] = '\0';
+	*strchrnul(dst, ' ') = '\0';
+
+	frame = Test_Frame(APRS_MAX_FRAME_LEN + 512);
+	if (Test_Ui_Frame(frame, "F4ABC", dst, NULL, buff+BENCH_DST_LEN)) {
+		free(frame);
+		return -1;
+	}
+
+	Frames[N_Frames].frame = frame;
+	Frames[N_Frames].dti = buff[BENCH_DST_LEN];
+	N_Frames++;
+
+	return 0;
+}
+
+static int Load(const char * Path) {
+	char file[1024];
+	struct dirent * ent;
+	struct stat st;
+	DIR * dir;
+
+	if (stat(Path, &st)) {
+		perror(Path);
+		return -1;
+	}
+
+	if (!S_ISDIR(st.st_mode))
+		return Load_File(Path);
+
+	if (!(dir = opendir(Path)))
+		return -1;
+	while ((ent = readdir(dir))) {
+		if (ent->d_name[0] == '.')
+			continue;
+		snprintf(file, sizeof(file), "%s/%s", Path, ent->d_name);
+		Load_File(file);
+	}
+	closedir(dir);
+
+	return 0;
+}
+
+static double Now_Ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1e9 + ts.tv_nsec;
+}
+
+static void Post_Copy(const void * Payload, size_t Size) {
+	void * copy;
+
+	if (!(copy = malloc(Size)))
+		abort();
+	memcpy(copy, Payload, Size);
+	__asm__ volatile("" : : "r"(copy) : "memory");
+	free(copy);
+}
+
+static int Cost_Cmp(const void * A, const void * B) {
+	const Bench_Frame_t * a = A, * b = B;
+
+	if (a->dti != b->dti)
+		return a->dti - b->dti;
+	return (a->cost > b->cost) - (a->cost < b->cost);
+}
+
+int main(int argc, char ** argv) {
+	static APRS_Data_t data;
+	static APRS_Event_Data_t event;
+	unsigned long iterations = 1000, n;
+	double start, total, event_total, copy_total;
+	int opt, i, j, errors;
+
+	while ((opt = getopt(argc, argv, "i:")) != -1) {
+		switch (opt) {
+			case 'i':
+				iterations = strtoul(optarg, NULL, 0);
+				break;
+			default:
+				fprintf(stderr, "Usage : %s [-i iterations] corpus_dir|file ...\n", argv[0]);
+				return 2;
+		}
+	}
+
+	esp_log_level_set("*", ESP_LOG_NONE);
+
+	for (; optind < argc ; optind++)
+		Load(argv[optind]);
+
+	if (!N_Frames || !iterations) {
+		fprintf(stderr, "Empty corpus\n");
+		return 1;
+	}
+
+	// Cost of each frame, parsed iterations times in a row
+	total = 0;
+	for (i=0 ; i<N_Frames ; i++) {
+		Frames[i].error = APRS_Parse(Frames[i].frame, &data) == -1;
+		start = Now_Ns();
+		for (n=0 ; n<iterations ; n++)
+			APRS_Parse(Frames[i].frame, &data);
+		Frames[i].cost = (Now_Ns() - start)/iterations;
+		total += Frames[i].cost;
+	}
+
+	// Event post, payload built from the last parse of each frame and
+	// copied to the heap as esp_event_post does
+	event_total = copy_total = 0;
+	for (i=0 ; i<N_Frames ; i++) {
+		if (APRS_Parse(Frames[i].frame, &data) == -1)
+			continue;
+		start = Now_Ns();
+		for (n=0 ; n<iterations ; n++) {
+			APRS_Event_Init(&event, Frames[i].frame, &data);
+			Post_Copy(&event, sizeof(event));
+		}
+		event_total += (Now_Ns() - start)/iterations;
+		start = Now_Ns();
+		for (n=0 ; n<iterations ; n++)
+			Post_Copy(&data, sizeof(data));
+		copy_total += (Now_Ns() - start)/iterations;
+	}
+
+	printf("%d frames x %lu : %.0f frames/s, %.0f ns/frame\n", N_Frames, iterations,
+			1e9*N_Frames/total, total/N_Frames);
+
+	// Per data type distribution
+	qsort(Frames, N_Frames, sizeof(Frames[0]), Cost_Cmp);
+	printf("DTI  frames errors   min(ns) median(ns)   max(ns)\n");
+	for (i=0 ; i<N_Frames ; i=j) {
+		errors = 0;
+		for (j=i ; j<N_Frames && Frames[j].dti == Frames[i].dti ; j++)
+			errors += Frames[j].error;
+		printf(" %c  %6d %6d %9.0f %10.0f %9.0f\n", Frames[i].dti >= ' ' && Frames[i].dti < 127 ? Frames[i].dti : '?',
+				j-i, errors, Frames[i].cost, Frames[i+(j-i)/2].cost, Frames[j-1].cost);
+	}
+
+	printf("Event descriptor %zu bytes : %.0f ns/frame, APRS_Data_t %zu bytes : %.0f ns/frame\n",
+			sizeof(event), event_total/N_Frames, sizeof(data), copy_total/N_Frames);
+
+	for (i=0 ; i<N_Frames ; i++)
+		free(Frames[i].frame);
+
+	return 0;
+}
@@ -0,0 +1,268 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/bench/bench_aprs_stations.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Last heard and near me station queries on a file-backed stations btree of
+// 5k and 50k stations, through the time and geohash indexes
+// (APRS_Log_Last_Heard, APRS_Log_Near) against a full scan of the station
+// records. Both must return the same stations.
+//
+//	bench_aprs_stations [-n stations]... [-i iterations] [-s seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <time.h>
+
+#include <esp_log.h>
+
+#include "aprs.h"
+#include "aprs_log.h"
+#include "test.h"
+
+#define BENCH_MAX_SIZES	4
+#define BENCH_BATCH	256	// Stations imported per sync
+#define BENCH_MAX	32	// Stations per query
+#define BENCH_NOW	1000000000
+#define BENCH_WEEK	(7*24*3600)
+#define BENCH_SINCE	(BENCH_NOW - 3600)
+#define BENCH_RADIUS	15	// Miles
+#define BENCH_SPREAD	(4<<GPS_FIXED_POINT_DEG)	// Stations over +/- 4 degrees around center
+#define MILES_PER_DEG	69.05
+
+static const struct APRS_Position Center = {
+	.latitude = 45<<GPS_FIXED_POINT_DEG,
+	.longitude = 2<<GPS_FIXED_POINT_DEG,
+};
+
+static char Dir[64];
+
+static int Compare(const DBT * Key1, const DBT * Key2) {
+	if (Key1->size == sizeof(AX25_Addr_t) && Key2->size == sizeof(AX25_Addr_t))
+		return AX25_Addr_Cmp(Key1->data, Key2->data);
+	if (Key1->size == sizeof(APRS_Log_Index_t) && Key2->size == sizeof(APRS_Log_Index_t))
+		return memcmp(Key1->data, Key2->data, sizeof(APRS_Log_Index_t));
+	return (Key1->size == sizeof(AX25_Addr_t))?-1:1;
+}
+
+static double Now_Us(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1e6 + ts.tv_nsec/1e3;
+}
+
+static void Paths(const char * Ext[4], char Path[4][96]) {
+	int i;
+
+	for (i=0 ; i<4 ; i++)
+		snprintf(Path[i], sizeof(Path[i]), "%s/stations.%s", Dir, Ext[i]);
+}
+
+static DB * Create(int N, unsigned Seed, int * Fd) {
+	static const char * ext[] = { "db", "new", "jnl", "rec" };
+	APRS_Station_t batch[BENCH_BATCH];
+	char path[4][96], name[10];
+	APRS_Log_Btree_t btree;
+	int i, n;
+	DB * db;
+
+	Paths(ext, path);
+	btree = (APRS_Log_Btree_t){
+		.path = path[0],
+		.rebuild = path[1],
+		.journal = path[2],
+		.recovery = path[3],
+		.compare = Compare,
+		.check_max = N*4,
+	};
+	if (!(db = APRS_Log_Btree_Open(&btree, O_TRUNC, Fd)))
+		return NULL;
+
+	for (i=0 ; i<N ; i+=n) {
+		for (n=0 ; n<BENCH_BATCH && i+n<N ; n++) {
+			APRS_Station_t * st = &batch[n];
+
+			bzero(st, sizeof(APRS_Station_t));
+			snprintf(name, sizeof(name), "F%c%c%c%c-%d", 'A'+(i+n)%26, 'A'+(i+n)/26%26, 'A'+(i+n)/676%26,
+					'A'+(i+n)/17576%26, (i+n)%16);
+			AX25_Str_To_Addr(name, &st->callid);
+			AX25_Norm_Addr(&st->callid);
+			st->timestamp = BENCH_NOW - rand_r(&Seed) % BENCH_WEEK;
+			st->position.latitude = Center.latitude + (int32_t)(rand_r(&Seed) % (2*BENCH_SPREAD)) - BENCH_SPREAD;
+			st->position.longitude = Center.longitude + (int32_t)(rand_r(&Seed) % (2*BENCH_SPREAD)) - BENCH_SPREAD;
+		}
+		if (APRS_Log_Import(db, batch, n) != n) {
+			db->close(db);
+			return NULL;
+		}
+	}
+
+	return db;
+}
+
+static void Clean(void) {
+	static const char * ext[] = { "db", "new", "jnl", "rec" };
+	char path[4][96];
+	int i;
+
+	Paths(ext, path);
+	for (i=0 ; i<4 ; i++)
+		unlink(path[i]);
+}
+
+static bool Near(const APRS_Station_t * Station) {
+	double lat, dlat, dlon;
+
+	lat = (double)Center.latitude / (1<<GPS_FIXED_POINT_DEG);
+	dlat = (double)Station->position.latitude / (1<<GPS_FIXED_POINT_DEG) - lat;
+	dlon = ((double)Station->position.longitude - Center.longitude) / (1<<GPS_FIXED_POINT_DEG);
+	dlon *= cos(lat * M_PI / 180.0);
+
+	return MILES_PER_DEG * sqrt(dlat*dlat + dlon*dlon) <= BENCH_RADIUS;
+}
+
+// Newest stations heard since BENCH_SINCE and stations near Center, by a walk over every station record
+static void Scan(DB * Db, APRS_Station_t * Heard, int * N_Heard, APRS_Station_t * Around, int * N_Around) {
+	APRS_Station_t station;
+	DBT key, data;
+	int ret, i, flag = R_FIRST;
+
+	*N_Heard = *N_Around = 0;
+	while (!(ret = Db->seq(Db, &key, &data, flag)) && key.size == sizeof(AX25_Addr_t)) {
+		flag = R_NEXT;
+		memcpy(&station, data.data, sizeof(station));
+		if (station.timestamp >= BENCH_SINCE) {
+			// Insert sorted, newest first
+			for (i=*N_Heard ; i>0 && Heard[i-1].timestamp < station.timestamp ; i--)
+				if (i < BENCH_MAX)
+					Heard[i] = Heard[i-1];
+			if (i < BENCH_MAX)
+				Heard[i] = station;
+			if (*N_Heard < BENCH_MAX)
+				(*N_Heard)++;
+		}
+		if (*N_Around < BENCH_MAX && Near(&station))
+			Around[(*N_Around)++] = station;
+	}
+}
+
+static bool Found(const APRS_Station_t * Stations, int N, const AX25_Addr_t * Callid) {
+	int i;
+
+	for (i=0 ; i<N ; i++)
+		if (!AX25_Addr_Cmp(&Stations[i].callid, Callid) && Stations[i].callid.ssid == Callid->ssid)
+			return true;
+	return false;
+}
+
+static void Bench(int N, int Iterations, unsigned Seed) {
+	APRS_Station_t heard[BENCH_MAX], around[BENCH_MAX], s_heard[BENCH_MAX], s_around[BENCH_MAX];
+	int n_heard = 0, n_around = 0, s_n_heard, s_n_around, i, fd;
+	double t0, t_create, t_heard, t_near, t_scan;
+	DB * db;
+
+	t0 = Now_Us();
+	if (!(db = Create(N, Seed, &fd))) {
+		CHECK(0, "%d stations DB not created", N);
+		return;
+	}
+	t_create = Now_Us() - t0;
+
+	t0 = Now_Us();
+	for (i=0 ; i<Iterations ; i++)
+		n_heard = APRS_Log_Last_Heard(db, BENCH_SINCE, heard, BENCH_MAX);
+	t_heard = (Now_Us() - t0) / Iterations;
+
+	t0 = Now_Us();
+	for (i=0 ; i<Iterations ; i++)
+		n_around = APRS_Log_Near(db, &Center, BENCH_RADIUS, around, BENCH_MAX);
+	t_near = (Now_Us() - t0) / Iterations;
+
+	t0 = Now_Us();
+	Scan(db, s_heard, &s_n_heard, s_around, &s_n_around);
+	t_scan = Now_Us() - t0;
+
+	printf("%6d stations : created in %.0f ms, last heard %d in %.0f us, near %d in %.0f us, full scan %.0f us\n",
+			N, t_create/1000, n_heard, t_heard, n_around, t_near, t_scan);
+
+	// Same newest timestamps, same stations within radius (any BENCH_MAX of them when more)
+	CHECK(n_heard == s_n_heard, "%d stations : %d last heard, %d by scan", N, n_heard, s_n_heard);
+	for (i=0 ; i<n_heard && i<s_n_heard ; i++)
+		CHECK(heard[i].timestamp == s_heard[i].timestamp, "%d stations : last heard %d at %lld, %lld by scan",
+				N, i, (long long)heard[i].timestamp, (long long)s_heard[i].timestamp);
+	CHECK(n_around == s_n_around, "%d stations : %d near, %d by scan", N, n_around, s_n_around);
+	for (i=0 ; i<n_around ; i++)
+		CHECK(Near(&around[i]) && (s_n_around == BENCH_MAX || Found(s_around, s_n_around, &around[i].callid)),
+				"%d stations : near %d not within radius", N, i);
+
+	db->close(db);
+	close(fd);
+	Clean();
+}
+
+int main(int argc, char ** argv) {
+	int sizes[BENCH_MAX_SIZES] = { 5000, 50000 }, n_sizes = 0, iterations = 100, opt, i;
+	unsigned seed = 1;
+
+	while ((opt = getopt(argc, argv, "n:i:s:")) != -1) {
+		switch (opt) {
+			case 'n':
+				if (n_sizes < BENCH_MAX_SIZES)
+					sizes[n_sizes++] = atoi(optarg);
+				break;
+			case 'i':
+				iterations = atoi(optarg);
+				break;
+			case 's':
+				seed = atoi(optarg);
+				break;
+			default:
+				fprintf(stderr, "Usage : %s [-n stations]... [-i iterations] [-s seed]\n", argv[0]);
+				return 2;
+		}
+	}
+	if (!n_sizes)
+		n_sizes = 2;
+	if (iterations < 1)
+		iterations = 1;
+
+	esp_log_level_set("*", ESP_LOG_NONE);
+
+	snprintf(Dir, sizeof(Dir), "%s/benchXXXXXX", getenv("TMPDIR") && strlen(getenv("TMPDIR")) < 32 ? getenv("TMPDIR") : "/tmp");
+	if (!mkdtemp(Dir)) {
+		perror(Dir);
+		return 1;
+	}
+
+	for (i=0 ; i<n_sizes ; i++)
+		Bench(sizes[i], iterations, seed);
+
+	rmdir(Dir);
+
+	return Test_Result("aprs_stations_bench");
+}
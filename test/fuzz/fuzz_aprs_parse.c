@@ -0,0 +1,110 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/fuzz/fuzz_aprs_parse.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Fuzz target for APRS_Parse, libFuzzer entry point.
+//
+// Input is the 6 chars destination callid (Mic-E latitude) then the
+// information field, the DTI in first info byte selects the parser.
+// Text left in the frame by the APRS_EVENT descriptor must be the decoded
+// one, and parsed data is encoded back to exercise the encoder on odd values.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_log.h>
+
+#include "aprs.h"
+#include "aprs_parsers.h"
+#include "aprs_encoder.h"
+#include "framebuff.h"
+
+#define FUZZ_DST_LEN	6
+#define FUZZ_HDR_LEN	(2*sizeof(AX25_Addr_t) + 2)	// DST, SRC, ctrl, pid
+
+int LLVMFuzzerTestOneInput(const uint8_t * Data, size_t Size) {
+	static const AX25_Addr_t src = {.callid = {'F'<<1, '4'<<1, 'A'<<1, 'B'<<1, 'C'<<1, ' '<<1}, .ssid = 0x61};
+	static APRS_Data_t data;
+	static APRS_Event_Data_t event;
+	char text[sizeof(data.message.text)];
+	static union {
+		Frame_t frame;
+		uint8_t buff[sizeof(Frame_t) + APRS_MAX_FRAME_LEN];
+	} out = {.frame.frame_size = APRS_MAX_FRAME_LEN};
+	AX25_Addr_t * dst;
+	Frame_t * frame;
+	static bool init;
+	size_t info, len;
+	int i, ret;
+
+	if (!init) {
+		esp_log_level_set("*", ESP_LOG_NONE);
+		init = true;
+	}
+
+	info = Size > FUZZ_DST_LEN ? Size - FUZZ_DST_LEN : 0;
+	len = FUZZ_HDR_LEN + info + 2;
+
+	// Exact size, out of bound reads are caught by ASan
+	if (!(frame = malloc(sizeof(Frame_t) + len)))
+		return 0;
+	bzero(frame, sizeof(Frame_t));
+	frame->frame_size = len;
+	frame->frame_len = len;
+
+	dst = (AX25_Addr_t*)frame->frame;
+	for (i=0 ; i<FUZZ_DST_LEN ; i++)
+		dst->callid[i] = (i < Size ? Data[i] : ' ')<<1;
+	dst->ssid = 0x60;
+	memcpy(&frame->frame[sizeof(AX25_Addr_t)], &src, sizeof(AX25_Addr_t));
+	frame->frame[FUZZ_HDR_LEN-2] = 0x03;
+	frame->frame[FUZZ_HDR_LEN-1] = 0xf0;
+	if (info)
+		memcpy(&frame->frame[FUZZ_HDR_LEN], Data+FUZZ_DST_LEN, info);
+	frame->frame[len-2] = 0x55;
+	frame->frame[len-1] = 0xaa;
+
+	ret = APRS_Parse(frame, &data);
+
+	// Frame must be left untouched
+	if (frame->frame[len-2] != 0x55 || frame->frame[len-1] != 0xaa
+			|| (info && memcmp(&frame->frame[FUZZ_HDR_LEN], Data+FUZZ_DST_LEN, info)))
+		abort();
+
+	if (ret != -1) {
+		if (!memchr(data.text, '\0', sizeof(data.text)))
+			abort();
+		APRS_Event_Init(&event, frame, &data);
+		if (event.text && (event.text+event.text_len > len-2
+				|| APRS_Event_Text(&event, text, sizeof(text)) != event.text_len
+				|| strcmp(text, (data.type == APRS_DTI_MESSAGE)?data.message.text:data.text)))
+			abort();
+		APRS_Encode(&data, &out.frame);
+	}
+
+	free(frame);
+
+	return 0;
+}
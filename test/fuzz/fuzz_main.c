@@ -0,0 +1,211 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/fuzz/fuzz_main.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Standalone driver for fuzz targets, when libFuzzer is not available :
+// runs each corpus file (or stdin, for AFL), then Iterations random
+// mutations of the corpus. Crashes are reported by the sanitizers.
+//
+//	fuzz_aprs_parse [-n iterations] [-s seed] corpus_dir|file ...
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define FUZZ_MAX_INPUT	512
+#define FUZZ_MAX_FILES	4096
+
+int LLVMFuzzerTestOneInput(const uint8_t * Data, size_t Size);
+
+static struct {
+	uint8_t * data;
+	size_t len;
+} Corpus[FUZZ_MAX_FILES];
+static int N_Corpus;
+
+static uint32_t Rnd;
+
+static uint32_t Random(void) {
+	Rnd ^= Rnd << 13;
+	Rnd ^= Rnd >> 17;
+	Rnd ^= Rnd << 5;
+	return Rnd;
+}
+
+static int Load_File(const char * Path) {
+	uint8_t buff[FUZZ_MAX_INPUT];
+	FILE * file;
+	size_t len;
+
+	if (N_Corpus == FUZZ_MAX_FILES)
+		return -1;
+
+	if (!(file = fopen(Path, "rb"))) {
+		perror(Path);
+		return -1;
+	}
+	len = fread(buff, 1, sizeof(buff), file);
+	fclose(file);
+
+	if (!(Corpus[N_Corpus].data = malloc(len ? len : 1)))
+		return -1;
+	memcpy(Corpus[N_Corpus].data, buff, len);
+	Corpus[N_Corpus].len = len;
+	N_Corpus++;
+
+	return 0;
+}
+
+static int Load(const char * Path) {
+	char file[1024];
+	struct dirent * ent;
+	struct stat st;
+	DIR * dir;
+
+	if (stat(Path, &st)) {
+		perror(Path);
+		return -1;
+	}
+
+	if (!S_ISDIR(st.st_mode))
+		return Load_File(Path);
+
+	if (!(dir = opendir(Path)))
+		return -1;
+	while ((ent = readdir(dir))) {
+		if (ent->d_name[0] == '.')
+			continue;
+		snprintf(file, sizeof(file), "%s/%s", Path, ent->d_name);
+		Load_File(file);
+	}
+	closedir(dir);
+
+	return 0;
+}
+
+// Apply a few random mutations, return new length
+static size_t Mutate(uint8_t * Buff, size_t Len) {
+	static const char special[] = "!\"#$%'()*,./:;<>=?@[]\\^_`{|}~-0123456789ANSEWTzh \r\n";
+	int n, pos, other;
+	size_t len;
+
+	for (n = 1 + Random()%4 ; n ; n--) {
+		pos = Len ? Random()%Len : 0;
+		switch (Random()%8) {
+			case 0:	// Bit flip
+				if (Len)
+					Buff[pos] ^= 1<<(Random()%8);
+				break;
+			case 1:	// Random byte
+				if (Len)
+					Buff[pos] = Random();
+				break;
+			case 2:	// APRS syntax char
+			case 3:
+				if (Len)
+					Buff[pos] = special[Random()%(sizeof(special)-1)];
+				break;
+			case 4:	// Insert
+				if (Len < FUZZ_MAX_INPUT) {
+					memmove(Buff+pos+1, Buff+pos, Len-pos);
+					Buff[pos] = special[Random()%(sizeof(special)-1)];
+					Len++;
+				}
+				break;
+			case 5:	// Delete
+				if (Len) {
+					memmove(Buff+pos, Buff+pos+1, Len-pos-1);
+					Len--;
+				}
+				break;
+			case 6:	// Truncate
+				Len = pos;
+				break;
+			case 7:	// Splice tail of another input
+				other = Random()%N_Corpus;
+				len = Corpus[other].len ? Random()%Corpus[other].len : 0;
+				if (pos + Corpus[other].len - len > FUZZ_MAX_INPUT)
+					break;
+				memcpy(Buff+pos, Corpus[other].data+len, Corpus[other].len-len);
+				Len = pos + Corpus[other].len - len;
+				break;
+		}
+	}
+
+	return Len;
+}
+
+int main(int argc, char ** argv) {
+	uint8_t buff[FUZZ_MAX_INPUT];
+	unsigned long iterations = 0, i;
+	size_t len;
+	int opt;
+
+	Rnd = 1;
+	while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+		switch (opt) {
+			case 'n':
+				iterations = strtoul(optarg, NULL, 0);
+				break;
+			case 's':
+				Rnd = strtoul(optarg, NULL, 0);
+				if (!Rnd)
+					Rnd = 1;
+				break;
+			default:
+				fprintf(stderr, "Usage : %s [-n iterations] [-s seed] corpus_dir|file ...\n", argv[0]);
+				return 2;
+		}
+	}
+
+	// No corpus : single input from stdin (AFL)
+	if (optind == argc) {
+		len = fread(buff, 1, sizeof(buff), stdin);
+		return LLVMFuzzerTestOneInput(buff, len);
+	}
+
+	for (; optind < argc ; optind++)
+		Load(argv[optind]);
+
+	if (!N_Corpus) {
+		fprintf(stderr, "Empty corpus\n");
+		return 1;
+	}
+
+	for (i=0 ; i<N_Corpus ; i++)
+		LLVMFuzzerTestOneInput(Corpus[i].data, Corpus[i].len);
+
+	for (i=0 ; i<iterations ; i++) {
+		opt = Random()%N_Corpus;
+		memcpy(buff, Corpus[opt].data, Corpus[opt].len);
+		len = Mutate(buff, Corpus[opt].len);
+		LLVMFuzzerTestOneInput(buff, len);
+	}
+
+	printf("%d corpus inputs, %lu mutations : ok\n", N_Corpus, iterations);
+
+	return 0;
+}
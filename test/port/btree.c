@@ -0,0 +1,66 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/port/btree.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// db 1.85 btree, host implementation on the compatibility interface of Berkeley DB
+
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <berkeley-db/db.h>
+
+#ifdef HOST_DB185
+DB * __db185_open(const char * Path, int Flags, int Mode, DBTYPE Type, const void * Openinfo);
+#endif
+
+// Firmware btree works on the file descriptor, Berkeley DB one opens a path :
+// the file is reopened by name
+DB * __bt_open(void * Fd, const void * Openinfo, const BTREEINFO * Info, int Dflags) {
+#ifdef HOST_DB185
+	char link[32], path[PATH_MAX];
+	BTREEINFO info = *Info;
+	struct stat st;
+	ssize_t len;
+
+	snprintf(link, sizeof(link), "/proc/self/fd/%d", (int)(intptr_t)Fd);
+	if ((len = readlink(link, path, sizeof(path)-1)) < 0)
+		return NULL;
+	path[len] = 0;
+
+	// An empty file is not a btree for Berkeley DB, let it create one
+	if (!fstat((int)(intptr_t)Fd, &st) && !st.st_size)
+		unlink(path);
+
+	// Keys per page bound the key size in Berkeley DB, page size is enough
+	info.maxkeypage = info.minkeypage = 0;
+
+	return __db185_open(path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR, DB_BTREE, &info);
+#else
+	errno = ENOSYS;
+	return NULL;
+#endif
+}
@@ -0,0 +1,150 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/port/esp.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// ESP-IDF helpers used by firmware modules, host implementation
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/random.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+
+#define SHUTDOWN_HANDLERS_MAX	5
+
+static esp_log_level_t Log_Level = ESP_LOG_WARN;
+
+void esp_log_level_set(const char * Tag, esp_log_level_t Level) {
+	if (Tag && !strcmp(Tag, "*"))
+		Log_Level = Level;
+}
+
+void esp_log_write(esp_log_level_t Level, const char * Tag, const char * Format, ...) {
+	va_list ap;
+
+	if (Level > Log_Level)
+		return;
+
+	va_start(ap, Format);
+	vfprintf(stderr, Format, ap);
+	va_end(ap);
+}
+
+uint32_t esp_log_timestamp(void) {
+	static struct timespec start;
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	if (!start.tv_sec && !start.tv_nsec)
+		start = ts;
+
+	return (ts.tv_sec - start.tv_sec)*1000 + (ts.tv_nsec - start.tv_nsec)/1000000;
+}
+
+const char * esp_err_to_name(esp_err_t Err) {
+	switch (Err) {
+		case ESP_OK: return "ESP_OK";
+		case ESP_FAIL: return "ESP_FAIL";
+		case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+		case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+		case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+		case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+		case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+		case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+		default: return "UNKNOWN ERROR";
+	}
+}
+
+uint32_t esp_random(void) {
+	uint32_t r;
+
+	if (getrandom(&r, sizeof(r), 0) != sizeof(r))
+		r = (uint32_t)random();
+
+	return r;
+}
+
+void esp_fill_random(void * Buf, size_t Len) {
+	uint8_t * p = Buf;
+	uint32_t r;
+
+	while (Len) {
+		r = esp_random();
+		size_t n = Len < sizeof(r) ? Len : sizeof(r);
+		memcpy(p, &r, n);
+		p += n;
+		Len -= n;
+	}
+}
+
+// CRC-16/CCITT, reflected (poly 0x8408)
+uint16_t esp_rom_crc16_le(uint16_t Crc, const uint8_t * Buf, uint32_t Len) {
+	int i;
+
+	Crc = ~Crc;
+	while (Len--) {
+		Crc ^= *(Buf++);
+		for (i=0;i<8;i++)
+			Crc = (Crc&1) ? (Crc>>1)^0x8408 : Crc>>1;
+	}
+
+	return ~Crc;
+}
+
+// CRC-32, reflected (poly 0xEDB88320)
+uint32_t esp_rom_crc32_le(uint32_t Crc, const uint8_t * Buf, uint32_t Len) {
+	int i;
+
+	Crc = ~Crc;
+	while (Len--) {
+		Crc ^= *(Buf++);
+		for (i=0;i<8;i++)
+			Crc = (Crc&1) ? (Crc>>1)^0xEDB88320 : Crc>>1;
+	}
+
+	return ~Crc;
+}
+
+static shutdown_handler_t Shutdown_Handlers[SHUTDOWN_HANDLERS_MAX];
+
+// Registered only, host processes are not restarted through esp_restart()
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t Handler) {
+	int i;
+
+	for (i=0; i<SHUTDOWN_HANDLERS_MAX; i++) {
+		if (Shutdown_Handlers[i] == Handler)
+			return ESP_ERR_INVALID_STATE;
+		if (!Shutdown_Handlers[i]) {
+			Shutdown_Handlers[i] = Handler;
+			return ESP_OK;
+		}
+	}
+
+	return ESP_ERR_NO_MEM;
+}
@@ -0,0 +1,705 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/port/freertos.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// FreeRTOS API on top of pthreads, enough to run firmware modules on host
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "freertos/timers.h"
+
+struct Host_Task_S {
+	pthread_t thread;
+	TaskFunction_t func;
+	void * arg;
+	SemaphoreHandle_t notify;
+};
+
+typedef enum {
+	HOST_SEM_COUNTING = 0,
+	HOST_SEM_MUTEX,
+	HOST_SEM_RECURSIVE,
+} Host_Sem_Type_t;
+
+struct Host_Sem_S {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	Host_Sem_Type_t type;
+	UBaseType_t count;
+	UBaseType_t max;
+	pthread_t owner;
+	UBaseType_t depth;
+};
+
+struct Host_Queue_S {
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	UBaseType_t len;
+	UBaseType_t item_size;
+	UBaseType_t head;
+	UBaseType_t count;
+	uint8_t buff[];
+};
+
+struct Host_Timer_S {
+	struct Host_Timer_S * next;
+	TimerCallbackFunction_t cb;
+	void * id;
+	TickType_t period;
+	bool reload;
+	bool active;
+	uint64_t expiry;	// Absolute, in ms
+};
+
+static pthread_mutex_t Critical_Lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static pthread_key_t Task_Key;
+static pthread_once_t Task_Key_Once = PTHREAD_ONCE_INIT;
+
+static pthread_mutex_t Timer_Lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t Timer_Cond;
+static pthread_once_t Timer_Once = PTHREAD_ONCE_INIT;
+static TimerHandle_t Timer_List;
+
+// Monotonic time in ms
+static uint64_t Host_Now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+static void Host_Deadline(struct timespec * Ts, TickType_t Ticks) {
+	uint64_t ns;
+
+	clock_gettime(CLOCK_MONOTONIC, Ts);
+	ns = (uint64_t)Ts->tv_nsec + (uint64_t)pdTICKS_TO_MS(Ticks)*1000000;
+	Ts->tv_sec += ns/1000000000;
+	Ts->tv_nsec = ns%1000000000;
+}
+
+static void Host_Cond_Init(pthread_cond_t * Cond) {
+	pthread_condattr_t attr;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(Cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+// Wait on Cond with Lock held, false on timeout
+static bool Host_Wait(pthread_cond_t * Cond, pthread_mutex_t * Lock, TickType_t Ticks, const struct timespec * Deadline) {
+	if (!Ticks)
+		return false;
+
+	if (Ticks == portMAX_DELAY) {
+		pthread_cond_wait(Cond, Lock);
+		return true;
+	}
+
+	return pthread_cond_timedwait(Cond, Lock, Deadline) != ETIMEDOUT;
+}
+
+void vPortEnterCritical(void) {
+	pthread_mutex_lock(&Critical_Lock);
+}
+
+void vPortExitCritical(void) {
+	pthread_mutex_unlock(&Critical_Lock);
+}
+
+// Tasks
+
+static void Host_Task_Key_Init(void) {
+	pthread_key_create(&Task_Key, NULL);
+}
+
+static void * Host_Task_Entry(void * Arg) {
+	TaskHandle_t task = Arg;
+
+	pthread_setspecific(Task_Key, task);
+	task->func(task->arg);
+
+	return NULL;
+}
+
+static TaskHandle_t Host_Task_Create(TaskFunction_t Func, void * Arg) {
+	TaskHandle_t task;
+	pthread_attr_t attr;
+
+	pthread_once(&Task_Key_Once, Host_Task_Key_Init);
+
+	if (!(task = calloc(1, sizeof(struct Host_Task_S))))
+		return NULL;
+
+	task->func = Func;
+	task->arg = Arg;
+	task->notify = xSemaphoreCreateCounting(UINT32_MAX, 0);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if (pthread_create(&task->thread, &attr, Host_Task_Entry, task)) {
+		pthread_attr_destroy(&attr);
+		vSemaphoreDelete(task->notify);
+		free(task);
+		return NULL;
+	}
+	pthread_attr_destroy(&attr);
+
+	return task;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t Func, const char * Name, uint32_t Stack, void * Arg, UBaseType_t Prio, TaskHandle_t * Handle) {
+	TaskHandle_t task = Host_Task_Create(Func, Arg);
+
+	if (Handle)
+		*Handle = task;
+
+	return task ? pdPASS : pdFAIL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t Func, const char * Name, uint32_t Stack, void * Arg, UBaseType_t Prio, TaskHandle_t * Handle, BaseType_t Core) {
+	return xTaskCreate(Func, Name, Stack, Arg, Prio, Handle);
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t Func, const char * Name, uint32_t Stack, void * Arg, UBaseType_t Prio, StackType_t * Stack_Buff, StaticTask_t * Task_Buff) {
+	return Host_Task_Create(Func, Arg);
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t Func, const char * Name, uint32_t Stack, void * Arg, UBaseType_t Prio, StackType_t * Stack_Buff, StaticTask_t * Task_Buff, BaseType_t Core) {
+	return Host_Task_Create(Func, Arg);
+}
+
+// Only self deletion is supported
+void vTaskDelete(TaskHandle_t Task) {
+	if (!Task || Task == xTaskGetCurrentTaskHandle())
+		pthread_exit(NULL);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+	pthread_once(&Task_Key_Once, Host_Task_Key_Init);
+	return pthread_getspecific(Task_Key);
+}
+
+void vTaskDelay(TickType_t Ticks) {
+	struct timespec ts = {
+		.tv_sec = pdTICKS_TO_MS(Ticks)/1000,
+		.tv_nsec = (pdTICKS_TO_MS(Ticks)%1000)*1000000
+	};
+
+	while (nanosleep(&ts, &ts) && errno == EINTR);
+}
+
+TickType_t xTaskGetTickCount(void) {
+	return (TickType_t)pdMS_TO_TICKS(Host_Now());
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t Task) {
+	if (!Task)
+		return pdFAIL;
+
+	return xSemaphoreGive(Task->notify);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t Clear, TickType_t Ticks) {
+	TaskHandle_t task = xTaskGetCurrentTaskHandle();
+	uint32_t count;
+
+	if (!task || xSemaphoreTake(task->notify, Ticks) != pdPASS)
+		return 0;
+
+	count = 1;
+	if (Clear)
+		while (xSemaphoreTake(task->notify, 0) == pdPASS)
+			count++;
+
+	return count;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t Task) {
+	return UINT32_MAX;
+}
+
+// Semaphores
+
+static SemaphoreHandle_t Host_Sem_Create(Host_Sem_Type_t Type, UBaseType_t Max, UBaseType_t Initial) {
+	SemaphoreHandle_t sem;
+
+	if (!(sem = calloc(1, sizeof(struct Host_Sem_S))))
+		return NULL;
+
+	pthread_mutex_init(&sem->lock, NULL);
+	Host_Cond_Init(&sem->cond);
+	sem->type = Type;
+	sem->max = Max;
+	sem->count = Initial;
+
+	return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+	return Host_Sem_Create(HOST_SEM_MUTEX, 1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t * Buff) {
+	return xSemaphoreCreateMutex();
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void) {
+	return Host_Sem_Create(HOST_SEM_RECURSIVE, 1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutexStatic(StaticSemaphore_t * Buff) {
+	return xSemaphoreCreateRecursiveMutex();
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+	return Host_Sem_Create(HOST_SEM_COUNTING, 1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t * Buff) {
+	return xSemaphoreCreateBinary();
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t Max, UBaseType_t Initial) {
+	return Host_Sem_Create(HOST_SEM_COUNTING, Max, Initial);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCountingStatic(UBaseType_t Max, UBaseType_t Initial, StaticSemaphore_t * Buff) {
+	return xSemaphoreCreateCounting(Max, Initial);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t Sem) {
+	if (!Sem)
+		return;
+
+	pthread_cond_destroy(&Sem->cond);
+	pthread_mutex_destroy(&Sem->lock);
+	free(Sem);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t Sem, TickType_t Ticks) {
+	struct timespec deadline;
+
+	if (!Sem)
+		return pdFAIL;
+
+	Host_Deadline(&deadline, Ticks);
+
+	pthread_mutex_lock(&Sem->lock);
+	while (!Sem->count) {
+		if (!Host_Wait(&Sem->cond, &Sem->lock, Ticks, &deadline)) {
+			pthread_mutex_unlock(&Sem->lock);
+			return pdFAIL;
+		}
+	}
+	Sem->count--;
+	if (Sem->type != HOST_SEM_COUNTING)
+		Sem->owner = pthread_self();
+	pthread_mutex_unlock(&Sem->lock);
+
+	return pdPASS;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t Sem) {
+	if (!Sem)
+		return pdFAIL;
+
+	pthread_mutex_lock(&Sem->lock);
+	if (Sem->count >= Sem->max) {
+		pthread_mutex_unlock(&Sem->lock);
+		return pdFAIL;
+	}
+	Sem->count++;
+	pthread_cond_signal(&Sem->cond);
+	pthread_mutex_unlock(&Sem->lock);
+
+	return pdPASS;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t Sem, TickType_t Ticks) {
+	if (!Sem)
+		return pdFAIL;
+
+	pthread_mutex_lock(&Sem->lock);
+	if (Sem->depth && pthread_equal(Sem->owner, pthread_self())) {
+		Sem->depth++;
+		pthread_mutex_unlock(&Sem->lock);
+		return pdPASS;
+	}
+	pthread_mutex_unlock(&Sem->lock);
+
+	if (xSemaphoreTake(Sem, Ticks) != pdPASS)
+		return pdFAIL;
+
+	pthread_mutex_lock(&Sem->lock);
+	Sem->depth = 1;
+	pthread_mutex_unlock(&Sem->lock);
+
+	return pdPASS;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t Sem) {
+	if (!Sem)
+		return pdFAIL;
+
+	pthread_mutex_lock(&Sem->lock);
+	if (!Sem->depth || !pthread_equal(Sem->owner, pthread_self())) {
+		pthread_mutex_unlock(&Sem->lock);
+		return pdFAIL;
+	}
+	if (--Sem->depth) {
+		pthread_mutex_unlock(&Sem->lock);
+		return pdPASS;
+	}
+	pthread_mutex_unlock(&Sem->lock);
+
+	return xSemaphoreGive(Sem);
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t Sem) {
+	UBaseType_t count;
+
+	if (!Sem)
+		return 0;
+
+	pthread_mutex_lock(&Sem->lock);
+	count = Sem->count;
+	pthread_mutex_unlock(&Sem->lock);
+
+	return count;
+}
+
+// Queues
+
+QueueHandle_t xQueueCreate(UBaseType_t Len, UBaseType_t Item_Size) {
+	QueueHandle_t queue;
+
+	if (!Len || !(queue = calloc(1, sizeof(struct Host_Queue_S) + (size_t)Len*Item_Size)))
+		return NULL;
+
+	pthread_mutex_init(&queue->lock, NULL);
+	Host_Cond_Init(&queue->not_empty);
+	Host_Cond_Init(&queue->not_full);
+	queue->len = Len;
+	queue->item_size = Item_Size;
+
+	return queue;
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t Len, UBaseType_t Item_Size, uint8_t * Buff, StaticQueue_t * Queue_Buff) {
+	return xQueueCreate(Len, Item_Size);
+}
+
+void vQueueDelete(QueueHandle_t Queue) {
+	if (!Queue)
+		return;
+
+	pthread_cond_destroy(&Queue->not_full);
+	pthread_cond_destroy(&Queue->not_empty);
+	pthread_mutex_destroy(&Queue->lock);
+	free(Queue);
+}
+
+static BaseType_t Host_Queue_Put(QueueHandle_t Queue, const void * Item, TickType_t Ticks, bool Front) {
+	struct timespec deadline;
+	UBaseType_t pos;
+
+	if (!Queue)
+		return pdFAIL;
+
+	Host_Deadline(&deadline, Ticks);
+
+	pthread_mutex_lock(&Queue->lock);
+	while (Queue->count == Queue->len) {
+		if (!Host_Wait(&Queue->not_full, &Queue->lock, Ticks, &deadline)) {
+			pthread_mutex_unlock(&Queue->lock);
+			return pdFAIL;
+		}
+	}
+
+	if (Front) {
+		Queue->head = Queue->head ? Queue->head-1 : Queue->len-1;
+		pos = Queue->head;
+	} else
+		pos = (Queue->head + Queue->count) % Queue->len;
+
+	memcpy(Queue->buff + (size_t)pos*Queue->item_size, Item, Queue->item_size);
+	Queue->count++;
+	pthread_cond_signal(&Queue->not_empty);
+	pthread_mutex_unlock(&Queue->lock);
+
+	return pdPASS;
+}
+
+static BaseType_t Host_Queue_Get(QueueHandle_t Queue, void * Item, TickType_t Ticks, bool Peek) {
+	struct timespec deadline;
+
+	if (!Queue)
+		return pdFAIL;
+
+	Host_Deadline(&deadline, Ticks);
+
+	pthread_mutex_lock(&Queue->lock);
+	while (!Queue->count) {
+		if (!Host_Wait(&Queue->not_empty, &Queue->lock, Ticks, &deadline)) {
+			pthread_mutex_unlock(&Queue->lock);
+			return pdFAIL;
+		}
+	}
+
+	memcpy(Item, Queue->buff + (size_t)Queue->head*Queue->item_size, Queue->item_size);
+	if (!Peek) {
+		Queue->head = (Queue->head + 1) % Queue->len;
+		Queue->count--;
+		pthread_cond_signal(&Queue->not_full);
+	}
+	pthread_mutex_unlock(&Queue->lock);
+
+	return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t Queue, const void * Item, TickType_t Ticks) {
+	return Host_Queue_Put(Queue, Item, Ticks, false);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t Queue, const void * Item, TickType_t Ticks) {
+	return Host_Queue_Put(Queue, Item, Ticks, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t Queue, const void * Item, TickType_t Ticks) {
+	return Host_Queue_Put(Queue, Item, Ticks, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t Queue, void * Item, TickType_t Ticks) {
+	return Host_Queue_Get(Queue, Item, Ticks, false);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t Queue, void * Item, TickType_t Ticks) {
+	return Host_Queue_Get(Queue, Item, Ticks, true);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t Queue) {
+	UBaseType_t count;
+
+	if (!Queue)
+		return 0;
+
+	pthread_mutex_lock(&Queue->lock);
+	count = Queue->count;
+	pthread_mutex_unlock(&Queue->lock);
+
+	return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t Queue) {
+	UBaseType_t count;
+
+	if (!Queue)
+		return 0;
+
+	pthread_mutex_lock(&Queue->lock);
+	count = Queue->len - Queue->count;
+	pthread_mutex_unlock(&Queue->lock);
+
+	return count;
+}
+
+BaseType_t xQueueReset(QueueHandle_t Queue) {
+	if (!Queue)
+		return pdFAIL;
+
+	pthread_mutex_lock(&Queue->lock);
+	Queue->head = 0;
+	Queue->count = 0;
+	pthread_cond_broadcast(&Queue->not_full);
+	pthread_mutex_unlock(&Queue->lock);
+
+	return pdPASS;
+}
+
+// Software timers
+
+static void * Host_Timer_Task(void * Arg) {
+	TimerHandle_t timer, next;
+	struct timespec ts;
+	uint64_t now;
+
+	pthread_mutex_lock(&Timer_Lock);
+	do {
+		now = Host_Now();
+		next = NULL;
+		for (timer = Timer_List ; timer ; timer = timer->next)
+			if (timer->active && (!next || timer->expiry < next->expiry))
+				next = timer;
+
+		if (!next) {
+			pthread_cond_wait(&Timer_Cond, &Timer_Lock);
+			continue;
+		}
+
+		if (next->expiry > now) {
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			ts.tv_sec += (next->expiry - now)/1000;
+			ts.tv_nsec += ((next->expiry - now)%1000)*1000000;
+			if (ts.tv_nsec >= 1000000000) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000;
+			}
+			pthread_cond_timedwait(&Timer_Cond, &Timer_Lock, &ts);
+			continue;
+		}
+
+		if (next->reload)
+			next->expiry += next->period ? pdTICKS_TO_MS(next->period) : 1;
+		else
+			next->active = false;
+
+		// Callback may restart or stop timers
+		pthread_mutex_unlock(&Timer_Lock);
+		next->cb(next);
+		pthread_mutex_lock(&Timer_Lock);
+	} while (1);
+
+	return NULL;
+}
+
+static void Host_Timer_Init(void) {
+	pthread_t thread;
+
+	Host_Cond_Init(&Timer_Cond);
+	pthread_create(&thread, NULL, Host_Timer_Task, NULL);
+	pthread_detach(thread);
+}
+
+TimerHandle_t xTimerCreate(const char * Name, TickType_t Period, UBaseType_t Reload, void * Id, TimerCallbackFunction_t Cb) {
+	TimerHandle_t timer;
+
+	if (!Cb || !(timer = calloc(1, sizeof(struct Host_Timer_S))))
+		return NULL;
+
+	pthread_once(&Timer_Once, Host_Timer_Init);
+
+	timer->cb = Cb;
+	timer->id = Id;
+	timer->period = Period;
+	timer->reload = Reload;
+
+	pthread_mutex_lock(&Timer_Lock);
+	timer->next = Timer_List;
+	Timer_List = timer;
+	pthread_mutex_unlock(&Timer_Lock);
+
+	return timer;
+}
+
+TimerHandle_t xTimerCreateStatic(const char * Name, TickType_t Period, UBaseType_t Reload, void * Id, TimerCallbackFunction_t Cb, StaticTimer_t * Buff) {
+	return xTimerCreate(Name, Period, Reload, Id, Cb);
+}
+
+BaseType_t xTimerDelete(TimerHandle_t Timer, TickType_t Ticks) {
+	TimerHandle_t * prev;
+
+	if (!Timer)
+		return pdFAIL;
+
+	pthread_mutex_lock(&Timer_Lock);
+	for (prev = &Timer_List ; *prev ; prev = &(*prev)->next)
+		if (*prev == Timer) {
+			*prev = Timer->next;
+			break;
+		}
+	pthread_mutex_unlock(&Timer_Lock);
+
+	free(Timer);
+
+	return pdPASS;
+}
+
+BaseType_t xTimerStart(TimerHandle_t Timer, TickType_t Ticks) {
+	if (!Timer)
+		return pdFAIL;
+
+	pthread_mutex_lock(&Timer_Lock);
+	Timer->expiry = Host_Now() + pdTICKS_TO_MS(Timer->period);
+	Timer->active = true;
+	pthread_cond_signal(&Timer_Cond);
+	pthread_mutex_unlock(&Timer_Lock);
+
+	return pdPASS;
+}
+
+BaseType_t xTimerReset(TimerHandle_t Timer, TickType_t Ticks) {
+	return xTimerStart(Timer, Ticks);
+}
+
+BaseType_t xTimerStop(TimerHandle_t Timer, TickType_t Ticks) {
+	if (!Timer)
+		return pdFAIL;
+
+	pthread_mutex_lock(&Timer_Lock);
+	Timer->active = false;
+	pthread_mutex_unlock(&Timer_Lock);
+
+	return pdPASS;
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t Timer, TickType_t Period, TickType_t Ticks) {
+	if (!Timer)
+		return pdFAIL;
+
+	pthread_mutex_lock(&Timer_Lock);
+	Timer->period = Period;
+	pthread_mutex_unlock(&Timer_Lock);
+
+	// As on target, changing the period starts the timer
+	return xTimerStart(Timer, Ticks);
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t Timer) {
+	BaseType_t active;
+
+	if (!Timer)
+		return pdFALSE;
+
+	pthread_mutex_lock(&Timer_Lock);
+	active = Timer->active;
+	pthread_mutex_unlock(&Timer_Lock);
+
+	return active;
+}
+
+void * pvTimerGetTimerID(TimerHandle_t Timer) {
+	return Timer ? Timer->id : NULL;
+}
+
+TickType_t xTimerGetPeriod(TimerHandle_t Timer) {
+	return Timer ? Timer->period : 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/port/include/berkeley-db/db.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOST_BERKELEY_DB_H_
+#define _HOST_BERKELEY_DB_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// 4.4BSD db 1.85 access method interface, as used by the station stores.
+// The btree is the 1.85 compatibility one of Berkeley DB when found at configure
+// time (test/port/btree.c), __bt_open fails otherwise
+
+#define RET_ERROR	-1
+#define RET_SUCCESS	0
+#define RET_SPECIAL	1
+
+// Routine flags
+#define R_CURSOR	1	// del, put, seq
+#define R_FIRST		3	// seq
+#define R_IAFTER	4	// put (RECNO)
+#define R_IBEFORE	5	// put (RECNO)
+#define R_LAST		6	// seq (BTREE, RECNO)
+#define R_NEXT		7	// seq
+#define R_NOOVERWRITE	8	// put
+#define R_PREV		9	// seq (BTREE, RECNO)
+#define R_SETCURSOR	10	// put (RECNO)
+#define R_RECNOSYNC	11	// sync (RECNO)
+
+typedef struct {
+	void * data;
+	size_t size;
+} DBT;
+
+typedef enum { DB_BTREE, DB_HASH, DB_RECNO } DBTYPE;
+
+typedef struct __db {
+	DBTYPE type;
+	int (*close)(struct __db *);
+	int (*del)(const struct __db *, const DBT *, unsigned int);
+	int (*get)(const struct __db *, const DBT *, DBT *, unsigned int);
+	int (*put)(const struct __db *, DBT *, const DBT *, unsigned int);
+	int (*seq)(const struct __db *, DBT *, DBT *, unsigned int);
+	int (*sync)(const struct __db *, unsigned int);
+	void * internal;
+	int (*fd)(const struct __db *);
+} DB;
+
+typedef struct {
+	unsigned long flags;
+	unsigned int cachesize;
+	int maxkeypage;
+	int minkeypage;
+	unsigned int psize;
+	int (*compare)(const DBT *, const DBT *);
+	size_t (*prefix)(const DBT *, const DBT *);
+	int lorder;
+} BTREEINFO;
+
+// Btree on an open file descriptor, as firmware one
+DB * __bt_open(void * Fd, const void * Openinfo, const BTREEINFO * Info, int Dflags);
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/port/include/esp_err.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOST_ESP_ERR_H_
+#define _HOST_ESP_ERR_H_
+
+typedef int esp_err_t;
+
+#define ESP_OK			0
+#define ESP_FAIL		-1
+#define ESP_ERR_NO_MEM		0x101
+#define ESP_ERR_INVALID_ARG	0x102
+#define ESP_ERR_INVALID_STATE	0x103
+#define ESP_ERR_INVALID_SIZE	0x104
+#define ESP_ERR_NOT_FOUND	0x105
+#define ESP_ERR_TIMEOUT		0x107
+
+const char * esp_err_to_name(esp_err_t Err);
+
+#endif
@@ -0,0 +1,41 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/port/include/esp_heap_caps.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOST_ESP_HEAP_CAPS_H_
+#define _HOST_ESP_HEAP_CAPS_H_
+
+#include <stdlib.h>
+
+#define MALLOC_CAP_DEFAULT	(1<<12)
+#define MALLOC_CAP_INTERNAL	(1<<11)
+#define MALLOC_CAP_SPIRAM	(1<<10)
+#define MALLOC_CAP_DMA		(1<<3)
+#define MALLOC_CAP_8BIT		(1<<2)
+
+// Single heap on host
+#define heap_caps_malloc(size, caps)		malloc(size)
+#define heap_caps_calloc(n, size, caps)		calloc(n, size)
+#define heap_caps_realloc(ptr, size, caps)	realloc(ptr, size)
+#define heap_caps_free(ptr)			free(ptr)
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/port/include/esp_log.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOST_ESP_LOG_H_
+#define _HOST_ESP_LOG_H_
+
+#include <stdint.h>
+
+typedef enum {
+	ESP_LOG_NONE = 0,
+	ESP_LOG_ERROR,
+	ESP_LOG_WARN,
+	ESP_LOG_INFO,
+	ESP_LOG_DEBUG,
+	ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+// Only the "*" tag is honored, default level is ESP_LOG_WARN
+void esp_log_level_set(const char * Tag, esp_log_level_t Level);
+void esp_log_write(esp_log_level_t Level, const char * Tag, const char * Format, ...);
+uint32_t esp_log_timestamp(void);
+
+#define ESP_LOG_LEVEL(level, letter, tag, format, ...) \
+	esp_log_write(level, tag, letter " (%lu) %s: " format "\n", (unsigned long)esp_log_timestamp(), tag, ##__VA_ARGS__)
+
+#define ESP_LOGE(tag, format, ...)	ESP_LOG_LEVEL(ESP_LOG_ERROR, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)	ESP_LOG_LEVEL(ESP_LOG_WARN, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)	ESP_LOG_LEVEL(ESP_LOG_INFO, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)	ESP_LOG_LEVEL(ESP_LOG_DEBUG, "D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...)	ESP_LOG_LEVEL(ESP_LOG_VERBOSE, "V", tag, format, ##__VA_ARGS__)
+
+#endif
@@ -0,0 +1,33 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/port/include/esp_rom_crc.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOST_ESP_ROM_CRC_H_
+#define _HOST_ESP_ROM_CRC_H_
+
+#include <stdint.h>
+
+// Same conventions as the ROM : Crc is inverted on entry and on return
+uint16_t esp_rom_crc16_le(uint16_t Crc, const uint8_t * Buf, uint32_t Len);
+uint32_t esp_rom_crc32_le(uint32_t Crc, const uint8_t * Buf, uint32_t Len);
+
+#endif
@@ -0,0 +1,41 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/port/include/esp_vfs_eventfd.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOST_ESP_VFS_EVENTFD_H_
+#define _HOST_ESP_VFS_EVENTFD_H_
+
+#include <sys/eventfd.h>
+#include "esp_err.h"
+
+typedef struct {
+	size_t max_fds;
+} esp_vfs_eventfd_config_t;
+
+#define ESP_VFS_EVENTD_CONFIG_DEFAULT() {.max_fds = 5}
+
+// Native eventfd on Linux, nothing to register
+static inline esp_err_t esp_vfs_eventfd_register(const esp_vfs_eventfd_config_t * Config) {
+	return ESP_OK;
+}
+
+#endif
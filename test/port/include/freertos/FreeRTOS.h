@@ -0,0 +1,76 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/port/include/freertos/FreeRTOS.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Host (pthread) port of the FreeRTOS API used by the firmware
+
+#ifndef _HOST_FREERTOS_H_
+#define _HOST_FREERTOS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint8_t StackType_t;
+
+// Objects are allocated by the port, static buffers are unused
+typedef struct { void * unused; } StaticTask_t;
+typedef struct { void * unused; } StaticSemaphore_t;
+typedef struct { void * unused; } StaticQueue_t;
+typedef struct { void * unused; } StaticTimer_t;
+
+typedef struct Host_Task_S * TaskHandle_t;
+typedef struct Host_Sem_S * SemaphoreHandle_t;
+typedef struct Host_Queue_S * QueueHandle_t;
+typedef struct Host_Timer_S * TimerHandle_t;
+
+typedef struct { int unused; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED	{0}
+
+#define configTICK_RATE_HZ	1000
+#define portTICK_PERIOD_MS	(1000/configTICK_RATE_HZ)
+#define portMAX_DELAY		((TickType_t)0xffffffff)
+#define pdMS_TO_TICKS(x)	((TickType_t)(((uint64_t)(x)*configTICK_RATE_HZ)/1000))
+#define pdTICKS_TO_MS(x)	((uint32_t)(((uint64_t)(x)*1000)/configTICK_RATE_HZ))
+
+#define pdFALSE		0
+#define pdTRUE		1
+#define pdFAIL		pdFALSE
+#define pdPASS		pdTRUE
+
+#define PRO_CPU_NUM	0
+#define APP_CPU_NUM	1
+#define tskNO_AFFINITY	0x7fffffff
+
+// No preemption control on host, critical sections share one lock
+void vPortEnterCritical(void);
+void vPortExitCritical(void);
+#define portENTER_CRITICAL(mux)		vPortEnterCritical()
+#define portEXIT_CRITICAL(mux)		vPortExitCritical()
+#define taskENTER_CRITICAL(mux)		vPortEnterCritical()
+#define taskEXIT_CRITICAL(mux)		vPortExitCritical()
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/port/include/freertos/queue.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOST_QUEUE_H_
+#define _HOST_QUEUE_H_
+
+#include "FreeRTOS.h"
+
+QueueHandle_t xQueueCreate(UBaseType_t Len, UBaseType_t Item_Size);
+QueueHandle_t xQueueCreateStatic(UBaseType_t Len, UBaseType_t Item_Size, uint8_t * Buff, StaticQueue_t * Queue_Buff);
+void vQueueDelete(QueueHandle_t Queue);
+
+BaseType_t xQueueSend(QueueHandle_t Queue, const void * Item, TickType_t Ticks);
+BaseType_t xQueueSendToBack(QueueHandle_t Queue, const void * Item, TickType_t Ticks);
+BaseType_t xQueueSendToFront(QueueHandle_t Queue, const void * Item, TickType_t Ticks);
+BaseType_t xQueueReceive(QueueHandle_t Queue, void * Item, TickType_t Ticks);
+BaseType_t xQueuePeek(QueueHandle_t Queue, void * Item, TickType_t Ticks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t Queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t Queue);
+BaseType_t xQueueReset(QueueHandle_t Queue);
+
+#define xQueueSendFromISR(q, i, w)	xQueueSend(q, i, 0)
+
+#endif
@@ -0,0 +1,47 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/port/include/freertos/semphr.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOST_SEMPHR_H_
+#define _HOST_SEMPHR_H_
+
+#include "FreeRTOS.h"
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t * Buff);
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void);
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutexStatic(StaticSemaphore_t * Buff);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t * Buff);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t Max, UBaseType_t Initial);
+SemaphoreHandle_t xSemaphoreCreateCountingStatic(UBaseType_t Max, UBaseType_t Initial, StaticSemaphore_t * Buff);
+void vSemaphoreDelete(SemaphoreHandle_t Sem);
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t Sem, TickType_t Ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t Sem);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t Sem, TickType_t Ticks);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t Sem);
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t Sem);
+
+#define xSemaphoreGiveFromISR(s, w)	xSemaphoreGive(s)
+
+#endif
@@ -0,0 +1,48 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/port/include/freertos/task.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOST_TASK_H_
+#define _HOST_TASK_H_
+
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+
+// Tasks are detached pthreads, priority, stack and core are ignored
+BaseType_t xTaskCreate(TaskFunction_t Func, const char * Name, uint32_t Stack, void * Arg, UBaseType_t Prio, TaskHandle_t * Handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t Func, const char * Name, uint32_t Stack, void * Arg, UBaseType_t Prio, TaskHandle_t * Handle, BaseType_t Core);
+TaskHandle_t xTaskCreateStatic(TaskFunction_t Func, const char * Name, uint32_t Stack, void * Arg, UBaseType_t Prio, StackType_t * Stack_Buff, StaticTask_t * Task_Buff);
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t Func, const char * Name, uint32_t Stack, void * Arg, UBaseType_t Prio, StackType_t * Stack_Buff, StaticTask_t * Task_Buff, BaseType_t Core);
+void vTaskDelete(TaskHandle_t Task);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+void vTaskDelay(TickType_t Ticks);
+TickType_t xTaskGetTickCount(void);
+
+BaseType_t xTaskNotifyGive(TaskHandle_t Task);
+uint32_t ulTaskNotifyTake(BaseType_t Clear, TickType_t Ticks);
+
+// Host threads have no fixed stack, report it as never used
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t Task);
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/port/include/freertos/timers.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOST_TIMERS_H_
+#define _HOST_TIMERS_H_
+
+#include "FreeRTOS.h"
+
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t Timer);
+
+// Callbacks run in a single timer service thread, as with the FreeRTOS daemon task
+TimerHandle_t xTimerCreate(const char * Name, TickType_t Period, UBaseType_t Reload, void * Id, TimerCallbackFunction_t Cb);
+TimerHandle_t xTimerCreateStatic(const char * Name, TickType_t Period, UBaseType_t Reload, void * Id, TimerCallbackFunction_t Cb, StaticTimer_t * Buff);
+BaseType_t xTimerDelete(TimerHandle_t Timer, TickType_t Ticks);
+BaseType_t xTimerStart(TimerHandle_t Timer, TickType_t Ticks);
+BaseType_t xTimerStop(TimerHandle_t Timer, TickType_t Ticks);
+BaseType_t xTimerReset(TimerHandle_t Timer, TickType_t Ticks);
+BaseType_t xTimerChangePeriod(TimerHandle_t Timer, TickType_t Period, TickType_t Ticks);
+BaseType_t xTimerIsTimerActive(TimerHandle_t Timer);
+void * pvTimerGetTimerID(TimerHandle_t Timer);
+TickType_t xTimerGetPeriod(TimerHandle_t Timer);
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/sim/aprs_sim.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_log.h>
+
+#include "aprs_log.h"
+#include "aprs_lsdb.h"
+#include "aprs_sim.h"
+
+#define TAG "APRS_SIM"
+
+#define APRS_SIM_SEGMENT	8192
+#define APRS_SIM_MAX_SIZE	(4<<20)
+
+struct APRS_S {
+	DB * stations_db;
+};
+
+// Station records first (callid order), then secondary index entries, as APRS_Db_Station_Compare
+static int APRS_Sim_Compare(const DBT * Key1, const DBT * Key2) {
+	if (Key1->size == sizeof(AX25_Addr_t) && Key2->size == sizeof(AX25_Addr_t))
+		return AX25_Addr_Cmp(Key1->data, Key2->data);
+	if (Key1->size == Key2->size)
+		return memcmp(Key1->data, Key2->data, Key1->size);
+	return (Key1->size == sizeof(AX25_Addr_t))?-1:1;
+}
+
+APRS_t * APRS_Sim_Open(const char * Path) {
+	APRS_t * aprs;
+
+	if (!(aprs = calloc(1, sizeof(APRS_t))))
+		return NULL;
+
+	if (!(aprs->stations_db = APRS_Lsdb_Open(Path, 0, APRS_Sim_Compare, APRS_SIM_SEGMENT, APRS_SIM_MAX_SIZE))) {
+		ESP_LOGE(TAG,"Can't open %s", Path);
+		free(aprs);
+		return NULL;
+	}
+
+	return aprs;
+}
+
+DB * APRS_Sim_Db(APRS_t * Aprs) {
+	return Aprs->stations_db;
+}
+
+void APRS_Sim_Close(APRS_t * Aprs) {
+	if (!Aprs)
+		return;
+	Aprs->stations_db->close(Aprs->stations_db);
+	free(Aprs);
+}
+
+// Only caller is the kiss task, no stations_sem nor cache
+int APRS_Stations_Match(APRS_t * Aprs, const AX25_Addr_t * Filter, AX25_Addr_t * Cursor, int Flags, APRS_Station_t * Station) {
+	if (!Aprs || !Aprs->stations_db)
+		return -1;
+
+	return APRS_Log_Match(Aprs->stations_db, Filter, Cursor, Flags, Station);
+}
+
+int APRS_Stations_Import(APRS_t * Aprs, APRS_Station_t * Stations, int N) {
+	if (!Aprs || !Aprs->stations_db)
+		return -1;
+
+	return APRS_Log_Import(Aprs->stations_db, Stations, N);
+}
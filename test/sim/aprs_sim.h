@@ -0,0 +1,39 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/sim/aprs_sim.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _APRS_SIM_H_
+#define _APRS_SIM_H_
+
+#include <berkeley-db/db.h>
+
+#include "aprs.h"
+
+// Stand-in of the APRS task for its stations DB only : a log-structured
+// store in Path (segments Path.<number>), with the firmware key order.
+// APRS_Stations_Match and APRS_Stations_Import work on it, as used by
+// aprs_xfer from the kiss task
+APRS_t * APRS_Sim_Open(const char * Path);
+DB * APRS_Sim_Db(APRS_t * Aprs);
+void APRS_Sim_Close(APRS_t * Aprs);
+
+#endif
@@ -0,0 +1,460 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/sim/kiss_sim.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Host simulator of the radio to KISS data path. The firmware kiss, link
+// multiplexer and simplex physical layers run on a simulated modem, the
+// host side is a pty (or a TCP port) any KISS client can connect to.
+//
+//	kiss_sim -p 8001 -r 127.0.0.1:8002 -l /tmp/kiss0
+//	kiss_sim -p 8002 -r 127.0.0.1:8001 -t 8101
+//
+// Both instances share the same simulated channel : frames sent by a client
+// of one instance are received by the clients of the other.
+//
+// More kiss ports on the same channel : -P n:CALL adds radio port n, for
+// frames to CALL only, -L n adds local port n.
+//
+// SetHardware (cmd 6) payloads handled by the simulator :
+//	'S'	: reply 'S' then big endian 32 bits counters : drops by reason
+//		  (Kiss_Drop_Reason_t order), smack crc errors, pending acks
+//	'L' f	: frame f (without fcs) generated locally, as by APRS task
+//	'P' n	: drop policy when queue to host is full (Kiss_Drop_Policy_t)
+// With -s, other payloads go to the station DB transfer (see main/aprs_xfer.h)
+// on a stations DB in the given path, as served by the firmware
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <netdb.h>
+#include <termios.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include <freertos/FreeRTOS.h>
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <sdkconfig.h>
+
+#include "modem_sim.h"
+#include "framebuff.h"
+#include "hdlc_dec.h"
+#include "ax25_phy_simplex.h"
+#include "ax25_lm.h"
+#include "kiss.h"
+#include "aprs_xfer.h"
+#include "aprs_sim.h"
+
+#define TAG "KISS_SIM"
+
+#define KISS_SIM_BUFF_LEN	1024
+#define KISS_SIM_MAX_PORTS	4
+#define KISS_SIM_LOCAL_FRAMES	8
+#define KISS_SIM_HW_STATS	'S'
+#define KISS_SIM_HW_LOCAL	'L'
+#define KISS_SIM_HW_POLICY	'P'
+#define KISS_SIM_XFER_BATCH	16	// Imported stations per DB sync, as firmware
+
+static const AFSK_Config_t AFSK_Config = {
+	.sample_rate = CONFIG_ESP32S3APRS_RADIO_SAMPLE_RATE,
+	.baud_rate = 1200,
+	.mark_freq = 1200,
+	.space_freq = 2200
+};
+
+static const char * Link;
+static Kiss_t * Kiss;
+static uint8_t Hw_Reply[64];
+static size_t Hw_Reply_Len;
+static Framebuff_t * Local_Buff;
+static APRS_Xfer_t * Xfer;
+
+static void Kiss_Sim_Usage(const char * Name) {
+	fprintf(stderr,
+		"Usage : %s [-p udp_port] [-r host:port]... [-P port:call]... [-L port] [-a audio_file] [-j] [-s stations] [-l link | -t tcp_port] [-v level]\n"
+		"\t-p : udp port to receive the channel from other instances\n"
+		"\t-r : instance to send the channel to (up to %d)\n"
+		"\t-P : radio kiss port for frames to call (up to %d)\n"
+		"\t-L : kiss port for locally generated frames\n"
+		"\t-a : write modulated audio (s16 mono, %d Hz)\n"
+		"\t-j : jammed channel, frames are never sent\n"
+		"\t-s : stations DB path, for station export and import\n"
+		"\t-l : symlink to the client pty\n"
+		"\t-t : serve kiss on tcp port instead of a pty\n"
+		"\t-v : log level, 0 (none) to 5 (verbose)\n",
+		Name, MODEM_SIM_MAX_PEERS, KISS_SIM_MAX_PORTS, CONFIG_ESP32S3APRS_RADIO_SAMPLE_RATE);
+}
+
+static void Kiss_Sim_Exit(int Sig) {
+	if (Link)
+		unlink(Link);
+	_exit(0);
+}
+
+static uint8_t * Kiss_Sim_Put32(uint8_t * Out, uint32_t Val) {
+	*(Out++) = Val>>24;
+	*(Out++) = Val>>16;
+	*(Out++) = Val>>8;
+	*(Out++) = Val;
+	return Out;
+}
+
+// Simulator SetHardware commands, run by kiss task
+static int Kiss_Sim_Hw_Command(void * Ctx, const uint8_t * Data, size_t Len) {
+	uint8_t * out = Hw_Reply;
+	Frame_t * frame;
+	uint16_t crc;
+	int i;
+
+	switch (Data[0]) {
+		case KISS_SIM_HW_STATS:
+			*(out++) = KISS_SIM_HW_STATS;
+			for (i=0 ; i<KISS_DROP_REASON_MAX ; i++)
+				out = Kiss_Sim_Put32(out, Kiss_Get_Drop_Count(Kiss, i));
+			out = Kiss_Sim_Put32(out, Kiss_Get_Crc_Errors(Kiss));
+			out = Kiss_Sim_Put32(out, Kiss_Get_Pending_Acks(Kiss));
+			Hw_Reply_Len = out - Hw_Reply;
+			break;
+		case KISS_SIM_HW_LOCAL:
+			if (Len-1 < HDLC_MIN_FRAME_LEN-2 || Len-1 > HDLC_MAX_FRAME_LEN-2 || !(frame = Framebuff_Get_Frame(Local_Buff)))
+				return -1;
+			memcpy(frame->frame, Data+1, Len-1);
+			crc = esp_rom_crc16_le(0, frame->frame, Len-1);
+			frame->frame[Len-1] = crc&0xff;
+			frame->frame[Len] = (crc>>8)&0xff;
+			frame->frame_len = Len+1;
+			Kiss_Frame_Received_Cb(Kiss, frame);
+			Framebuff_Free_Frame(frame);
+			break;
+		case KISS_SIM_HW_POLICY:
+			if (Len < 2)
+				return -1;
+			return Kiss_Set_Drop_Policy(Kiss, Data[1]);
+		default:
+			if (Xfer)
+				return APRS_Xfer_Command(Xfer, Data, Len);
+			ESP_LOGW(TAG,"Unknown SetHardware command 0x%02x", Data[0]);
+			return -1;
+	}
+
+	return 0;
+}
+
+static int Kiss_Sim_Hw_Source(void * Ctx, uint8_t * Data, size_t Size) {
+	size_t len = Hw_Reply_Len;
+
+	if (!len && Xfer)
+		return APRS_Xfer_Next(Xfer, Data, Size);
+
+	if (len > Size)
+		len = Size;
+	memcpy(Data, Hw_Reply, len);
+	Hw_Reply_Len = 0;
+
+	return len;
+}
+
+static int Kiss_Sim_Peer(const char * Arg, struct sockaddr_in * Peer) {
+	struct addrinfo hints = {
+		.ai_family = AF_INET,
+		.ai_socktype = SOCK_DGRAM,
+	}, * res;
+	char host[256];
+	const char * port;
+
+	if (!(port = strrchr(Arg, ':')) || port == Arg || port-Arg >= sizeof(host))
+		return -1;
+
+	memcpy(host, Arg, port-Arg);
+	host[port-Arg] = '\0';
+
+	if (getaddrinfo(host, port+1, &hints, &res))
+		return -1;
+
+	memcpy(Peer, res->ai_addr, sizeof(struct sockaddr_in));
+	freeaddrinfo(res);
+
+	return 0;
+}
+
+// Radio port n:CALL, on frames to CALL
+static int Kiss_Sim_Port(const char * Arg, int * Port, AX25_Addr_t * Filter) {
+	char * call;
+
+	*Port = strtol(Arg, &call, 10);
+	if (*call != ':' || AX25_Str_To_Addr(call+1, Filter))
+		return -1;
+
+	// Destination only
+	Filter->ssid |= 1;
+
+	return 0;
+}
+
+// New raw pty, the slave stays open so reads on master never fail with EIO
+static int Kiss_Sim_Pty(char * Path, size_t Len) {
+	struct termios tio;
+	int master, slave;
+
+	if ((master = posix_openpt(O_RDWR|O_NOCTTY)) < 0)
+		return -1;
+
+	if (grantpt(master) || unlockpt(master) || ptsname_r(master, Path, Len)
+			|| (slave = open(Path, O_RDWR|O_NOCTTY)) < 0) {
+		close(master);
+		return -1;
+	}
+
+	tcgetattr(slave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(slave, TCSANOW, &tio);
+
+	return master;
+}
+
+static int Kiss_Sim_Listen(int Port) {
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(Port),
+		.sin_addr.s_addr = htonl(INADDR_ANY),
+	};
+	int fd, on = 1;
+
+	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+		return -1;
+
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, 1)) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int Kiss_Sim_Write(int Fd, const uint8_t * Data, size_t Len) {
+	ssize_t ret;
+
+	while (Len) {
+		ret = write(Fd, Data, Len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		Data += ret;
+		Len -= ret;
+	}
+
+	return 0;
+}
+
+// Copy bytes between firmware and client side
+static void Kiss_Sim_Bridge(int Fw, int Client, int Listen) {
+	uint8_t buff[KISS_SIM_BUFF_LEN];
+	fd_set rfds;
+	int maxfd;
+	ssize_t len;
+
+	do {
+		FD_ZERO(&rfds);
+		FD_SET(Fw, &rfds);
+		maxfd = Fw;
+		if (Client >= 0) {
+			FD_SET(Client, &rfds);
+			if (Client > maxfd)
+				maxfd = Client;
+		} else {
+			FD_SET(Listen, &rfds);
+			if (Listen > maxfd)
+				maxfd = Listen;
+		}
+
+		if (select(maxfd+1, &rfds, NULL, NULL, NULL) < 0) {
+			if (errno == EINTR)
+				continue;
+			ESP_LOGE(TAG,"Select error %d", errno);
+			return;
+		}
+
+		if (Client < 0 && FD_ISSET(Listen, &rfds)) {
+			Client = accept(Listen, NULL, NULL);
+			ESP_LOGI(TAG,"Client %sconnected", Client < 0 ? "not " : "");
+		}
+
+		// Nobody listening, frames are lost
+		if (FD_ISSET(Fw, &rfds) && (len = read(Fw, buff, sizeof(buff))) > 0 && Client >= 0) {
+			if (Kiss_Sim_Write(Client, buff, len)) {
+				ESP_LOGI(TAG,"Client disconnected");
+				close(Client);
+				Client = -1;
+			}
+		}
+
+		if (Client >= 0 && FD_ISSET(Client, &rfds)) {
+			len = read(Client, buff, sizeof(buff));
+			if (len > 0)
+				Kiss_Sim_Write(Fw, buff, len);
+			else if (Listen >= 0) {
+				ESP_LOGI(TAG,"Client disconnected");
+				close(Client);
+				Client = -1;
+			}
+		}
+	} while (1);
+}
+
+int main(int argc, char ** argv) {
+	Modem_Sim_Config_t config = { 0 };
+	char fw_path[64], client_path[64];
+	AX25_Addr_t filters[KISS_SIM_MAX_PORTS];
+	int ports[KISS_SIM_MAX_PORTS];
+	int fw, client = -1, listen_fd = -1;
+	int opt, tcp_port = 0, local_port = 0, ports_count = 0, i;
+	Modem_t * modem;
+	AX25_Phy_t * phy;
+	AX25_Lm_t * lm;
+	APRS_t * aprs = NULL;
+	const char * stations = NULL;
+
+	while ((opt = getopt(argc, argv, "p:r:P:L:a:js:l:t:v:h")) != -1) {
+		switch (opt) {
+			case 'p':
+				config.port = atoi(optarg);
+				break;
+			case 'r':
+				if (config.peers_count == MODEM_SIM_MAX_PEERS || Kiss_Sim_Peer(optarg, &config.peers[config.peers_count])) {
+					fprintf(stderr, "Invalid peer %s\n", optarg);
+					return 1;
+				}
+				config.peers_count++;
+				break;
+			case 'P':
+				if (ports_count == KISS_SIM_MAX_PORTS || Kiss_Sim_Port(optarg, &ports[ports_count], &filters[ports_count])) {
+					fprintf(stderr, "Invalid port %s\n", optarg);
+					return 1;
+				}
+				ports_count++;
+				break;
+			case 'L':
+				local_port = atoi(optarg);
+				break;
+			case 'a':
+				if (!(config.audio = fopen(optarg, "wb"))) {
+					perror(optarg);
+					return 1;
+				}
+				break;
+			case 'j':
+				config.jam = true;
+				break;
+			case 's':
+				stations = optarg;
+				break;
+			case 'l':
+				Link = optarg;
+				break;
+			case 't':
+				tcp_port = atoi(optarg);
+				break;
+			case 'v':
+				esp_log_level_set("*", atoi(optarg));
+				break;
+			default:
+				Kiss_Sim_Usage(argv[0]);
+				return 1;
+		}
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, Kiss_Sim_Exit);
+	signal(SIGTERM, Kiss_Sim_Exit);
+
+	// Firmware side of the serial line
+	if ((fw = Kiss_Sim_Pty(fw_path, sizeof(fw_path))) < 0) {
+		perror("pty");
+		return 1;
+	}
+
+	// Client side
+	if (tcp_port) {
+		if ((listen_fd = Kiss_Sim_Listen(tcp_port)) < 0) {
+			perror("listen");
+			return 1;
+		}
+		snprintf(client_path, sizeof(client_path), "tcp:%d", tcp_port);
+	} else {
+		if ((client = Kiss_Sim_Pty(client_path, sizeof(client_path))) < 0) {
+			perror("pty");
+			return 1;
+		}
+		if (Link) {
+			unlink(Link);
+			if (symlink(client_path, Link)) {
+				perror(Link);
+				return 1;
+			}
+		}
+	}
+
+	// Same stack as the firmware, on a simulated modem
+	if (!(modem = Modem_Sim_Init(&config, &AFSK_Config))) {
+		fprintf(stderr, "Error creating simulated modem\n");
+		return 1;
+	}
+	Modem_Start_Receiver(modem);
+	phy = AX25_Phy_Simplex_Init(modem);
+	lm = AX25_Lm_Init(phy);
+	if (!phy || !lm || !(Kiss = Kiss_Init(fw_path, lm))) {
+		fprintf(stderr, "Error creating kiss stack\n");
+		return 1;
+	}
+	for (i=0 ; i<ports_count ; i++)
+		if (Kiss_Add_Port(Kiss, ports[i], KISS_PORT_RADIO, lm, &filters[i])) {
+			fprintf(stderr, "Error adding port %d\n", ports[i]);
+			return 1;
+		}
+	if (local_port && Kiss_Add_Port(Kiss, local_port, KISS_PORT_LOCAL, NULL, NULL)) {
+		fprintf(stderr, "Error adding port %d\n", local_port);
+		return 1;
+	}
+	Local_Buff = Framebuff_Init(KISS_SIM_LOCAL_FRAMES, HDLC_MAX_FRAME_LEN);
+	if (stations && (!(aprs = APRS_Sim_Open(stations)) || !(Xfer = APRS_Xfer_Init(aprs, KISS_SIM_XFER_BATCH)))) {
+		fprintf(stderr, "Error opening stations DB %s\n", stations);
+		return 1;
+	}
+	Kiss_Set_Hardware(Kiss, Kiss_Sim_Hw_Command, Kiss_Sim_Hw_Source, NULL);
+
+	printf("%s\n", Link ? Link : client_path);
+	fflush(stdout);
+
+	Kiss_Sim_Bridge(fw, client, listen_fd);
+
+	Kiss_Sim_Exit(0);
+
+	return 0;
+}
@@ -0,0 +1,471 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/sim/modem_sim.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _MODEM_PRIV_INCLUDE_
+#include "modem_sim.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <esp_log.h>
+
+#include "framebuff.h"
+#include "hdlc_dec.h"
+#include "hdlc_enc.h"
+#include "afsk_mod.h"
+#include "nrzi.h"
+
+#define TAG "MODEM_SIM"
+
+#define MODEM_SIM_TASK_STACK_SIZE	4096
+#define MODEM_SIM_TASK_PRIORITY		5
+#define MODEM_SIM_TICK_MS		10
+#define MODEM_SIM_CHUNK_LEN		64	// Max bitstream bytes sent per tick
+#define MODEM_SIM_TAIL_LEN		3	// Mark tone bytes after last frame, decoded as abort
+#define MODEM_SIM_CARRIER_TO_MS		100	// Carrier lost if no bitstream received
+
+#ifndef MODEM_SIM_RECEIVE_BUFF_LEN
+#define MODEM_SIM_RECEIVE_BUFF_LEN	10
+#endif
+#define MODEM_SIM_TRANSMIT_BUFF_LEN	10
+
+enum Modem_Sim_State_E {
+	MODEM_SIM_STATE_STOPPED = 0,
+	MODEM_SIM_STATE_RECEIVING,
+	MODEM_SIM_STATE_TRANSMITTING,
+	MODEM_SIM_STATE_TRANSMITTER_ENDING,
+	MODEM_SIM_STATE_TRANSMITTER_STOPPING,
+};
+
+struct Modem_Sim_S {
+	// Interface
+	struct Modem_S modem;
+
+	Modem_Sim_Config_t config;
+	int sock;
+	SemaphoreHandle_t lock;
+	TaskHandle_t task;
+
+	enum Modem_Sim_State_E state;
+	enum Modem_Sim_State_E last_state;	// state before transmiting
+
+	// Receiver
+	Hdlc_Dec_t * hdlc_dec;
+	bool sync;
+	bool rx_nrzi;
+	TickType_t rx_time;
+	Framebuff_t * receive_buff;
+	uint32_t rx_frame_count;
+
+	// Transmiter
+	Framebuff_t * transmit_buff;
+	Hdlc_Enc_t * hdlc_enc;
+	AFSK_Mod_t * afsk_mod;
+	bool tx_nrzi;
+	int stop_count;
+	uint32_t tx_frame_count;
+	uint32_t bit_credit;	// In 1/1000 bit
+	uint16_t baud_rate;
+
+	int16_t * samples;
+	size_t samples_len;
+	uint8_t bitstream[MODEM_SIM_CHUNK_LEN];
+};
+
+// Modem Ops
+static int Modem_Sim_Start_Receiver(struct Modem_Sim_S * Modem);
+static int Modem_Sim_Stop_Receiver(struct Modem_Sim_S * Modem);
+static int Modem_Sim_Start_Transmiter(struct Modem_Sim_S * Modem);
+static int Modem_Sim_Stop_Transmiter(struct Modem_Sim_S * Modem);
+static int Modem_Sim_Send_Frame(struct Modem_Sim_S * Modem, Frame_t * Frame);
+
+static const Modem_Ops_t Modem_Sim_Ops = {
+	.start_receiver = (typeof(Modem_Sim_Ops.start_receiver))Modem_Sim_Start_Receiver,
+	.stop_receiver = (typeof(Modem_Sim_Ops.stop_receiver))Modem_Sim_Stop_Receiver,
+	.start_transmiter = (typeof(Modem_Sim_Ops.start_transmiter))Modem_Sim_Start_Transmiter,
+	.stop_transmiter = (typeof(Modem_Sim_Ops.stop_transmiter))Modem_Sim_Stop_Transmiter,
+	.send_frame = (typeof(Modem_Sim_Ops.send_frame))Modem_Sim_Send_Frame
+};
+
+// Hdlc Callback
+static void Modem_Sim_Hdlc_Dec_Cb(struct Modem_Sim_S * Modem, Frame_t * Frame);
+static void Modem_Sim_Hdlc_Enc_Cb(struct Modem_Sim_S * Modem, Frame_t * Frame);
+
+static void Modem_Sim_Task(struct Modem_Sim_S * Modem);
+
+Modem_t * Modem_Sim_Init(const Modem_Sim_Config_t * Config, const AFSK_Config_t * Afsk_Config) {
+	struct Modem_Sim_S * modem;
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_ANY),
+	};
+
+	if (!Config || !Afsk_Config || !Afsk_Config->baud_rate)
+		return NULL;
+
+	if (!(modem = malloc(sizeof(struct Modem_Sim_S)))) {
+		ESP_LOGE(TAG,"Error allocating modem struct");
+		return NULL;
+	}
+	bzero(modem,sizeof(struct Modem_Sim_S));
+	modem->modem.ops = &Modem_Sim_Ops;
+	memcpy(&modem->config, Config, sizeof(Modem_Sim_Config_t));
+	modem->baud_rate = Afsk_Config->baud_rate;
+
+	if ((modem->sock = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+		ESP_LOGE(TAG,"Error creating socket");
+		free(modem);
+		return NULL;
+	}
+
+	if (Config->port) {
+		addr.sin_port = htons(Config->port);
+		if (bind(modem->sock, (struct sockaddr *)&addr, sizeof(addr))) {
+			ESP_LOGE(TAG,"Error binding udp port %d", Config->port);
+			close(modem->sock);
+			free(modem);
+			return NULL;
+		}
+	}
+	fcntl(modem->sock, F_SETFL, O_NONBLOCK);
+
+	modem->lock = xSemaphoreCreateMutex();
+
+	modem->hdlc_dec = Hdlc_Dec_Init((Hdlc_Dec_Cb_t)Modem_Sim_Hdlc_Dec_Cb,(void*)modem);
+	modem->receive_buff = Framebuff_Init(MODEM_SIM_RECEIVE_BUFF_LEN, HDLC_MAX_FRAME_LEN);
+	modem->transmit_buff = Framebuff_Init(MODEM_SIM_TRANSMIT_BUFF_LEN, 0);
+	modem->hdlc_enc = Hdlc_Enc_Init((Hdlc_Enc_Cb_t)Modem_Sim_Hdlc_Enc_Cb,(void*)modem);
+
+	if (Config->audio) {
+		modem->afsk_mod = AFSK_Mod_Init(Afsk_Config);
+		modem->samples_len = (MODEM_SIM_CHUNK_LEN*8*Afsk_Config->sample_rate)/Afsk_Config->baud_rate + 1;
+		modem->samples = malloc(modem->samples_len*sizeof(int16_t));
+	}
+
+	if (!modem->lock || !modem->hdlc_dec || !modem->receive_buff || !modem->transmit_buff || !modem->hdlc_enc
+			|| (Config->audio && (!modem->afsk_mod || !modem->samples))) {
+		ESP_LOGE(TAG,"Error in initialisation of simulated modem");
+		// TODO : Cleanup
+		return NULL;
+	}
+
+	xTaskCreate((void(*)(void*))Modem_Sim_Task, TAG, MODEM_SIM_TASK_STACK_SIZE, (void*)modem, MODEM_SIM_TASK_PRIORITY, &modem->task);
+
+	return (Modem_t*)modem;
+}
+
+// Feed received bitstream to decoder, byte by byte to follow carrier detect as the radio does
+static void Modem_Sim_Receive(struct Modem_Sim_S * Modem, uint8_t * Bitstream, size_t Len) {
+	bool sync;
+
+	while (Len--) {
+		NRZI_Decode(&Modem->rx_nrzi, Bitstream, 8);
+		Hdlc_Dec_Input(Modem->hdlc_dec, Bitstream, 8);
+		Bitstream++;
+
+		sync = HDLC_Dec_Get_Sync(Modem->hdlc_dec) || Modem->config.jam;
+		if (sync != Modem->sync) {
+			ESP_LOGV(TAG,"(Radio) %s of signal",sync?"Acquisition":"Lost");
+			Modem->sync = sync;
+			Modem_Dcd_Changed_Cb((Modem_t*)Modem, sync);
+		}
+	}
+}
+
+// Generate Len bitstream bytes, send them to peers and to audio file
+static void Modem_Sim_Transmit(struct Modem_Sim_S * Modem, size_t Len) {
+	uint8_t * bitstream;
+	uint16_t bitstream_len;
+	size_t len, i;
+	bool stopped = false;
+
+	for (len = 0 ; len < Len && !stopped ; len++) {
+		if (Modem->state == MODEM_SIM_STATE_TRANSMITTER_STOPPING) {
+			// Constant mark tone
+			Modem->bitstream[len] = 0xFF;
+			if (--Modem->stop_count <= 0) {
+				Modem->state = Modem->last_state;
+				stopped = true;
+			}
+		} else {
+			Hdlc_Enc_Output(Modem->hdlc_enc, &Modem->bitstream[len], 1);
+			NRZI_Encode(&Modem->tx_nrzi, &Modem->bitstream[len], 8);
+		}
+	}
+
+	for (i = 0 ; i < Modem->config.peers_count ; i++)
+		sendto(Modem->sock, Modem->bitstream, len, 0, (struct sockaddr *)&Modem->config.peers[i], sizeof(struct sockaddr_in));
+
+	if (Modem->afsk_mod) {
+		bitstream = Modem->bitstream;
+		bitstream_len = len*8;
+		i = AFSK_Mod_Output(Modem->afsk_mod, &bitstream, &bitstream_len, Modem->samples, Modem->samples_len);
+		fwrite(Modem->samples, sizeof(int16_t), i, Modem->config.audio);
+	}
+
+	if (stopped) {
+		ESP_LOGD(TAG,"Transmiter stopped");
+		if (Modem->afsk_mod)
+			fflush(Modem->config.audio);
+		Modem_Transmiter_Stopped_Cb((Modem_t*)Modem);
+	}
+}
+
+static void Modem_Sim_Task(struct Modem_Sim_S * Modem) {
+	uint8_t buff[1500];
+	TickType_t now, last;
+	struct timeval tv;
+	fd_set rfds;
+	ssize_t len;
+	size_t bytes;
+
+	last = xTaskGetTickCount();
+
+	do {
+		FD_ZERO(&rfds);
+		FD_SET(Modem->sock, &rfds);
+		tv.tv_sec = 0;
+		tv.tv_usec = MODEM_SIM_TICK_MS*1000;
+		select(Modem->sock+1, &rfds, NULL, NULL, &tv);
+
+		xSemaphoreTake(Modem->lock, portMAX_DELAY);
+
+		now = xTaskGetTickCount();
+
+		// A half duplex radio does not hear while transmitting
+		while ((len = recv(Modem->sock, buff, sizeof(buff), 0)) > 0) {
+			if (Modem->state == MODEM_SIM_STATE_RECEIVING) {
+				Modem_Sim_Receive(Modem, buff, len);
+				Modem->rx_time = now;
+			}
+		}
+
+		// Jammed channel, signal acquisition repeated for listeners not ready yet
+		if (Modem->config.jam && Modem->state == MODEM_SIM_STATE_RECEIVING && now - Modem->rx_time > pdMS_TO_TICKS(MODEM_SIM_CARRIER_TO_MS)) {
+			Modem->sync = true;
+			Modem->rx_time = now;
+			Modem_Dcd_Changed_Cb((Modem_t*)Modem, true);
+		}
+
+		if (Modem->sync && !Modem->config.jam && now - Modem->rx_time > pdMS_TO_TICKS(MODEM_SIM_CARRIER_TO_MS)) {
+			Hdlc_Dec_Reset(Modem->hdlc_dec);
+			Modem->sync = false;
+			Modem_Dcd_Changed_Cb((Modem_t*)Modem, false);
+		}
+
+		switch (Modem->state) {
+			case MODEM_SIM_STATE_TRANSMITTING:
+			case MODEM_SIM_STATE_TRANSMITTER_ENDING:
+			case MODEM_SIM_STATE_TRANSMITTER_STOPPING:
+				// Bitstream at baud rate, none on a jammed channel
+				Modem->bit_credit += pdTICKS_TO_MS(now - last)*Modem->baud_rate;
+				bytes = Modem->bit_credit/8000;
+				Modem->bit_credit %= 8000;
+				if (bytes > MODEM_SIM_CHUNK_LEN)
+					bytes = MODEM_SIM_CHUNK_LEN;
+				if (bytes && !Modem->config.jam)
+					Modem_Sim_Transmit(Modem, bytes);
+				break;
+			default:
+				Modem->bit_credit = 0;
+				break;
+		}
+
+		last = now;
+
+		xSemaphoreGive(Modem->lock);
+	} while (1);
+}
+
+static void Modem_Sim_Hdlc_Dec_Cb(struct Modem_Sim_S * Modem, Frame_t *Frame) {
+	if (Frame) {
+		Modem->rx_frame_count++;
+		ESP_LOGD(TAG,"%ld frame received", (long)Modem->rx_frame_count);
+		Modem_Frame_Received_Cb((Modem_t*)Modem,Frame);
+		Framebuff_Free_Frame(Frame);
+	}
+
+	Frame = Framebuff_Get_Frame(Modem->receive_buff);
+	if (!Frame)
+		ESP_LOGW(TAG,"Receiver frames buffer empty !");
+
+	Hdlc_Dec_Add_Frame(Modem->hdlc_dec,Frame);
+}
+
+static void Modem_Sim_Hdlc_Enc_Cb(struct Modem_Sim_S * Modem, Frame_t * Frame) {
+	if (Frame) {
+		Modem->tx_frame_count++;
+		ESP_LOGD(TAG,"%ld frame sent (%p)", (long)Modem->tx_frame_count, Frame);
+		Modem_Frame_Sent_Cb((Modem_t*)Modem, Frame);
+		Framebuff_Free_Frame(Frame);
+	}
+
+	if (Modem->state == MODEM_SIM_STATE_TRANSMITTER_ENDING) {
+		Modem->stop_count = MODEM_SIM_TAIL_LEN;
+		Modem->state = MODEM_SIM_STATE_TRANSMITTER_STOPPING;
+		Frame = NULL;
+	} else {
+		Frame = Framebuff_Get_Frame(Modem->transmit_buff);
+		if (Frame) {
+			ESP_LOGD(TAG,"Sending frame %p", Frame);
+		}
+	}
+
+	Hdlc_Enc_Add_Frame(Modem->hdlc_enc, Frame);
+}
+
+static int Modem_Sim_Start_Receiver(struct Modem_Sim_S * Modem) {
+	int ret = -1;
+
+	xSemaphoreTake(Modem->lock, portMAX_DELAY);
+	switch (Modem->state) {
+		case MODEM_SIM_STATE_STOPPED:
+			ESP_LOGD(TAG,"Starting Receiver");
+			Hdlc_Dec_Reset(Modem->hdlc_dec);
+			Modem->state = MODEM_SIM_STATE_RECEIVING;
+			ret = 0;
+			break;
+		case MODEM_SIM_STATE_RECEIVING:
+			ret = 1;
+			break;
+		case MODEM_SIM_STATE_TRANSMITTING:
+		case MODEM_SIM_STATE_TRANSMITTER_STOPPING:
+		case MODEM_SIM_STATE_TRANSMITTER_ENDING:
+			if (Modem->last_state == MODEM_SIM_STATE_RECEIVING)
+				ret = 1;
+			else {
+				ret = 0;
+				Modem->last_state = MODEM_SIM_STATE_RECEIVING;
+			}
+			break;
+	}
+	xSemaphoreGive(Modem->lock);
+
+	return ret;
+}
+
+static int Modem_Sim_Stop_Receiver(struct Modem_Sim_S * Modem) {
+	int ret = -1;
+
+	xSemaphoreTake(Modem->lock, portMAX_DELAY);
+	switch (Modem->state) {
+		case MODEM_SIM_STATE_STOPPED:
+			ret = 1;
+			break;
+		case MODEM_SIM_STATE_RECEIVING:
+			ESP_LOGD(TAG,"Stopping Receiver");
+			Modem->state = MODEM_SIM_STATE_STOPPED;
+			ret = 0;
+			break;
+		case MODEM_SIM_STATE_TRANSMITTING:
+		case MODEM_SIM_STATE_TRANSMITTER_STOPPING:
+		case MODEM_SIM_STATE_TRANSMITTER_ENDING:
+			if (Modem->last_state == MODEM_SIM_STATE_STOPPED)
+				ret = 1;
+			else {
+				Modem->last_state = MODEM_SIM_STATE_STOPPED;
+				ret = 0;
+			}
+			break;
+	}
+	xSemaphoreGive(Modem->lock);
+
+	return ret;
+}
+
+static int Modem_Sim_Start_Transmiter(struct Modem_Sim_S * Modem) {
+	int ret = -1;
+	bool started = false;
+
+	xSemaphoreTake(Modem->lock, portMAX_DELAY);
+	switch (Modem->state) {
+		case MODEM_SIM_STATE_STOPPED:
+		case MODEM_SIM_STATE_RECEIVING:
+			ESP_LOGD(TAG,"Starting Transmiter");
+			Modem->last_state = Modem->state;
+			Modem->state = MODEM_SIM_STATE_TRANSMITTING;
+			Hdlc_Enc_Reset(Modem->hdlc_enc);
+			if (Modem->afsk_mod)
+				AFSK_Mod_Reset(Modem->afsk_mod);
+			Modem->bit_credit = 0;
+			started = true;
+			ret = 0;
+			break;
+		case MODEM_SIM_STATE_TRANSMITTING:
+		case MODEM_SIM_STATE_TRANSMITTER_STOPPING:
+		case MODEM_SIM_STATE_TRANSMITTER_ENDING:
+			Modem->stop_count = 0;
+			Modem->state = MODEM_SIM_STATE_TRANSMITTING;
+			ret = 1;
+			break;
+	}
+	xSemaphoreGive(Modem->lock);
+
+	// PTT pushed
+	if (started)
+		Modem_Transmiter_Started_Cb((Modem_t*)Modem);
+
+	return ret;
+}
+
+static int Modem_Sim_Stop_Transmiter(struct Modem_Sim_S * Modem) {
+	int ret = -1;
+
+	xSemaphoreTake(Modem->lock, portMAX_DELAY);
+	switch (Modem->state) {
+		case MODEM_SIM_STATE_STOPPED:
+		case MODEM_SIM_STATE_RECEIVING:
+		case MODEM_SIM_STATE_TRANSMITTER_STOPPING:
+		case MODEM_SIM_STATE_TRANSMITTER_ENDING:
+			ret = 1;
+			break;
+		case MODEM_SIM_STATE_TRANSMITTING:
+			ESP_LOGD(TAG,"Stopping Transmiter");
+			Modem->state = MODEM_SIM_STATE_TRANSMITTER_ENDING;
+			ret = 0;
+			break;
+	}
+	xSemaphoreGive(Modem->lock);
+
+	return ret;
+}
+
+static int Modem_Sim_Send_Frame(struct Modem_Sim_S * Modem, Frame_t * Frame) {
+
+	Framebuff_Inc_Frame_Usage(Frame);
+	ESP_LOGD(TAG,"Queueing frame %p",Frame);
+	if (Framebuff_Put_Frame(Modem->transmit_buff, Frame)) {
+		Framebuff_Free_Frame(Frame);
+		ESP_LOGE(TAG,"Transmit frames buffer full");
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/sim/modem_sim.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MODEM_SIM_H_
+#define _MODEM_SIM_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+
+#include "modem.h"
+#include "afsk_config.h"
+
+#define MODEM_SIM_MAX_PEERS	8
+
+// Simulated radio channel. The NRZI bitstream of each transmission is
+// streamed in real time as UDP datagrams to every peer, and received
+// datagrams feed the HDLC decoder. Modulated audio (signed 16 bits, mono,
+// Afsk_Config->sample_rate) can be written to Audio.
+typedef struct Modem_Sim_Config_S {
+	uint16_t port;				// UDP port to listen on, 0 for transmit only
+	struct sockaddr_in peers[MODEM_SIM_MAX_PEERS];
+	int peers_count;
+	FILE * audio;
+	bool jam;				// Carrier always detected, nothing is ever sent
+} Modem_Sim_Config_t;
+
+Modem_t * Modem_Sim_Init(const Modem_Sim_Config_t * Config, const AFSK_Config_t * Afsk_Config);
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/test.h
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TEST_H_
+#define _TEST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "framebuff.h"
+#include "ax25.h"
+
+// Host test helpers
+
+static int Test_Failed;
+
+#define CHECK(cond, ...) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s : ", __FILE__, __LINE__, #cond); \
+		fprintf(stderr, __VA_ARGS__); \
+		fprintf(stderr, "\n"); \
+		Test_Failed++; \
+	} \
+} while (0)
+
+// Report and return main() exit code
+static inline int Test_Result(const char * Name) {
+	if (Test_Failed)
+		fprintf(stderr, "%s : %d check(s) failed\n", Name, Test_Failed);
+	else
+		printf("%s : ok\n", Name);
+	return Test_Failed ? 1 : 0;
+}
+
+// Standalone frame, not attached to a framebuff
+static inline Frame_t * Test_Frame(size_t Size) {
+	Frame_t * frame;
+
+	frame = calloc(1, sizeof(Frame_t) + Size);
+	if (!frame)
+		abort();
+	frame->frame_size = Size;
+
+	return frame;
+}
+
+// UI frame SRC>DST[,DIGI...] with info field, crc bytes left to 0
+static inline int Test_Ui_Frame(Frame_t * Frame, const char * Src, const char * Dst, const char * Digis[], const char * Info) {
+	AX25_Addr_t * addr = (AX25_Addr_t*)Frame->frame;
+	size_t len = strlen(Info);
+	int n = 2;
+
+	AX25_Str_To_Addr(Dst, &addr[0]);
+	AX25_Str_To_Addr(Src, &addr[1]);
+	while (Digis && Digis[n-2]) {
+		AX25_Str_To_Addr(Digis[n-2], &addr[n]);
+		n++;
+	}
+	addr[n-1].ssid |= 1;
+
+	if (n*sizeof(AX25_Addr_t) + 2 + len + 2 > Frame->frame_size)
+		return -1;
+	Frame->frame_len = n*sizeof(AX25_Addr_t);
+	Frame->frame[Frame->frame_len++] = 0x03;
+	Frame->frame[Frame->frame_len++] = 0xf0;
+	memcpy(&Frame->frame[Frame->frame_len], Info, len);
+	Frame->frame_len += len;
+	Frame->frame[Frame->frame_len++] = 0;
+	Frame->frame[Frame->frame_len++] = 0;
+
+	return 0;
+}
+
+#endif
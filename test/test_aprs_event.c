@@ -0,0 +1,108 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/test_aprs_event.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// APRS_EVENT descriptor : text left in the frame, decoded on demand when it
+// is not there as is.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <esp_log.h>
+
+#include "aprs.h"
+#include "aprs_parsers.h"
+#include "test.h"
+
+static Frame_t * Frame;
+static APRS_Data_t Data;
+static APRS_Event_Data_t Event;
+
+static int Event_Of(const char * Info) {
+	if (Test_Ui_Frame(Frame, "F4ABC-9", "APZ001", NULL, Info))
+		return -1;
+	if (APRS_Parse(Frame, &Data) == -1)
+		return -1;
+	return APRS_Event_Init(&Event, Frame, &Data);
+}
+
+static void Check_Text(const char * Info, const char * Text, bool In_Frame) {
+	char buff[80];
+	int len;
+
+	CHECK(!Event_Of(Info), "%s : not parsed", Info);
+	CHECK((Event.text || !Event.text_len) == In_Frame, "%s : text offset %u", Info, Event.text);
+	len = APRS_Event_Text(&Event, buff, sizeof(buff));
+	CHECK(len == (int)strlen(Text) && !strcmp(buff, Text), "%s : text '%s'", Info, buff);
+}
+
+int main(void) {
+	char info[128], text[64];
+	AX25_Addr_t addr;
+
+	esp_log_level_set("*", ESP_LOG_NONE);
+	Frame = Test_Frame(APRS_MAX_FRAME_LEN);
+
+	// Eager fields
+	CHECK(!Event_Of("!4903.50N/07201.75W-Test"), "position not parsed");
+	AX25_Str_To_Addr("F4ABC-9", &addr);
+	CHECK(!AX25_Addr_Cmp(&Event.src, &addr), "source");
+	CHECK(Event.frame == Frame && Event.type == APRS_DTI_POS, "type %c", Event.type);
+	CHECK(Event.symbol[0] == '/' && Event.symbol[1] == '-', "symbol %c%c", Event.symbol[0], Event.symbol[1]);
+	CHECK(!memcmp(&Event.position, &Data.position, sizeof(Event.position)), "position");
+
+	// Text found in frame
+	Check_Text("!4903.50N/07201.75W-Test comment", "Test comment", true);
+	Check_Text("!4903.50N/07201.75W-", "", true);
+	Check_Text(":F4JMZ    :Hello{12", "Hello", true);
+	Check_Text(":F4JMZ    :Brace { far from the end of text", "Brace { far from the end of text", true);
+	Check_Text(":F4JMZ    :ack12", "", true);
+	Check_Text(">On air", "On air", true);
+	Check_Text("?APRS?", "", true);
+
+	// Third party source, text in inner frame
+	Check_Text("}F4XYZ>APRS,TCPIP,F4GW*:>Hello", "Hello", true);
+	AX25_Str_To_Addr("F4XYZ", &addr);
+	CHECK(!AX25_Addr_Cmp(&Event.src, &addr), "third party source");
+
+	// Not in frame as is : decoded on demand
+	memset(text, 'x', sizeof(text)-1);
+	text[sizeof(text)-1] = '\0';
+	snprintf(info, sizeof(info), "!4903.50N/07201.75W-%sabc", text);
+	Check_Text(info, text, false);
+
+	// Truncated to buffer, frame left untouched
+	CHECK(!Event_Of(">On air"), "status not parsed");
+	CHECK(APRS_Event_Text(&Event, text, 4) == 3 && !strcmp(text, "On "), "truncated '%s'", text);
+	CHECK(Frame->frame[Frame->frame_len-2] == 0 && Frame->frame[Frame->frame_len-3] == 'r', "frame modified");
+
+	// Full decode
+	CHECK(!Event_Of(":F4JMZ    :Hello{12"), "message not parsed");
+	Event.timestamp = 1234;
+	memset(&Data, 0, sizeof(Data));
+	CHECK(APRS_Event_Decode(&Event, &Data) == APRS_DTI_MESSAGE, "decode");
+	CHECK(Data.timestamp == 1234 && !strcmp(Data.message.id, "12"), "decoded id '%s'", Data.message.id);
+
+	free(Frame);
+
+	return Test_Result("aprs_event");
+}
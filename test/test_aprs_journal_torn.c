@@ -0,0 +1,365 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/test_aprs_journal_torn.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Journaled stations btree under torn writes : a child process applies
+// batches of station updates and deletes through the journal, and one of its
+// writes, picked at random among the first CRASH_WRITES, is cut at a random
+// length or replaced by garbage before the process dies, as a power loss in
+// the middle of a page or journal write would leave it. The next open must
+// recover a btree passing APRS_Log_Check where every station holds its
+// committed or in-flight value, and all of the in-flight batch when its journal
+// group was committed. Untouched stations may only be lost by a rebuild.
+// A boot crashing or looping on a damaged page (firmware restarts after
+// APRS_STATIONS_OPEN_TIMEOUT) must be followed by an empty one.
+//
+//	test_aprs_journal_torn [-c cycles] [-s seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+
+#include <esp_log.h>
+
+#include "aprs.h"
+#include "aprs_log.h"
+#include "aprs_journal.h"
+#include "test.h"
+
+#define N_STATIONS	200
+#define BATCH_MAX	24
+#define BATCHES_MAX	100000
+#define CRASH_WRITES	6000	// Faulty write is one of the first ones of a run
+#define CHECK_MAX	(N_STATIONS*4)
+#define RUN_TIMEOUT	60	// Seconds, a child not done by then is stuck
+#define OPEN_TIMEOUT	10	// Seconds, stands for APRS_STATIONS_OPEN_TIMEOUT
+
+// Station values (timestamps, 0 if absent) and verify results, shared with children
+typedef struct Model_S {
+	int64_t committed[N_STATIONS];	// Last sync completed
+	int64_t inflight[N_STATIONS];	// Once current batch is synced
+	int errors;
+	int lost;
+	bool rebuilt;
+	bool reset;
+	bool done;
+} Model_t;
+
+static Model_t * Model;
+static AX25_Addr_t Calls[N_STATIONS];
+static char Dir[64], Db_Path[80], Rebuild_Path[80], Journal_Path[80], Recovery_Path[80];
+static APRS_Log_Btree_t Btree;
+
+// Fault injection, armed in children only
+static long Writes, Crash_At;
+static bool Corrupt;
+static unsigned Fault_Seed;
+
+static ssize_t Fault_Write(int Fd, const void * Buf, size_t Len, off_t Offset, bool Positional) {
+	uint8_t garbage[4096];
+	size_t len = Len, i;
+
+	if (Crash_At && ++Writes == Crash_At) {
+		if (Corrupt) {
+			if (len > sizeof(garbage))
+				len = sizeof(garbage);
+			for (i=0 ; i<len ; i++)
+				garbage[i] = rand_r(&Fault_Seed);
+			Buf = garbage;
+		} else
+			len = Len ? rand_r(&Fault_Seed) % Len : 0;
+		if (Positional)
+			syscall(SYS_pwrite64, Fd, Buf, len, Offset);
+		else
+			syscall(SYS_write, Fd, Buf, len);
+		_exit(9);
+	}
+
+	return Positional ? syscall(SYS_pwrite64, Fd, Buf, Len, Offset) : syscall(SYS_write, Fd, Buf, Len);
+}
+
+ssize_t write(int Fd, const void * Buf, size_t Len) {
+	return Fault_Write(Fd, Buf, Len, 0, false);
+}
+
+ssize_t pwrite(int Fd, const void * Buf, size_t Len, off_t Offset) {
+	return Fault_Write(Fd, Buf, Len, Offset, true);
+}
+
+ssize_t pwrite64(int Fd, const void * Buf, size_t Len, off_t Offset) {
+	return Fault_Write(Fd, Buf, Len, Offset, true);
+}
+
+static int Compare(const DBT * Key1, const DBT * Key2) {
+	if (Key1->size == sizeof(AX25_Addr_t) && Key2->size == sizeof(AX25_Addr_t))
+		return AX25_Addr_Cmp(Key1->data, Key2->data);
+	if (Key1->size == sizeof(APRS_Log_Index_t) && Key2->size == sizeof(APRS_Log_Index_t))
+		return memcmp(Key1->data, Key2->data, sizeof(APRS_Log_Index_t));
+	return (Key1->size == sizeof(AX25_Addr_t))?-1:1;
+}
+
+static int64_t Value(DB * Db, int I) {
+	AX25_Addr_t callid = Calls[I];
+	DBT key, data;
+
+	key.data = &callid;
+	key.size = sizeof(AX25_Addr_t);
+	if (Db->get(Db, &key, &data, 0))
+		return 0;
+	return ((APRS_Station_t *)data.data)->timestamp;
+}
+
+static int Find(const APRS_Station_t * Batch, int N, int I) {
+	int b;
+
+	for (b=0 ; b<N ; b++)
+		if (!AX25_Addr_Cmp(&Batch[b].callid, &Calls[I]))
+			return b;
+	return -1;
+}
+
+// Batches of deletes and updates, each committed by one journal sync
+static void Child(unsigned Seed) {
+	APRS_Station_t batch[BATCH_MAX];
+	int del[BATCH_MAX];
+	int64_t clock = 0;
+	int g, i, d, o, b, nb, nd, ops, fd;
+	DB * db, * journal;
+
+	alarm(RUN_TIMEOUT);
+	if (!(db = APRS_Log_Btree_Open(&Btree, 0, &fd)))
+		_exit(3);
+	if (!(journal = APRS_Journal_Open(db, Journal_Path)))
+		_exit(4);
+
+	for (i=0 ; i<N_STATIONS ; i++)
+		if (Model->committed[i] > clock)
+			clock = Model->committed[i];
+
+	for (g=0 ; g<BATCHES_MAX ; g++) {
+		memcpy(Model->inflight, Model->committed, sizeof(Model->inflight));
+		ops = 1 + rand_r(&Seed) % BATCH_MAX;
+		nb = nd = 0;
+		for (o=0 ; o<ops ; o++) {
+			i = rand_r(&Seed) % N_STATIONS;
+			if (!(rand_r(&Seed) % 7)) {
+				if (Model->inflight[i]) {
+					del[nd++] = i;
+					Model->inflight[i] = 0;
+				}
+			} else if (Find(batch, nb, i) < 0) {
+				APRS_Station_t * st = &batch[nb++];
+
+				bzero(st, sizeof(APRS_Station_t));
+				st->callid = Calls[i];
+				st->timestamp = ++clock;
+				if (rand_r(&Seed) % 3) {
+					st->position.latitude = rand_r(&Seed) % (90<<GPS_FIXED_POINT_DEG);
+					st->position.longitude = -(rand_r(&Seed) % (180<<GPS_FIXED_POINT_DEG));
+				}
+				snprintf(st->status, sizeof(st->status), "st %lld", (long long)clock);
+				Model->inflight[i] = clock;
+			}
+		}
+		// Deletes are applied before the batch import
+		for (d=0 ; d<nd ; d++)
+			if ((b = Find(batch, nb, del[d])) >= 0)
+				Model->inflight[del[d]] = batch[b].timestamp;
+
+		for (d=0 ; d<nd ; d++)
+			if (APRS_Log_Delete(journal, &Calls[del[d]]) < 0)
+				_exit(5);
+		if (APRS_Log_Import(journal, batch, nb) < 0)
+			_exit(6);
+		if (!nb && journal->sync(journal, 0))
+			_exit(7);
+		memcpy(Model->committed, Model->inflight, sizeof(Model->committed));
+	}
+
+	journal->close(journal);
+	_exit(0);
+}
+
+// Boot as the firmware does and check the recovered btree against the model
+static void Verify(int Cycle) {
+	struct stat before, after;
+	int state, i, fd;
+	bool had, touched;
+	DB * db, * journal;
+	int64_t x;
+
+	state = APRS_Journal_State(Journal_Path);
+	had = !stat(Db_Path, &before);
+	Model->reset = !stat(Recovery_Path, &after);
+
+	alarm(OPEN_TIMEOUT);
+	if (!(db = APRS_Log_Btree_Open(&Btree, 0, &fd))) {
+		fprintf(stderr, "cycle %d : open failed\n", Cycle);
+		Model->errors++;
+		_exit(1);
+	}
+	alarm(0);
+	Model->rebuilt = had && (stat(Db_Path, &after) || before.st_ino != after.st_ino);
+
+	if (APRS_Log_Check(db, CHECK_MAX)) {
+		fprintf(stderr, "cycle %d : check failed after recovery\n", Cycle);
+		Model->errors++;
+	}
+
+	for (i=0 ; i<N_STATIONS ; i++) {
+		x = Value(db, i);
+		touched = Model->inflight[i] != Model->committed[i];
+		if (Model->reset)
+			;
+		else if (state == APRS_JOURNAL_COMMITTED && touched && x != Model->inflight[i]) {
+			fprintf(stderr, "cycle %d station %d : %lld, committed group has %lld\n", Cycle, i, (long long)x, (long long)Model->inflight[i]);
+			Model->errors++;
+		} else if (x != Model->committed[i] && x != Model->inflight[i]) {
+			if (Model->rebuilt && !x)
+				Model->lost++;
+			else {
+				fprintf(stderr, "cycle %d station %d : %lld, committed %lld in-flight %lld, journal state %d\n",
+						Cycle, i, (long long)x, (long long)Model->committed[i], (long long)Model->inflight[i], state);
+				Model->errors++;
+			}
+		}
+		Model->committed[i] = x;
+	}
+
+	// Clean close empties the journal
+	if ((journal = APRS_Journal_Open(db, Journal_Path)))
+		journal->close(journal);
+	close(fd);
+	Model->done = true;
+	_exit(0);
+}
+
+static void Clean(void) {
+	unlink(Db_Path);
+	unlink(Rebuild_Path);
+	unlink(Journal_Path);
+	unlink(Recovery_Path);
+}
+
+int main(int argc, char ** argv) {
+	int cycles = 600, seed = 1, opt, cycle, status;
+	int lost = 0, rebuilds = 0, replays = 0, crashes = 0, resets = 0, boots;
+	unsigned rnd;
+	char name[10];
+	pid_t pid;
+	int i;
+
+	while ((opt = getopt(argc, argv, "c:s:")) != -1) {
+		switch (opt) {
+			case 'c':
+				cycles = atoi(optarg);
+				break;
+			case 's':
+				seed = atoi(optarg);
+				break;
+			default:
+				fprintf(stderr, "Usage : %s [-c cycles] [-s seed]\n", argv[0]);
+				return 2;
+		}
+	}
+
+	esp_log_level_set("*", ESP_LOG_NONE);
+
+	Model = mmap(NULL, sizeof(Model_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (Model == MAP_FAILED)
+		return 1;
+	bzero(Model, sizeof(Model_t));
+	snprintf(Dir, sizeof(Dir), "%s/jnlXXXXXX", getenv("TMPDIR") && strlen(getenv("TMPDIR")) < 32 ? getenv("TMPDIR") : "/tmp");
+	if (!mkdtemp(Dir)) {
+		perror(Dir);
+		return 1;
+	}
+	snprintf(Db_Path, sizeof(Db_Path), "%s/stations.db", Dir);
+	snprintf(Rebuild_Path, sizeof(Rebuild_Path), "%s/stations.new", Dir);
+	snprintf(Journal_Path, sizeof(Journal_Path), "%s/stations.jnl", Dir);
+	snprintf(Recovery_Path, sizeof(Recovery_Path), "%s/stations.rec", Dir);
+	Btree = (APRS_Log_Btree_t){
+		.path = Db_Path,
+		.rebuild = Rebuild_Path,
+		.journal = Journal_Path,
+		.recovery = Recovery_Path,
+		.compare = Compare,
+		.check_max = CHECK_MAX,
+	};
+
+	for (i=0 ; i<N_STATIONS ; i++) {
+		snprintf(name, sizeof(name), "F%dX%c-%d", i%10, 'A'+(i/10)%26, i/100+1);
+		AX25_Str_To_Addr(name, &Calls[i]);
+		AX25_Norm_Addr(&Calls[i]);
+	}
+
+	rnd = seed;
+	for (cycle=0 ; cycle<cycles && !Test_Failed ; cycle++) {
+		fflush(NULL);
+		if (!(pid = fork())) {
+			Crash_At = 1 + rand_r(&rnd) % CRASH_WRITES;
+			Corrupt = !(rand_r(&rnd) % 3);
+			Fault_Seed = rnd;
+			Child(rnd + cycle);
+		}
+		rand_r(&rnd);
+		rand_r(&rnd);
+		waitpid(pid, &status, 0);
+		CHECK(WIFEXITED(status) && (WEXITSTATUS(status) == 9 || !WEXITSTATUS(status)), "cycle %d : child status %x", cycle, status);
+		if (APRS_Journal_State(Journal_Path) == APRS_JOURNAL_COMMITTED)
+			replays++;
+
+		// Btree code may crash or loop on a damaged page, next boot must start empty
+		for (boots=0 ; boots<2 ; boots++) {
+			Model->done = false;
+			Model->errors = Model->lost = 0;
+			fflush(NULL);
+			if (!(pid = fork()))
+				Verify(cycle);
+			waitpid(pid, &status, 0);
+			if (Model->done)
+				break;
+			crashes++;
+		}
+		CHECK(Model->done, "cycle %d : boot crashed twice", cycle);
+		CHECK(!boots || Model->reset, "cycle %d : boot following a crashed one did not start empty", cycle);
+		CHECK(!Model->errors, "cycle %d : %d error(s) in recovered btree", cycle, Model->errors);
+		lost += Model->lost;
+		rebuilds += Model->rebuilt;
+		resets += Model->reset;
+	}
+
+	Clean();
+	rmdir(Dir);
+	printf("%d cycles, %d journal replays, %d rebuilds, %d stations lost, %d boots crashed or timed out, %d empty restarts\n",
+			cycle, replays, rebuilds, lost, crashes, resets);
+
+	return Test_Result("aprs_journal_torn");
+}
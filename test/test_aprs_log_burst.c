@@ -0,0 +1,276 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/test_aprs_log_burst.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Burst of received frames logged to a file-backed stations btree, once with
+// a sync per frame (APRS_Log_Station) and once through the write-back cache
+// (APRS_Log_Cache_Station, flushed on dirty count, age, then shutdown), on a
+// simulated clock. Syncs and bytes written are counted for both, and both
+// DBs must end with the same stations.
+//
+//	test_aprs_log_burst [-n frames] [-s seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+
+#include <esp_log.h>
+
+#include "aprs.h"
+#include "aprs_log.h"
+#include "test.h"
+
+#define N_CALLS		100
+#define FRAMES_PER_SEC	10	// Burst rate on simulated clock
+#define CACHE_SIZE	64
+#define CACHE_DIRTY	32
+#define CACHE_AGE	10	// Seconds
+#define CHECK_MAX	(N_CALLS*4)
+
+typedef struct Run_S {
+	const char * name;
+	long syncs;
+	long long bytes;
+} Run_t;
+
+static AX25_Addr_t Calls[N_CALLS];
+static char Dir[64];
+static time_t Now;
+static Run_t * Counting;
+static int (*Db_Sync)(const DB *, unsigned int);
+
+// Bytes written by the btree, counted while a run is on
+static ssize_t Count_Write(int Fd, const void * Buf, size_t Len, off_t Offset, bool Positional) {
+	ssize_t ret;
+
+	ret = Positional ? syscall(SYS_pwrite64, Fd, Buf, Len, Offset) : syscall(SYS_write, Fd, Buf, Len);
+	if (Counting && ret > 0)
+		Counting->bytes += ret;
+
+	return ret;
+}
+
+ssize_t write(int Fd, const void * Buf, size_t Len) {
+	return Count_Write(Fd, Buf, Len, 0, false);
+}
+
+ssize_t pwrite(int Fd, const void * Buf, size_t Len, off_t Offset) {
+	return Count_Write(Fd, Buf, Len, Offset, true);
+}
+
+ssize_t pwrite64(int Fd, const void * Buf, size_t Len, off_t Offset) {
+	return Count_Write(Fd, Buf, Len, Offset, true);
+}
+
+static int Count_Sync(const DB * Db, unsigned int Flags) {
+	if (Counting)
+		Counting->syncs++;
+	return Db_Sync(Db, Flags);
+}
+
+static time_t Clock(void * Ctx) {
+	return Now;
+}
+
+static int Compare(const DBT * Key1, const DBT * Key2) {
+	if (Key1->size == sizeof(AX25_Addr_t) && Key2->size == sizeof(AX25_Addr_t))
+		return AX25_Addr_Cmp(Key1->data, Key2->data);
+	if (Key1->size == sizeof(APRS_Log_Index_t) && Key2->size == sizeof(APRS_Log_Index_t))
+		return memcmp(Key1->data, Key2->data, sizeof(APRS_Log_Index_t));
+	return (Key1->size == sizeof(AX25_Addr_t))?-1:1;
+}
+
+static DB * Open(const char * Name, int * Fd) {
+	char path[4][96];
+	APRS_Log_Btree_t btree;
+	DB * db;
+
+	snprintf(path[0], sizeof(path[0]), "%s/%s.db", Dir, Name);
+	snprintf(path[1], sizeof(path[1]), "%s/%s.new", Dir, Name);
+	snprintf(path[2], sizeof(path[2]), "%s/%s.jnl", Dir, Name);
+	snprintf(path[3], sizeof(path[3]), "%s/%s.rec", Dir, Name);
+	btree = (APRS_Log_Btree_t){
+		.path = path[0],
+		.rebuild = path[1],
+		.journal = path[2],
+		.recovery = path[3],
+		.compare = Compare,
+		.check_max = CHECK_MAX,
+	};
+
+	if (!(db = APRS_Log_Btree_Open(&btree, O_TRUNC, Fd)))
+		return NULL;
+
+	Db_Sync = db->sync;
+	db->sync = Count_Sync;
+
+	return db;
+}
+
+static void Clean(const char * Name) {
+	const char * ext[] = { "db", "new", "jnl", "rec" };
+	char path[96];
+	int i;
+
+	for (i=0 ; i<4 ; i++) {
+		snprintf(path, sizeof(path), "%s/%s.%s", Dir, Name, ext[i]);
+		unlink(path);
+	}
+}
+
+// Next frame of the burst, same sequence for both runs
+static void Frame(unsigned * Seed, APRS_Data_t * Data) {
+	int k = rand_r(Seed) % N_CALLS;
+
+	bzero(Data, sizeof(APRS_Data_t));
+	Data->address[1] = Calls[k];
+	Data->from = 1;
+	Data->type = APRS_DTI_POS;
+	Data->timestamp = Now;
+	Data->position.latitude = rand_r(Seed) % (90<<GPS_FIXED_POINT_DEG);
+	Data->position.longitude = -(rand_r(Seed) % (180<<GPS_FIXED_POINT_DEG));
+}
+
+static void Burst(DB * Db, APRS_Log_Cache_t * Cache, long Frames, unsigned Seed) {
+	APRS_Data_t data;
+	long n;
+
+	for (n=0 ; n<Frames ; n++) {
+		Now = 1000 + n/FRAMES_PER_SEC;
+		Frame(&Seed, &data);
+		if (Cache)
+			CHECK(!APRS_Log_Cache_Station(Cache, Db, &data), "frame %ld not cached", n);
+		else
+			CHECK(!APRS_Log_Station(Db, &data), "frame %ld not logged", n);
+	}
+
+	// Shutdown
+	if (Cache)
+		CHECK(!APRS_Log_Cache_Flush(Cache, Db), "flush");
+}
+
+// Station record of Calls[I], return 0 if found
+static int Get(DB * Db, int I, APRS_Station_t * Station) {
+	AX25_Addr_t callid = Calls[I];
+	DBT key, data;
+
+	key.data = &callid;
+	key.size = sizeof(AX25_Addr_t);
+	if (Db->get(Db, &key, &data, 0))
+		return 1;
+	memcpy(Station, data.data, sizeof(APRS_Station_t));
+	return 0;
+}
+
+static void Compare_Dbs(DB * Db1, DB * Db2) {
+	APRS_Station_t s1, s2;
+	int i, r1, r2, differ = 0;
+
+	for (i=0 ; i<N_CALLS ; i++) {
+		r1 = Get(Db1, i, &s1);
+		r2 = Get(Db2, i, &s2);
+		if (r1 != r2 || (!r1 && (s1.timestamp != s2.timestamp
+				|| s1.position.latitude != s2.position.latitude || s1.position.longitude != s2.position.longitude)))
+			differ++;
+	}
+
+	CHECK(!differ, "%d stations differ between direct and cached runs", differ);
+	CHECK(!APRS_Log_Check(Db1, CHECK_MAX) && !APRS_Log_Check(Db2, CHECK_MAX), "btree check");
+}
+
+int main(int argc, char ** argv) {
+	Run_t direct = { .name = "direct" }, cached = { .name = "cached" };
+	long frames = 1000, max_syncs;
+	unsigned seed = 1;
+	APRS_Log_Cache_t * cache;
+	int opt, i, fd1, fd2;
+	char name[10];
+	DB * db1, * db2;
+
+	while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+		switch (opt) {
+			case 'n':
+				frames = atol(optarg);
+				break;
+			case 's':
+				seed = atoi(optarg);
+				break;
+			default:
+				fprintf(stderr, "Usage : %s [-n frames] [-s seed]\n", argv[0]);
+				return 2;
+		}
+	}
+
+	esp_log_level_set("*", ESP_LOG_NONE);
+
+	snprintf(Dir, sizeof(Dir), "%s/burstXXXXXX", getenv("TMPDIR") && strlen(getenv("TMPDIR")) < 32 ? getenv("TMPDIR") : "/tmp");
+	if (!mkdtemp(Dir)) {
+		perror(Dir);
+		return 1;
+	}
+
+	for (i=0 ; i<N_CALLS ; i++) {
+		snprintf(name, sizeof(name), "F%dB%c-%d", i%10, 'A'+(i/10)%26, i/50+1);
+		AX25_Str_To_Addr(name, &Calls[i]);
+		AX25_Norm_Addr(&Calls[i]);
+	}
+
+	if (!(db1 = Open(direct.name, &fd1)) || !(db2 = Open(cached.name, &fd2))
+			|| !(cache = APRS_Log_Cache_Init(Clock, NULL, CACHE_SIZE, CACHE_DIRTY, CACHE_AGE))) {
+		CHECK(0, "stations DB not opened");
+		return Test_Result("aprs_log_burst");
+	}
+
+	Counting = &direct;
+	Burst(db1, NULL, frames, seed);
+	Counting = &cached;
+	Burst(db2, cache, frames, seed);
+	Counting = NULL;
+
+	printf("%ld frames : %s %ld syncs %lld bytes, %s %ld syncs %lld bytes\n", frames,
+			direct.name, direct.syncs, direct.bytes, cached.name, cached.syncs, cached.bytes);
+
+	// Every frame updates its station
+	CHECK(direct.syncs == frames, "%ld syncs for %ld frames", direct.syncs, frames);
+	// Flushed when CACHE_DIRTY stations are dirty, or the oldest is CACHE_AGE old, and at shutdown
+	max_syncs = frames/CACHE_DIRTY + frames/FRAMES_PER_SEC/CACHE_AGE + 1;
+	CHECK(cached.syncs && cached.syncs <= max_syncs, "%ld syncs, %ld max", cached.syncs, max_syncs);
+	CHECK(cached.bytes*4 <= direct.bytes, "%lld bytes written through cache, %lld direct", cached.bytes, direct.bytes);
+
+	Compare_Dbs(db1, db2);
+
+	db1->close(db1);
+	db2->close(db2);
+	close(fd1);
+	close(fd2);
+	free(cache);
+	Clean(direct.name);
+	Clean(cached.name);
+	rmdir(Dir);
+
+	return Test_Result("aprs_log_burst");
+}
@@ -0,0 +1,176 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/test_aprs_log_match.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// APRS_Log_Match on a segment store : stations matching a filter made by
+// AX25_Str_To_Addr are visited in key order, from R_FIRST then R_NEXT, and
+// the scan stops just past the prefix range. Filter forms :
+//	"CALL-*" or "CALL-"	: ssid field 0, any SSID (AX25_Addr_Cmp wildcard)
+//	"CALL"			: SSID 0 only, ssid field is not 0
+//	"CALL-n"		: SSID n only
+//	"PRE*"			: callid prefix, with one of the above for SSID
+//
+//	test_aprs_log_match
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include <esp_log.h>
+
+#include "aprs.h"
+#include "aprs_log.h"
+#include "aprs_lsdb.h"
+#include "test.h"
+
+#define MAX_MATCH	16
+
+// Stored stations, end of key space included
+static const char * Stations[] = {
+	"F4AAZZ", "F4AB", "F4ABC", "F4ABC-1", "F4ABC-9", "F4ABCD", "F4ABD", "F4AC",
+	"F4ABC-15", "ZZZZZY", "ZZZZZZ", "ZZZZZZ-15", "ZZZZZZ-3",
+};
+
+static DB * Db;
+
+static int Compare(const DBT * Key1, const DBT * Key2) {
+	if (Key1->size == sizeof(AX25_Addr_t) && Key2->size == sizeof(AX25_Addr_t))
+		return AX25_Addr_Cmp(Key1->data, Key2->data);
+	if (Key1->size == Key2->size)
+		return memcmp(Key1->data, Key2->data, Key1->size);
+	return (Key1->size == sizeof(AX25_Addr_t))?-1:1;
+}
+
+static void Addr(const char * Str, AX25_Addr_t * Addr) {
+	AX25_Str_To_Addr(Str, Addr);
+	AX25_Norm_Addr(Addr);
+}
+
+// Calls matching Filter, as "CALL-n" (ssid 0 without dash), space separated
+static int Match(const char * Filter, char * Out, size_t Size) {
+	APRS_Station_t station;
+	AX25_Addr_t filter, cursor;
+	char call[16];
+	int ret, n = 0, flags = R_FIRST;
+	size_t len = 0;
+
+	AX25_Str_To_Addr(Filter, &filter);
+	*Out = '\0';
+	while (n < MAX_MATCH && !(ret = APRS_Log_Match(Db, &filter, &cursor, flags, &station))) {
+		AX25_Addr_To_Str(&station.callid, call, sizeof(call));
+		CHECK(!AX25_Addr_Cmp(&cursor, &station.callid), "%s : cursor not on %s", Filter, call);
+		len += snprintf(Out+len, Size-len, "%s%s", n ? " " : "", call);
+		flags = R_NEXT;
+		n++;
+	}
+	CHECK(ret == 1, "%s : scan ended with %d", Filter, ret);
+
+	return n;
+}
+
+static void Expect(const char * Filter, const char * Expected) {
+	char out[256];
+
+	Match(Filter, out, sizeof(out));
+	CHECK(!strcmp(out, Expected), "%s : \"%s\" instead of \"%s\"", Filter, out, Expected);
+}
+
+// Match removed from DB between two calls, next one follows it
+static void Test_Removed_Cursor(void) {
+	APRS_Station_t station;
+	AX25_Addr_t filter, cursor;
+	char call[16] = "";
+
+	AX25_Str_To_Addr("F4ABC-*", &filter);
+	CHECK(!APRS_Log_Match(Db, &filter, &cursor, R_FIRST, &station), "no first match");
+	CHECK(!APRS_Log_Delete(Db, &cursor), "delete");
+	if (!APRS_Log_Match(Db, &filter, &cursor, R_NEXT, &station))
+		AX25_Addr_To_Str(&station.callid, call, sizeof(call));
+	CHECK(!strcmp(call, "F4ABC-1"), "%s after removed F4ABC", call);
+}
+
+int main(int argc, char ** argv) {
+	APRS_Station_t stations[sizeof(Stations)/sizeof(Stations[0])];
+	char dir[64], path[80], name[sizeof(dir)+260];
+	struct dirent * ent;
+	int i, n;
+	DIR * d;
+
+	esp_log_level_set("*", ESP_LOG_NONE);
+
+	snprintf(dir, sizeof(dir), "%s/matchXXXXXX", getenv("TMPDIR") && strlen(getenv("TMPDIR")) < 32 ? getenv("TMPDIR") : "/tmp");
+	if (!mkdtemp(dir)) {
+		perror(dir);
+		return 1;
+	}
+	snprintf(path, sizeof(path), "%s/st", dir);
+	Db = APRS_Lsdb_Open(path, 0, Compare, 8192, 1<<20);
+	CHECK(Db, "open");
+	if (!Db)
+		return Test_Result("aprs_log_match");
+
+	n = sizeof(Stations)/sizeof(Stations[0]);
+	bzero(stations, sizeof(stations));
+	for (i=0 ; i<n ; i++) {
+		Addr(Stations[i], &stations[i].callid);
+		stations[i].timestamp = 1000 + i;
+	}
+	CHECK(APRS_Log_Import(Db, stations, n) == n, "import");
+
+	// Exact callid, SSID forms
+	Expect("F4ABC-*", "F4ABC F4ABC-1 F4ABC-9 F4ABC-15");
+	Expect("F4ABC-", "F4ABC F4ABC-1 F4ABC-9 F4ABC-15");
+	Expect("F4ABC", "F4ABC");
+	Expect("F4ABC-9", "F4ABC-9");
+	Expect("F4ABC-2", "");
+
+	// Prefix range, F4AAZZ just before and F4AC just past it
+	Expect("F4AB*-*", "F4AB F4ABC F4ABC-1 F4ABC-9 F4ABC-15 F4ABCD F4ABD");
+	Expect("F4AB*", "F4AB F4ABC F4ABCD F4ABD");
+	Expect("F4AB*-1", "F4ABC-1");
+	Expect("F4AC*-*", "F4AC");
+
+	// End of key space
+	Expect("ZZZZZZ-*", "ZZZZZZ ZZZZZZ-3 ZZZZZZ-15");
+	Expect("ZZZ*-*", "ZZZZZY ZZZZZZ ZZZZZZ-3 ZZZZZZ-15");
+	Expect("ZZZZZZ-15", "ZZZZZZ-15");
+	Expect("ZZZZZZ-14", "");
+
+	Test_Removed_Cursor();
+
+	Db->close(Db);
+	if ((d = opendir(dir))) {
+		while ((ent = readdir(d)))
+			if (ent->d_name[0] != '.') {
+				snprintf(name, sizeof(name), "%s/%s", dir, ent->d_name);
+				unlink(name);
+			}
+		closedir(d);
+	}
+	rmdir(dir);
+
+	return Test_Result("aprs_log_match");
+}
@@ -0,0 +1,389 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/test_aprs_log_retention.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// A week of received traffic on a simulated clock, logged through the
+// write-back cache with retention passes scheduled as in APRS_Task, on a
+// btree and on a segment store. Regular stations, a stream of stations heard
+// only a few times, and pinned stations heard once at start. The stations
+// count, index entries and file size are sampled every hour of simulated time
+// and must stay within their bounds, pinned stations must survive.
+//
+//	test_aprs_log_retention [-d days] [-s seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <esp_log.h>
+
+#include "aprs.h"
+#include "aprs_log.h"
+#include "aprs_lsdb.h"
+#include "test.h"
+
+#define FRAME_EVERY	10	// Seconds between received frames
+#define N_REGULARS	300	// Stations heard all along
+#define TRANSIENT_PCT	30	// Frames from stations heard only a few times
+#define MAX_STATIONS	500
+#define MAX_AGE		(48*3600)
+#define PERIOD		600	// As APRS_RETENTION_PERIOD
+#define BUDGET		32	// As APRS_RETENTION_BUDGET
+#define CACHE_SIZE	64
+#define CACHE_DIRTY	32
+#define CACHE_AGE	60
+#define CHECK_MAX	(MAX_STATIONS*8)
+#define LSDB_SEGMENT	16384
+#define LSDB_MAX	(256*1024)
+#define LSDB_BUDGET	4096	// Compaction bytes per second
+#define T0		1700000000
+
+// Never evicted, heard once at start
+static const char * Pinned[] = { "F4JMZ-9", "F4JMZ-7", "TK5PIN", "TK5PIN-12" };
+#define N_PINNED	(sizeof(Pinned)/sizeof(Pinned[0]))
+
+typedef struct Run_S {
+	const char * name;
+	DB * db;
+	int fd;			// btree file, -1 for segment store
+	int peak;		// Stations
+	long size;		// File size at end of day one
+	long peak_size;		// Largest file size after day one
+	long distinct;		// Stations heard
+} Run_t;
+
+static char Dir[64];
+static time_t Now;
+static AX25_Addr_t Pinned_Addr[N_PINNED];
+
+static time_t Clock(void * Ctx) {
+	return Now;
+}
+
+static int Compare(const DBT * Key1, const DBT * Key2) {
+	if (Key1->size == sizeof(AX25_Addr_t) && Key2->size == sizeof(AX25_Addr_t))
+		return AX25_Addr_Cmp(Key1->data, Key2->data);
+	if (Key1->size == sizeof(APRS_Log_Index_t) && Key2->size == sizeof(APRS_Log_Index_t))
+		return memcmp(Key1->data, Key2->data, sizeof(APRS_Log_Index_t));
+	return (Key1->size == sizeof(AX25_Addr_t))?-1:1;
+}
+
+// Pinned list with any SSID, as APRS_Retention_Pinned
+static bool Is_Pinned(const AX25_Addr_t * Callid, void * Ctx) {
+	AX25_Addr_t any;
+	int i;
+
+	for (i=0 ; i<N_PINNED ; i++) {
+		any = Pinned_Addr[i];
+		any.ssid = 0;
+		if (!AX25_Addr_Cmp(Callid, &any))
+			return true;
+	}
+
+	return false;
+}
+
+static DB * Open_Btree(int * Fd) {
+	char path[4][96];
+	APRS_Log_Btree_t btree;
+
+	snprintf(path[0], sizeof(path[0]), "%s/btree.db", Dir);
+	snprintf(path[1], sizeof(path[1]), "%s/btree.new", Dir);
+	snprintf(path[2], sizeof(path[2]), "%s/btree.jnl", Dir);
+	snprintf(path[3], sizeof(path[3]), "%s/btree.rec", Dir);
+	btree = (APRS_Log_Btree_t){
+		.path = path[0],
+		.rebuild = path[1],
+		.journal = path[2],
+		.recovery = path[3],
+		.compare = Compare,
+		.check_max = CHECK_MAX,
+	};
+
+	return APRS_Log_Btree_Open(&btree, O_TRUNC, Fd);
+}
+
+static DB * Open_Lsdb(void) {
+	char path[96];
+
+	snprintf(path, sizeof(path), "%s/lsdb", Dir);
+	return APRS_Lsdb_Open(path, O_TRUNC, Compare, LSDB_SEGMENT, LSDB_MAX);
+}
+
+// Btree file size, or total size of the segments
+static long Size(Run_t * Run) {
+	char path[96];
+	struct dirent * ent;
+	struct stat st;
+	long size = 0;
+	DIR * d;
+
+	// Host btree is reopened by path, fd is not the file in use
+	if (Run->fd >= 0) {
+		snprintf(path, sizeof(path), "%s/btree.db", Dir);
+		return stat(path, &st)?-1:st.st_size;
+	}
+
+	if (!(d = opendir(Dir)))
+		return -1;
+	while ((ent = readdir(d)))
+		if (!strncmp(ent->d_name, "lsdb.", 5)) {
+			snprintf(path, sizeof(path), "%s/%s", Dir, ent->d_name);
+			if (!stat(path, &st))
+				size += st.st_size;
+		}
+	closedir(d);
+
+	return size;
+}
+
+// Station records and entries of one index, oldest unpinned station timestamp
+static int Count(DB * Db, uint8_t Index, time_t * Oldest) {
+	APRS_Log_Index_t start;
+	DBT key, data;
+	int n = 0, flags = R_FIRST;
+
+	if (Oldest)
+		*Oldest = 0;
+
+	if (Index) {
+		bzero(&start, sizeof(start));
+		start.index = Index;
+		key.data = &start;
+		key.size = sizeof(start);
+		flags = R_CURSOR;
+	}
+
+	while (!Db->seq(Db, &key, &data, flags)) {
+		flags = R_NEXT;
+		if (Index && (key.size != sizeof(APRS_Log_Index_t) || ((APRS_Log_Index_t *)key.data)->index != Index))
+			break;
+		if (!Index) {
+			if (key.size != sizeof(AX25_Addr_t))
+				break;
+			if (Oldest && !Is_Pinned(key.data, NULL)
+					&& (!*Oldest || ((APRS_Station_t *)data.data)->timestamp < *Oldest))
+				*Oldest = ((APRS_Station_t *)data.data)->timestamp;
+		}
+		n++;
+	}
+
+	return n;
+}
+
+// Next received frame : a regular, a new or recent transient station, pinned ones at start
+static void Frame(unsigned * Seed, long N, long * Transients, APRS_Data_t * Data) {
+	char name[10];
+	long t;
+
+	bzero(Data, sizeof(APRS_Data_t));
+	if (N < N_PINNED)
+		Data->address[1] = Pinned_Addr[N];
+	else {
+		if (rand_r(Seed)%100 >= TRANSIENT_PCT)
+			t = rand_r(Seed) % N_REGULARS;
+		else if (!*Transients || rand_r(Seed)%3)	// New station
+			t = N_REGULARS + (*Transients)++;
+		else						// Heard again among the last 20
+			t = N_REGULARS + *Transients - 1 - rand_r(Seed)%(*Transients < 20 ? *Transients : 20);
+		snprintf(name, sizeof(name), "F%ldR%c%c-%ld", t%10, 'A'+(int)(t/10)%26, 'A'+(int)(t/260)%26, t/6760%16);
+		AX25_Str_To_Addr(name, &Data->address[1]);
+	}
+	AX25_Norm_Addr(&Data->address[1]);
+	Data->from = 1;
+	Data->type = APRS_DTI_POS;
+	Data->timestamp = Now;
+	Data->position.latitude = (40<<GPS_FIXED_POINT_DEG) + rand_r(Seed) % (10<<GPS_FIXED_POINT_DEG);
+	Data->position.longitude = rand_r(Seed) % (10<<GPS_FIXED_POINT_DEG);
+}
+
+static void Simulate(Run_t * Run, int Days, unsigned Seed) {
+	APRS_Log_Retention_t * retention;
+	APRS_Log_Cache_t * cache;
+	APRS_Data_t data;
+	time_t end, next_frame, next_sample;
+	long n = 0, transients = 0, size;
+	int wait, ret, stations, bound;
+
+	Now = T0;
+	end = T0 + Days*86400;
+	next_frame = next_sample = T0;
+	Run->fd = -1;
+
+	if (!(Run->db = Run->name[0] == 'b' ? Open_Btree(&Run->fd) : Open_Lsdb())
+			|| !(cache = APRS_Log_Cache_Init(Clock, NULL, CACHE_SIZE, CACHE_DIRTY, CACHE_AGE))
+			|| !(retention = APRS_Log_Retention_Init(Clock, NULL, MAX_AGE, MAX_STATIONS, PERIOD, Is_Pinned, NULL))) {
+		CHECK(0, "%s : stations DB not opened", Run->name);
+		return;
+	}
+
+	// Stations heard in the period between two passes, and while a pass runs
+	bound = MAX_STATIONS + N_PINNED + (PERIOD + 60)/FRAME_EVERY;
+
+	while (Now < end) {
+		// Task loop
+		wait = APRS_Log_Cache_Process(cache, Run->db);
+		ret = APRS_Log_Retention_Process(retention, Run->db, cache, BUDGET);
+		CHECK(ret >= 0, "%s : retention error at %ld s", Run->name, (long)(Now-T0));
+		if (ret >= 0 && (wait < 0 || ret < wait))
+			wait = ret;
+		if (Run->fd < 0 && APRS_Lsdb_Compact(Run->db, LSDB_BUDGET) > 0 && (wait < 0 || wait > 1))
+			wait = 1;
+
+		if (wait < 0 || Now + wait >= next_frame) {
+			Now = next_frame;
+			Frame(&Seed, n++, &transients, &data);
+			CHECK(!APRS_Log_Cache_Station(cache, Run->db, &data), "%s : frame %ld not logged", Run->name, n);
+			next_frame += FRAME_EVERY;
+		} else
+			Now += wait ? wait : 1;
+
+		if (Now >= next_sample) {
+			stations = Count(Run->db, 0, NULL);
+			if (stations > Run->peak)
+				Run->peak = stations;
+			CHECK(stations <= bound, "%s : %d stations at %ld h, %d max", Run->name, stations,
+					(long)(Now-T0)/3600, bound);
+			size = Size(Run);
+			if (Now - T0 >= 86400 && !Run->size)
+				Run->size = size;
+			if (Run->size && size > Run->peak_size)
+				Run->peak_size = size;
+			if (Run->fd < 0)
+				CHECK(size <= LSDB_MAX + 2*LSDB_SEGMENT, "%s : %ld bytes at %ld h", Run->name, size,
+						(long)(Now-T0)/3600);
+			next_sample += 3600;
+		}
+	}
+
+	// Shutdown, then one last full pass
+	CHECK(!APRS_Log_Cache_Flush(cache, Run->db), "%s : flush", Run->name);
+	Now += PERIOD;
+	while ((ret = APRS_Log_Retention_Process(retention, Run->db, cache, BUDGET)) == 1);
+	CHECK(ret == PERIOD, "%s : last pass %d", Run->name, ret);
+	Run->distinct = N_PINNED + N_REGULARS + transients;
+
+	free(retention);
+	free(cache);
+}
+
+static void Check_Final(Run_t * Run) {
+	time_t oldest;
+	DBT key, data;
+	int i, stations, times, geos;
+
+	stations = Count(Run->db, 0, &oldest);
+	times = Count(Run->db, APRS_LOG_INDEX_TIME, NULL);
+	geos = Count(Run->db, APRS_LOG_INDEX_GEO, NULL);
+
+	printf("%s : %ld stations heard, peak %d, final %d, %ld bytes after day one, %ld peak\n", Run->name,
+			Run->distinct, Run->peak, stations, Run->size, Run->peak_size);
+
+	CHECK(stations <= MAX_STATIONS + N_PINNED, "%s : %d stations after last pass", Run->name, stations);
+	CHECK(times == stations && geos == stations, "%s : %d stations, %d time and %d geohash index entries",
+			Run->name, stations, times, geos);
+	CHECK(oldest >= Now - PERIOD - MAX_AGE, "%s : station heard %ld h before last pass", Run->name,
+			(long)(Now - PERIOD - oldest)/3600);
+	// Growth stops once the DB is full, freed space is reused
+	CHECK(Run->peak_size <= Run->size + Run->size/4, "%s : grew from %ld to %ld bytes", Run->name,
+			Run->size, Run->peak_size);
+
+	for (i=0 ; i<N_PINNED ; i++) {
+		key.data = &Pinned_Addr[i];
+		key.size = sizeof(AX25_Addr_t);
+		CHECK(!Run->db->get(Run->db, &key, &data, 0), "%s : pinned %s evicted", Run->name, Pinned[i]);
+	}
+
+	if (Run->fd >= 0)
+		CHECK(!APRS_Log_Check(Run->db, CHECK_MAX), "%s : btree check", Run->name);
+}
+
+static void Clean(void) {
+	char path[96];
+	struct dirent * ent;
+	DIR * d;
+
+	if ((d = opendir(Dir))) {
+		while ((ent = readdir(d)))
+			if (ent->d_name[0] != '.') {
+				snprintf(path, sizeof(path), "%s/%s", Dir, ent->d_name);
+				unlink(path);
+			}
+		closedir(d);
+	}
+	rmdir(Dir);
+}
+
+int main(int argc, char ** argv) {
+	Run_t runs[] = { { .name = "btree" }, { .name = "lsdb" } };
+	unsigned seed = 1;
+	int opt, i, days = 7;
+
+	while ((opt = getopt(argc, argv, "d:s:")) != -1) {
+		switch (opt) {
+			case 'd':
+				days = atoi(optarg);
+				break;
+			case 's':
+				seed = atoi(optarg);
+				break;
+			default:
+				fprintf(stderr, "Usage : %s [-d days] [-s seed]\n", argv[0]);
+				return 2;
+		}
+	}
+	if (days < 3)
+		days = 3;
+
+	esp_log_level_set("*", ESP_LOG_NONE);
+
+	snprintf(Dir, sizeof(Dir), "%s/retentionXXXXXX", getenv("TMPDIR") && strlen(getenv("TMPDIR")) < 32 ? getenv("TMPDIR") : "/tmp");
+	if (!mkdtemp(Dir)) {
+		perror(Dir);
+		return 1;
+	}
+
+	for (i=0 ; i<N_PINNED ; i++) {
+		AX25_Str_To_Addr(Pinned[i], &Pinned_Addr[i]);
+		AX25_Norm_Addr(&Pinned_Addr[i]);
+	}
+
+	for (i=0 ; i<sizeof(runs)/sizeof(runs[0]) ; i++) {
+		Simulate(&runs[i], days, seed);
+		if (!runs[i].db)
+			continue;
+		Check_Final(&runs[i]);
+		runs[i].db->close(runs[i].db);
+		if (runs[i].fd >= 0)
+			close(runs[i].fd);
+	}
+
+	Clean();
+
+	return Test_Result("aprs_log_retention");
+}
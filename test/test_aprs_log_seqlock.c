@@ -0,0 +1,244 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/test_aprs_log_seqlock.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Lock free station cache reads : a writer thread updates stations under the
+// stations lock (APRS_Task role) while reader threads (HMI role) use
+// APRS_Log_Cache_Peek / APRS_Log_Cache_Valid and APRS_Log_Cache_Read
+// without it. A station seen as valid must never mix two updates. The
+// station store is the segment store on a temporary directory.
+//
+//	test_aprs_log_seqlock [-n updates] [-t readers]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include <esp_log.h>
+
+#include "aprs.h"
+#include "aprs_log.h"
+#include "aprs_lsdb.h"
+#include "test.h"
+
+#define N_CALLS		48
+#define CACHE_SIZE	32
+#define MAX_READERS	8
+
+static DB * Db;
+static APRS_Log_Cache_t * Cache;
+static AX25_Addr_t Calls[N_CALLS];
+static pthread_mutex_t Lock = PTHREAD_MUTEX_INITIALIZER;	// stations_sem
+static atomic_bool Stop;
+static long Updates = 10000;
+
+static atomic_long Peek_Valid, Peek_Torn, Peek_Bad;
+static atomic_long Read_Hits, Read_Bad;
+static atomic_long Read_While_Locked;
+
+static int Compare(const DBT * Key1, const DBT * Key2) {
+	if (Key1->size == sizeof(AX25_Addr_t) && Key2->size == sizeof(AX25_Addr_t))
+		return AX25_Addr_Cmp(Key1->data, Key2->data);
+	if (Key1->size == Key2->size)
+		return memcmp(Key1->data, Key2->data, Key1->size);
+	return (Key1->size == sizeof(AX25_Addr_t))?-1:1;
+}
+
+// Every field written by update n is derived from n
+static void Update(long N) {
+	APRS_Data_t data;
+	int k = N % N_CALLS;
+
+	bzero(&data, sizeof(data));
+	data.address[1] = Calls[k];
+	data.from = 1;
+	data.type = APRS_DTI_POS;
+	data.timestamp = N;
+	data.position.latitude = N;
+	data.position.longitude = -N;
+	data.extension = APRS_DATA_EXT_CSE;
+	data.course.dir = N % 360;
+	data.course.speed = N & 0x7fff;
+
+	pthread_mutex_lock(&Lock);
+	APRS_Log_Cache_Station(Cache, Db, &data);
+	if (!(N % 500))
+		APRS_Log_Cache_Drop(Cache, &Calls[(k+1) % N_CALLS]);
+	if (!(N % 5000))
+		APRS_Log_Cache_Clear(Cache);
+	pthread_mutex_unlock(&Lock);
+}
+
+static bool Consistent(time_t Timestamp, int32_t Latitude, int32_t Longitude, uint16_t Dir, uint16_t Speed,
+		const AX25_Addr_t * Callid, int K) {
+	return Timestamp == Latitude && Longitude == -Latitude && Dir == Timestamp % 360
+		&& Speed == (Timestamp & 0x7fff) && !AX25_Addr_Cmp(Callid, &Calls[K]);
+}
+
+static void * Writer(void * Arg) {
+	long n;
+
+	for (n=1 ; n<=Updates ; n++)
+		Update(n);
+	atomic_store(&Stop, true);
+
+	return NULL;
+}
+
+static void * Reader(void * Arg) {
+	unsigned seed = (uintptr_t)Arg;
+	const APRS_Station_t * peek;
+	APRS_Station_t station;
+	AX25_Addr_t callid;
+	uint16_t dir, speed;
+	int32_t lat, lon;
+	uint32_t version;
+	time_t ts;
+	int k;
+
+	while (!atomic_load(&Stop)) {
+		k = rand_r(&seed) % N_CALLS;
+
+		// Copy out
+		if (!APRS_Log_Cache_Read(Cache, &Calls[k], &station)) {
+			Read_Hits++;
+			if (!Consistent(station.timestamp, station.position.latitude, station.position.longitude,
+						station.course.dir, station.course.speed, &station.callid, k))
+				Read_Bad++;
+		}
+
+		// Stable pointer, fields read then validated
+		if ((peek = APRS_Log_Cache_Peek(Cache, &Calls[k], &version))) {
+			ts = peek->timestamp;
+			lat = peek->position.latitude;
+			lon = peek->position.longitude;
+			dir = peek->course.dir;
+			speed = peek->course.speed;
+			memcpy(&callid, &peek->callid, sizeof(callid));
+			if (!APRS_Log_Cache_Valid(Cache, peek, version))
+				Peek_Torn++;
+			else if (Consistent(ts, lat, lon, dir, speed, &callid, k))
+				Peek_Valid++;
+			else
+				Peek_Bad++;
+		}
+
+		// A locked reader would have waited here
+		if (pthread_mutex_trylock(&Lock))
+			Read_While_Locked++;
+		else
+			pthread_mutex_unlock(&Lock);
+	}
+
+	return NULL;
+}
+
+int main(int argc, char ** argv) {
+	pthread_t writer, readers[MAX_READERS];
+	char dir[64], path[80], name[sizeof(dir)+260], str[10];
+	int n_readers = 3, opt, i;
+	struct dirent * ent;
+	DIR * d;
+
+	while ((opt = getopt(argc, argv, "n:t:")) != -1) {
+		switch (opt) {
+			case 'n':
+				Updates = atol(optarg);
+				break;
+			case 't':
+				n_readers = atoi(optarg);
+				if (n_readers < 1 || n_readers > MAX_READERS)
+					n_readers = 3;
+				break;
+			default:
+				fprintf(stderr, "Usage : %s [-n updates] [-t readers]\n", argv[0]);
+				return 2;
+		}
+	}
+
+	esp_log_level_set("*", ESP_LOG_NONE);
+
+	strcpy(dir, "/tmp/seqlockXXXXXX");
+	if (!mkdtemp(dir)) {
+		perror(dir);
+		return 1;
+	}
+	snprintf(path, sizeof(path), "%s/st", dir);
+	Db = APRS_Lsdb_Open(path, 0, Compare, 8192, 1<<20);
+	Cache = APRS_Log_Cache_Init(NULL, NULL, CACHE_SIZE, CACHE_SIZE/2, 60);
+	CHECK(Db && Cache, "open");
+	if (!Db || !Cache)
+		return Test_Result("aprs_log_seqlock");
+
+	for (i=0 ; i<N_CALLS ; i++) {
+		snprintf(str, sizeof(str), "F%dAB-%d", i % 10, i / 10 + 1);
+		AX25_Str_To_Addr(str, &Calls[i]);
+		AX25_Norm_Addr(&Calls[i]);
+	}
+
+	pthread_create(&writer, NULL, Writer, NULL);
+	for (i=0 ; i<n_readers ; i++)
+		pthread_create(&readers[i], NULL, Reader, (void*)(uintptr_t)(i+1));
+	pthread_join(writer, NULL);
+	for (i=0 ; i<n_readers ; i++)
+		pthread_join(readers[i], NULL);
+
+	printf("%ld updates : peek %ld valid %ld retried, read %ld, %ld reads while lock held\n", Updates,
+			(long)Peek_Valid, (long)Peek_Torn, (long)Read_Hits, (long)Read_While_Locked);
+	CHECK(!Peek_Bad, "%ld peeked stations validated but inconsistent", (long)Peek_Bad);
+	CHECK(!Read_Bad, "%ld inconsistent station copies", (long)Read_Bad);
+	CHECK(Peek_Valid && Read_Hits, "no cache hit");
+
+	// Written back stations are complete too
+	APRS_Log_Cache_Flush(Cache, Db);
+	for (i=0 ; i<N_CALLS ; i++) {
+		APRS_Station_t station;
+		DBT key = {.data = &Calls[i], .size = sizeof(AX25_Addr_t)}, data;
+
+		CHECK(!Db->get(Db, &key, &data, 0) && data.size == sizeof(station), "station %d not stored", i);
+		if (data.size != sizeof(station))
+			continue;
+		memcpy(&station, data.data, sizeof(station));
+		CHECK(Consistent(station.timestamp, station.position.latitude, station.position.longitude,
+					station.course.dir, station.course.speed, &station.callid, i), "station %d stored inconsistent", i);
+	}
+
+	Db->close(Db);
+	free(Cache);
+	if ((d = opendir(dir))) {
+		while ((ent = readdir(d)))
+			if (ent->d_name[0] != '.') {
+				snprintf(name, sizeof(name), "%s/%s", dir, ent->d_name);
+				unlink(name);
+			}
+		closedir(d);
+	}
+	rmdir(dir);
+
+	return Test_Result("aprs_log_seqlock");
+}
@@ -0,0 +1,361 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/test_aprs_lsdb_crash.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Log-structured station store crash consistency : a child process applies
+// a deterministic stream of puts, deletes and compaction steps and is
+// killed at a random point. After some kills the tail of the newest segment
+// is overwritten with garbage, as a power loss in the middle of a write
+// would leave it. The reopened store must then hold exactly the state after
+// some prefix of the stream, not older than the last sync, and compaction
+// must not change it.
+//
+//	test_aprs_lsdb_crash [-r rounds] [-k kills] [-s seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <esp_log.h>
+
+#include "aprs_lsdb.h"
+#include "test.h"
+
+#define N_KEYS		200
+#define DATA_MAX	64
+#define SEGMENT_SIZE	2048
+#define SYNC_EVERY	10
+#define OPS_PER_RUN	3000
+
+typedef struct Op_S {
+	bool del;
+	int key;
+	int len;
+	uint8_t data[DATA_MAX];
+} Op_t;
+
+// Progress of the child, shared with the parent
+typedef struct Progress_S {
+	volatile long started;	// Operations begun
+	volatile long synced;	// Operations made durable
+} Progress_t;
+
+static Progress_t * Progress;
+static char Dir[64], Path[80];
+static unsigned Seed;
+static long Ops;		// Operations run by children
+
+// Expected content : key present, data
+static struct {
+	bool present;
+	int len;
+	uint8_t data[DATA_MAX];
+} Model[N_KEYS];
+
+static uint64_t Mix(uint64_t X) {
+	X ^= X >> 33;
+	X *= 0xff51afd7ed558ccdULL;
+	X ^= X >> 33;
+	X *= 0xc4ceb9fe1a85ec53ULL;
+	X ^= X >> 33;
+	return X;
+}
+
+// Operation I of the stream
+static void Gen(long I, Op_t * Op) {
+	uint64_t r = Mix(Seed*1000003ULL + I);
+	int i;
+
+	Op->key = r % N_KEYS;
+	Op->del = !((r >> 8) % 4);
+	Op->len = (r >> 16) % DATA_MAX;
+	for (i=0 ; i<Op->len ; i++)
+		Op->data[i] = Mix(r + i);
+}
+
+static void Key(int K, uint8_t Buf[4]) {
+	Buf[0] = K >> 24;
+	Buf[1] = K >> 16;
+	Buf[2] = K >> 8;
+	Buf[3] = K;
+}
+
+static int Compare(const DBT * A, const DBT * B) {
+	size_t n = A->size < B->size ? A->size : B->size;
+	int ret = memcmp(A->data, B->data, n);
+
+	return ret ? ret : (int)A->size - (int)B->size;
+}
+
+static void Model_Apply(long I) {
+	Op_t op;
+
+	Gen(I, &op);
+	Model[op.key].present = !op.del;
+	if (!op.del) {
+		Model[op.key].len = op.len;
+		memcpy(Model[op.key].data, op.data, op.len);
+	}
+}
+
+static uint64_t Hash(uint64_t H, const void * Buf, size_t Len) {
+	const uint8_t * ptr = Buf;
+
+	while (Len--) {
+		H ^= *ptr++;
+		H *= 0x100000001b3ULL;
+	}
+	return H;
+}
+
+static uint64_t Model_Digest(void) {
+	uint64_t h = 1469598103934665603ULL;
+	uint8_t key[4];
+	int k;
+
+	for (k=0 ; k<N_KEYS ; k++) {
+		if (!Model[k].present)
+			continue;
+		Key(k, key);
+		h = Hash(h, key, sizeof(key));
+		h = Hash(h, &Model[k].len, sizeof(Model[k].len));
+		h = Hash(h, Model[k].data, Model[k].len);
+	}
+	return h;
+}
+
+// Same digest over the store, in key order
+static uint64_t Store_Digest(DB * Db) {
+	uint64_t h = 1469598103934665603ULL;
+	unsigned int flag;
+	DBT key, data;
+	int len;
+
+	for (flag = R_FIRST ; !Db->seq(Db, &key, &data, flag) ; flag = R_NEXT) {
+		len = data.size;
+		h = Hash(h, key.data, key.size);
+		h = Hash(h, &len, sizeof(len));
+		h = Hash(h, data.data, data.size);
+	}
+	return h;
+}
+
+static void Child(long Start) {
+	uint8_t buf[4];
+	DBT key, data;
+	Op_t op;
+	long i;
+	DB * db;
+
+	if (!(db = APRS_Lsdb_Open(Path, 0, Compare, SEGMENT_SIZE, 1<<30)))
+		_exit(3);
+
+	for (i=Start ; i<Start+OPS_PER_RUN ; i++) {
+		Gen(i, &op);
+		Key(op.key, buf);
+		key.data = buf;
+		key.size = sizeof(buf);
+		data.data = op.data;
+		data.size = op.len;
+
+		Progress->started = i+1;
+		if (op.del)
+			db->del(db, &key, 0);
+		else if (db->put(db, &key, &data, 0))
+			_exit(4);
+		if (!((i+1) % SYNC_EVERY)) {
+			if (db->sync(db, 0))
+				_exit(5);
+			Progress->synced = i+1;
+		}
+		if (APRS_Lsdb_Compact(db, 256) < 0)
+			_exit(6);
+	}
+
+	db->close(db);
+	_exit(0);
+}
+
+// Garbage after the last record of the newest segment, whole or torn
+static bool Tear(uint64_t R) {
+	char name[sizeof(Dir)+32], best[32] = "";
+	struct dirent * ent;
+	uint8_t garbage[sizeof(APRS_Lsdb_Rec_t) + 4 + DATA_MAX];
+	int fd, i, len;
+	DIR * dir;
+
+	if (!(dir = opendir(Dir)))
+		return false;
+	while ((ent = readdir(dir)))
+		if (ent->d_name[0] != '.' && strlen(ent->d_name) < sizeof(best) && strcmp(ent->d_name, best) > 0)
+			strcpy(best, ent->d_name);
+	closedir(dir);
+	if (!*best)
+		return false;
+
+	snprintf(name, sizeof(name), "%s/%s", Dir, best);
+	if ((fd = open(name, O_WRONLY | O_APPEND)) < 0)
+		return false;
+	len = R % sizeof(garbage) + 1;
+	for (i=0 ; i<len ; i++)
+		garbage[i] = Mix(R + i);
+	// Or a record header written before its body
+	if (R & 0x100) {
+		APRS_Lsdb_Rec_t rec = {.crc = Mix(R), .data_size = R % DATA_MAX, .key_size = 4, .type = APRS_LSDB_PUT};
+
+		memcpy(garbage, &rec, sizeof(rec));
+		if (len < sizeof(rec) + 4 + rec.data_size && (R & 0x200))
+			len = sizeof(rec) + 4 + rec.data_size;
+	}
+	len = write(fd, garbage, len);
+	close(fd);
+
+	return len > 0;
+}
+
+static void Clean(void) {
+	char name[sizeof(Dir)+260];
+	struct dirent * ent;
+	DIR * dir;
+
+	if (!(dir = opendir(Dir)))
+		return;
+	while ((ent = readdir(dir))) {
+		if (ent->d_name[0] == '.')
+			continue;
+		snprintf(name, sizeof(name), "%s/%s", Dir, ent->d_name);
+		unlink(name);
+	}
+	closedir(dir);
+}
+
+// Kill the child Kills times, checking the store after each kill
+static void Round(int Round, int Kills, int * Torn) {
+	long state, prefix, i;
+	uint64_t digest;
+	int kill_n, status, ret;
+	pid_t pid;
+	DB * db;
+
+	Seed = Round + 1;
+	Clean();
+	bzero(Model, sizeof(Model));
+	state = 0;
+
+	for (kill_n=0 ; kill_n<Kills ; kill_n++) {
+		Progress->started = Progress->synced = state;
+		fflush(NULL);
+		if (!(pid = fork()))
+			Child(state);
+		usleep(Mix(Round*31 + kill_n) % 20000);
+		kill(pid, SIGKILL);
+		waitpid(pid, &status, 0);
+		Ops += Progress->started - state;
+		CHECK(!WIFEXITED(status) || !WEXITSTATUS(status), "round %d : child exit %d", Round, WEXITSTATUS(status));
+
+		if (!(Mix(Round*7 + kill_n) % 3) && Tear(Mix(Round + kill_n)))
+			(*Torn)++;
+
+		db = APRS_Lsdb_Open(Path, 0, Compare, SEGMENT_SIZE, 1<<30);
+		CHECK(db, "round %d kill %d : open failed", Round, kill_n);
+		if (!db)
+			return;
+		digest = Store_Digest(db);
+
+		// Synced operations are there, then any prefix of the others
+		while (state < Progress->synced)
+			Model_Apply(state++);
+		prefix = -1;
+		for (i=state ; ; i++) {
+			if (Model_Digest() == digest) {
+				prefix = i;
+				break;
+			}
+			if (i >= Progress->started)
+				break;
+			Model_Apply(i);
+		}
+		CHECK(prefix >= 0, "round %d kill %d : no prefix in [%ld, %ld] matches", Round, kill_n, state, Progress->started);
+		if (prefix < 0) {
+			db->close(db);
+			return;
+		}
+		state = prefix;
+
+		// Full compaction keeps content
+		while ((ret = APRS_Lsdb_Compact(db, 4096)) == 1);
+		CHECK(ret == 0 && Store_Digest(db) == digest, "round %d kill %d : compaction changed content", Round, kill_n);
+		db->close(db);
+	}
+}
+
+int main(int argc, char ** argv) {
+	int rounds = 20, kills = 6, seed = 0, torn = 0;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "r:k:s:")) != -1) {
+		switch (opt) {
+			case 'r':
+				rounds = atoi(optarg);
+				break;
+			case 'k':
+				kills = atoi(optarg);
+				break;
+			case 's':
+				seed = atoi(optarg);
+				break;
+			default:
+				fprintf(stderr, "Usage : %s [-r rounds] [-k kills] [-s seed]\n", argv[0]);
+				return 2;
+		}
+	}
+
+	esp_log_level_set("*", ESP_LOG_NONE);
+
+	Progress = mmap(NULL, sizeof(Progress_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (Progress == MAP_FAILED)
+		return 1;
+	snprintf(Dir, sizeof(Dir), "%s/lsdbXXXXXX", getenv("TMPDIR") && strlen(getenv("TMPDIR")) < 32 ? getenv("TMPDIR") : "/tmp");
+	if (!mkdtemp(Dir)) {
+		perror(Dir);
+		return 1;
+	}
+	snprintf(Path, sizeof(Path), "%s/st", Dir);
+
+	for (i=0 ; i<rounds && !Test_Failed ; i++)
+		Round(seed + i, kills, &torn);
+
+	Clean();
+	rmdir(Dir);
+	printf("%d rounds of %d kills, %ld operations, %d torn tails\n", rounds, kills, Ops, torn);
+
+	return Test_Result("aprs_lsdb_crash");
+}
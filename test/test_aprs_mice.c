@@ -0,0 +1,145 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/test_aprs_mice.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Mic-E encoder and parser round trip, and rounding of minutes carried to
+// degrees in Mic-E and uncompressed positions.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "aprs.h"
+#include "aprs_encoder.h"
+#include "aprs_parsers.h"
+#include "test.h"
+
+#define CENT_TOL	((1<<GPS_FIXED_POINT_DEG)/6000 + 1)	// 1/100 minute
+
+static int32_t Fixed(int Deg, double Min) {
+	double deg = abs(Deg) + Min/60.0;
+
+	return (Deg < 0 ? -1 : 1) * llround(deg * (1<<GPS_FIXED_POINT_DEG));
+}
+
+static void Init_Data(APRS_Data_t * Data, enum APRS_DTI_E Type, int32_t Lat, int32_t Lon) {
+	bzero(Data, sizeof(APRS_Data_t));
+	AX25_Str_To_Addr("APZ001", &Data->address[0]);
+	AX25_Str_To_Addr("F4JMZ-9", &Data->address[1]);
+	Data->address[1].ssid |= 1;
+	Data->type = Type;
+	Data->symbol[0] = '/';
+	Data->symbol[1] = '>';
+	Data->position.latitude = Lat;
+	Data->position.longitude = Lon;
+}
+
+static int Encode_Parse(APRS_Data_t * In, Frame_t * Frame, APRS_Data_t * Out) {
+	if (APRS_Encode(In, Frame) < 0)
+		return -1;
+	Frame->frame_len += 2;	// crc
+	return APRS_Parse(Frame, Out);
+}
+
+// Latitude digit encoded in Mic-E destination address
+static int Mice_Digit(const APRS_Data_t * Data, int i) {
+	char c = Data->address[0].callid[i]>>1;
+
+	if (c >= 'P' && c <= 'Y')
+		return c - 'P';
+	if (c >= 'A' && c <= 'J')
+		return c - 'A';
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	return -1;
+}
+
+static void Test_Round_Trip(Frame_t * Frame, int Lat_Deg, double Lat_Min, int Lon_Deg, double Lon_Min) {
+	APRS_Data_t in, out;
+
+	Init_Data(&in, APRS_DTI_CUR_MICE, Fixed(Lat_Deg, Lat_Min), Fixed(Lon_Deg, Lon_Min));
+	in.extension = APRS_DATA_EXT_CSE;
+	in.course.dir = 123;
+	in.course.speed = 45;
+	in.position.altitude = 1000;
+	in.mice_msg = APRS_MICE_MSG_EN_ROUTE;
+	strcpy(in.text, "round trip");
+
+	CHECK(Encode_Parse(&in, Frame, &out) >= 0, "%d %f %d %f", Lat_Deg, Lat_Min, Lon_Deg, Lon_Min);
+	CHECK(out.type == APRS_DTI_CUR_MICE, "type %c", out.type);
+	CHECK(abs(out.position.latitude - in.position.latitude) <= CENT_TOL,
+			"latitude %d != %d", out.position.latitude, in.position.latitude);
+	CHECK(abs(out.position.longitude - in.position.longitude) <= CENT_TOL,
+			"longitude %d != %d", out.position.longitude, in.position.longitude);
+	CHECK(out.course.dir == in.course.dir && out.course.speed == in.course.speed,
+			"course %d/%d", out.course.dir, out.course.speed);
+	CHECK(abs(out.position.altitude - in.position.altitude) <= 2, "altitude %d", out.position.altitude);
+	CHECK(out.mice_msg == in.mice_msg, "message %d", out.mice_msg);
+	CHECK(out.symbol[0] == '/' && out.symbol[1] == '>', "symbol %c%c", out.symbol[0], out.symbol[1]);
+	CHECK(!strcmp(out.text, in.text), "text '%s'", out.text);
+}
+
+// Minutes rounded up to 60 must be carried to degrees
+static void Test_Mice_Carry(Frame_t * Frame) {
+	static const int lat[6] = {4, 9, 0, 0, 0, 0};
+	APRS_Data_t in, out;
+	int i;
+
+	Init_Data(&in, APRS_DTI_CUR_MICE, Fixed(48, 59.996), Fixed(9, 59.997));
+	CHECK(Encode_Parse(&in, Frame, &out) >= 0, "48 59.996");
+	for (i=0 ; i<6 ; i++)
+		CHECK(Mice_Digit(&out, i) == lat[i], "latitude digit %d : %d", i, Mice_Digit(&out, i));
+	CHECK(out.position.latitude == 49<<GPS_FIXED_POINT_DEG, "latitude %d", out.position.latitude);
+	CHECK(out.position.longitude == 10<<GPS_FIXED_POINT_DEG, "longitude %d", out.position.longitude);
+
+	Init_Data(&in, APRS_DTI_CUR_MICE, Fixed(-33, 59.999), Fixed(-99, 59.998));
+	CHECK(Encode_Parse(&in, Frame, &out) >= 0, "-33 59.999");
+	CHECK(out.position.latitude == -(34<<GPS_FIXED_POINT_DEG), "latitude %d", out.position.latitude);
+	CHECK(out.position.longitude == -(100<<GPS_FIXED_POINT_DEG), "longitude %d", out.position.longitude);
+}
+
+static void Test_Pos_Carry(Frame_t * Frame) {
+	APRS_Data_t in, out;
+
+	Init_Data(&in, APRS_DTI_POS, Fixed(48, 59.996), Fixed(-2, 59.997));
+	CHECK(Encode_Parse(&in, Frame, &out) >= 0, "48 59.996");
+	CHECK(!memcmp(&Frame->frame[17], "4900.00N/00300.00W>", 19), "info '%.19s'", &Frame->frame[17]);
+	CHECK(out.position.latitude == 49<<GPS_FIXED_POINT_DEG, "latitude %d", out.position.latitude);
+	CHECK(out.position.longitude == -(3<<GPS_FIXED_POINT_DEG), "longitude %d", out.position.longitude);
+}
+
+int main(int argc, char ** argv) {
+	Frame_t * frame;
+
+	frame = Test_Frame(APRS_MAX_FRAME_LEN);
+
+	Test_Round_Trip(frame, 45, 30.12, 3, 5.67);
+	Test_Round_Trip(frame, -33, 51.0, -122, 25.5);
+	Test_Round_Trip(frame, 0, 0.5, 179, 59.99);
+	Test_Round_Trip(frame, 12, 7.33, -105, 0.01);
+	Test_Mice_Carry(frame);
+	Test_Pos_Carry(frame);
+
+	free(frame);
+
+	return Test_Result("aprs_mice");
+}
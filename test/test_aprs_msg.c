@@ -0,0 +1,206 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/test_aprs_msg.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Message retries, acks and duplicate suppression, on a stub clock.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "aprs.h"
+#include "aprs_msg.h"
+#include "test.h"
+
+#define MAX_SENT	32
+
+static time_t Now = 1000;
+static struct APRS_Message Sent[MAX_SENT];
+static int N_Sent;
+
+static time_t Clock(void * Ctx) {
+	return Now;
+}
+
+static int Send(void * Ctx, const struct APRS_Message * Message) {
+	if (N_Sent < MAX_SENT)
+		memcpy(&Sent[N_Sent], Message, sizeof(struct APRS_Message));
+	N_Sent++;
+	return 0;
+}
+
+static APRS_Msg_t * Reset(void) {
+	Now = 1000;
+	N_Sent = 0;
+	return APRS_Msg_Init(Clock, Send, NULL);
+}
+
+static void Make_Message(struct APRS_Message * Message, int Type, const char * Id, const char * Reply_Ack) {
+	bzero(Message, sizeof(struct APRS_Message));
+	Message->type = Type;
+	strcpy(Message->addressee, "F4JMZ-9");
+	strcpy(Message->text, "hello");
+	strcpy(Message->id, Id);
+	if (Reply_Ack) {
+		Message->reply_ack_cap = true;
+		strcpy(Message->reply_ack, Reply_Ack);
+	}
+}
+
+static AX25_Addr_t Addr(const char * Str) {
+	AX25_Addr_t addr;
+
+	AX25_Str_To_Addr(Str, &addr);
+	return addr;
+}
+
+// Retries at 30, 60, 120, 240 s then give up after 5 transmissions
+static void Test_Retry(void) {
+	static const int delay[] = {30, 60, 120, 240, 480};
+	APRS_Msg_t * msg = Reset();
+	int i, wait;
+
+	CHECK(!APRS_Msg_Queue(msg, "F4ABC", "hello", true), "queue");
+	for (i=0 ; i<5 ; i++) {
+		wait = APRS_Msg_Process(msg);
+		CHECK(N_Sent == i+1, "try %d : %d sent", i, N_Sent);
+		CHECK(wait == delay[i], "try %d : wait %d", i, wait);
+		Now += wait-1;
+		CHECK(APRS_Msg_Process(msg) == 1, "try %d : early", i);
+		CHECK(N_Sent == i+1, "try %d : sent early", i);
+		Now++;
+	}
+	CHECK(!strcmp(Sent[0].addressee, "F4ABC") && !strcmp(Sent[0].id, "01") && Sent[0].reply_ack_cap,
+			"message %s {%s}", Sent[0].addressee, Sent[0].id);
+	CHECK(!strcmp(Sent[4].id, "01"), "retry id %s", Sent[4].id);
+
+	APRS_Msg_Process(msg);
+	CHECK(N_Sent == 5, "%d sent after give up", N_Sent);
+	CHECK(APRS_Msg_Process(msg) == -1, "queue not empty");
+
+	free(msg);
+}
+
+// Ack from addressee stops retries, ack from another station doesn't
+static void Test_Ack(void) {
+	APRS_Msg_t * msg = Reset();
+	struct APRS_Message ack;
+	AX25_Addr_t from;
+
+	APRS_Msg_Queue(msg, "F4ABC-7", "hello", true);
+	APRS_Msg_Process(msg);
+	CHECK(N_Sent == 1, "%d sent", N_Sent);
+
+	Make_Message(&ack, APRS_MSG_TYPE_ACK, "01", NULL);
+	from = Addr("F4XYZ");
+	CHECK(APRS_Msg_Received(msg, &from, &ack) == 1, "ack not consumed");
+	Now += 30;
+	APRS_Msg_Process(msg);
+	CHECK(N_Sent == 2, "ack from other station stopped retries");
+
+	from = Addr("F4ABC-7");
+	APRS_Msg_Received(msg, &from, &ack);
+	Now += 60;
+	CHECK(APRS_Msg_Process(msg) == -1, "message still queued after ack");
+	CHECK(N_Sent == 2, "%d sent after ack", N_Sent);
+
+	// Reply-ack in a received message acks too
+	APRS_Msg_Queue(msg, "F4ABC-7", "again", true);
+	APRS_Msg_Process(msg);
+	Make_Message(&ack, APRS_MSG_TYPE_MESSAGE, "", "02");
+	APRS_Msg_Received(msg, &from, &ack);
+	CHECK(APRS_Msg_Process(msg) == -1, "message still queued after reply-ack");
+
+	// No ack requested : sent once
+	N_Sent = 0;
+	APRS_Msg_Queue(msg, "F4ABC", "once", false);
+	APRS_Msg_Process(msg);
+	CHECK(N_Sent == 1 && !Sent[0].id[0], "%d sent, id '%s'", N_Sent, Sent[0].id);
+	CHECK(APRS_Msg_Process(msg) == -1, "message without ack still queued");
+
+	free(msg);
+}
+
+// One outstanding message per destination, in queuing order
+static void Test_Order(void) {
+	APRS_Msg_t * msg = Reset();
+	struct APRS_Message ack;
+	AX25_Addr_t from = Addr("F4ABC");
+
+	APRS_Msg_Queue(msg, "F4ABC", "first", true);
+	APRS_Msg_Queue(msg, "F4ABC", "second", true);
+	APRS_Msg_Queue(msg, "F4DEF", "other", true);
+	APRS_Msg_Process(msg);
+	CHECK(N_Sent == 2, "%d sent", N_Sent);
+	CHECK(!strcmp(Sent[0].text, "first") && !strcmp(Sent[1].text, "other"), "sent %s, %s", Sent[0].text, Sent[1].text);
+
+	Make_Message(&ack, APRS_MSG_TYPE_ACK, "01", NULL);
+	APRS_Msg_Received(msg, &from, &ack);
+	APRS_Msg_Process(msg);
+	CHECK(N_Sent == 3 && !strcmp(Sent[2].text, "second") && !strcmp(Sent[2].id, "02"),
+			"%d sent, last %s {%s}", N_Sent, Sent[N_Sent-1].text, Sent[N_Sent-1].id);
+
+	free(msg);
+}
+
+// Duplicates are acked but not delivered, until dup timeout
+static void Test_Dup(void) {
+	APRS_Msg_t * msg = Reset();
+	struct APRS_Message in;
+	AX25_Addr_t from = Addr("F4XYZ-5"), other = Addr("F4XYZ");
+
+	Make_Message(&in, APRS_MSG_TYPE_MESSAGE, "AB", "");
+	CHECK(APRS_Msg_Received(msg, &from, &in) == 0, "first not delivered");
+	CHECK(N_Sent == 1 && Sent[0].type == APRS_MSG_TYPE_ACK && !strcmp(Sent[0].id, "AB")
+			&& !strcmp(Sent[0].addressee, "F4XYZ-5"), "ack %s {%s}", Sent[0].addressee, Sent[0].id);
+
+	Now += 10;
+	CHECK(APRS_Msg_Received(msg, &from, &in) == 1, "duplicate delivered");
+	CHECK(N_Sent == 2, "duplicate not acked");
+
+	CHECK(APRS_Msg_Received(msg, &other, &in) == 0, "same id from other station not delivered");
+
+	Now += APRS_MSG_DUP_TIMEOUT;
+	CHECK(APRS_Msg_Received(msg, &from, &in) == 0, "not delivered after dup timeout");
+
+	// Reply-ack capable sender : our next message carries its last id
+	APRS_Msg_Queue(msg, "F4XYZ-5", "reply", true);
+	N_Sent = 0;
+	APRS_Msg_Process(msg);
+	CHECK(N_Sent == 1 && !strcmp(Sent[0].reply_ack, "AB"), "reply-ack '%s'", Sent[0].reply_ack);
+
+	// Without id : always delivered, never acked
+	N_Sent = 0;
+	Make_Message(&in, APRS_MSG_TYPE_MESSAGE, "", NULL);
+	CHECK(APRS_Msg_Received(msg, &from, &in) == 0 && APRS_Msg_Received(msg, &from, &in) == 0, "message without id");
+	CHECK(N_Sent == 0, "message without id acked");
+
+	free(msg);
+}
+
+int main(int argc, char ** argv) {
+	Test_Retry();
+	Test_Ack();
+	Test_Order();
+	Test_Dup();
+
+	return Test_Result("aprs_msg");
+}
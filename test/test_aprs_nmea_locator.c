@@ -0,0 +1,166 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/test_aprs_nmea_locator.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Raw NMEA ('$') and Maidenhead locator ('[') frames, as captured on air.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include <esp_log.h>
+
+#include "aprs.h"
+#include "aprs_parsers.h"
+#include "test.h"
+
+#define DEG(d)	((int32_t)lround((d)*(1<<GPS_FIXED_POINT_DEG)))
+#define DEG_TOL	DEG(0.0001)
+
+static Frame_t * Frame;
+static APRS_Data_t Data;
+
+static int Parse(const char * Info) {
+	if (Test_Ui_Frame(Frame, "F4ABC-11", "GPS", NULL, Info))
+		return -2;
+	return APRS_Parse(Frame, &Data);
+}
+
+static bool Near(int32_t Pos, double Deg) {
+	return abs(Pos - DEG(Deg)) <= DEG_TOL;
+}
+
+static void Test_Nmea(void) {
+	static const char * bad[] = {
+		"$GPRMC,123519,V,4807.038,N,01131.000,E,022.4,084.4,230324,003.1,W*76",	// No fix
+		"$GPRMC,123519,V,4807.038,N,01131.000,E,022.4,084.4,230324,,,A*60",
+		"$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230324,,,N*78",
+		"$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230324,003.1,W*60",	// Bad checksum
+		"$GPGGA,001038.00,3334.2313457,N,11211.0576940,W,0,,,,M,,M,,*62",	// Fix quality 0
+		"$GPRMC,123519,A,4807",
+		"$ULTW0000000001FF000127210000000000000000000001CE",		// Ultimeter weather
+		"$",
+		NULL
+	};
+	int i;
+
+	CHECK(Parse("$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230324,003.1,W*61") == APRS_DTI_RAW_GPS, "RMC");
+	CHECK(Near(Data.position.latitude, 48+7.038/60) && Near(Data.position.longitude, 11+31.0/60),
+			"RMC position %d %d", Data.position.latitude, Data.position.longitude);
+	CHECK(Data.extension == APRS_DATA_EXT_CSE && Data.course.speed == 22 && Data.course.dir == 84,
+			"RMC course %d/%d", Data.course.dir, Data.course.speed);
+	CHECK(Data.time.hours == 12 && Data.time.minutes == 35 && Data.time.seconds == 19
+			&& Data.time.day == 23 && Data.time.month == 3, "RMC time %02d/%02d %02d:%02d:%02d",
+			Data.time.day, Data.time.month, Data.time.hours, Data.time.minutes, Data.time.seconds);
+
+	CHECK(Parse("$GNRMC,081836.00,A,3751.65,S,14507.36,E,0.00,360.0,130924,011.3,E,A*08") == APRS_DTI_RAW_GPS, "GNRMC");
+	CHECK(Near(Data.position.latitude, -(37+51.65/60)) && Near(Data.position.longitude, 145+7.36/60),
+			"GNRMC position %d %d", Data.position.latitude, Data.position.longitude);
+
+	CHECK(Parse("$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47 balloon") == APRS_DTI_RAW_GPS, "GGA");
+	CHECK(Near(Data.position.latitude, 48+7.038/60) && Near(Data.position.longitude, 11+31.0/60),
+			"GGA position %d %d", Data.position.latitude, Data.position.longitude);
+	CHECK(abs(Data.position.altitude - 1789) <= 1, "GGA altitude %d ft", Data.position.altitude);
+	CHECK(strstr(Data.text, "balloon"), "GGA comment '%s'", Data.text);
+
+	CHECK(Parse("$GPGLL,4916.45,N,12311.12,W,225444,A,*1D") == APRS_DTI_RAW_GPS, "GLL");
+	CHECK(Near(Data.position.latitude, 49+16.45/60) && Near(Data.position.longitude, -(123+11.12/60)),
+			"GLL position %d %d", Data.position.latitude, Data.position.longitude);
+	CHECK(Data.time.hours == 22 && Data.time.minutes == 54 && Data.time.seconds == 44,
+			"GLL time %02d:%02d:%02d", Data.time.hours, Data.time.minutes, Data.time.seconds);
+
+	for (i=0 ; bad[i] ; i++)
+		CHECK(Parse(bad[i]) == -1, "'%s' accepted", bad[i]);
+}
+
+static void Test_Locator(void) {
+	static const char * bad[] = {
+		"[JN18DU",	// Not closed
+		"[JN1]",	// Odd length
+		"[JN]",		// Field only
+		"[SN18]",	// Field out of A-R
+		"[JNA8]",
+		"[JN18DZ]",	// Subsquare out of A-X
+		"[]",
+		NULL
+	};
+	int i;
+
+	CHECK(Parse("[JN18DU]") == APRS_DTI_MH_LOCATOR, "JN18DU");
+	CHECK(Near(Data.position.longitude, 2+17.5/60) && Near(Data.position.latitude, 48+51.25/60),
+			"JN18DU position %d %d", Data.position.latitude, Data.position.longitude);
+	CHECK(Data.position.ambiguity == APRS_AMBIGUITY_LOC_SUBSQUARE, "JN18DU ambiguity %d", Data.position.ambiguity);
+
+	CHECK(Parse("[io91wm] London") == APRS_DTI_MH_LOCATOR, "io91wm");
+	CHECK(Near(Data.position.longitude, -0.125) && Near(Data.position.latitude, 51+31.25/60),
+			"io91wm position %d %d", Data.position.latitude, Data.position.longitude);
+	CHECK(strstr(Data.text, "London"), "io91wm comment '%s'", Data.text);
+
+	CHECK(Parse("[JN18]") == APRS_DTI_MH_LOCATOR, "JN18");
+	CHECK(Near(Data.position.longitude, 3) && Near(Data.position.latitude, 48.5),
+			"JN18 position %d %d", Data.position.latitude, Data.position.longitude);
+	CHECK(Data.position.ambiguity == APRS_AMBIGUITY_LOC_SQUARE, "JN18 ambiguity %d", Data.position.ambiguity);
+
+	CHECK(Parse("[RR99XX]") == APRS_DTI_MH_LOCATOR, "RR99XX");
+	CHECK(Data.position.longitude < DEG(180) && Data.position.latitude < DEG(90),
+			"RR99XX position %d %d", Data.position.latitude, Data.position.longitude);
+
+	for (i=0 ; bad[i] ; i++)
+		CHECK(Parse(bad[i]) == -1, "'%s' accepted", bad[i]);
+}
+
+// Locator of a position contains that position
+static void Test_Locator_Round_Trip(void) {
+	static const double pos[][2] = {
+		{48.8566, 2.3522}, {51.5072, -0.1276}, {-33.8688, 151.2093},
+		{-54.8019, -68.3030}, {0.0001, -0.0001}, {89.99, 179.99},
+	};
+	struct APRS_Position in, out;
+	char grid[10];
+	int i, len;
+
+	for (i=0 ; i<sizeof(pos)/sizeof(pos[0]) ; i++) {
+		bzero(&in, sizeof(in));
+		in.latitude = DEG(pos[i][0]);
+		in.longitude = DEG(pos[i][1]);
+		len = APRS_Position_To_Locator(&in, grid, sizeof(grid));
+		CHECK(len == 8, "%f %f : length %d", pos[i][0], pos[i][1], len);
+		CHECK(APRS_Locator_To_Position(grid, len, &out) == len, "%s", grid);
+		// Extended square : 30" x 15"
+		CHECK(fabs(out.longitude - in.longitude) <= DEG(0.25/60) && fabs(out.latitude - in.latitude) <= DEG(0.125/60),
+				"%f %f : %s", pos[i][0], pos[i][1], grid);
+	}
+}
+
+int main(int argc, char ** argv) {
+	esp_log_level_set("*", ESP_LOG_NONE);
+
+	Frame = Test_Frame(256);
+
+	Test_Nmea();
+	Test_Locator();
+	Test_Locator_Round_Trip();
+
+	free(Frame);
+
+	return Test_Result("aprs_nmea_locator");
+}
@@ -0,0 +1,282 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/test_aprs_objects.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Objects and items : parsing, encode/parse round trip, and the object
+// table updates, kills and LRU eviction when full.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <esp_log.h>
+
+#include "aprs.h"
+#include "aprs_encoder.h"
+#include "aprs_parsers.h"
+#include "aprs_objects.h"
+#include "test.h"
+
+static Frame_t * Frame;
+static APRS_Data_t Data;
+
+static int Parse(const char * Src, const char * Info) {
+	bzero(&Data, sizeof(Data));
+	if (Test_Ui_Frame(Frame, Src, "APZ001", NULL, Info))
+		return -2;
+	return APRS_Parse(Frame, &Data);
+}
+
+static AX25_Addr_t Addr(const char * Str) {
+	AX25_Addr_t addr;
+
+	AX25_Str_To_Addr(Str, &addr);
+	return addr;
+}
+
+static void Init_Data(APRS_Data_t * Data, enum APRS_DTI_E Type, const char * Name, bool Killed) {
+	bzero(Data, sizeof(APRS_Data_t));
+	AX25_Str_To_Addr("APZ001", &Data->address[0]);
+	AX25_Str_To_Addr("F4JMZ-9", &Data->address[1]);
+	Data->address[1].ssid |= 1;
+	Data->type = Type;
+	strcpy(Data->object_name, Name);
+	Data->object_killed = Killed;
+	Data->symbol[0] = '/';
+	Data->symbol[1] = 'E';
+	Data->position.latitude = 49<<GPS_FIXED_POINT_DEG;
+	Data->position.longitude = -(72<<GPS_FIXED_POINT_DEG);
+}
+
+static void Test_Parse(void) {
+	CHECK(Parse("F4ABC", ";LEADER   *092345z4903.50N/07201.75W>088/036Net") == APRS_DTI_OBJECT, "object");
+	CHECK(!strcmp(Data.object_name, "LEADER") && !Data.object_killed, "object '%s' killed %d",
+			Data.object_name, Data.object_killed);
+	CHECK(Data.time.day == 9 && Data.time.hours == 23 && Data.time.minutes == 45 && !Data.time.local,
+			"time %02d%02d%02d", Data.time.day, Data.time.hours, Data.time.minutes);
+	CHECK(Data.position.latitude > (49<<GPS_FIXED_POINT_DEG) && Data.position.longitude < -(72<<GPS_FIXED_POINT_DEG),
+			"position %d %d", Data.position.latitude, Data.position.longitude);
+	CHECK(Data.symbol[0] == '/' && Data.symbol[1] == '>', "symbol %c%c", Data.symbol[0], Data.symbol[1]);
+	CHECK(Data.extension == APRS_DATA_EXT_CSE && Data.course.dir == 88 && Data.course.speed == 36,
+			"course %d/%d", Data.course.dir, Data.course.speed);
+	CHECK(!strcmp(Data.text, "Net"), "comment '%s'", Data.text);
+
+	// Full 9 chars name, killed
+	CHECK(Parse("F4ABC", ";WX-STN-01_092345z4903.50N/07201.75W_") == APRS_DTI_OBJECT, "killed object");
+	CHECK(!strcmp(Data.object_name, "WX-STN-01") && Data.object_killed, "object '%s' killed %d",
+			Data.object_name, Data.object_killed);
+
+	CHECK(Parse("F4ABC", ")AID #2!4903.50N/07201.75WA") == APRS_DTI_ITEM, "item");
+	CHECK(!strcmp(Data.object_name, "AID #2") && !Data.object_killed, "item '%s' killed %d",
+			Data.object_name, Data.object_killed);
+	CHECK(Data.symbol[0] == '/' && Data.symbol[1] == 'A', "symbol %c%c", Data.symbol[0], Data.symbol[1]);
+
+	CHECK(Parse("F4ABC", ")AID #2_4903.50N/07201.75WA") == APRS_DTI_ITEM, "killed item");
+	CHECK(!strcmp(Data.object_name, "AID #2") && Data.object_killed, "item '%s' killed %d",
+			Data.object_name, Data.object_killed);
+
+	// Malformed
+	CHECK(Parse("F4ABC", ")AB!4903.50N/07201.75WA") < 0, "2 chars item name");
+	CHECK(Parse("F4ABC", ")ITEMNAME10!4903.50N/07201.75WA") < 0, "10 chars item name");
+	CHECK(Parse("F4ABC", ";LEADER    092345z4903.50N/07201.75W>") < 0, "object without live flag");
+	CHECK(Parse("F4ABC", ";LEADER   *0923z4903.50N/07201.75W>") < 0, "short object timestamp");
+	CHECK(Parse("F4ABC", ";LEADER   *092345z") < 0, "object without position");
+}
+
+static void Test_Round_Trip(void) {
+	APRS_Data_t in, out;
+
+	Init_Data(&in, APRS_DTI_OBJECT, "EVENT", false);
+	in.time.day = 19;
+	in.time.hours = 8;
+	in.time.minutes = 30;
+	in.extension = APRS_DATA_EXT_CSE;
+	in.course.dir = 270;
+	in.course.speed = 12;
+	strcpy(in.text, "Field day");
+	CHECK(APRS_Encode(&in, Frame) > 0, "encode object");
+	CHECK(!memcmp(&Frame->frame[16], ";EVENT    *190830z", 18), "info '%.18s'", &Frame->frame[16]);
+	Frame->frame_len += 2;	// crc
+	CHECK(APRS_Parse(Frame, &out) == APRS_DTI_OBJECT, "parse object");
+	CHECK(!strcmp(out.object_name, "EVENT") && !out.object_killed, "object '%s' killed %d",
+			out.object_name, out.object_killed);
+	CHECK(out.time.day == 19 && out.time.hours == 8 && out.time.minutes == 30, "time %02d%02d%02d",
+			out.time.day, out.time.hours, out.time.minutes);
+	CHECK(out.position.latitude == in.position.latitude && out.position.longitude == in.position.longitude,
+			"position %d %d", out.position.latitude, out.position.longitude);
+	CHECK(out.symbol[0] == '/' && out.symbol[1] == 'E', "symbol %c%c", out.symbol[0], out.symbol[1]);
+	CHECK(out.course.dir == 270 && out.course.speed == 12, "course %d/%d", out.course.dir, out.course.speed);
+	CHECK(!strcmp(out.text, "Field day"), "comment '%s'", out.text);
+
+	Init_Data(&in, APRS_DTI_ITEM, "AID#2", true);
+	CHECK(APRS_Encode(&in, Frame) > 0, "encode item");
+	CHECK(!memcmp(&Frame->frame[16], ")AID#2_", 7), "info '%.7s'", &Frame->frame[16]);
+	Frame->frame_len += 2;
+	CHECK(APRS_Parse(Frame, &out) == APRS_DTI_ITEM, "parse item");
+	CHECK(!strcmp(out.object_name, "AID#2") && out.object_killed, "item '%s' killed %d",
+			out.object_name, out.object_killed);
+	CHECK(out.position.latitude == in.position.latitude && out.position.longitude == in.position.longitude,
+			"position %d %d", out.position.latitude, out.position.longitude);
+
+	// Names the parser couldn't read back
+	Init_Data(&in, APRS_DTI_ITEM, "AB", false);
+	CHECK(APRS_Encode(&in, Frame) < 0, "2 chars item name encoded");
+	Init_Data(&in, APRS_DTI_OBJECT, "NET*1", false);
+	CHECK(APRS_Encode(&in, Frame) < 0, "object name with '*' encoded");
+	Init_Data(&in, APRS_DTI_OBJECT, "", false);
+	CHECK(APRS_Encode(&in, Frame) < 0, "empty object name encoded");
+}
+
+// Same name from two originators, updates, kill and revive
+static void Test_Table(void) {
+	APRS_Objects_t * objects = APRS_Objects_Init(8);
+	AX25_Addr_t abc = Addr("F4ABC"), def = Addr("F4DEF-1");
+	APRS_Obj_t obj;
+
+	CHECK(objects, "init");
+	CHECK(APRS_Objects_Init(0) == NULL, "empty table");
+
+	Parse("F4ABC", ";LEADER   *092345z4903.50N/07201.75W>088/036Net");
+	Data.timestamp = 100;
+	CHECK(!APRS_Objects_Update(objects, &Data), "create");
+	Parse("F4DEF-1", ";LEADER   *092346z4904.00N/07202.00W>Other");
+	Data.timestamp = 101;
+	APRS_Objects_Update(objects, &Data);
+	CHECK(APRS_Objects_Count(objects) == 2, "%d objects", APRS_Objects_Count(objects));
+
+	CHECK(!APRS_Objects_Get(objects, "LEADER", &abc, &obj), "get F4ABC");
+	CHECK(obj.timestamp == 100 && !obj.killed && !obj.item && obj.course.dir == 88 && !strcmp(obj.comment, "Net"),
+			"F4ABC object %ld killed %d course %d '%s'", (long)obj.timestamp, obj.killed, obj.course.dir, obj.comment);
+	CHECK(!APRS_Objects_Get(objects, "LEADER", &def, &obj), "get F4DEF-1");
+	CHECK(obj.timestamp == 101 && !strcmp(obj.comment, "Other"), "F4DEF-1 object %ld '%s'",
+			(long)obj.timestamp, obj.comment);
+	CHECK(APRS_Objects_Get(objects, "FOLLOWER", &abc, &obj) == 1, "unknown name found");
+	abc = Addr("F4ABC-2");
+	CHECK(APRS_Objects_Get(objects, "LEADER", &abc, &obj) == 1, "other ssid found");
+	abc = Addr("F4ABC");
+
+	// Update moves and keeps one entry, course dropped when not reported
+	Parse("F4ABC", ";LEADER   *092350z4905.00N/07203.00W>Moved");
+	Data.timestamp = 110;
+	APRS_Objects_Update(objects, &Data);
+	APRS_Objects_Get(objects, "LEADER", &abc, &obj);
+	CHECK(APRS_Objects_Count(objects) == 2, "%d objects after update", APRS_Objects_Count(objects));
+	CHECK(obj.timestamp == 110 && !obj.course.dir && !strcmp(obj.comment, "Moved"),
+			"updated object %ld course %d '%s'", (long)obj.timestamp, obj.course.dir, obj.comment);
+
+	// Kill from one originator leaves the other live
+	Parse("F4ABC", ";LEADER   _092355z4905.00N/07203.00W>");
+	APRS_Objects_Update(objects, &Data);
+	APRS_Objects_Get(objects, "LEADER", &abc, &obj);
+	CHECK(obj.killed, "object not killed");
+	APRS_Objects_Get(objects, "LEADER", &def, &obj);
+	CHECK(!obj.killed, "other originator object killed");
+
+	// Kill of an unknown object adds nothing
+	Parse("F4ABC", ")GHOST_4903.50N/07201.75WA");
+	CHECK(!APRS_Objects_Update(objects, &Data), "unknown kill");
+	CHECK(APRS_Objects_Count(objects) == 2, "%d objects after unknown kill", APRS_Objects_Count(objects));
+
+	// Live report revives
+	Parse("F4ABC", ";LEADER   *100005z4905.00N/07203.00W>Back");
+	APRS_Objects_Update(objects, &Data);
+	APRS_Objects_Get(objects, "LEADER", &abc, &obj);
+	CHECK(!obj.killed && !strcmp(obj.comment, "Back"), "revived %d '%s'", obj.killed, obj.comment);
+
+	// Item
+	Parse("F4ABC", ")AID #2!4903.50N/07201.75WA");
+	APRS_Objects_Update(objects, &Data);
+	CHECK(!APRS_Objects_Get(objects, "AID #2", &abc, &obj) && obj.item, "item");
+
+	// Not an object
+	Parse("F4ABC", "!4903.50N/07201.75W-Test");
+	CHECK(APRS_Objects_Update(objects, &Data) == -1, "position report updated table");
+
+	free(objects);
+}
+
+// Full table : least recently updated object expires first,
+// and Get_Nth walks (name, originator) order
+static void Test_Evict(void) {
+	static const char * names[] = {"DELTA", "ALPHA", "CHARLIE", "BRAVO", "ECHO"};
+	static const char * order[] = {"BRAVO", "CHARLIE", "DELTA", "ECHO"};
+	APRS_Objects_t * objects = APRS_Objects_Init(4);
+	AX25_Addr_t abc = Addr("F4ABC");
+	APRS_Obj_t obj;
+	int i;
+
+	for (i=0 ; i<4 ; i++) {
+		Init_Data(&Data, APRS_DTI_OBJECT, names[i], false);
+		Data.address[1] = abc;
+		Data.timestamp = i;
+		APRS_Objects_Update(objects, &Data);
+	}
+
+	// Refresh DELTA, ALPHA is now the oldest
+	Init_Data(&Data, APRS_DTI_OBJECT, "DELTA", false);
+	Data.address[1] = abc;
+	Data.timestamp = 10;
+	APRS_Objects_Update(objects, &Data);
+
+	Init_Data(&Data, APRS_DTI_OBJECT, names[4], false);
+	Data.address[1] = abc;
+	Data.timestamp = 11;
+	APRS_Objects_Update(objects, &Data);
+
+	CHECK(APRS_Objects_Count(objects) == 4, "%d objects", APRS_Objects_Count(objects));
+	CHECK(APRS_Objects_Get(objects, "ALPHA", &abc, &obj) == 1, "oldest object not evicted");
+	CHECK(!APRS_Objects_Get(objects, "DELTA", &abc, &obj) && obj.timestamp == 10, "refreshed object evicted");
+	CHECK(!APRS_Objects_Get(objects, "ECHO", &abc, &obj), "new object missing");
+
+	for (i=0 ; i<4 ; i++)
+		CHECK(!APRS_Objects_Get_Nth(objects, i, &obj) && !strcmp(obj.name, order[i]),
+				"object %d : %s", i, obj.name);
+	CHECK(APRS_Objects_Get_Nth(objects, 4, &obj) == 1, "object past the end");
+
+	// Next two evictions in update order
+	for (i=0 ; i<2 ; i++) {
+		Init_Data(&Data, APRS_DTI_ITEM, i?"ZULU":"YANKEE", false);
+		Data.address[1] = abc;
+		APRS_Objects_Update(objects, &Data);
+	}
+	CHECK(APRS_Objects_Get(objects, "CHARLIE", &abc, &obj) == 1 && APRS_Objects_Get(objects, "BRAVO", &abc, &obj) == 1,
+			"evicted out of update order");
+	CHECK(!APRS_Objects_Get(objects, "DELTA", &abc, &obj) && !APRS_Objects_Get(objects, "ECHO", &abc, &obj),
+			"recent objects evicted");
+
+	free(objects);
+}
+
+int main(int argc, char ** argv) {
+	esp_log_level_set("*", ESP_LOG_NONE);
+
+	Frame = Test_Frame(512);
+
+	Test_Parse();
+	Test_Round_Trip();
+	Test_Table();
+	Test_Evict();
+
+	free(Frame);
+
+	return Test_Result("aprs_objects");
+}
@@ -0,0 +1,203 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/test_aprs_query.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Query responder : reply types, jitter, merging and per-requester rate
+// limit, on a stub clock.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <esp_log.h>
+
+#include "aprs_query.h"
+#include "test.h"
+
+#define MAX_SENT	32
+
+static time_t Now;
+static struct {
+	enum APRS_Query_Reply_E reply;
+	AX25_Addr_t to;
+	char text[68];
+} Sent[MAX_SENT];
+static int N_Sent;
+
+static time_t Clock(void * Ctx) {
+	return Now;
+}
+
+static int Send(void * Ctx, enum APRS_Query_Reply_E Reply, const AX25_Addr_t * Requester, const char * Text) {
+	if (N_Sent < MAX_SENT) {
+		Sent[N_Sent].reply = Reply;
+		Sent[N_Sent].to = *Requester;
+		strncpy(Sent[N_Sent].text, Text, sizeof(Sent[N_Sent].text)-1);
+	}
+	N_Sent++;
+	return 0;
+}
+
+static APRS_Query_t * Reset(uint32_t Seed) {
+	Now = 1000;
+	N_Sent = 0;
+	return APRS_Query_Init(Clock, Send, NULL, Seed);
+}
+
+static AX25_Addr_t Addr(const char * Str) {
+	AX25_Addr_t addr;
+
+	AX25_Str_To_Addr(Str, &addr);
+	return addr;
+}
+
+// Run replies due in the next Secs seconds
+static void Run(APRS_Query_t * Query, int Secs) {
+	time_t end = Now + Secs;
+	int wait;
+
+	while ((wait = APRS_Query_Process(Query)) >= 0 && Now + wait <= end)
+		Now += wait;
+	Now = end;
+}
+
+static void Test_Reply_Type(void) {
+	CHECK(APRS_Query_Reply_Type("?APRS?", false) == APRS_QUERY_REPLY_POSITION, "?APRS?");
+	CHECK(APRS_Query_Reply_Type("WX?", false) == APRS_QUERY_REPLY_POSITION, "WX?");
+	CHECK(APRS_Query_Reply_Type("IGATE", false) == APRS_QUERY_REPLY_CAPABILITIES, "IGATE");
+	CHECK(APRS_Query_Reply_Type("?ping?", false) == APRS_QUERY_REPLY_TRACE, "?ping?");
+	CHECK(APRS_Query_Reply_Type("APRSP", true) == APRS_QUERY_REPLY_POSITION, "APRSP");
+	CHECK(APRS_Query_Reply_Type("?aprss", true) == APRS_QUERY_REPLY_STATUS, "?aprss");
+	CHECK(APRS_Query_Reply_Type("APRST", true) == APRS_QUERY_REPLY_TRACE, "APRST");
+	CHECK(APRS_Query_Reply_Type("APRSP", false) == -1, "general APRSP");
+	CHECK(APRS_Query_Reply_Type("APRS", true) == -1, "directed APRS");
+	CHECK(APRS_Query_Reply_Type("APRSPX", true) == -1, "APRSPX");
+	CHECK(APRS_Query_Reply_Type("", false) == -1, "empty");
+	CHECK(APRS_Query_Reply_Type(NULL, false) == -1, "NULL");
+}
+
+// Replies delayed by MIN_JITTER to MAX_JITTER seconds
+static void Test_Jitter(void) {
+	APRS_Query_t * query;
+	AX25_Addr_t from = Addr("F4ABC-7");
+	int seed, wait, min = APRS_QUERY_MAX_JITTER, max = 0;
+
+	for (seed=1 ; seed<200 ; seed++) {
+		query = Reset(seed*2654435761u);
+		CHECK(APRS_Query_Request(query, APRS_QUERY_REPLY_TRACE, &from, "F4ABC-7>APRS,WIDE1-1*") == 0, "request");
+		wait = APRS_Query_Process(query);
+		CHECK(wait >= APRS_QUERY_MIN_JITTER && wait <= APRS_QUERY_MAX_JITTER, "seed %d : wait %d", seed, wait);
+		if (wait < min)
+			min = wait;
+		if (wait > max)
+			max = wait;
+
+		Now += wait-1;
+		APRS_Query_Process(query);
+		CHECK(N_Sent == 0, "seed %d : sent early", seed);
+		Now++;
+		CHECK(APRS_Query_Process(query) == -1, "seed %d : still pending", seed);
+		CHECK(N_Sent == 1 && Sent[0].reply == APRS_QUERY_REPLY_TRACE && !AX25_Addr_Cmp(&Sent[0].to, &from)
+				&& !strcmp(Sent[0].text, "F4ABC-7>APRS,WIDE1-1*"), "seed %d : reply", seed);
+		free(query);
+	}
+	CHECK(max - min > (APRS_QUERY_MAX_JITTER - APRS_QUERY_MIN_JITTER)/2, "jitter spread %d-%d", min, max);
+}
+
+// One reply of a kind per requester every MIN_INTERVAL
+static void Test_Rate_Limit(void) {
+	APRS_Query_t * query = Reset(1);
+	AX25_Addr_t a = Addr("F4ABC"), b = Addr("F4DEF");
+
+	CHECK(APRS_Query_Request(query, APRS_QUERY_REPLY_POSITION, &a, NULL) == 0, "first");
+	Run(query, APRS_QUERY_MAX_JITTER);
+	CHECK(N_Sent == 1, "%d sent", N_Sent);
+
+	Now += 10;
+	CHECK(APRS_Query_Request(query, APRS_QUERY_REPLY_POSITION, &a, NULL) == 1, "repeat not limited");
+	CHECK(APRS_Query_Request(query, APRS_QUERY_REPLY_STATUS, &a, NULL) == 0, "other kind limited");
+	CHECK(APRS_Query_Request(query, APRS_QUERY_REPLY_POSITION, &b, NULL) == 0, "other requester limited");
+	Run(query, APRS_QUERY_MAX_JITTER);
+	CHECK(N_Sent == 3, "%d sent", N_Sent);
+
+	Now = 1000 + APRS_QUERY_MIN_INTERVAL - 1;
+	CHECK(APRS_Query_Request(query, APRS_QUERY_REPLY_POSITION, &a, NULL) == 1, "limited until interval");
+	Now++;
+	CHECK(APRS_Query_Request(query, APRS_QUERY_REPLY_POSITION, &a, NULL) == 0, "limited after interval");
+
+	free(query);
+}
+
+// Broadcast replies are merged, traces are not
+static void Test_Merge(void) {
+	APRS_Query_t * query = Reset(1);
+	AX25_Addr_t a = Addr("F4ABC"), b = Addr("F4DEF"), c = Addr("F4GHI"), d = Addr("F4JKL"), e = Addr("F4MNO");
+
+	CHECK(APRS_Query_Request(query, APRS_QUERY_REPLY_POSITION, &a, NULL) == 0, "position a");
+	CHECK(APRS_Query_Request(query, APRS_QUERY_REPLY_POSITION, &b, NULL) == 1, "position b not merged");
+	CHECK(APRS_Query_Request(query, APRS_QUERY_REPLY_TRACE, &a, "a") == 0, "trace a");
+	CHECK(APRS_Query_Request(query, APRS_QUERY_REPLY_TRACE, &b, "b") == 0, "trace b");
+	CHECK(APRS_Query_Request(query, APRS_QUERY_REPLY_TRACE, &c, "c") == 0, "trace c");
+	CHECK(APRS_Query_Request(query, APRS_QUERY_REPLY_TRACE, &d, "d") == -1, "pending table overflow");
+	Run(query, APRS_QUERY_MAX_JITTER);
+	CHECK(N_Sent == 4, "%d sent", N_Sent);
+
+	// Merged requester was rate limited too
+	Now += 10;
+	CHECK(APRS_Query_Request(query, APRS_QUERY_REPLY_POSITION, &b, NULL) == 1, "merged requester not limited");
+	CHECK(APRS_Query_Request(query, APRS_QUERY_REPLY_TRACE, &e, "e") == 0, "trace e");
+
+	free(query);
+}
+
+// Requester table full : oldest entry is forgotten
+static void Test_Eviction(void) {
+	APRS_Query_t * query = Reset(1);
+	AX25_Addr_t from[APRS_QUERY_MAX_REQ+1];
+	char call[10];
+	int i;
+
+	for (i=0 ; i<=APRS_QUERY_MAX_REQ ; i++) {
+		snprintf(call, sizeof(call), "F4AA%c", 'A'+i);
+		from[i] = Addr(call);
+		CHECK(APRS_Query_Request(query, APRS_QUERY_REPLY_TRACE, &from[i], call) == 0, "%s", call);
+		Run(query, APRS_QUERY_MAX_JITTER+1);
+	}
+	CHECK(N_Sent == APRS_QUERY_MAX_REQ+1, "%d sent", N_Sent);
+	CHECK(Now - 1000 < APRS_QUERY_MIN_INTERVAL, "test too long");
+
+	CHECK(APRS_Query_Request(query, APRS_QUERY_REPLY_TRACE, &from[1], "") == 1, "second requester forgotten");
+	CHECK(APRS_Query_Request(query, APRS_QUERY_REPLY_TRACE, &from[0], "") == 0, "oldest requester remembered");
+
+	free(query);
+}
+
+int main(int argc, char ** argv) {
+	esp_log_level_set("*", ESP_LOG_NONE);
+
+	Test_Reply_Type();
+	Test_Jitter();
+	Test_Rate_Limit();
+	Test_Merge();
+	Test_Eviction();
+
+	return Test_Result("aprs_query");
+}
@@ -0,0 +1,210 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/test_aprs_telemetry.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Telemetry : "T#" reports encoded then parsed back, and PARM/UNIT/EQNS/BITS
+// definition messages encoded, parsed and applied to the station table.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <esp_log.h>
+
+#include "aprs.h"
+#include "aprs_encoder.h"
+#include "aprs_parsers.h"
+#include "aprs_telemetry.h"
+#include "test.h"
+
+#define CALL	"F4ABC-11"
+
+static Frame_t * Frame;
+
+static void Init_Data(APRS_Data_t * Data, enum APRS_DTI_E Type) {
+	bzero(Data, sizeof(APRS_Data_t));
+	AX25_Str_To_Addr("APZ001", &Data->address[0]);
+	AX25_Str_To_Addr(CALL, &Data->address[1]);
+	Data->address[1].ssid |= 1;
+	Data->type = Type;
+}
+
+static int Encode_Parse(APRS_Data_t * In, APRS_Data_t * Out) {
+	if (APRS_Encode(In, Frame) < 0)
+		return -1;
+	Frame->frame_len += 2;	// crc
+	return APRS_Parse(Frame, Out);
+}
+
+// Definition message sent to itself, parsed back and applied
+static int Define(APRS_Telemetries_t * Tlms, const char * Text, time_t Timestamp) {
+	APRS_Data_t in, out;
+
+	Init_Data(&in, APRS_DTI_MESSAGE);
+	in.message.type = APRS_MSG_TYPE_MESSAGE;
+	strcpy(in.message.addressee, CALL);
+	strcpy(in.message.text, Text);
+	if (Encode_Parse(&in, &out) != APRS_DTI_MESSAGE)
+		return -2;
+	CHECK(out.message.type == APRS_MSG_TYPE_MESSAGE && !strcmp(out.message.text, Text),
+			"message '%s'", out.message.text);
+	out.timestamp = Timestamp;
+
+	return APRS_Telemetry_Define(Tlms, out.message.addressee, out.message.text, out.timestamp);
+}
+
+static void Test_Report(void) {
+	static const struct {
+		int16_t seq;
+		uint8_t n_analog;
+		float analog[APRS_TLM_ANALOG];
+		bool has_bits;
+		uint8_t bits;
+		const char * info;
+	} reports[] = {
+		{5, 5, {199, 0, 255, 73, 123}, true, 0x69, "T#005,199,0,255,73,123,01101001"},
+		{-1, 5, {1.5, -2.25, 1000, 0.125, 42}, true, 0x80, "T#MIC,1.5,-2.25,1000,0.125,42,10000000"},
+		{999, 3, {10, 20, 30}, false, 0, "T#999,10,20,30"},
+		{12, 5, {7, 0, 0, 0, 0}, true, 0x01, "T#012,7,,,,,00000001"},	// Empty fields kept positional
+		{1234, 1, {3}, false, 0, "T#234,3"},	// Sequence modulo 1000
+	};
+	APRS_Data_t in, out;
+	int i, j;
+
+	for (i=0 ; i<sizeof(reports)/sizeof(reports[0]) ; i++) {
+		Init_Data(&in, APRS_DTI_TELEMETRIE);
+		in.telemetry.seq = reports[i].seq;
+		in.telemetry.n_analog = reports[i].n_analog;
+		memcpy(in.telemetry.analog, reports[i].analog, sizeof(in.telemetry.analog));
+		in.telemetry.has_bits = reports[i].has_bits;
+		in.telemetry.bits = reports[i].bits;
+		if (i == 3)	// Only the first value, bits after the empty fields
+			in.telemetry.n_analog = 1;
+
+		CHECK(Encode_Parse(&in, &out) == APRS_DTI_TELEMETRIE, "report %d : not parsed", i);
+		CHECK(!memcmp(&Frame->frame[16], reports[i].info, strlen(reports[i].info)),
+				"report %d : info '%.*s'", i, (int)strlen(reports[i].info), &Frame->frame[16]);
+		CHECK(out.telemetry.seq == reports[i].seq % 1000, "report %d : seq %d", i, out.telemetry.seq);
+		CHECK(out.telemetry.n_analog == reports[i].n_analog, "report %d : %d analog", i, out.telemetry.n_analog);
+		for (j=0 ; j<reports[i].n_analog ; j++)
+			CHECK(out.telemetry.analog[j] == reports[i].analog[j], "report %d : analog %d %g",
+					i, j, out.telemetry.analog[j]);
+		CHECK(out.telemetry.has_bits == reports[i].has_bits && out.telemetry.bits == reports[i].bits,
+				"report %d : bits %d %02x", i, out.telemetry.has_bits, out.telemetry.bits);
+	}
+}
+
+static void Test_Definitions(void) {
+	APRS_Telemetries_t * tlms = APRS_Telemetry_Init(2);
+	AX25_Addr_t call;
+	APRS_Data_t in;
+	APRS_Tlm_t tlm;
+	int i;
+
+	AX25_Str_To_Addr(CALL, &call);
+
+	CHECK(!Define(tlms, "PARM.Vbat,Temp,Light,Wind,Rain,Door,Alarm,Heat,Fan,Pump,Aux,B7,B8", 100), "PARM");
+	CHECK(!Define(tlms, "UNIT.Volts,deg.C,lux,m/s,mm,open,on,on,on,on,on,on,on", 100), "UNIT");
+	CHECK(!Define(tlms, "EQNS.0,0.075,0,0,0.5,-40,0,1,0,0,0.1,0,0,0.001,0", 100), "EQNS");
+	CHECK(!Define(tlms, "BITS.10110000,Weather station", 100), "BITS");
+	CHECK(Define(tlms, "Hello there", 100) == 1, "plain message taken as definition");
+	CHECK(Define(tlms, "BITS.1O110000", 100) == -1, "malformed BITS accepted");
+
+	CHECK(!APRS_Telemetry_Get(tlms, &call, &tlm), "station not in table");
+	CHECK(!strcmp(tlm.parm[0], "Vbat") && !strcmp(tlm.parm[4], "Rain") && !strcmp(tlm.parm[5], "Door")
+			&& !strcmp(tlm.parm[12], "B8"), "PARM %s,%s,%s,%s", tlm.parm[0], tlm.parm[4], tlm.parm[5], tlm.parm[12]);
+	CHECK(!strcmp(tlm.unit[0], "Volts") && !strcmp(tlm.unit[1], "deg.C") && !strcmp(tlm.unit[5], "open"),
+			"UNIT %s,%s,%s", tlm.unit[0], tlm.unit[1], tlm.unit[5]);
+	CHECK(tlm.eqns[0][1] == 0.075f && tlm.eqns[1][2] == -40 && tlm.eqns[4][1] == 0.001f,
+			"EQNS %g %g %g", tlm.eqns[0][1], tlm.eqns[1][2], tlm.eqns[4][1]);
+	CHECK(tlm.bits_sense == 0xb0 && !strcmp(tlm.project, "Weather station"), "BITS %02x '%s'",
+			tlm.bits_sense, tlm.project);
+
+	// Reports encoded then parsed into the ring, scaled with EQNS
+	for (i=0 ; i<APRS_TLM_RING+2 ; i++) {
+		APRS_Data_t out;
+
+		Init_Data(&in, APRS_DTI_TELEMETRIE);
+		in.telemetry.seq = i;
+		in.telemetry.n_analog = 5;
+		in.telemetry.analog[0] = 160 + i;
+		in.telemetry.analog[1] = 120;
+		in.telemetry.analog[4] = 500;
+		in.telemetry.has_bits = true;
+		in.telemetry.bits = i;
+		CHECK(Encode_Parse(&in, &out) == APRS_DTI_TELEMETRIE, "report %d", i);
+		out.timestamp = 200 + i;
+		CHECK(!APRS_Telemetry_Update(tlms, &out), "update %d", i);
+	}
+
+	APRS_Telemetry_Get(tlms, &call, &tlm);
+	CHECK(tlm.count == APRS_TLM_RING && tlm.timestamp == 200 + APRS_TLM_RING+1, "%d points, last %ld",
+			tlm.count, (long)tlm.timestamp);
+	i = (tlm.head + APRS_TLM_RING-1) % APRS_TLM_RING;	// Newest
+	CHECK(tlm.ring[i].seq == APRS_TLM_RING+1 && tlm.ring[i].bits == APRS_TLM_RING+1, "newest seq %d bits %02x",
+			tlm.ring[i].seq, tlm.ring[i].bits);
+	CHECK(tlm.ring[tlm.head].seq == 2, "oldest seq %d", tlm.ring[tlm.head].seq);
+	CHECK(fabsf(APRS_Telemetry_Scale(&tlm, 0, tlm.ring[i].analog[0]) - 0.075f*169) < 1e-4,
+			"battery %g V", APRS_Telemetry_Scale(&tlm, 0, tlm.ring[i].analog[0]));
+	CHECK(APRS_Telemetry_Scale(&tlm, 1, tlm.ring[i].analog[1]) == 20, "temperature %g",
+			APRS_Telemetry_Scale(&tlm, 1, tlm.ring[i].analog[1]));
+	CHECK(APRS_Telemetry_Scale(&tlm, 4, tlm.ring[i].analog[4]) == 0.5f, "rain %g",
+			APRS_Telemetry_Scale(&tlm, 4, tlm.ring[i].analog[4]));
+	CHECK(APRS_Telemetry_Scale(&tlm, 5, 3) == 3, "no equation for bits");
+
+	// Redefinition replaces the labels
+	Define(tlms, "PARM.Battery", 300);
+	APRS_Telemetry_Get(tlms, &call, &tlm);
+	CHECK(!strcmp(tlm.parm[0], "Battery") && !tlm.parm[1][0], "PARM redefined %s,%s", tlm.parm[0], tlm.parm[1]);
+
+	// Full table reuses the oldest station, defaults for a new one
+	Init_Data(&in, APRS_DTI_TELEMETRIE);
+	AX25_Str_To_Addr("F4DEF", &in.address[1]);
+	in.address[1].ssid |= 1;
+	in.timestamp = 400;
+	APRS_Telemetry_Update(tlms, &in);
+	AX25_Str_To_Addr("F4GHI", &in.address[1]);
+	in.address[1].ssid |= 1;
+	in.timestamp = 401;
+	APRS_Telemetry_Update(tlms, &in);
+	CHECK(APRS_Telemetry_Get(tlms, &call, &tlm) == -1, "oldest station kept");
+	AX25_Str_To_Addr("F4GHI", &call);
+	CHECK(!APRS_Telemetry_Get(tlms, &call, &tlm), "new station missing");
+	CHECK(tlm.count == 1 && tlm.bits_sense == 0xff && tlm.eqns[2][1] == 1 && !tlm.parm[0][0],
+			"new station %d points, bits %02x", tlm.count, tlm.bits_sense);
+
+	free(tlms);
+}
+
+int main(int argc, char ** argv) {
+	esp_log_level_set("*", ESP_LOG_NONE);
+
+	Frame = Test_Frame(512);
+
+	Test_Report();
+	Test_Definitions();
+
+	free(Frame);
+
+	return Test_Result("aprs_telemetry");
+}
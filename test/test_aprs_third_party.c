@@ -0,0 +1,149 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/test_aprs_third_party.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Third-party frames : nested headers unwrapped up to APRS_MAX_THIRD_PARTY,
+// malformed headers rejected.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <esp_log.h>
+
+#include "aprs.h"
+#include "aprs_parsers.h"
+#include "test.h"
+
+static Frame_t * Frame;
+static APRS_Data_t Data;
+
+static int Parse(const char * Info) {
+	if (Test_Ui_Frame(Frame, "F4GW-10", "APZ001", NULL, Info))
+		return -2;
+	return APRS_Parse(Frame, &Data);
+}
+
+static const char * Addr_Str(const AX25_Addr_t * Addr) {
+	static char str[4][12];
+	static int n;
+
+	n = (n+1)%4;
+	AX25_Addr_To_Str(Addr, str[n], sizeof(str[n]));
+	return str[n];
+}
+
+static void Test_Single(void) {
+	CHECK(Parse("}F4ABC-5>APRS,TCPIP,F4IG*:!4903.50N/07201.75W-Test") == APRS_DTI_POS, "position");
+	CHECK(Data.third_party == 1, "third_party %d", Data.third_party);
+	CHECK(!strcmp(Addr_Str(&Data.gateway), "F4GW-10"), "gateway %s", Addr_Str(&Data.gateway));
+	CHECK(!strcmp(Addr_Str(&Data.address[1]), "F4ABC-5"), "source %s", Addr_Str(&Data.address[1]));
+	CHECK(!strcmp(Addr_Str(&Data.address[0]), "APRS"), "destination %s", Addr_Str(&Data.address[0]));
+	CHECK(!strcmp(Addr_Str(&Data.address[2]), "TCPIP"), "path %s", Addr_Str(&Data.address[2]));
+	CHECK(Data.from == 3 && (Data.address[3].ssid & 0x80), "heard from %d", Data.from);
+	CHECK(Data.address[3].ssid & 1, "last address not marked");
+	CHECK(Data.position.latitude > (49<<GPS_FIXED_POINT_DEG) && Data.position.longitude < -(72<<GPS_FIXED_POINT_DEG),
+			"position %d %d", Data.position.latitude, Data.position.longitude);
+	CHECK(!strcmp(Data.text, "Test"), "comment '%s'", Data.text);
+
+	// Message payload, ':' after the header belong to the payload
+	CHECK(Parse("}F4ABC>APRS,WIDE1-1::F4JMZ-9  :hello{01") == APRS_DTI_MESSAGE, "message");
+	CHECK(!strcmp(Data.message.addressee, "F4JMZ-9") && !strcmp(Data.message.text, "hello")
+			&& !strcmp(Data.message.id, "01"), "message %s '%s' {%s}", Data.message.addressee,
+			Data.message.text, Data.message.id);
+
+	// Non AX25 path elements dropped
+	CHECK(Parse("}F4ABC>APRS,T2FRANCE,qAC,F4IG:>status") == APRS_DTI_STATUS, "long path element");
+	CHECK(!strcmp(Addr_Str(&Data.address[2]), "QAC") && !strcmp(Addr_Str(&Data.address[3]), "F4IG")
+			&& (Data.address[3].ssid & 1), "path %s,%s", Addr_Str(&Data.address[2]), Addr_Str(&Data.address[3]));
+
+	// Path longer than APRS_MAX_DIGI truncated
+	CHECK(Parse("}F4ABC>APRS,A1,A2,A3,A4,A5,A6,A7,A8,A9,A10:>status") == APRS_DTI_STATUS, "long path");
+	CHECK(!strcmp(Addr_Str(&Data.address[1+APRS_MAX_DIGI]), "A8") && (Data.address[1+APRS_MAX_DIGI].ssid & 1),
+			"last digi %s", Addr_Str(&Data.address[1+APRS_MAX_DIGI]));
+}
+
+static void Test_Nested(void) {
+	CHECK(Parse("}F4IG>APRS,TCPIP:}F4ABC>APZ002,WIDE2-2:>nested") == APRS_DTI_STATUS, "two headers");
+	CHECK(Data.third_party == 2, "third_party %d", Data.third_party);
+	CHECK(!strcmp(Addr_Str(&Data.address[1]), "F4ABC"), "innermost source %s", Addr_Str(&Data.address[1]));
+	CHECK(!strcmp(Addr_Str(&Data.address[0]), "APZ002"), "innermost destination %s", Addr_Str(&Data.address[0]));
+	CHECK(!strcmp(Addr_Str(&Data.gateway), "F4GW-10"), "gateway %s", Addr_Str(&Data.gateway));
+	CHECK(!strcmp(Data.text, "nested"), "status '%s'", Data.text);
+
+	CHECK(Parse("}A>APRS:}B>APRS:}C>APRS:>deep") == APRS_DTI_STATUS, "%d headers", APRS_MAX_THIRD_PARTY);
+	CHECK(Data.third_party == APRS_MAX_THIRD_PARTY && !strcmp(Addr_Str(&Data.address[1]), "C"),
+			"third_party %d from %s", Data.third_party, Addr_Str(&Data.address[1]));
+
+	CHECK(Parse("}A>APRS:}B>APRS:}C>APRS:}D>APRS:>deep") == -1, "too deeply nested");
+}
+
+static void Test_Malformed(void) {
+	static const char * bad[] = {
+		"}F4ABC>APRS",			// No payload
+		"}F4ABC>APRS:",			// Empty payload
+		"}F4ABC>APRS:}",		// Empty nested header
+		"}F4ABC>APRS:}F4DEF>APRS",	// Nested without payload
+		"}F4ABC:>status",		// No destination
+		"}>APRS:>status",		// No source
+		"}F4ABC>:>status",		// Empty destination
+		"}F4ABCDEF>APRS:>status",	// Source too long
+		"}F4ABC-16>APRS:>status",	// Bad ssid
+		"}F4ABC-X>APRS:>status",
+		"}F4ABC->APRS:>status",
+		"}F4.BC>APRS:>status",
+		"}F4ABC>AP.RS:>status",		// Bad destination
+		"}F4ABC>APRS:!garbage",		// Bad payload
+		"}F4ABC>APRS:}F4DEF>APRS:!99",
+		"}:>status",
+		"}",
+		NULL
+	};
+	int i;
+
+	for (i=0 ; bad[i] ; i++)
+		CHECK(Parse(bad[i]) == -1, "'%s' accepted", bad[i]);
+}
+
+// APRS_MAX_DIGI digipeaters accepted, one more rejected
+static void Test_Max_Digi(void) {
+	static const char * digis[] = {"D1", "D2", "D3", "D4", "D5", "D6", "D7", "D8", "D9", NULL};
+
+	Test_Ui_Frame(Frame, "F4ABC", "APRS", digis+1, ">status");
+	CHECK(APRS_Parse(Frame, &Data) == APRS_DTI_STATUS, "%d digis rejected", APRS_MAX_DIGI);
+	Test_Ui_Frame(Frame, "F4ABC", "APRS", digis, ">status");
+	CHECK(APRS_Parse(Frame, &Data) == -1, "%d digis accepted", APRS_MAX_DIGI+1);
+}
+
+int main(int argc, char ** argv) {
+	esp_log_level_set("*", ESP_LOG_NONE);
+
+	Frame = Test_Frame(512);
+
+	Test_Single();
+	Test_Nested();
+	Test_Malformed();
+	Test_Max_Digi();
+
+	free(Frame);
+
+	return Test_Result("aprs_third_party");
+}
@@ -0,0 +1,138 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/test_aprs_weather.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Weather reports : corpus lines and the fields they must decode to,
+// positionless, uncompressed and compressed position with weather symbol.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <esp_log.h>
+
+#include "aprs.h"
+#include "aprs_parsers.h"
+#include "test.h"
+
+#define WX(Field)	(1<<APRS_WX_##Field)
+#define WX_ALL		(WX(WIND_DIR)|WX(WIND_SPEED)|WX(GUST)|WX(TEMP)|WX(RAIN_1H)|WX(RAIN_24H)|WX(RAIN_MIDNIGHT)|WX(HUMIDITY)|WX(PRESSURE))
+
+static const struct {
+	const char * info;
+	int type;		// Expected APRS_Parse result
+	struct APRS_Weather wx;	// Expected fields, only those in valid are checked
+} Reports[] = {
+	// Seeds in test/corpus/aprs_parse
+	{"_10090556c220s004g005t077r000p000P000h50b09900wRSW", APRS_DTI_WEATHER,
+		{.wind_dir = 220, .wind_speed = 4, .gust = 5, .temp = 77, .humidity = 50, .pressure = 9900, .valid = WX_ALL}},
+	{"_10090556c...s...g...t077", APRS_DTI_WEATHER,
+		{.temp = 77, .valid = WX(TEMP)}},
+	{"!4903.50N/07201.75W_220/004g005t077r000p000P000h50b09900wRSW", APRS_DTI_POS,
+		{.wind_dir = 220, .wind_speed = 4, .gust = 5, .temp = 77, .humidity = 50, .pressure = 9900, .valid = WX_ALL}},
+
+	// Negative temperature, "h00" is 100%, luminosity below 1000
+	{"_10090556c090s010g015t-05r012p034P056h00b10132L456", APRS_DTI_WEATHER,
+		{.wind_dir = 90, .wind_speed = 10, .gust = 15, .temp = -5, .rain_last_1h = 12, .rain_last_24h = 34,
+		 .rain_since_midnight = 56, .humidity = 100, .pressure = 10132, .luminosity = 456, .valid = WX_ALL|WX(LUMINOSITY)}},
+	// Luminosity above 1000
+	{"_10090556c...s...t050l123", APRS_DTI_WEATHER,
+		{.temp = 50, .luminosity = 1123, .valid = WX(TEMP)|WX(LUMINOSITY)}},
+	// After a position 's' is snowfall, rain counter
+	{"=4903.50N/07201.75W_090/010s002#123t030", APRS_DTI_POS_W_MSG,
+		{.wind_dir = 90, .wind_speed = 10, .snow_fall = 2, .rain_counter = 123, .temp = 30,
+		 .valid = WX(WIND_DIR)|WX(WIND_SPEED)|WX(SNOW)|WX(RAIN_COUNTER)|WX(TEMP)}},
+	// Unknown wind, space filled gust
+	{"!4903.50N/07201.75W_.../...g   t077", APRS_DTI_POS,
+		{.temp = 77, .valid = WX(TEMP)}},
+	// Timestamped position, weather fields stop at the software type
+	{"@092345z4903.50N/07201.75W_180/020g030t068h85b10200eMB51", APRS_DTI_POS_W_TS_W_MSG,
+		{.wind_dir = 180, .wind_speed = 20, .gust = 30, .temp = 68, .humidity = 85, .pressure = 10200,
+		 .valid = WX(WIND_DIR)|WX(WIND_SPEED)|WX(GUST)|WX(TEMP)|WX(HUMIDITY)|WX(PRESSURE)}},
+	// Compressed : cs is wind direction (88°) and speed (36 kt = 41 mph)
+	{"!/5L!!<*e7_7P[g005t077", APRS_DTI_POS,
+		{.wind_dir = 88, .wind_speed = 41, .gust = 5, .temp = 77,
+		 .valid = WX(WIND_DIR)|WX(WIND_SPEED)|WX(GUST)|WX(TEMP)}},
+	// Not a weather symbol : course/speed, no weather
+	{"!4903.50N/07201.75W>220/004g005t077", APRS_DTI_POS,
+		{.valid = 0}},
+	// Malformed
+	{"_1009055c220s004", -1},
+	{"_10090556c2x0s004t077", APRS_DTI_WEATHER,
+		{.valid = 0}},
+};
+
+static Frame_t * Frame;
+
+static int Parse(const char * Info, APRS_Data_t * Data) {
+	bzero(Data, sizeof(APRS_Data_t));
+	if (Test_Ui_Frame(Frame, "F4WX-13", "APZ001", NULL, Info))
+		return -2;
+	return APRS_Parse(Frame, Data);
+}
+
+#define CHECK_WX(Field, Member) \
+	if (expect->valid & WX(Field)) \
+		CHECK(wx->Member == expect->Member, "'%s' : " #Member " %d, expected %d", \
+				Reports[i].info, wx->Member, expect->Member)
+
+int main(int argc, char ** argv) {
+	const struct APRS_Weather * wx, * expect;
+	APRS_Data_t data;
+	int i, ret;
+
+	esp_log_level_set("*", ESP_LOG_NONE);
+
+	Frame = Test_Frame(512);
+
+	for (i=0 ; i<sizeof(Reports)/sizeof(Reports[0]) ; i++) {
+		ret = Parse(Reports[i].info, &data);
+		CHECK(ret == Reports[i].type || (ret < 0 && Reports[i].type < 0), "'%s' : type %d, expected %d",
+				Reports[i].info, ret, Reports[i].type);
+		if (ret < 0)
+			continue;
+
+		wx = &data.weather;
+		expect = &Reports[i].wx;
+		CHECK(wx->valid == expect->valid, "'%s' : fields %03x, expected %03x", Reports[i].info,
+				wx->valid, expect->valid);
+		CHECK_WX(WIND_DIR, wind_dir);
+		CHECK_WX(WIND_SPEED, wind_speed);
+		CHECK_WX(GUST, gust);
+		CHECK_WX(TEMP, temp);
+		CHECK_WX(RAIN_1H, rain_last_1h);
+		CHECK_WX(RAIN_24H, rain_last_24h);
+		CHECK_WX(RAIN_MIDNIGHT, rain_since_midnight);
+		CHECK_WX(HUMIDITY, humidity);
+		CHECK_WX(PRESSURE, pressure);
+		CHECK_WX(LUMINOSITY, luminosity);
+		CHECK_WX(SNOW, snow_fall);
+		CHECK_WX(RAIN_COUNTER, rain_counter);
+		if (expect->valid)
+			CHECK(data.extension == APRS_DATA_EXT_WTH || data.extension == APRS_DATA_EXT_WEATHER,
+					"'%s' : extension %d", Reports[i].info, data.extension);
+	}
+
+	free(Frame);
+
+	return Test_Result("aprs_weather");
+}
@@ -0,0 +1,355 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/test_capture.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Packet capture ring on a file-backed flash stand-in : segment files in a
+// temporary directory. Frames are buffered, flushed and exported as pcap,
+// the ring wraps with the oldest segments removed, time ranges are checked
+// against a brute force filter, also across a clock step back, and the ring
+// is reopened with and without a torn tail.
+//
+//	test_capture [-n frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+
+#include "capture.h"
+#include "framebuff.h"
+#include "test.h"
+
+#define SEGMENT_SIZE	4096
+#define SEGMENTS	4
+#define BUFFER_SIZE	1024
+#define FLUSH_EVERY	8	// Frames between flushes
+#define T0		1700000000
+#define STEP_BACK	600	// Clock set back at half of the frames
+
+typedef struct Pcap_S {
+	uint8_t * data;
+	size_t len;
+	size_t size;
+} Pcap_t;
+
+// Exported frame
+typedef struct Exported_S {
+	int seq;
+	uint32_t sec;
+	uint32_t usec;
+	uint8_t kiss;
+} Exported_t;
+
+static char Dir[64];
+static char Path[96];
+static Frame_t * Frame;
+
+static int Pcap_Write(void * Ctx, const void * Data, size_t Len) {
+	Pcap_t * pcap = Ctx;
+
+	if (pcap->len + Len > pcap->size) {
+		pcap->size = (pcap->len + Len) * 2;
+		if (!(pcap->data = realloc(pcap->data, pcap->size)))
+			abort();
+	}
+	memcpy(pcap->data + pcap->len, Data, Len);
+	pcap->len += Len;
+
+	return 0;
+}
+
+// Frame with sequence number Seq in info, fcs valid unless Bad_Fcs
+static void Make_Frame(int Seq, bool Bad_Fcs) {
+	char info[32];
+	uint16_t fcs;
+
+	snprintf(info, sizeof(info), ">#%06d", Seq);
+	Test_Ui_Frame(Frame, Seq&1 ? "F4ABC-1" : "F4DEF-12", "APZ001", NULL, info);
+	fcs = esp_rom_crc16_le(0, Frame->frame, Frame->frame_len-2);
+	if (Bad_Fcs)
+		fcs ^= 0x5a5a;
+	Frame->frame[Frame->frame_len-2] = fcs & 0xff;
+	Frame->frame[Frame->frame_len-1] = fcs >> 8;
+}
+
+// Check pcap header and records, return number of records, -1 if malformed
+static int Pcap_Parse(const Pcap_t * Pcap, Exported_t * Out, int Max) {
+	const uint8_t * ptr = Pcap->data, * end = Pcap->data + Pcap->len;
+	uint32_t magic, network, incl, orig;
+	int i, n = 0;
+
+	if (Pcap->len < 24)
+		return -1;
+	memcpy(&magic, ptr, 4);
+	memcpy(&network, ptr+20, 4);
+	if (magic != 0xa1b2c3d4 || network != 202)
+		return -1;
+	ptr += 24;
+
+	while (ptr < end) {
+		if (end - ptr < 16 || n == Max)
+			return -1;
+		memcpy(&Out[n].sec, ptr, 4);
+		memcpy(&Out[n].usec, ptr+4, 4);
+		memcpy(&incl, ptr+8, 4);
+		memcpy(&orig, ptr+12, 4);
+		ptr += 16;
+		if (incl != orig || end - ptr < incl || incl < 1 + 16 + 8)
+			return -1;
+		// KISS byte, addresses, control and pid, then ">#nnnnnn" without fcs
+		Out[n].kiss = ptr[0];
+		if (ptr[17] != '>' || ptr[18] != '#' || incl != 1 + 16 + 8)
+			return -1;
+		for (i=0, Out[n].seq=0 ; i<6 ; i++)
+			Out[n].seq = Out[n].seq*10 + ptr[19+i] - '0';
+		ptr += incl;
+		n++;
+	}
+
+	return n;
+}
+
+static int Export(Capture_t * Capture, time_t From, time_t To, Exported_t * Out, int Max) {
+	Pcap_t pcap = { 0 };
+	int n, ret;
+
+	ret = Capture_Export_Pcap(Capture, From, To, Pcap_Write, &pcap);
+	n = Pcap_Parse(&pcap, Out, Max);
+	CHECK(n == ret, "%d frames exported, %d in pcap", ret, n);
+	free(pcap.data);
+
+	return n;
+}
+
+static int Segment_Files(uint32_t * Last) {
+	struct dirent * ent;
+	int n = 0;
+	DIR * d;
+
+	*Last = 0;
+	if (!(d = opendir(Dir)))
+		return -1;
+	while ((ent = readdir(d)))
+		if (!strncmp(ent->d_name, "cap.", 4)) {
+			n++;
+			if (strtoul(ent->d_name+4, NULL, 10) > *Last)
+				*Last = strtoul(ent->d_name+4, NULL, 10);
+		}
+	closedir(d);
+
+	return n;
+}
+
+static void Clean(void) {
+	struct dirent * ent;
+	char path[160];
+	DIR * d;
+
+	if ((d = opendir(Dir))) {
+		while ((ent = readdir(d)))
+			if (ent->d_name[0] != '.') {
+				snprintf(path, sizeof(path), "%s/%s", Dir, ent->d_name);
+				unlink(path);
+			}
+		closedir(d);
+	}
+}
+
+// Received, received with bad fcs and sent frames, buffer full drops
+static void Test_Write(void) {
+	Capture_t * capture;
+	Exported_t out[64];
+	struct timeval tv;
+	struct stat st;
+	char name[128];
+	uint8_t kiss;
+	int i, n, accepted;
+	off_t size = 0;
+
+	CHECK(!Capture_Init(NULL, Path, 64, SEGMENTS, BUFFER_SIZE), "segment smaller than a frame");
+	CHECK(!Capture_Init(NULL, Path, SEGMENT_SIZE, 1, BUFFER_SIZE), "ring of one segment");
+	CHECK(!Capture_Init(NULL, Path, SEGMENT_SIZE, SEGMENTS, 64), "buffer smaller than a frame");
+
+	capture = Capture_Init(NULL, Path, SEGMENT_SIZE, SEGMENTS, BUFFER_SIZE);
+	CHECK(capture, "init");
+	CHECK(Export(capture, 0, 0, out, 64) == 0, "frames in empty capture");
+
+	for (i=0 ; i<9 ; i++) {
+		Make_Frame(i, i%3 == 1);
+		tv.tv_sec = T0 + i;
+		tv.tv_usec = i*1000;
+		CHECK(!Capture_Frame(capture, i%3 == 2 ? CAPTURE_TX : CAPTURE_RX, Frame, &tv), "frame %d", i);
+		size += sizeof(Capture_Rec_t) + Frame->frame_len;
+	}
+	CHECK(!Capture_Flush(capture), "flush");
+	snprintf(name, sizeof(name), "%s.000001", Path);
+	CHECK(!stat(name, &st) && st.st_size == size, "segment %ld bytes, %ld written", (long)st.st_size, (long)size);
+
+	n = Export(capture, 0, 0, out, 64);
+	CHECK(n == 9, "%d frames exported", n);
+	for (i=0 ; i<n ; i++) {
+		kiss = (i%3 == 2) ? 0x10 : (i%3 == 1) ? 0x20 : 0x00;
+		CHECK(out[i].seq == i && out[i].sec == T0 + i && out[i].usec == i*1000 && out[i].kiss == kiss,
+				"frame %d : seq %d at %u.%06u, kiss %02x", i, out[i].seq, out[i].sec, out[i].usec, out[i].kiss);
+	}
+
+	// Buffer full until next flush
+	for (i=0, accepted=0 ; i<BUFFER_SIZE ; i++) {
+		Make_Frame(100 + i, false);
+		tv.tv_sec = T0 + 100;
+		if (!Capture_Frame(capture, CAPTURE_RX, Frame, &tv))
+			accepted++;
+	}
+	CHECK(accepted == BUFFER_SIZE / (sizeof(Capture_Rec_t) + Frame->frame_len), "%d frames buffered", accepted);
+	n = Export(capture, T0 + 100, 0, out, 64);
+	CHECK(n == accepted && out[n-1].seq == 100 + accepted - 1, "%d frames exported after drops", n);
+	Make_Frame(99, false);
+	CHECK(!Capture_Frame(capture, CAPTURE_RX, Frame, &tv), "buffer not emptied by flush");
+}
+
+// Ring wrap, time ranges, reopen and torn tail
+static void Test_Ring(int Frames) {
+	Capture_t * capture;
+	Exported_t * all, * out;
+	struct timeval tv;
+	char name[128];
+	struct stat st;
+	uint32_t last, prev;
+	int i, j, k, n, n_all, files, frame_size;
+	time_t from, to;
+
+	all = malloc(Frames * sizeof(Exported_t));
+	out = malloc(Frames * sizeof(Exported_t));
+	Clean();
+	capture = Capture_Init(NULL, Path, SEGMENT_SIZE, SEGMENTS, BUFFER_SIZE);
+
+	for (i=0 ; i<Frames ; i++) {
+		Make_Frame(i, false);
+		tv.tv_sec = T0 + i*2 - (i >= Frames/2 ? STEP_BACK : 0);
+		tv.tv_usec = 0;
+		Capture_Frame(capture, CAPTURE_RX, Frame, &tv);
+		if (i%FLUSH_EVERY == FLUSH_EVERY-1)
+			CHECK(!Capture_Flush(capture), "flush at %d", i);
+	}
+	frame_size = sizeof(Capture_Rec_t) + Frame->frame_len;
+
+	files = Segment_Files(&last);
+	CHECK(files == SEGMENTS, "%d segment files", files);
+
+	// Newest frames, without a gap
+	n_all = Export(capture, 0, 0, all, Frames);
+	CHECK(n_all > (SEGMENTS-1)*(SEGMENT_SIZE/frame_size) && n_all <= SEGMENTS*(SEGMENT_SIZE/frame_size),
+			"%d frames in ring", n_all);
+	CHECK(n_all > 0 && all[n_all-1].seq == Frames-1, "last frame %d", n_all ? all[n_all-1].seq : -1);
+	for (i=1 ; i<n_all ; i++)
+		if (all[i].seq != all[i-1].seq + 1)
+			break;
+	CHECK(i == n_all, "gap after frame %d", all[i-1].seq);
+
+	// Time ranges against a brute force filter, across the clock step back
+	for (k=0 ; k<200 ; k++) {
+		from = T0 + (k*37) % (Frames*2);
+		to = (k%4 == 0) ? 0 : from + (k*13) % 400;
+		n = Export(capture, from, to, out, Frames);
+		for (i=0, j=0 ; i<n_all ; i++) {
+			if (all[i].sec < from || (to && all[i].sec > to))
+				continue;
+			if (j >= n || out[j].seq != all[i].seq)
+				break;
+			j++;
+		}
+		CHECK(i == n_all && j == n, "range %ld-%ld : %d frames, mismatch at %d", (long)(from-T0), to ? (long)(to-T0) : 0L, n, j);
+	}
+
+	// Reopen, same frames
+	capture = Capture_Init(NULL, Path, SEGMENT_SIZE, SEGMENTS, BUFFER_SIZE);
+	n = Export(capture, 0, 0, out, Frames);
+	for (i=0 ; i<n && i<n_all ; i++)
+		if (out[i].seq != all[i].seq || out[i].sec != all[i].sec || out[i].usec != all[i].usec || out[i].kiss != all[i].kiss)
+			break;
+	CHECK(n == n_all && i == n, "%d frames after reopen, %d before, differ at %d", n, n_all, i);
+
+	// Torn tail ignored, writing goes on in a new segment
+	snprintf(name, sizeof(name), "%s.%06u", Path, last);
+	CHECK(!stat(name, &st) && !truncate(name, st.st_size - 5), "truncate %s", name);
+	capture = Capture_Init(NULL, Path, SEGMENT_SIZE, SEGMENTS, BUFFER_SIZE);
+	n = Export(capture, 0, 0, out, Frames);
+	CHECK(n == n_all-1 && out[n-1].seq == Frames-2, "%d frames after torn tail, last %d", n, n ? out[n-1].seq : -1);
+	prev = last;
+	Make_Frame(Frames, false);
+	tv.tv_sec = T0 + Frames*2;
+	Capture_Frame(capture, CAPTURE_RX, Frame, &tv);
+	Capture_Flush(capture);
+	files = Segment_Files(&last);
+	CHECK(files == SEGMENTS && last == prev + 1, "%d segments, last %u after %u", files, last, prev);
+	n = Export(capture, 0, 0, out, Frames);
+	CHECK(n > 0 && out[n-1].seq == Frames, "last frame %d after torn tail", n ? out[n-1].seq : -1);
+
+	free(all);
+	free(out);
+}
+
+int main(int argc, char ** argv) {
+	int opt, frames = 3000;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1) {
+		switch (opt) {
+			case 'n':
+				frames = atoi(optarg);
+				break;
+			default:
+				fprintf(stderr, "Usage : %s [-n frames]\n", argv[0]);
+				return 2;
+		}
+	}
+	if (frames < 1000)
+		frames = 1000;
+
+	esp_log_level_set("*", ESP_LOG_NONE);
+
+	snprintf(Dir, sizeof(Dir), "%s/captureXXXXXX", getenv("TMPDIR") && strlen(getenv("TMPDIR")) < 32 ? getenv("TMPDIR") : "/tmp");
+	if (!mkdtemp(Dir)) {
+		perror(Dir);
+		return 1;
+	}
+	snprintf(Path, sizeof(Path), "%s/cap", Dir);
+
+	Frame = Test_Frame(512);
+
+	// Capture has no close, instances are left open
+	Test_Write();
+	Test_Ring(frames);
+
+	free(Frame);
+	Clean();
+	rmdir(Dir);
+
+	return Test_Result("capture");
+}
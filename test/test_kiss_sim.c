@@ -0,0 +1,648 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/test_kiss_sim.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// kiss_sim instances on a shared channel, driven from their client ptys :
+//	- a frame sent by a client of one must be received by a client of the other
+//	- an ackmode frame is acknowledged once it is on air, acks in order
+//	- a smack frame with a bad crc is dropped and counted
+//	- frames are tagged with the port they come from : radio ports filtered
+//	  on destination, local port for locally generated frames. A smack host
+//	  never gets frames of ports 8 to 15, their flag would be taken for smack
+//	- frames to a stalled host (no credit) are queued by priority : local,
+//	  direct, via one digipeater, via more. Full queue evicts by drop policy,
+//	  drops are counted by reason, credits release frames one by one
+//	- on a jammed channel, an ackmode frame never sent is forgotten after
+//	  the ack timeout (KISS_ACK_TIMEOUT_MS of the kiss_sim build)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include "test.h"
+
+#define FEND	0xC0
+#define FESC	0xDB
+#define TFEND	0xDC
+#define TFESC	0xDD
+
+#define CMD_DATA	0x00
+#define CMD_SETHW	0x06
+#define CMD_ACKMODE	0x0C
+#define CMD_SMACK	0x80
+
+#define TIMEOUT_MS	10000
+#define MAX_SIMS	2
+#define MAX_ARGS	16
+
+// Kiss_Drop_Reason_t order, then smack crc errors and pending acks
+enum { STAT_FULL, STAT_EVICTED, STAT_PREEMPTED, STAT_LENGTH, STAT_CRC, STAT_ACKS, STAT_MAX };
+
+typedef struct Sim_S {
+	pid_t pid;
+	int fd;
+	bool smack;	// Smack frame sent, replies have crc
+} Sim_t;
+
+static const char * Sim_Path;
+static Sim_t Sims[MAX_SIMS];
+static int Udp_Port;
+
+static void Stop_Sims(void) {
+	int i;
+
+	for (i=0 ; i<MAX_SIMS ; i++) {
+		if (Sims[i].fd > 0)
+			close(Sims[i].fd);
+		if (Sims[i].pid > 0) {
+			kill(Sims[i].pid, SIGTERM);
+			waitpid(Sims[i].pid, NULL, 0);
+		}
+		Sims[i].fd = -1;
+		Sims[i].pid = 0;
+		Sims[i].smack = false;
+	}
+}
+
+// Start simulator with its own arguments (NULL terminated), open its client pty
+static int Start_Sim(Sim_t * Sim, const char * Args[]) {
+	const char * argv[MAX_ARGS];
+	char path[64];
+	struct pollfd pfd;
+	int fds[2], argc = 0;
+	size_t pos = 0;
+
+	argv[argc++] = Sim_Path;
+	while (*Args && argc < MAX_ARGS-1)
+		argv[argc++] = *(Args++);
+	argv[argc] = NULL;
+
+	if (pipe(fds) || (Sim->pid = fork()) < 0)
+		return -1;
+
+	if (!Sim->pid) {
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[0]);
+		close(fds[1]);
+		execv(Sim_Path, (char * const *)argv);
+		_exit(127);
+	}
+
+	close(fds[1]);
+	pfd.fd = fds[0];
+	pfd.events = POLLIN;
+	while (pos < sizeof(path)-1 && poll(&pfd, 1, TIMEOUT_MS) > 0 && read(fds[0], path+pos, 1) == 1) {
+		if (path[pos] == '\n')
+			break;
+		pos++;
+	}
+	path[pos] = '\0';
+	close(fds[0]);
+
+	if (!pos || (Sim->fd = open(path, O_RDWR|O_NOCTTY)) < 0) {
+		fprintf(stderr, "Error starting simulator\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+// Two instances on the same channel, second one with Extra arguments
+static int Start_Pair(const char * Extra[]) {
+	char port[2][16], peer[2][32];
+	const char * args[2][MAX_ARGS];
+	int i, j;
+
+	Udp_Port += 2;
+	for (i=0 ; i<2 ; i++) {
+		snprintf(port[i], sizeof(port[i]), "%d", Udp_Port+i);
+		snprintf(peer[i], sizeof(peer[i]), "127.0.0.1:%d", Udp_Port+1-i);
+		args[i][0] = "-p";
+		args[i][1] = port[i];
+		args[i][2] = "-r";
+		args[i][3] = peer[i];
+		args[i][4] = NULL;
+	}
+	for (j=0 ; Extra && Extra[j] && j<MAX_ARGS-6 ; j++)
+		args[1][4+j] = Extra[j];
+	args[1][4+j] = NULL;
+
+	return (Start_Sim(&Sims[0], args[0]) || Start_Sim(&Sims[1], args[1])) ? -1 : 0;
+}
+
+// Smack crc (CRC-16, poly 0x8005 reflected)
+static uint16_t Smack_Crc(uint16_t Crc, const uint8_t * Data, size_t Len) {
+	int i;
+
+	while (Len--) {
+		Crc ^= *(Data++);
+		for (i=0 ; i<8 ; i++)
+			Crc = (Crc&1) ? (Crc>>1)^0xA001 : Crc>>1;
+	}
+
+	return Crc;
+}
+
+static uint8_t * Kiss_Put(uint8_t * Out, uint8_t C) {
+	if (C == FEND) {
+		*(Out++) = FESC;
+		*(Out++) = TFEND;
+	} else if (C == FESC) {
+		*(Out++) = FESC;
+		*(Out++) = TFESC;
+	} else
+		*(Out++) = C;
+
+	return Out;
+}
+
+// Send kiss frame, with smack crc (xored with Crc_Xor) if Cmd has smack flag
+static int Kiss_Send(Sim_t * Sim, uint8_t Cmd, const uint8_t * Data, size_t Len, uint16_t Crc_Xor) {
+	uint8_t buff[1024], * out = buff;
+	uint16_t crc;
+	size_t i;
+
+	*(out++) = FEND;
+	out = Kiss_Put(out, Cmd);
+	for (i=0 ; i<Len ; i++)
+		out = Kiss_Put(out, Data[i]);
+	if (Cmd & CMD_SMACK) {
+		Sim->smack = true;
+		crc = Smack_Crc(Smack_Crc(0, &Cmd, 1), Data, Len) ^ Crc_Xor;
+		out = Kiss_Put(out, crc&0xff);
+		out = Kiss_Put(out, crc>>8);
+	}
+	*(out++) = FEND;
+
+	return write(Sim->fd, buff, out-buff) == out-buff ? 0 : -1;
+}
+
+// Next kiss frame from Sim, smack crc checked and removed once Sim speaks smack
+// return data length, -1 on timeout, -2 on smack crc error
+static int Kiss_Read(Sim_t * Sim, uint8_t * Cmd, uint8_t * Data, size_t Size, int Timeout_Ms) {
+	struct pollfd pfd = { .fd = Sim->fd, .events = POLLIN };
+	bool in_frame = false, esc = false, cmd = false;
+	size_t len = 0;
+	uint8_t c;
+
+	while (poll(&pfd, 1, Timeout_Ms) > 0 && read(Sim->fd, &c, 1) == 1) {
+		if (c == FEND) {
+			if (in_frame && cmd) {
+				if (!Sim->smack || !(*Cmd & CMD_SMACK))
+					return len;
+				if (len < 2 || Smack_Crc(Smack_Crc(0, Cmd, 1), Data, len))
+					return -2;
+				return len-2;
+			}
+			in_frame = true;
+			cmd = false;
+			len = 0;
+			continue;
+		}
+		if (!in_frame)
+			continue;
+		if (!cmd) {
+			*Cmd = c;
+			cmd = true;
+			continue;
+		}
+		if (esc) {
+			c = c == TFEND ? FEND : c == TFESC ? FESC : c;
+			esc = false;
+		} else if (c == FESC) {
+			esc = true;
+			continue;
+		}
+		if (len < Size)
+			Data[len++] = c;
+	}
+
+	return -1;
+}
+
+// Simulator counters, other frames read meanwhile are counted in Others
+static int Sim_Stats(Sim_t * Sim, uint32_t Stats[STAT_MAX], int * Others) {
+	uint8_t data[512], cmd, req = 'S';
+	int i, ret;
+
+	if (Kiss_Send(Sim, CMD_SETHW, &req, 1, 0))
+		return -1;
+
+	while ((ret = Kiss_Read(Sim, &cmd, data, sizeof(data), TIMEOUT_MS)) != -1) {
+		if ((cmd & 0x7f) != CMD_SETHW || ret != 1 + STAT_MAX*4 || data[0] != 'S') {
+			if (Others)
+				(*Others)++;
+			continue;
+		}
+		for (i=0 ; i<STAT_MAX ; i++)
+			Stats[i] = (data[1+i*4]<<24) | (data[2+i*4]<<16) | (data[3+i*4]<<8) | data[4+i*4];
+		return 0;
+	}
+
+	return -1;
+}
+
+static void Ax25_Addr(uint8_t * Out, const char * Call, uint8_t Ssid) {
+	int i;
+
+	for (i=0 ; i<6 ; i++)
+		Out[i] = (*Call ? *(Call++) : ' ')<<1;
+	Out[6] = Ssid;
+}
+
+// UI frame to Dest with info Info, return its length
+static size_t Ui_Frame(uint8_t * Frame, const char * Dest, const char * Info) {
+	size_t len = strlen(Info);
+
+	Ax25_Addr(Frame, Dest, 0x60);
+	Ax25_Addr(Frame+7, "N0CALL", 0x61);
+	Frame[14] = 0x03;
+	Frame[15] = 0xF0;
+	memcpy(Frame+16, Info, len);
+
+	return 16 + len;
+}
+
+// UI frame heard via Digis digipeaters, Used of them with H bit set
+static size_t Via_Frame(uint8_t * Frame, int Digis, int Used, const char * Info) {
+	size_t len = strlen(Info), pos;
+	int i;
+
+	Ax25_Addr(Frame, "APZ000", 0x60);
+	Ax25_Addr(Frame+7, "N0CALL", Digis ? 0x60 : 0x61);
+	for (i=0, pos=14 ; i<Digis ; i++, pos+=7)
+		Ax25_Addr(Frame+pos, "DIGI", 0x60 | (i<Used ? 0x80 : 0) | (i==Digis-1 ? 1 : 0));
+	Frame[pos++] = 0x03;
+	Frame[pos++] = 0xF0;
+	memcpy(Frame+pos, Info, len);
+
+	return pos + len;
+}
+
+// Ackmode payload : id then frame
+static size_t Ack_Frame(uint8_t * Data, uint16_t Id, const char * Info) {
+	Data[0] = Id>>8;
+	Data[1] = Id;
+	return 2 + Ui_Frame(Data+2, "APZ000", Info);
+}
+
+static void Test_Data(void) {
+	uint8_t frame[64], data[512], cmd;
+	size_t frame_len;
+	int ret;
+
+	// UI frame, with bytes to escape in info
+	frame_len = Ui_Frame(frame, "APZ000", ">sim \xC0\xDB test");
+
+	CHECK(!Kiss_Send(&Sims[0], CMD_DATA, frame, frame_len, 0), "write");
+	ret = Kiss_Read(&Sims[1], &cmd, data, sizeof(data), TIMEOUT_MS);
+	CHECK(ret == frame_len && cmd == CMD_DATA && !memcmp(data, frame, frame_len), "data frame not received (%d)", ret);
+}
+
+// Acks come back in order, once each frame is on air. Three kiss out frames :
+// at most two are kept waiting for their ack
+static void Test_Ack_Order(void) {
+	uint8_t data[512], cmd;
+	char info[32];
+	int sent = 0, acked = 0, heard = 0, ret;
+	uint16_t id;
+	size_t len;
+
+	while (acked < 4) {
+		while (sent < 4 && sent - acked < 2) {
+			snprintf(info, sizeof(info), ">ack %d", sent);
+			len = Ack_Frame(data, 0x1000 + sent, info);
+			CHECK(!Kiss_Send(&Sims[0], CMD_ACKMODE, data, len, 0), "write");
+			sent++;
+		}
+		ret = Kiss_Read(&Sims[0], &cmd, data, sizeof(data), TIMEOUT_MS);
+		if (ret < 0) {
+			CHECK(0, "ack %d not received", acked);
+			return;
+		}
+		id = (data[0]<<8) | data[1];
+		CHECK(ret == 2 && cmd == CMD_ACKMODE && id == 0x1000 + acked, "ack %d : got cmd 0x%02x id 0x%04x", acked, cmd, id);
+		acked++;
+	}
+
+	while (heard < 4 && (ret = Kiss_Read(&Sims[1], &cmd, data, sizeof(data), TIMEOUT_MS)) >= 0) {
+		snprintf(info, sizeof(info), ">ack %d", heard);
+		CHECK(cmd == CMD_DATA && ret == 16 + strlen(info) && !memcmp(data+16, info, strlen(info)), "frame %d received out of order", heard);
+		heard++;
+	}
+	CHECK(heard == 4, "%d ackmode frames received", heard);
+}
+
+// Bad crc is dropped and counted, host is then spoken smack to
+static void Test_Smack_Crc(void) {
+	uint32_t stats[STAT_MAX];
+	uint8_t data[512], cmd;
+	size_t len;
+	int ret, others = 0;
+
+	len = Ack_Frame(data, 0x2001, ">smack bad");
+	CHECK(!Kiss_Send(&Sims[0], CMD_SMACK | CMD_ACKMODE, data, len, 0x0100), "write");
+	len = Ack_Frame(data, 0x2002, ">smack good");
+	CHECK(!Kiss_Send(&Sims[0], CMD_SMACK | CMD_ACKMODE, data, len, 0), "write");
+
+	ret = Kiss_Read(&Sims[0], &cmd, data, sizeof(data), TIMEOUT_MS);
+	CHECK(ret == 2 && cmd == (CMD_SMACK | CMD_ACKMODE) && data[0] == 0x20 && data[1] == 0x02,
+			"smack ack : ret %d cmd 0x%02x id 0x%02x%02x", ret, cmd, data[0], data[1]);
+
+	ret = Kiss_Read(&Sims[1], &cmd, data, sizeof(data), TIMEOUT_MS);
+	CHECK(ret == 16 + 11 && cmd == CMD_DATA && !memcmp(data+16, ">smack good", 11), "first smack frame heard is not the good one");
+	ret = Kiss_Read(&Sims[1], &cmd, data, sizeof(data), 1500);
+	CHECK(ret == -1, "frame with bad smack crc sent on air");
+
+	CHECK(!Sim_Stats(&Sims[0], stats, &others), "no stats");
+	CHECK(stats[STAT_CRC] == 1 && !others, "crc errors %u, %d unexpected frames", stats[STAT_CRC], others);
+}
+
+// Frames read from Sim until Timeout_Ms of silence, counted by port and info in Count[port][n]
+static int Read_Ports(Sim_t * Sim, const char * Infos[], int Count[16][4], int Timeout_Ms) {
+	uint8_t data[512], cmd;
+	int i, ret, others = 0;
+
+	memset(Count, 0, sizeof(int)*16*4);
+	while ((ret = Kiss_Read(Sim, &cmd, data, sizeof(data), Timeout_Ms)) != -1) {
+		for (i=0 ; Infos[i] ; i++)
+			if ((cmd & 0x0f) == CMD_DATA && ret == 16 + strlen(Infos[i]) && !memcmp(data+16, Infos[i], strlen(Infos[i])))
+				break;
+		if (Infos[i])
+			Count[Sim->smack ? (cmd>>4)&0x07 : cmd>>4][i]++;
+		else
+			others++;
+	}
+
+	return others;
+}
+
+// Second instance has radio ports 2 and 5, filtered on PORT2 and PORT5, and local port 9
+static void Test_Ports(void) {
+	const char * infos[] = { ">to p0", ">to p2", ">to p5", ">local", NULL };
+	const char * dests[] = { "APZ000", "PORT2", "PORT5" };
+	int count[16][4], i, others;
+	uint8_t data[512], cmd;
+	size_t len;
+
+	for (i=0 ; i<3 ; i++) {
+		len = Ui_Frame(data, dests[i], infos[i]);
+		CHECK(!Kiss_Send(&Sims[0], CMD_DATA, data, len, 0), "write");
+	}
+	others = Read_Ports(&Sims[1], infos, count, 3000);
+	CHECK(!others, "%d unexpected frames", others);
+	CHECK(count[0][0] == 1 && count[0][1] == 1 && count[0][2] == 1, "port 0 : %d %d %d", count[0][0], count[0][1], count[0][2]);
+	CHECK(!count[2][0] && count[2][1] == 1 && !count[2][2], "port 2 : %d %d %d", count[2][0], count[2][1], count[2][2]);
+	CHECK(!count[5][0] && !count[5][1] && count[5][2] == 1, "port 5 : %d %d %d", count[5][0], count[5][1], count[5][2]);
+
+	// Locally generated, on local port only
+	data[0] = 'L';
+	len = 1 + Ui_Frame(data+1, "APZ000", infos[3]);
+	CHECK(!Kiss_Send(&Sims[1], CMD_SETHW, data, len, 0), "write");
+	others = Read_Ports(&Sims[1], infos, count, 1500);
+	CHECK(!others && count[9][3] == 1 && !count[0][3], "local frame : port 9 %d, port 0 %d, %d others", count[9][3], count[0][3], others);
+
+	// From host on port 2, goes on air
+	len = Ui_Frame(data, "APZ000", infos[0]);
+	CHECK(!Kiss_Send(&Sims[1], 0x20 | CMD_DATA, data, len, 0), "write");
+	others = Read_Ports(&Sims[0], infos, count, 3000);
+	CHECK(!others && count[0][0] == 1, "port 2 frame not sent (%d)", count[0][0]);
+
+	// Smack host : port 9 can't be told apart from port 1 with smack flag, dropped
+	data[0] = 'S';
+	CHECK(!Kiss_Send(&Sims[1], CMD_SMACK | CMD_SETHW, data, 1, 0), "write");
+	CHECK(Kiss_Read(&Sims[1], &cmd, data, sizeof(data), TIMEOUT_MS) > 0 && cmd == (CMD_SMACK | CMD_SETHW), "no smack reply");
+	data[0] = 'L';
+	len = 1 + Ui_Frame(data+1, "APZ000", infos[3]);
+	CHECK(!Kiss_Send(&Sims[1], CMD_SMACK | CMD_SETHW, data, len, 0), "write");
+	len = Ui_Frame(data, "PORT2", infos[1]);
+	CHECK(!Kiss_Send(&Sims[0], CMD_DATA, data, len, 0), "write");
+	others = Read_Ports(&Sims[1], infos, count, 3000);
+	CHECK(!others && !count[1][3] && !count[9][3], "local frame to smack host : port 1 %d, port 9 %d, %d others", count[1][3], count[9][3], others);
+	CHECK(count[0][1] == 1 && count[2][1] == 1, "smack port 0 %d, port 2 %d", count[0][1], count[2][1]);
+}
+
+typedef struct Tx_S {
+	int digis, used;
+	const char * info;
+} Tx_t;
+
+// Frames sent in ackmode, two at a time, return once all are on air
+static int Send_Acked(Sim_t * Sim, const Tx_t * Tx, int Count) {
+	uint8_t data[512], cmd;
+	int sent = 0, acked = 0;
+	size_t len;
+
+	while (acked < Count) {
+		while (sent < Count && sent - acked < 2) {
+			data[0] = 0x30;
+			data[1] = sent;
+			len = 2 + Via_Frame(data+2, Tx[sent].digis, Tx[sent].used, Tx[sent].info);
+			if (Kiss_Send(Sim, CMD_ACKMODE, data, len, 0))
+				return -1;
+			sent++;
+		}
+		if (Kiss_Read(Sim, &cmd, data, sizeof(data), TIMEOUT_MS) < 0)
+			return -1;
+		if (cmd == CMD_ACKMODE)
+			acked++;
+	}
+
+	// Let the other side decode the last one
+	usleep(500000);
+
+	return 0;
+}
+
+// SetHardware command with one byte argument
+static int Sim_Hw(Sim_t * Sim, uint8_t Cmd, uint8_t Arg) {
+	uint8_t data[2] = { Cmd, Arg };
+
+	return Kiss_Send(Sim, CMD_SETHW, data, 2, 0);
+}
+
+// Frames read from Sim until Timeout_Ms of silence, their info in Infos
+static int Read_Infos(Sim_t * Sim, char Infos[][16], int Size, int Timeout_Ms) {
+	uint8_t data[512], cmd;
+	int n = 0, ret, pos;
+
+	while (n < Size && (ret = Kiss_Read(Sim, &cmd, data, sizeof(data), Timeout_Ms)) != -1) {
+		if (cmd != CMD_DATA)
+			continue;
+		// Info after last address, control and pid
+		for (pos=6 ; pos<ret && !(data[pos]&1) ; pos+=7);
+		pos += 3;
+		if (pos > ret || ret - pos >= 16)
+			continue;
+		memcpy(Infos[n], data+pos, ret-pos);
+		Infos[n][ret-pos] = '\0';
+		n++;
+	}
+
+	return n;
+}
+
+// Sims[1] host stalled with no credit while Sims[0] sends, then frames released by credits
+static void Test_Queue(void) {
+	static const Tx_t fill[] = {
+		{ 2, 2, ">m0" }, { 1, 1, ">d0" }, { 0, 0, ">n0" },
+		{ 2, 2, ">m1" }, { 1, 1, ">d1" }, { 0, 0, ">n1" },
+		{ 3, 2, ">m2" }, { 2, 1, ">d2" }, { 1, 0, ">n2" },
+		{ 3, 3, ">m3" }, { 1, 1, ">d3" }, { 0, 0, ">n3" },
+	};
+	static const Tx_t direct[] = { { 0, 0, ">n4" }, { 0, 0, ">n5" } };
+	static const Tx_t multi[] = { { 2, 2, ">m4" } };
+	static const Tx_t newest[] = { { 2, 2, ">m5" }, { 0, 0, ">n6" } };
+	static const char * expected[] = {
+		">l0", ">l1", ">l2", ">l3",
+		">n0", ">n1", ">n2", ">n3", ">n4", ">n5", ">n6",
+		">d0", ">d1", ">d2", ">d3",
+		">m4",
+	};
+	char infos[20][16], info[8];
+	uint32_t stats[STAT_MAX];
+	uint8_t data[512];
+	int i, n, others = 0;
+	size_t len;
+
+	// Stall host, queue filled : 4 local, 4 direct, 4 via one digi, 4 via more
+	CHECK(!Sim_Hw(&Sims[1], 'C', 0), "write");
+	CHECK(!Send_Acked(&Sims[0], fill, 12), "fill frames not sent");
+	for (i=0 ; i<4 ; i++) {
+		snprintf(info, sizeof(info), ">l%d", i);
+		data[0] = 'L';
+		len = 1 + Ui_Frame(data+1, "APZ000", info);
+		CHECK(!Kiss_Send(&Sims[1], CMD_SETHW, data, len, 0), "write");
+	}
+	CHECK(!Sim_Stats(&Sims[1], stats, &others) && !others, "%d frames to stalled host", others);
+	CHECK(!stats[STAT_FULL] && !stats[STAT_EVICTED] && !stats[STAT_PREEMPTED], "drops before queue full");
+
+	// Drop oldest : direct frames preempt the oldest via more digis, which evicts its oldest
+	CHECK(!Send_Acked(&Sims[0], direct, 2), "direct frames not sent");
+	CHECK(!Send_Acked(&Sims[0], multi, 1), "multi digi frame not sent");
+	CHECK(!Sim_Stats(&Sims[1], stats, &others), "no stats");
+	CHECK(stats[STAT_PREEMPTED] == 2 && stats[STAT_EVICTED] == 1 && !stats[STAT_FULL],
+		"drop oldest : preempted %u evicted %u full %u", stats[STAT_PREEMPTED], stats[STAT_EVICTED], stats[STAT_FULL]);
+
+	// Drop newest : same priority rejected, higher priority still preempts
+	CHECK(!Sim_Hw(&Sims[1], 'P', 1), "write");
+	CHECK(!Send_Acked(&Sims[0], newest, 2), "newest frames not sent");
+	CHECK(!Sim_Stats(&Sims[1], stats, &others), "no stats");
+	CHECK(stats[STAT_PREEMPTED] == 3 && stats[STAT_EVICTED] == 1 && stats[STAT_FULL] == 1 && !stats[STAT_LENGTH],
+		"drop newest : preempted %u evicted %u full %u", stats[STAT_PREEMPTED], stats[STAT_EVICTED], stats[STAT_FULL]);
+	CHECK(!others, "%d frames to stalled host", others);
+
+	// Credits release that many frames, by priority
+	CHECK(!Sim_Hw(&Sims[1], 'C', 5), "write");
+	n = Read_Infos(&Sims[1], infos, 20, 1500);
+	CHECK(n == 5, "%d frames for 5 credits", n);
+	CHECK(!Sim_Hw(&Sims[1], 'C', 5), "write");
+	n += Read_Infos(&Sims[1], infos+n, 20-n, 1500);
+	CHECK(n == 10, "%d frames for 10 credits", n);
+
+	// No more credit mode, the rest follows
+	CHECK(!Sim_Hw(&Sims[1], 'X', 0), "write");
+	n += Read_Infos(&Sims[1], infos+n, 20-n, 1500);
+	CHECK(n == 16, "%d frames queued", n);
+
+	for (i=0 ; i<n && i<16 ; i++)
+		CHECK(!strcmp(infos[i], expected[i]), "frame %d : %s instead of %s", i, infos[i], expected[i]);
+}
+
+// Ack forgotten on timeout by kiss task, without further ackmode frame
+static void Test_Ack_Timeout(void) {
+	const char * args[] = { "-j", NULL };
+	struct timespec start, now;
+	uint32_t stats[STAT_MAX];
+	uint8_t data[512];
+	int others = 0;
+	size_t len;
+
+	if (Start_Sim(&Sims[0], args)) {
+		CHECK(0, "jammed simulator not started");
+		return;
+	}
+
+	len = Ack_Frame(data, 0x3001, ">jammed");
+	CHECK(!Kiss_Send(&Sims[0], CMD_ACKMODE, data, len, 0), "write");
+	usleep(500000);
+	CHECK(!Sim_Stats(&Sims[0], stats, &others) && stats[STAT_ACKS] == 1, "ack not pending (%u)", stats[STAT_ACKS]);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		usleep(250000);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (Sim_Stats(&Sims[0], stats, &others)) {
+			CHECK(0, "no stats");
+			break;
+		}
+	} while (stats[STAT_ACKS] && now.tv_sec - start.tv_sec < TIMEOUT_MS/1000);
+
+	CHECK(!stats[STAT_ACKS], "stale ack still pending");
+	CHECK(!others, "%d unexpected frames, ack of a frame never sent ?", others);
+}
+
+int main(int argc, char ** argv) {
+	const char * ports_args[] = { "-P", "2:PORT2", "-P", "5:PORT5", "-L", "9", NULL };
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage : %s kiss_sim\n", argv[0]);
+		return 2;
+	}
+
+	Sim_Path = argv[1];
+	Udp_Port = 20000 + (getpid()%1000)*16;
+	atexit(Stop_Sims);
+
+	if (!Start_Pair(NULL)) {
+		Test_Data();
+		Test_Ack_Order();
+		Test_Smack_Crc();
+	} else
+		CHECK(0, "simulators not started");
+	Stop_Sims();
+
+	if (!Start_Pair(NULL))
+		Test_Queue();
+	else
+		CHECK(0, "simulators not started");
+	Stop_Sims();
+
+	if (!Start_Pair(ports_args))
+		Test_Ports();
+	else
+		CHECK(0, "simulators not started");
+	Stop_Sims();
+
+	Test_Ack_Timeout();
+	Stop_Sims();
+
+	return Test_Result("kiss_sim");
+}
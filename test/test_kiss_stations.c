@@ -0,0 +1,301 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ESP32s3APRS by F4JMZ
+ *
+ * test/test_kiss_stations.c
+ *
+ * Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// tools/kiss_stations.py against kiss_sim serving a stations DB :
+//	- roundtrip of a filled DB : export, import back, second export identical
+//	- export with a callid filter gets the matching stations only
+//	- import of the exported file into an empty DB, then export again gives
+//	  the same file, and the imported DB holds the same records as the
+//	  original one, with consistent indexes
+//
+//	test_kiss_stations kiss_sim python3 tools/kiss_stations.py
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+#include <esp_log.h>
+
+#include "aprs.h"
+#include "aprs_log.h"
+#include "aprs_sim.h"
+#include "test.h"
+
+#define TIMEOUT_MS	10000
+#define N_STATIONS	300
+#define MAX_ARGS	8
+
+static const char * Sim_Path;
+static const char * Python;
+static const char * Script;
+static pid_t Sim_Pid;
+
+static void Stop_Sim(void) {
+	if (Sim_Pid > 0) {
+		kill(Sim_Pid, SIGTERM);
+		waitpid(Sim_Pid, NULL, 0);
+	}
+	Sim_Pid = 0;
+}
+
+// Start simulator on stations DB Stations, Pty is its client pty
+static int Start_Sim(const char * Stations, char * Pty, size_t Size) {
+	struct pollfd pfd;
+	int fds[2];
+	size_t pos = 0;
+
+	if (pipe(fds) || (Sim_Pid = fork()) < 0)
+		return -1;
+
+	if (!Sim_Pid) {
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[0]);
+		close(fds[1]);
+		execl(Sim_Path, Sim_Path, "-s", Stations, NULL);
+		_exit(127);
+	}
+
+	close(fds[1]);
+	pfd.fd = fds[0];
+	pfd.events = POLLIN;
+	while (pos < Size-1 && poll(&pfd, 1, TIMEOUT_MS) > 0 && read(fds[0], Pty+pos, 1) == 1) {
+		if (Pty[pos] == '\n')
+			break;
+		pos++;
+	}
+	Pty[pos] = '\0';
+	close(fds[0]);
+
+	if (!pos) {
+		fprintf(stderr, "Error starting simulator\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+// Run the tool with its arguments (NULL terminated), first line of its output in Out
+static int Tool(char * Out, size_t Size, ...) {
+	const char * argv[MAX_ARGS];
+	const char * arg;
+	va_list ap;
+	int fds[2], status, argc = 0;
+	ssize_t len;
+	size_t pos = 0;
+	pid_t pid;
+
+	argv[argc++] = Python;
+	argv[argc++] = Script;
+	va_start(ap, Size);
+	while ((arg = va_arg(ap, const char *)) && argc < MAX_ARGS-1)
+		argv[argc++] = arg;
+	va_end(ap);
+	argv[argc] = NULL;
+
+	if (pipe(fds) || (pid = fork()) < 0)
+		return -1;
+
+	if (!pid) {
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[0]);
+		close(fds[1]);
+		execv(Python, (char * const *)argv);
+		_exit(127);
+	}
+
+	close(fds[1]);
+	while (pos < Size-1 && (len = read(fds[0], Out+pos, Size-1-pos)) > 0)
+		pos += len;
+	Out[pos] = '\0';
+	Out[strcspn(Out, "\n")] = '\0';
+	close(fds[0]);
+
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status))
+		return -1;
+
+	return WEXITSTATUS(status);
+}
+
+// Stations i%3 == 0 are F4 calls, some with position, status or weather
+static void Station(int I, APRS_Station_t * Station) {
+	static const char * prefixes[] = { "F4", "DL1", "W2" };
+	char call[16];
+	int ssid = I%16;
+
+	snprintf(call, sizeof(call), "%s%c%c", prefixes[I%3], 'A'+(I/3)%26, 'A'+(I/78)%26);
+	if (ssid)
+		snprintf(call+strlen(call), sizeof(call)-strlen(call), "-%d", ssid);
+
+	bzero(Station, sizeof(APRS_Station_t));
+	AX25_Str_To_Addr(call, &Station->callid);
+	AX25_Norm_Addr(&Station->callid);
+	Station->timestamp = 1700000000 + I*60;
+	Station->symbol[0] = '/';
+	Station->symbol[1] = '>';
+	if (I%4) {
+		Station->position.latitude = (45<<22) + I*1000;
+		Station->position.longitude = (2<<22) - I*1000;
+		Station->position.altitude = I;
+	}
+	if (I%2)
+		snprintf(Station->status, sizeof(Station->status), "Station %d status", I);
+	if (!(I%5)) {
+		Station->weather.temp = 50 + I%40;
+		Station->weather.wind_dir = I%360;
+	}
+}
+
+static int Fill(const char * Path) {
+	APRS_Station_t stations[N_STATIONS];
+	APRS_t * aprs;
+	int i, ret;
+
+	if (!(aprs = APRS_Sim_Open(Path)))
+		return -1;
+	for (i=0 ; i<N_STATIONS ; i++)
+		Station(i, &stations[i]);
+	ret = APRS_Log_Import(APRS_Sim_Db(aprs), stations, N_STATIONS);
+	APRS_Sim_Close(aprs);
+
+	return ret;
+}
+
+static int Same_Files(const char * Path1, const char * Path2) {
+	FILE * f1 = fopen(Path1, "rb"), * f2 = fopen(Path2, "rb");
+	int c1 = 0, c2 = 0;
+
+	while (f1 && f2 && (c1 = fgetc(f1)) == (c2 = fgetc(f2)) && c1 != EOF);
+	if (f1)
+		fclose(f1);
+	if (f2)
+		fclose(f2);
+
+	return f1 && f2 && c1 == EOF && c2 == EOF;
+}
+
+// Records of Path2 against Path1, return number of stations compared
+static int Compare_Dbs(const char * Path1, const char * Path2) {
+	APRS_t * aprs1 = APRS_Sim_Open(Path1), * aprs2 = APRS_Sim_Open(Path2);
+	APRS_Station_t station;
+	AX25_Addr_t filter, cursor;
+	char call[16];
+	DBT key, data;
+	DB * db;
+	int n = 0, flags = R_FIRST;
+
+	CHECK(aprs1 && aprs2, "stations DBs not opened");
+	if (!aprs1 || !aprs2) {
+		APRS_Sim_Close(aprs1);
+		APRS_Sim_Close(aprs2);
+		return -1;
+	}
+
+	db = APRS_Sim_Db(aprs2);
+	AX25_Str_To_Addr("*-*", &filter);
+	while (!APRS_Log_Match(APRS_Sim_Db(aprs1), &filter, &cursor, flags, &station)) {
+		AX25_Addr_To_Str(&station.callid, call, sizeof(call));
+		key.data = &cursor;
+		key.size = sizeof(AX25_Addr_t);
+		if (db->get(db, &key, &data, 0))
+			CHECK(0, "%s not imported", call);
+		else
+			CHECK(data.size == sizeof(APRS_Station_t) && !memcmp(data.data, &station, sizeof(APRS_Station_t)),
+					"%s imported record differs", call);
+		flags = R_NEXT;
+		n++;
+	}
+	CHECK(!APRS_Log_Check(db, 4*N_STATIONS), "imported DB not consistent");
+
+	APRS_Sim_Close(aprs1);
+	APRS_Sim_Close(aprs2);
+
+	return n;
+}
+
+int main(int argc, char ** argv) {
+	char dir[64], a[80], b[80], exported[80], filtered[80], copy[80];
+	char pty[64], out[256], expect[64];
+	int ret;
+
+	if (argc != 4) {
+		fprintf(stderr, "Usage : %s kiss_sim python kiss_stations.py\n", argv[0]);
+		return 2;
+	}
+	Sim_Path = argv[1];
+	Python = argv[2];
+	Script = argv[3];
+	atexit(Stop_Sim);
+
+	esp_log_level_set("*", ESP_LOG_NONE);
+
+	snprintf(dir, sizeof(dir), "%s/stationsXXXXXX", getenv("TMPDIR") && strlen(getenv("TMPDIR")) < 32 ? getenv("TMPDIR") : "/tmp");
+	if (!mkdtemp(dir)) {
+		perror(dir);
+		return 1;
+	}
+	snprintf(a, sizeof(a), "%s/a", dir);
+	snprintf(b, sizeof(b), "%s/b", dir);
+	snprintf(exported, sizeof(exported), "%s/export.db", dir);
+	snprintf(filtered, sizeof(filtered), "%s/f4.db", dir);
+	snprintf(copy, sizeof(copy), "%s/copy.db", dir);
+
+	ret = Fill(a);
+	CHECK(ret == N_STATIONS, "%d stations written in DB", ret);
+
+	// Round trip and filtered export of the filled DB
+	if (!Start_Sim(a, pty, sizeof(pty))) {
+		ret = Tool(out, sizeof(out), "roundtrip", pty, exported, NULL);
+		snprintf(expect, sizeof(expect), "%d stations round trip ok", N_STATIONS);
+		CHECK(!ret && !strcmp(out, expect), "roundtrip exit %d : %s", ret, out);
+
+		ret = Tool(out, sizeof(out), "export", pty, filtered, "F4*-*", NULL);
+		snprintf(expect, sizeof(expect), "%d stations exported", N_STATIONS/3);
+		CHECK(!ret && !strcmp(out, expect), "filtered export exit %d : %s", ret, out);
+	} else
+		CHECK(0, "simulator not started");
+	Stop_Sim();
+
+	// Exported file into an empty DB, exported again
+	if (!Start_Sim(b, pty, sizeof(pty))) {
+		ret = Tool(out, sizeof(out), "import", pty, exported, NULL);
+		snprintf(expect, sizeof(expect), "%d stations imported, %d written", N_STATIONS, N_STATIONS);
+		CHECK(!ret && !strcmp(out, expect), "import exit %d : %s", ret, out);
+
+		ret = Tool(out, sizeof(out), "export", pty, copy, NULL);
+		CHECK(!ret && Same_Files(exported, copy), "export of imported DB differs, exit %d : %s", ret, out);
+	} else
+		CHECK(0, "simulator not started");
+	Stop_Sim();
+
+	ret = Compare_Dbs(a, b);
+	CHECK(ret == N_STATIONS, "%d stations compared", ret);
+
+	return Test_Result("kiss_stations");
+}
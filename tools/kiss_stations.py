@@ -0,0 +1,236 @@
+#!/usr/bin/env python3
+#
+# SPDX-License-Identifier: GPL-3.0-or-later
+#
+# ESP32s3APRS by F4JMZ
+#
+# tools/kiss_stations.py
+#
+# Copyright (C) 2025  Marc CAPDEVILLE (F4JMZ)
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Station DB export and import over the kiss port (see main/aprs_xfer.h)
+#
+#   kiss_stations.py export /dev/ttyACM1 stations.db [FILTER]
+#   kiss_stations.py import /dev/ttyACM1 stations.db
+#   kiss_stations.py roundtrip /dev/ttyACM1 stations.db
+#   kiss_stations.py list stations.db
+#
+# File format : "APRSDB", version, station size (16 bits le),
+# then for each station its image length (16 bits le) and image
+
+import os
+import select
+import sys
+import struct
+import termios
+import time
+import tty
+
+FEND = 0xc0
+FESC = 0xdb
+TFEND = 0xdc
+TFESC = 0xdd
+CMD_SETHW = 0x06
+
+VERSION = 1
+MAGIC = b"APRSDB"
+TIMEOUT = 10
+USAGE = "usage: kiss_stations.py export|import|roundtrip PORT FILE [FILTER] | list FILE"
+
+
+class Kiss:
+    def __init__(self, path):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        if os.isatty(self.fd):
+            tty.setraw(self.fd)
+            termios.tcflush(self.fd, termios.TCIOFLUSH)
+        self.frame = None
+        self.esc = False
+        self.frames = []
+
+    def close(self):
+        os.close(self.fd)
+
+    def send(self, payload):
+        out = bytearray([FEND, CMD_SETHW])
+        for c in payload:
+            if c == FEND:
+                out += bytes([FESC, TFEND])
+            elif c == FESC:
+                out += bytes([FESC, TFESC])
+            else:
+                out.append(c)
+        out.append(FEND)
+        while out:
+            n = os.write(self.fd, out)
+            out = out[n:]
+
+    # Next SetHardware payload from TNC, data frames are ignored
+    def recv(self, timeout=TIMEOUT):
+        end = time.monotonic() + timeout
+        while True:
+            while self.frames:
+                frame = self.frames.pop(0)
+                if frame and frame[0] & 0x0f == CMD_SETHW and len(frame) > 1:
+                    return bytes(frame[1:])
+            left = end - time.monotonic()
+            if left <= 0 or not select.select([self.fd], [], [], left)[0]:
+                raise TimeoutError("No answer from TNC")
+            for c in os.read(self.fd, 4096):
+                self.decode(c)
+
+    def decode(self, c):
+        if c == FEND:
+            if self.frame:
+                self.frames.append(self.frame)
+            self.frame = bytearray()
+            self.esc = False
+        elif self.frame is None:
+            pass
+        elif self.esc:
+            self.frame.append(FEND if c == TFEND else FESC if c == TFESC else c)
+            self.esc = False
+        elif c == FESC:
+            self.esc = True
+        else:
+            self.frame.append(c)
+
+
+def header(kiss):
+    kiss.send(b"H")
+    while True:
+        p = kiss.recv()
+        if p[0] == ord("H") and len(p) >= 4:
+            if p[1] != VERSION:
+                raise ValueError("Unsupported transfer version %d" % p[1])
+            return struct.unpack_from("<H", p, 2)[0]
+
+
+def export(kiss, filter=b""):
+    kiss.send(b"A")
+    kiss.send(b"E" + filter)
+    size = None
+    stations = []
+    while True:
+        p = kiss.recv()
+        if p[0] == ord("H") and len(p) >= 4:
+            if p[1] != VERSION:
+                raise ValueError("Unsupported transfer version %d" % p[1])
+            size = struct.unpack_from("<H", p, 2)[0]
+        elif p[0] == ord("S") and size is not None:
+            stations.append(p[1:])
+        elif p[0] == ord("D") and len(p) >= 6 and size is not None:
+            count, status = struct.unpack_from("<IB", p, 1)
+            if status or count != len(stations):
+                raise IOError("Export failed (%d/%d stations, status %d)" % (len(stations), count, status))
+            return size, stations
+
+
+def import_(kiss, size, stations):
+    if header(kiss) != size:
+        raise ValueError("Station size mismatch, file and TNC firmware differ")
+    kiss.send(b"A")
+    for image in stations:
+        kiss.send(b"I" + image)
+    kiss.send(b"W")
+    while True:
+        p = kiss.recv()
+        if p[0] == ord("K") and len(p) >= 6:
+            count, status = struct.unpack_from("<IB", p, 1)
+            if status:
+                raise IOError("Import failed after %d stations" % count)
+            return count
+
+
+def save(path, size, stations):
+    with open(path, "wb") as f:
+        f.write(MAGIC + struct.pack("<BH", VERSION, size))
+        for image in stations:
+            f.write(struct.pack("<H", len(image)) + image)
+
+
+def load(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:len(MAGIC)] != MAGIC:
+        raise ValueError("Not a station file")
+    version, size = struct.unpack_from("<BH", data, len(MAGIC))
+    if version != VERSION:
+        raise ValueError("Unsupported file version %d" % version)
+    pos = len(MAGIC) + 3
+    stations = []
+    while pos < len(data):
+        n = struct.unpack_from("<H", data, pos)[0]
+        stations.append(data[pos + 2:pos + 2 + n])
+        pos += 2 + n
+    return size, stations
+
+
+# APRS_Station_t starts with time_t timestamp (64 bits) and callid
+def describe(image):
+    image = image + bytes(15 - min(len(image), 15))
+    timestamp = struct.unpack_from("<q", image, 0)[0]
+    call = "".join(chr(c >> 1) for c in image[8:14]).strip()
+    ssid = (image[14] >> 1) & 0x0f
+    if ssid:
+        call += "-%d" % ssid
+    return "%-10s %s" % (call, time.strftime("%Y-%m-%d %H:%M:%S", time.gmtime(timestamp)))
+
+
+def main(argv):
+    if len(argv) < 3 or argv[1] not in ("export", "import", "roundtrip", "list"):
+        print(USAGE, file=sys.stderr)
+        return 2
+
+    if argv[1] == "list":
+        size, stations = load(argv[2])
+        for image in stations:
+            print(describe(image))
+        print("%d stations" % len(stations))
+        return 0
+
+    if len(argv) < 4:
+        print("missing FILE", file=sys.stderr)
+        return 2
+
+    kiss = Kiss(argv[2])
+    try:
+        if argv[1] == "export":
+            size, stations = export(kiss, argv[4].encode() if len(argv) > 4 else b"")
+            save(argv[3], size, stations)
+            print("%d stations exported" % len(stations))
+        elif argv[1] == "import":
+            size, stations = load(argv[3])
+            count = import_(kiss, size, stations)
+            print("%d stations imported, %d written" % (len(stations), count))
+        else:
+            # Export, import back and check a second export is identical
+            size, stations = export(kiss)
+            save(argv[3], size, stations)
+            import_(kiss, size, stations)
+            size2, stations2 = export(kiss)
+            if size2 != size or stations2 != stations:
+                print("Round trip mismatch", file=sys.stderr)
+                return 1
+            print("%d stations round trip ok" % len(stations))
+    finally:
+        kiss.close()
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))